@@ -24,6 +24,7 @@
 
 #include <libinfinity/server/infd-filesystem-storage.h>
 #include <libinfinity/server/infd-filesystem-account-storage.h>
+#include <libinfinity/common/inf-timing-policy.h>
 #include <libinfinity/inf-config.h>
 #include <libinfinity/inf-i18n.h>
 
@@ -75,6 +76,7 @@ infinoted_config_reload(InfinotedRun* run,
   InfdFilesystemStorage* filesystem_storage;
   InfdFilesystemAccountStorage* filesystem_account_storage;
   gchar* root_directory;
+  gchar* index_file;
   gboolean result;
 
 #ifdef G_OS_WIN32
@@ -82,6 +84,7 @@ infinoted_config_reload(InfinotedRun* run,
 #endif
   gchar* plugin_path;
   InfinotedPluginManager* plugin_manager;
+  InfTimingPolicy* timing_policy;
 
   /* Note that this opens a new log handle to the log file. */
   startup = infinoted_startup_new(NULL, NULL, error);
@@ -104,6 +107,11 @@ infinoted_config_reload(InfinotedRun* run,
       infinoted_startup_free(startup);
       return FALSE;
     }
+
+    /* The run owns the parameters from now on, also if reloading fails
+     * later, so that they are not leaked. */
+    if(run->dh_params == NULL)
+      run->dh_params = dh_params;
   }
 
   if((startup->options->listen_address != NULL &&
@@ -221,8 +229,20 @@ infinoted_config_reload(InfinotedRun* run,
   {
     /* Root directory changes. I don't think this is actually useful, but
      * all code is there, so let's support it. */
-    filesystem_storage =
-      infd_filesystem_storage_new(startup->options->root_directory);
+    index_file = g_build_filename(
+      g_get_home_dir(),
+      ".infinoted",
+      "storage-index",
+      NULL
+    );
+
+    filesystem_storage = infd_filesystem_storage_new_with_index(
+      startup->options->root_directory,
+      index_file
+    );
+
+    g_free(index_file);
+
     filesystem_account_storage = infd_filesystem_account_storage_new();
 
     result = infd_filesystem_account_storage_set_filesystem(
@@ -451,6 +471,17 @@ infinoted_config_reload(InfinotedRun* run,
 
   run->plugin_manager = plugin_manager;
 
+  /* The directory shares its timing policy with sessions and the
+   * communication registry via its communication manager */
+  g_object_get(
+    G_OBJECT(run->directory),
+    "timing-policy", &timing_policy,
+    NULL
+  );
+
+  infinoted_options_apply_timing_policy(startup->options, timing_policy);
+  g_object_unref(timing_policy);
+
 #ifdef LIBINFINITY_HAVE_LIBDAEMON
   /* Remember whether we have been daemonized; this is not a config file
    * option, so not properly set in our newly created startup. */
@@ -20,10 +20,58 @@
 #include <infinoted/infinoted-dh-params.h>
 #include <infinoted/infinoted-util.h>
 #include <libinfinity/common/inf-cert-util.h>
+#include <libinfinity/common/inf-error.h>
 #include <libinfinity/inf-i18n.h>
 
 #include <glib/gstdio.h>
 #include <sys/stat.h>
+#include <time.h>
+
+/* The 2048 bit finite field Diffie-Hellman group from RFC 7919, used until
+ * the server has generated its own parameters. */
+static const gchar INFINOTED_DH_PARAMS_FFDHE2048[] =
+  "-----BEGIN DH PARAMETERS-----\n"
+  "MIIBCAKCAQEA//////////+t+FRYortKmq/cViAnPTzx2LnFg84tNpWp4TZBFGQz\n"
+  "+8yTnc4kmz75fS/jY2MMddj2gbICrsRhetPfHtXV/WVhJDP1H18GbtCFY2VVPe0a\n"
+  "87VXE15/V8k1mE8McODmi3fipona8+/och3xWKE2rec1MKzKT0g6eXq8CrGCsyT7\n"
+  "YdEIqUuyyOP7uWrat2DX9GgdT0Kj3jlN9K5W7edjcrsZCwenyO4KbXCeAvzhzffi\n"
+  "7MA0BM0oNC9hkXL+nOmFg/+OTxIy7vKBg8P+OxtMb61zO7X8vC7CIAXFjvGDfRaD\n"
+  "ssbzSibBsu/6iGtCOGEoXJf//////////wIBAg==\n"
+  "-----END DH PARAMETERS-----\n";
+
+static gchar*
+infinoted_dh_params_get_filename(void)
+{
+  return g_build_filename(g_get_home_dir(), ".infinoted", "dh.pem", NULL);
+}
+
+static gnutls_dh_params_t
+infinoted_dh_params_builtin(GError** error)
+{
+  gnutls_dh_params_t params;
+  gnutls_datum_t datum;
+  int res;
+
+  res = gnutls_dh_params_init(&params);
+  if(res != GNUTLS_E_SUCCESS)
+  {
+    inf_gnutls_set_error(error, res);
+    return NULL;
+  }
+
+  datum.data = (unsigned char*)INFINOTED_DH_PARAMS_FFDHE2048;
+  datum.size = sizeof(INFINOTED_DH_PARAMS_FFDHE2048) - 1;
+
+  res = gnutls_dh_params_import_pkcs3(params, &datum, GNUTLS_X509_FMT_PEM);
+  if(res != GNUTLS_E_SUCCESS)
+  {
+    gnutls_dh_params_deinit(params);
+    inf_gnutls_set_error(error, res);
+    return NULL;
+  }
+
+  return params;
+}
 
 /**
  * infinoted_dh_params_ensure:
@@ -35,14 +83,14 @@
  * Ensures that DH parameters are set in the certificate credentials. If
  * *@dh_params is non-%NULL, then this simply sets *@dh_params in
  * @credentials. Otherwise it tries to read the server's cached DH params
- * from disk. If successful, it sets them in @credentials and stores them in
- * *@dh_params. If not, then it generates new DH params, writes them to the
- * disk cache and sets them into *@dh_params. If generation fails, the
- * function returns %FALSE and @error is set.
+ * from disk. If there are none, the 2048 bit group from RFC 7919 is used.
+ * The parameters are set in @credentials and stored in *@dh_params. This
+ * function does not generate new parameters, so it does not block; use
+ * infinoted_dh_params_generate() in a worker thread for that. If the
+ * built-in group cannot be loaded, the function returns %FALSE and @error
+ * is set.
  *
- * @log is used to write a log message about the parameters being generated
- * if they are not cached, so the user knows what's going on during this
- * lengthy operation.
+ * @log is used to write a log message if the built-in parameters are used.
  *
  * Returns: %TRUE on success or %FALSE on error.
  */
@@ -54,7 +102,6 @@ infinoted_dh_params_ensure(InfinotedLog* log,
 {
   gnutls_certificate_credentials_t creds;
   gchar* filename;
-  struct stat st;
 
   creds = inf_certificate_credentials_get(credentials);
   if(*dh_params != NULL)
@@ -63,41 +110,97 @@ infinoted_dh_params_ensure(InfinotedLog* log,
     return TRUE;
   }
 
-  filename =
-    g_build_filename(g_get_home_dir(), ".infinoted", "dh.pem", NULL);
-
-  if(g_stat(filename, &st) == 0)
-  {
-    /* DH params expire every week */
-    /*if(st.st_mtime + 60 * 60 * 24 * 7 > time(NULL))*/
-      *dh_params = inf_cert_util_read_dh_params(filename, NULL);
-  }
+  /* Expired parameters are still good enough to start with; they are
+   * replaced once new ones have been generated. */
+  filename = infinoted_dh_params_get_filename();
+  *dh_params = inf_cert_util_read_dh_params(filename, NULL);
+  g_free(filename);
 
   if(*dh_params == NULL)
   {
-    infinoted_util_create_dirname(filename, NULL);
+    *dh_params = infinoted_dh_params_builtin(error);
+    if(*dh_params == NULL)
+      return FALSE;
 
     if(log != NULL)
     {
       infinoted_log_info(
-        log, _("Generating 2048 bit Diffie-Hellman parameters..."));
+        log,
+        _("Using built-in Diffie-Hellman parameters until own parameters "
+          "have been generated")
+      );
     }
+  }
 
-    *dh_params = inf_cert_util_create_dh_params(error);
+  gnutls_certificate_set_dh_params(creds, *dh_params);
+  return TRUE;
+}
 
-    if(*dh_params == NULL)
-    {
-      g_free(filename);
-      return FALSE;
-    }
+/**
+ * infinoted_dh_params_get_remaining_lifetime:
+ *
+ * Returns the number of seconds until the server's cached DH parameters
+ * should be replaced by new ones. Parameters are replaced every
+ * %INFINOTED_DH_PARAMS_LIFETIME seconds. If there are no cached parameters,
+ * or they are expired already, the function returns 0.
+ *
+ * Returns: The remaining lifetime of the cached DH parameters, in seconds.
+ */
+guint
+infinoted_dh_params_get_remaining_lifetime(void)
+{
+  gchar* filename;
+  GStatBuf st;
+  time_t now;
+  int ret;
 
-    inf_cert_util_write_dh_params(*dh_params, filename, NULL);
-  }
+  filename = infinoted_dh_params_get_filename();
+  ret = g_stat(filename, &st);
+  g_free(filename);
+
+  if(ret != 0)
+    return 0;
+
+  now = time(NULL);
+  if(st.st_mtime > now)
+    return INFINOTED_DH_PARAMS_LIFETIME;
+  if(now - st.st_mtime >= INFINOTED_DH_PARAMS_LIFETIME)
+    return 0;
 
+  return INFINOTED_DH_PARAMS_LIFETIME - (now - st.st_mtime);
+}
+
+/**
+ * infinoted_dh_params_generate:
+ * @error: Location to store error information, if any.
+ *
+ * Generates new 2048 bit DH parameters and writes them to the server's
+ * cache on disk, so that infinoted_dh_params_ensure() picks them up the
+ * next time the server starts. This takes a long time, so it should be
+ * called in a worker thread. It does not access any shared state and can
+ * safely be called from any thread. If generation fails, the function
+ * returns %NULL and @error is set. Failing to write the cache is not an
+ * error.
+ *
+ * Returns: New DH params to be freed with gnutls_dh_params_deinit(), or
+ * %NULL on error.
+ */
+gnutls_dh_params_t
+infinoted_dh_params_generate(GError** error)
+{
+  gnutls_dh_params_t params;
+  gchar* filename;
+
+  params = inf_cert_util_create_dh_params(error);
+  if(params == NULL)
+    return NULL;
+
+  filename = infinoted_dh_params_get_filename();
+  infinoted_util_create_dirname(filename, NULL);
+  inf_cert_util_write_dh_params(params, filename, NULL);
   g_free(filename);
 
-  gnutls_certificate_set_dh_params(creds, *dh_params);
-  return TRUE;
+  return params;
 }
 
 /* vim:set et sw=2 ts=2: */
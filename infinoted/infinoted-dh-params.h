@@ -29,12 +29,26 @@
 
 G_BEGIN_DECLS
 
+/**
+ * INFINOTED_DH_PARAMS_LIFETIME:
+ *
+ * The number of seconds after which the server generates new DH
+ * parameters.
+ */
+#define INFINOTED_DH_PARAMS_LIFETIME (7 * 24 * 60 * 60)
+
 gboolean
 infinoted_dh_params_ensure(InfinotedLog* log,
                            InfCertificateCredentials* creds,
                            gnutls_dh_params_t* dh_params,
                            GError** error);
 
+guint
+infinoted_dh_params_get_remaining_lifetime(void);
+
+gnutls_dh_params_t
+infinoted_dh_params_generate(GError** error);
+
 G_END_DECLS
 
 #endif /* __INFINOTED_DH_PARAMS_H__ */
@@ -140,6 +140,63 @@ const InfinotedParameterInfo INFINOTED_OPTIONS[] = {
        "the configuration file (one section for each plugin), or with the "
        "--plugin-parameter option. [Default=note-text]"),
     N_("PLUGIN-NAME")
+  }, {
+    "save-timeout",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, save_timeout),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Number of seconds a document needs to be idle before it is stored "
+       "to disk and unloaded from memory. Unless --fixed-timing is given, "
+       "this is shortened when many clients are connected. [Default=60]"),
+    N_("SECONDS")
+  }, {
+    "noop-interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, noop_interval),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Number of seconds after which the server tells other users about "
+       "the changes it has processed, if it has not done so otherwise. "
+       "Unless --fixed-timing is given, this is lengthened when many "
+       "clients are connected. [Default=30]"),
+    N_("SECONDS")
+  }, {
+    "caret-update-interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, caret_update_interval),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Minimum number of milliseconds between two caret updates of a user "
+       "on the server. Unless --fixed-timing is given, this is raised to the "
+       "round trip time of client connections. [Default=0]"),
+    N_("MILLISECONDS")
+  }, {
+    "message-queue-limit",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedOptions, message_queue_limit),
+    infinoted_parameter_convert_positive,
+    0,
+    N_("Maximum number of messages of one document or directory which are "
+       "queued on a client connection at the same time. Unless "
+       "--fixed-timing is given, this is raised on high-latency "
+       "connections. [Default=5]"),
+    N_("NUMBER")
+  }, {
+    "fixed-timing",
+    INFINOTED_PARAMETER_BOOLEAN,
+    0,
+    offsetof(InfinotedOptions, fixed_timing),
+    infinoted_parameter_convert_boolean,
+    0,
+    N_("Always use the configured timing values, instead of adapting them "
+       "to the measured round trip time and the number of connected "
+       "clients."),
+    NULL
   }, {
     "password",
     INFINOTED_PARAMETER_STRING,
@@ -978,6 +1035,11 @@ infinoted_options_new(const gchar* const* config_files,
   options->plugins = g_malloc(2 * sizeof(gchar*));
   options->plugins[0] = g_strdup("note-text");
   options->plugins[1] = NULL;
+  options->save_timeout = 60;
+  options->noop_interval = 30;
+  options->caret_update_interval = 0;
+  options->message_queue_limit = 5;
+  options->fixed_timing = FALSE;
   options->password = NULL;
   options->password_len = 0;
 #ifdef LIBINFINITY_HAVE_PAM
@@ -1062,4 +1124,28 @@ infinoted_options_drop_config_file(InfinotedOptions* options)
   options->config_key_file = NULL;
 }
 
+/**
+ * infinoted_options_apply_timing_policy:
+ * @options: A #InfinotedOptions.
+ * @policy: The #InfTimingPolicy to configure.
+ *
+ * Sets the timing values of @policy to the ones given in @options. Unless
+ * the fixed-timing option is set, this also makes @policy adapt the values
+ * to the measured round trip time and load.
+ */
+void
+infinoted_options_apply_timing_policy(const InfinotedOptions* options,
+                                      InfTimingPolicy* policy)
+{
+  g_object_set(
+    G_OBJECT(policy),
+    "save-timeout", MIN(options->save_timeout, G_MAXUINT / 1000) * 1000,
+    "noop-interval", options->noop_interval,
+    "caret-update-interval", options->caret_update_interval,
+    "inner-queue-limit", options->message_queue_limit,
+    "adaptive", !options->fixed_timing,
+    NULL
+  );
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -21,6 +21,7 @@
 #define __INFINOTED_OPTIONS_H__
 
 #include <libinfinity/common/inf-xmpp-connection.h>
+#include <libinfinity/common/inf-timing-policy.h>
 #include <libinfinity/inf-config.h>
 
 #include <glib.h>
@@ -45,6 +46,12 @@ struct _InfinotedOptions {
 
   gchar** plugins;
 
+  guint save_timeout;
+  guint noop_interval;
+  guint caret_update_interval;
+  guint message_queue_limit;
+  gboolean fixed_timing;
+
   gchar* password;
   gsize password_len;
 #ifdef LIBINFINITY_HAVE_PAM
@@ -84,6 +91,10 @@ infinoted_options_error_quark(void);
 void
 infinoted_options_drop_config_file(InfinotedOptions* options);
 
+void
+infinoted_options_apply_timing_policy(const InfinotedOptions* options,
+                                      InfTimingPolicy* policy);
+
 G_END_DECLS
 
 #endif /* __INFINOTED_OPTIONS_H__ */
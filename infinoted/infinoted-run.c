@@ -25,6 +25,7 @@
 #include <libinfinity/server/infd-filesystem-account-storage.h>
 #include <libinfinity/server/infd-tcp-server.h>
 #include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-timing-policy.h>
 #include <libinfinity/common/inf-discovery-avahi.h>
 #include <libinfinity/common/inf-xmpp-manager.h>
 
@@ -38,6 +39,173 @@
 static const guint8 INFINOTED_RUN_IPV6_ANY_ADDR[16] =
   { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 
+typedef struct _InfinotedRunDhParamsResult InfinotedRunDhParamsResult;
+struct _InfinotedRunDhParamsResult {
+  gnutls_dh_params_t dh_params;
+  GError* error;
+};
+
+static void
+infinoted_run_schedule_dh_params(InfinotedRun* run);
+
+static void
+infinoted_run_dh_params_timeout_func(gpointer user_data);
+
+static void
+infinoted_run_dh_params_result_free(gpointer data)
+{
+  InfinotedRunDhParamsResult* result;
+  result = (InfinotedRunDhParamsResult*)data;
+
+  if(result->dh_params != NULL)
+    gnutls_dh_params_deinit(result->dh_params);
+  if(result->error != NULL)
+    g_error_free(result->error);
+
+  g_slice_free(InfinotedRunDhParamsResult, result);
+}
+
+/* Runs in a worker thread */
+static void
+infinoted_run_dh_params_run_func(gpointer* run_data,
+                                 GDestroyNotify* run_notify,
+                                 gpointer user_data)
+{
+  InfinotedRunDhParamsResult* result;
+
+  result = g_slice_new(InfinotedRunDhParamsResult);
+  result->error = NULL;
+  result->dh_params = infinoted_dh_params_generate(&result->error);
+
+  *run_data = result;
+  *run_notify = infinoted_run_dh_params_result_free;
+}
+
+static void
+infinoted_run_dh_params_done_func(gpointer run_data,
+                                  gpointer user_data)
+{
+  InfinotedRun* run;
+  InfinotedRunDhParamsResult* result;
+
+  run = (InfinotedRun*)user_data;
+  result = (InfinotedRunDhParamsResult*)run_data;
+
+  run->dh_params_generator = NULL;
+
+  if(result->error != NULL)
+  {
+    infinoted_log_error(
+      run->startup->log,
+      _("Failed to generate Diffie-Hellman parameters: %s"),
+      result->error->message
+    );
+  }
+  else
+  {
+    /* The credentials only hold a pointer to the parameters, so keep the
+     * old ones around until the next rotation, for handshakes that might
+     * still be using them. */
+    if(run->prev_dh_params != NULL)
+      gnutls_dh_params_deinit(run->prev_dh_params);
+    run->prev_dh_params = run->dh_params;
+    run->dh_params = result->dh_params;
+    result->dh_params = NULL;
+
+    if(run->startup->credentials != NULL)
+    {
+      gnutls_certificate_set_dh_params(
+        inf_certificate_credentials_get(run->startup->credentials),
+        run->dh_params
+      );
+    }
+
+    infinoted_log_info(
+      run->startup->log,
+      _("New Diffie-Hellman parameters are in use")
+    );
+  }
+
+  /* If generation failed, then the cache file is still expired, and we try
+   * again after a full lifetime. */
+  if(result->error != NULL)
+  {
+    run->dh_params_timeout = inf_io_add_timeout(
+      INF_IO(run->io),
+      INFINOTED_DH_PARAMS_LIFETIME * 1000u,
+      infinoted_run_dh_params_timeout_func,
+      run,
+      NULL
+    );
+  }
+  else
+  {
+    infinoted_run_schedule_dh_params(run);
+  }
+}
+
+static void
+infinoted_run_dh_params_timeout_func(gpointer user_data)
+{
+  InfinotedRun* run;
+  run = (InfinotedRun*)user_data;
+
+  run->dh_params_timeout = NULL;
+  infinoted_run_schedule_dh_params(run);
+}
+
+static void
+infinoted_run_generate_dh_params(InfinotedRun* run)
+{
+  GError* error;
+
+  g_assert(run->dh_params_generator == NULL);
+
+  run->dh_params_generator = inf_async_operation_new(
+    INF_IO(run->io),
+    infinoted_run_dh_params_run_func,
+    infinoted_run_dh_params_done_func,
+    run
+  );
+
+  error = NULL;
+  if(!inf_async_operation_start(run->dh_params_generator, &error))
+  {
+    run->dh_params_generator = NULL;
+
+    infinoted_log_error(
+      run->startup->log,
+      _("Failed to generate Diffie-Hellman parameters: %s"),
+      error->message
+    );
+
+    g_error_free(error);
+  }
+}
+
+static void
+infinoted_run_schedule_dh_params(InfinotedRun* run)
+{
+  guint remaining;
+
+  remaining = infinoted_dh_params_get_remaining_lifetime();
+
+  if(remaining == 0)
+  {
+    infinoted_run_generate_dh_params(run);
+  }
+  else
+  {
+    run->dh_params_timeout = inf_io_add_timeout(
+      INF_IO(run->io),
+      remaining * 1000u,
+      infinoted_run_dh_params_timeout_func,
+      run,
+      NULL
+    );
+  }
+}
+
 static gboolean
 infinoted_run_load_directory(InfinotedRun* run,
                              InfinotedStartup* startup,
@@ -46,6 +214,8 @@ infinoted_run_load_directory(InfinotedRun* run,
   InfdFilesystemStorage* storage;
   InfdFilesystemAccountStorage* account_storage;
   InfCommunicationManager* communication_manager;
+  InfTimingPolicy* timing_policy;
+  gchar* index_file;
 
 #ifdef G_OS_WIN32
   gchar* module_path;
@@ -53,7 +223,19 @@ infinoted_run_load_directory(InfinotedRun* run,
   gchar* plugin_path;
   gboolean result;
 
-  storage = infd_filesystem_storage_new(startup->options->root_directory);
+  index_file = g_build_filename(
+    g_get_home_dir(),
+    ".infinoted",
+    "storage-index",
+    NULL
+  );
+
+  storage = infd_filesystem_storage_new_with_index(
+    startup->options->root_directory,
+    index_file
+  );
+
+  g_free(index_file);
 
   communication_manager = inf_communication_manager_new();
 
@@ -67,6 +249,17 @@ infinoted_run_load_directory(InfinotedRun* run,
 
   infd_directory_enable_chat(run->directory, TRUE);
 
+  /* The directory shares its timing policy with sessions and the
+   * communication registry via its communication manager */
+  g_object_get(
+    G_OBJECT(run->directory),
+    "timing-policy", &timing_policy,
+    NULL
+  );
+
+  infinoted_options_apply_timing_policy(startup->options, timing_policy);
+  g_object_unref(timing_policy);
+
   g_object_unref(communication_manager);
 
   /* Load server plugins via plugin manager */
@@ -228,8 +421,12 @@ infinoted_run_new(InfinotedStartup* startup,
   GError* local_error;
 
   run = g_slice_new(InfinotedRun);
+  run->start_time = g_get_monotonic_time();
   run->startup = startup;
   run->dh_params = NULL;
+  run->prev_dh_params = NULL;
+  run->dh_params_generator = NULL;
+  run->dh_params_timeout = NULL;
 
   if(infinoted_run_load_directory(run, startup, error) == FALSE)
   {
@@ -321,6 +518,11 @@ infinoted_run_free(InfinotedRun* run)
   if(inf_standalone_io_loop_running(run->io))
     inf_standalone_io_loop_quit(run->io);
 
+  if(run->dh_params_timeout != NULL)
+    inf_io_remove_timeout(INF_IO(run->io), run->dh_params_timeout);
+  if(run->dh_params_generator != NULL)
+    inf_async_operation_free(run->dh_params_generator);
+
   if(run->xmpp6 != NULL)
   {
     g_object_get(G_OBJECT(run->xmpp6), "status", &status, NULL);
@@ -355,6 +557,8 @@ infinoted_run_free(InfinotedRun* run)
 
   if(run->dh_params != NULL)
     gnutls_dh_params_deinit(run->dh_params);
+  if(run->prev_dh_params != NULL)
+    gnutls_dh_params_deinit(run->prev_dh_params);
 
   if(run->startup != NULL)
     infinoted_startup_free(run->startup);
@@ -368,8 +572,9 @@ infinoted_run_free(InfinotedRun* run)
  *
  * Starts the infinote server. This runs in a loop until infinoted_run_stop()
  * is called. This may fail in theory, but hardly does in practise. If it
- * fails, it prints an error message to stderr and returns. It may also block
- * before starting to generate DH parameters for key exchange.
+ * fails, it prints an error message to stderr and returns. If the server's
+ * DH parameters for key exchange are missing or expired, new ones are
+ * generated in a background thread while the server is already running.
  */
 void
 infinoted_run_start(InfinotedRun* run)
@@ -402,6 +607,9 @@ infinoted_run_start(InfinotedRun* run)
       g_error_free(error);
       return;
     }
+
+    if(run->dh_params_generator == NULL && run->dh_params_timeout == NULL)
+      infinoted_run_schedule_dh_params(run);
   }
 
   /* Open server sockets, accepting incoming connections... TODO: Prevent
@@ -467,6 +675,15 @@ infinoted_run_start(InfinotedRun* run)
   if(error4 != NULL) g_error_free(error4);
   if(error6 != NULL) g_error_free(error6);
 
+  if(run->xmpp4 != NULL || run->xmpp6 != NULL)
+  {
+    infinoted_log_info(
+      run->startup->log,
+      _("Server started in %.3f seconds"),
+      (g_get_monotonic_time() - run->start_time) / 1e6
+    );
+  }
+
   /* Make sure messages are shown. This explicit flush is for example
    * required when running in an MSYS shell on Windows. */
   fflush(stderr);
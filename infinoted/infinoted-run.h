@@ -28,6 +28,7 @@
 #include <libinfinity/server/infd-server-pool.h>
 #include <libinfinity/server/infd-directory.h>
 #include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-async-operation.h>
 #include <libinfinity/common/inf-discovery-avahi.h>
 
 #include <glib.h>
@@ -48,6 +49,14 @@ struct _InfinotedRun {
   InfdXmppServer* xmpp6;
   gnutls_dh_params_t dh_params;
 
+  /* Previous DH parameters, kept alive for handshakes that were started
+   * before the last rotation. */
+  gnutls_dh_params_t prev_dh_params;
+  InfAsyncOperation* dh_params_generator;
+  InfIoTimeout* dh_params_timeout;
+
+  gint64 start_time;
+
 #ifdef LIBINFINITY_HAVE_AVAHI
   InfDiscoveryAvahi* avahi;
 #endif
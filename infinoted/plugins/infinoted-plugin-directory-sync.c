@@ -219,9 +219,8 @@ infinoted_plugin_directory_sync_save(
 
   InfSession* session;
   InfTextBuffer* buffer;
-  InfTextChunk* chunk;
-  gchar* content;
-  gsize bytes;
+  InfTextBufferIter* iter;
+  GString* content;
   gchar* path;
   gchar* argv[4];
 
@@ -263,17 +262,24 @@ infinoted_plugin_directory_sync_save(
   g_object_get(G_OBJECT(info->proxy), "session", &session, NULL);
   buffer = INF_TEXT_BUFFER(inf_session_get_buffer(session));
 
-  /* TODO: Use the iterator API here, which should be less expensive */
-  chunk = inf_text_buffer_get_slice(
-    buffer,
-    0,
-    inf_text_buffer_get_length(buffer)
-  );
+  /* Collect the segments without copying each of them first */
+  content = g_string_sized_new(inf_text_buffer_get_length(buffer));
+  iter = inf_text_buffer_create_begin_iter(buffer);
+  if(iter != NULL)
+  {
+    do
+    {
+      g_string_append_len(
+        content,
+        inf_text_buffer_iter_peek_text(buffer, iter),
+        inf_text_buffer_iter_get_bytes(buffer, iter)
+      );
+    } while(inf_text_buffer_iter_next(buffer, iter));
 
-  content = inf_text_chunk_get_text(chunk, &bytes);
-  inf_text_chunk_free(chunk);
+    inf_text_buffer_destroy_iter(buffer, iter);
+  }
 
-  if(!g_file_set_contents(filename, content, bytes, error))
+  if(!g_file_set_contents(filename, content->str, content->len, error))
   {
     utf8 = infinoted_plugin_directory_sync_filename_to_utf8(filename);
     g_free(filename);
@@ -284,13 +290,13 @@ infinoted_plugin_directory_sync_save(
       utf8
     );
 
-    g_free(content);
+    g_string_free(content, TRUE);
     g_object_unref(session);
     g_free(utf8);
     return FALSE;
   }
 
-  g_free(content);
+  g_string_free(content, TRUE);
   g_object_unref(session);
 
   if(info->plugin->hook != NULL)
@@ -373,7 +373,7 @@ infinoted_plugin_document_stream_sync_text(
 {
   InfTextBuffer* buffer;
   InfTextBufferIter* iter;
-  gpointer text;
+  gconstpointer text;
   guint32 comm;
   guint32 len;
   gboolean alive;
@@ -395,9 +395,8 @@ infinoted_plugin_document_stream_sync_text(
       alive = infinoted_plugin_document_stream_send(stream, &len, 4);
       if(!alive) break;
 
-      text = inf_text_buffer_iter_get_text(buffer, iter);
+      text = inf_text_buffer_iter_peek_text(buffer, iter);
       alive = infinoted_plugin_document_stream_send(stream, text, len);
-      g_free(text);
       if(!alive) break;
     } while(inf_text_buffer_iter_next(buffer, iter));
 
@@ -84,9 +84,9 @@ infinoted_plugin_linekeeper_count_lines(InfTextBuffer* buffer)
 
   guint length;
   gsize bytes;
-  gchar* text;
-  gchar* pos;
-  gchar* new_pos;
+  const gchar* text;
+  const gchar* pos;
+  const gchar* new_pos;
   gunichar c;
 
   g_assert(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") == 0);
@@ -100,7 +100,7 @@ infinoted_plugin_linekeeper_count_lines(InfTextBuffer* buffer)
   {
     length = inf_text_buffer_iter_get_length(buffer, iter);
     bytes = inf_text_buffer_iter_get_bytes(buffer, iter);
-    text = inf_text_buffer_iter_get_text(buffer, iter);
+    text = inf_text_buffer_iter_peek_text(buffer, iter);
     pos = text + bytes;
 
     while(length > 0)
@@ -118,8 +118,6 @@ infinoted_plugin_linekeeper_count_lines(InfTextBuffer* buffer)
       bytes -= (pos - new_pos);
       pos = new_pos;
     }
-
-    g_free(text);
   } while(length == 0 && inf_text_buffer_iter_prev(buffer, iter));
 
   inf_text_buffer_destroy_iter(buffer, iter);
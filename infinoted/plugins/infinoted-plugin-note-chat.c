@@ -19,6 +19,7 @@
 
 #include <infinoted/infinoted-plugin-manager.h>
 #include <infinoted/infinoted-parameter.h>
+#include <infinoted/infinoted-log.h>
 
 #include <libinfinity/server/infd-filesystem-storage.h>
 #include <libinfinity/server/infd-chat-filesystem-format.h>
@@ -26,10 +27,14 @@
 
 #include <libinfinity/inf-i18n.h>
 
+#include <string.h>
+
 typedef struct _InfinotedPluginNoteChat InfinotedPluginNoteChat;
 struct _InfinotedPluginNoteChat {
   InfinotedPluginManager* manager;
   const InfdNotePlugin* plugin;
+  guint sync_history;
+  guint archive_size;
 };
 
 typedef enum InfinotedPluginNoteChatError {
@@ -138,6 +143,8 @@ infinoted_plugin_note_chat_info_initialize(gpointer plugin_info)
 
   plugin->manager = NULL;
   plugin->plugin = NULL;
+  plugin->sync_history = 0;
+  plugin->archive_size = 0;
 }
 
 static gboolean
@@ -196,8 +203,112 @@ infinoted_plugin_note_chat_deinitialize(gpointer plugin_info)
   }
 }
 
+static void
+infinoted_plugin_note_chat_session_added(const InfBrowserIter* iter,
+                                         InfSessionProxy* proxy,
+                                         gpointer plugin_info,
+                                         gpointer session_info)
+{
+  InfinotedPluginNoteChat* plugin;
+  InfdDirectory* directory;
+  InfdStorage* storage;
+  InfSession* session;
+  gchar* path;
+  gchar* archive_path;
+  GError* error;
+
+  plugin = (InfinotedPluginNoteChat*)plugin_info;
+  directory = infinoted_plugin_manager_get_directory(plugin->manager);
+  storage = infd_directory_get_storage(directory);
+
+  g_object_get(G_OBJECT(proxy), "session", &session, NULL);
+
+  g_object_set(
+    G_OBJECT(session),
+    "sync-history", plugin->sync_history,
+    "archive-size", plugin->archive_size,
+    NULL
+  );
+
+  if(plugin->archive_size > 0 && INFD_IS_FILESYSTEM_STORAGE(storage))
+  {
+    error = NULL;
+    path = inf_browser_get_path(INF_BROWSER(directory), iter);
+
+    archive_path = infd_chat_filesystem_format_get_archive_path(
+      INFD_FILESYSTEM_STORAGE(storage),
+      path,
+      &error
+    );
+
+    if(archive_path != NULL)
+    {
+      inf_chat_session_set_archive_file(
+        INF_CHAT_SESSION(session),
+        archive_path,
+        &error
+      );
+
+      g_free(archive_path);
+    }
+
+    if(error != NULL)
+    {
+      infinoted_log_warning(
+        infinoted_plugin_manager_get_log(plugin->manager),
+        _("Failed to open chat archive for \"%s\": %s"),
+        path,
+        error->message
+      );
+
+      g_error_free(error);
+    }
+
+    g_free(path);
+  }
+
+  g_object_unref(session);
+}
+
+static void
+infinoted_plugin_note_chat_session_removed(const InfBrowserIter* iter,
+                                           InfSessionProxy* proxy,
+                                           gpointer plugin_info,
+                                           gpointer session_info)
+{
+  InfSession* session;
+
+  /* Close the archive file. It is re-opened and re-indexed when the
+   * session is loaded again. */
+  g_object_get(G_OBJECT(proxy), "session", &session, NULL);
+  inf_chat_session_set_archive_file(INF_CHAT_SESSION(session), NULL, NULL);
+  g_object_unref(session);
+}
+
 static const InfinotedParameterInfo INFINOTED_PLUGIN_NOTE_CHAT_OPTIONS[] = {
   {
+    "sync-history",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginNoteChat, sync_history),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("The maximum number of messages sent to a client when it subscribes "
+       "to a chat document. Older messages can be requested by the client "
+       "on demand. If 0, all messages are sent."),
+    N_("MESSAGES")
+  }, {
+    "archive-size",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginNoteChat, archive_size),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("The maximum number of messages to keep in an on-disk archive next to "
+       "each chat document, from which clients can request older messages. "
+       "If 0, no archive is kept."),
+    N_("MESSAGES")
+  }, {
     NULL,
     0,
     0,
@@ -213,14 +324,14 @@ const InfinotedPlugin INFINOTED_PLUGIN = {
   sizeof(InfinotedPluginNoteChat),
   0,
   0,
-  NULL,
+  "InfChatSession",
   infinoted_plugin_note_chat_info_initialize,
   infinoted_plugin_note_chat_initialize,
   infinoted_plugin_note_chat_deinitialize,
   NULL,
   NULL,
-  NULL,
-  NULL
+  infinoted_plugin_note_chat_session_added,
+  infinoted_plugin_note_chat_session_removed
 };
 
 /* vim:set et sw=2 ts=2: */
@@ -69,43 +69,21 @@ infinoted_plugin_note_text_session_read(InfdStorage* storage,
                                         gpointer user_data,
                                         GError** error)
 {
-  InfUserTable* user_table;
-  InfTextBuffer* buffer;
-  gboolean result;
   InfTextSession* session;
 
   g_assert(INFD_IS_FILESYSTEM_STORAGE(storage));
 
-  user_table = inf_user_table_new();
-  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
-
-  result = inf_text_filesystem_format_read(
+  /* This also restores the request logs, if they were stored */
+  session = inf_text_filesystem_format_read_session(
     INFD_FILESYSTEM_STORAGE(storage),
     path,
-    user_table,
-    buffer,
-    error
-  );
-
-  if(result == FALSE)
-  {
-    g_object_unref(user_table);
-    g_object_unref(buffer);
-    return NULL;
-  }
-
-  session = inf_text_session_new_with_user_table(
     manager,
-    buffer,
     io,
-    user_table,
-    INF_SESSION_RUNNING,
-    NULL,
-    NULL
+    error
   );
 
-  g_object_unref(user_table);
-  g_object_unref(buffer);
+  if(session == NULL)
+    return NULL;
 
   return INF_SESSION(session);
 }
@@ -117,13 +95,43 @@ infinoted_plugin_note_text_session_write(InfdStorage* storage,
                                          gpointer user_data,
                                          GError** error)
 {
-  return inf_text_filesystem_format_write(
+  GError* log_error;
+  gboolean result;
+
+  result = inf_text_filesystem_format_write(
     INFD_FILESYSTEM_STORAGE(storage),
     path,
     inf_session_get_user_table(session),
     INF_TEXT_BUFFER(inf_session_get_buffer(session)),
     error
   );
+
+  if(result == FALSE)
+    return FALSE;
+
+  /* The request log only preserves undo history across unloading the
+   * session. Failing to write it is not fatal, since a log that does not
+   * match the document is ignored when reading. */
+  log_error = NULL;
+  result = inf_text_filesystem_format_write_request_log(
+    INFD_FILESYSTEM_STORAGE(storage),
+    path,
+    INF_TEXT_SESSION(session),
+    &log_error
+  );
+
+  if(result == FALSE)
+  {
+    g_warning(
+      _("Failed to write request log of \"%s\": %s"),
+      path,
+      log_error->message
+    );
+
+    g_error_free(log_error);
+  }
+
+  return TRUE;
 }
 
 const InfdNotePlugin INFINOTED_PLUGIN_NOTE_TEXT_PLUGIN = {
@@ -0,0 +1,1152 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "util/infinoted-plugin-util-search-index.h"
+
+#include <infinoted/infinoted-plugin-manager.h>
+#include <infinoted/infinoted-parameter.h>
+#include <infinoted/infinoted-log.h>
+
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-buffer.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-filesystem-format.h>
+
+#include <libinfinity/server/infd-filesystem-storage.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/inf-signals.h>
+#include <libinfinity/inf-i18n.h>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <string.h>
+
+/* Number of storage entries that are looked at in one main loop iteration
+ * while scanning the storage at startup. */
+#define INFINOTED_PLUGIN_SEARCH_SCAN_BATCH 16
+
+/* Time, in seconds, after a change to the index until it is written to
+ * disk. */
+#define INFINOTED_PLUGIN_SEARCH_SAVE_INTERVAL 60
+
+static const gchar infinoted_plugin_search_introspection[] =
+  "<node>"
+  "  <interface name='org.infinote.search'>"
+  "    <method name='search'>"
+  "      <arg type='s' name='query' direction='in'/>"
+  "      <arg type='u' name='max_results' direction='in'/>"
+  "      <arg type='as' name='nodes' direction='out'/>"
+  "    </method>"
+  "  </interface>"
+  "</node>";
+
+typedef struct _InfinotedPluginSearch InfinotedPluginSearch;
+struct _InfinotedPluginSearch {
+  InfinotedPluginManager* manager;
+  gchar* index_file;
+  guint interval;
+  GBusType bus_type;
+  gchar* bus_name;
+
+  InfinotedPluginUtilSearchIndex* index;
+  InfIoTimeout* save_timeout;
+
+  /* Paths of documents with an open session */
+  GHashTable* sessions;
+
+  /* Storage scan at startup */
+  GQueue scan_queue; /* paths of subdirectories still to be read */
+  GSList* scan_notes; /* paths of notes in the current subdirectory */
+  GHashTable* scan_seen; /* set of paths of all notes found */
+  InfIoDispatch* scan_dispatch;
+
+  GMutex mutex;
+  GThread* thread;
+  GMainContext* context;
+  GMainLoop* loop;
+  guint id;
+
+  /* Queries dispatched to the main thread, protected by mutex */
+  GSList* queries;
+};
+
+typedef struct _InfinotedPluginSearchSessionInfo
+  InfinotedPluginSearchSessionInfo;
+struct _InfinotedPluginSearchSessionInfo {
+  InfinotedPluginSearch* plugin;
+  InfSessionProxy* proxy;
+  InfTextBuffer* buffer;
+  gchar* path;
+  InfIoTimeout* timeout;
+};
+
+typedef struct _InfinotedPluginSearchQuery InfinotedPluginSearchQuery;
+struct _InfinotedPluginSearchQuery {
+  InfinotedPluginSearch* plugin;
+  GDBusMethodInvocation* invocation;
+  InfIoDispatch* dispatch;
+};
+
+static InfIo*
+infinoted_plugin_search_get_io(InfinotedPluginSearch* plugin)
+{
+  return infd_directory_get_io(
+    infinoted_plugin_manager_get_directory(plugin->manager)
+  );
+}
+
+static void
+infinoted_plugin_search_save(InfinotedPluginSearch* plugin)
+{
+  GError* error;
+
+  if(plugin->save_timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      infinoted_plugin_search_get_io(plugin),
+      plugin->save_timeout
+    );
+
+    plugin->save_timeout = NULL;
+  }
+
+  error = NULL;
+  infinoted_plugin_util_search_index_save(
+    plugin->index,
+    plugin->index_file,
+    &error
+  );
+
+  if(error != NULL)
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Failed to write search index \"%s\": %s"),
+      plugin->index_file,
+      error->message
+    );
+
+    g_error_free(error);
+  }
+}
+
+static void
+infinoted_plugin_search_save_timeout_cb(gpointer user_data)
+{
+  InfinotedPluginSearch* plugin;
+  plugin = (InfinotedPluginSearch*)user_data;
+
+  plugin->save_timeout = NULL;
+  infinoted_plugin_search_save(plugin);
+}
+
+static void
+infinoted_plugin_search_changed(InfinotedPluginSearch* plugin)
+{
+  if(plugin->index_file != NULL && plugin->save_timeout == NULL)
+  {
+    plugin->save_timeout = inf_io_add_timeout(
+      infinoted_plugin_search_get_io(plugin),
+      INFINOTED_PLUGIN_SEARCH_SAVE_INTERVAL * 1000,
+      infinoted_plugin_search_save_timeout_cb,
+      plugin,
+      NULL
+    );
+  }
+}
+
+static void
+infinoted_plugin_search_index_buffer(InfinotedPluginSearch* plugin,
+                                     const gchar* path,
+                                     gint64 mtime,
+                                     InfTextBuffer* buffer)
+{
+  InfinotedPluginUtilSearchTerms* terms;
+  InfTextBufferIter* iter;
+  gconstpointer text;
+
+  /* The tokenizer only understands UTF-8, which is what infinoted uses */
+  if(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") != 0)
+    return;
+
+  terms = infinoted_plugin_util_search_terms_new();
+
+  iter = inf_text_buffer_create_begin_iter(buffer);
+  if(iter != NULL)
+  {
+    do
+    {
+      text = inf_text_buffer_iter_peek_text(buffer, iter);
+      infinoted_plugin_util_search_terms_add_text(
+        terms,
+        text,
+        inf_text_buffer_iter_get_bytes(buffer, iter)
+      );
+    } while(inf_text_buffer_iter_next(buffer, iter));
+
+    inf_text_buffer_destroy_iter(buffer, iter);
+  }
+
+  infinoted_plugin_util_search_index_set_document(
+    plugin->index,
+    path,
+    mtime,
+    terms
+  );
+
+  infinoted_plugin_search_changed(plugin);
+}
+
+/* Indexes a note from storage, unless it has not changed since it was
+ * indexed last time. */
+static void
+infinoted_plugin_search_index_stored(InfinotedPluginSearch* plugin,
+                                     InfdFilesystemStorage* storage,
+                                     const gchar* path)
+{
+  GStatBuf statbuf;
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+  gchar* filename;
+  gint64 mtime;
+  GError* error;
+
+  error = NULL;
+  filename = infd_filesystem_storage_get_path(storage, "InfText", path, &error);
+  if(filename == NULL)
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Failed to index document \"%s\": %s"),
+      path,
+      error->message
+    );
+
+    g_error_free(error);
+    return;
+  }
+
+  if(g_stat(filename, &statbuf) == -1)
+  {
+    g_free(filename);
+    return;
+  }
+
+  g_free(filename);
+
+  if(infinoted_plugin_util_search_index_lookup_document(plugin->index,
+                                                         path,
+                                                         &mtime))
+  {
+    if(mtime == (gint64)statbuf.st_mtime)
+      return;
+  }
+
+  user_table = inf_user_table_new();
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+  inf_text_filesystem_format_read(storage, path, user_table, buffer, &error);
+  if(error != NULL)
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Failed to index document \"%s\": %s"),
+      path,
+      error->message
+    );
+
+    g_error_free(error);
+  }
+  else
+  {
+    infinoted_plugin_search_index_buffer(
+      plugin,
+      path,
+      (gint64)statbuf.st_mtime,
+      buffer
+    );
+  }
+
+  g_object_unref(buffer);
+  g_object_unref(user_table);
+}
+
+static gchar*
+infinoted_plugin_search_child_path(const gchar* parent,
+                                   const gchar* name)
+{
+  if(strcmp(parent, "/") == 0)
+    return g_strconcat("/", name, NULL);
+  return g_strconcat(parent, "/", name, NULL);
+}
+
+static void
+infinoted_plugin_search_scan_read_subdirectory(InfinotedPluginSearch* plugin,
+                                               InfdStorage* storage,
+                                               const gchar* path)
+{
+  GSList* list;
+  GSList* item;
+  InfdStorageNode* node;
+  gchar* child_path;
+  GError* error;
+
+  error = NULL;
+  list = infd_storage_read_subdirectory(storage, path, &error);
+  if(error != NULL)
+  {
+    infinoted_log_warning(
+      infinoted_plugin_manager_get_log(plugin->manager),
+      _("Failed to read subdirectory \"%s\" for indexing: %s"),
+      path,
+      error->message
+    );
+
+    g_error_free(error);
+    return;
+  }
+
+  for(item = list; item != NULL; item = item->next)
+  {
+    node = (InfdStorageNode*)item->data;
+    child_path = infinoted_plugin_search_child_path(path, node->name);
+
+    if(node->type == INFD_STORAGE_NODE_SUBDIRECTORY)
+    {
+      g_queue_push_tail(&plugin->scan_queue, child_path);
+    }
+    else if(strcmp(node->identifier, "InfText") == 0)
+    {
+      g_hash_table_insert(plugin->scan_seen, child_path, child_path);
+      plugin->scan_notes = g_slist_prepend(plugin->scan_notes, child_path);
+    }
+    else
+    {
+      g_free(child_path);
+    }
+  }
+
+  infd_storage_node_list_free(list);
+}
+
+static void
+infinoted_plugin_search_scan_dispatch_func(gpointer user_data)
+{
+  InfinotedPluginSearch* plugin;
+  InfdStorage* storage;
+  gchar* path;
+  guint i;
+
+  plugin = (InfinotedPluginSearch*)user_data;
+  plugin->scan_dispatch = NULL;
+
+  storage = infd_directory_get_storage(
+    infinoted_plugin_manager_get_directory(plugin->manager)
+  );
+
+  for(i = 0; i < INFINOTED_PLUGIN_SEARCH_SCAN_BATCH; ++i)
+  {
+    if(plugin->scan_notes != NULL)
+    {
+      /* Paths are owned by scan_seen */
+      path = plugin->scan_notes->data;
+      plugin->scan_notes =
+        g_slist_delete_link(plugin->scan_notes, plugin->scan_notes);
+
+      /* Open documents are indexed from their session */
+      if(g_hash_table_lookup(plugin->sessions, path) == NULL)
+      {
+        infinoted_plugin_search_index_stored(
+          plugin,
+          INFD_FILESYSTEM_STORAGE(storage),
+          path
+        );
+      }
+    }
+    else if(!g_queue_is_empty(&plugin->scan_queue))
+    {
+      path = g_queue_pop_head(&plugin->scan_queue);
+      infinoted_plugin_search_scan_read_subdirectory(plugin, storage, path);
+      g_free(path);
+    }
+    else
+    {
+      /* Scan is done. Drop all documents that no longer exist. */
+      infinoted_plugin_util_search_index_retain(
+        plugin->index,
+        plugin->scan_seen
+      );
+
+      g_hash_table_destroy(plugin->scan_seen);
+      plugin->scan_seen = NULL;
+
+      infinoted_log_info(
+        infinoted_plugin_manager_get_log(plugin->manager),
+        _("Search index contains %u documents"),
+        infinoted_plugin_util_search_index_get_n_documents(plugin->index)
+      );
+
+      infinoted_plugin_search_changed(plugin);
+      return;
+    }
+  }
+
+  plugin->scan_dispatch = inf_io_add_dispatch(
+    infinoted_plugin_search_get_io(plugin),
+    infinoted_plugin_search_scan_dispatch_func,
+    plugin,
+    NULL
+  );
+}
+
+static void
+infinoted_plugin_search_session_timeout_cb(gpointer user_data)
+{
+  InfinotedPluginSearchSessionInfo* info;
+  info = (InfinotedPluginSearchSessionInfo*)user_data;
+
+  info->timeout = NULL;
+
+  /* The document is stored to disk later, so do not remember a
+   * modification time. It is read again at the next startup. */
+  infinoted_plugin_search_index_buffer(
+    info->plugin,
+    info->path,
+    0,
+    info->buffer
+  );
+}
+
+static void
+infinoted_plugin_search_schedule(InfinotedPluginSearchSessionInfo* info)
+{
+  if(info->timeout == NULL)
+  {
+    info->timeout = inf_io_add_timeout(
+      infinoted_plugin_search_get_io(info->plugin),
+      info->plugin->interval * 1000,
+      infinoted_plugin_search_session_timeout_cb,
+      info,
+      NULL
+    );
+  }
+}
+
+static void
+infinoted_plugin_search_text_inserted_cb(InfTextBuffer* buffer,
+                                         guint pos,
+                                         InfTextChunk* chunk,
+                                         InfUser* user,
+                                         gpointer user_data)
+{
+  infinoted_plugin_search_schedule(
+    (InfinotedPluginSearchSessionInfo*)user_data
+  );
+}
+
+static void
+infinoted_plugin_search_text_erased_cb(InfTextBuffer* buffer,
+                                       guint pos,
+                                       InfTextChunk* chunk,
+                                       InfUser* user,
+                                       gpointer user_data)
+{
+  infinoted_plugin_search_schedule(
+    (InfinotedPluginSearchSessionInfo*)user_data
+  );
+}
+
+static void
+infinoted_plugin_search_node_removed_cb(InfBrowser* browser,
+                                        const InfBrowserIter* iter,
+                                        InfRequest* request,
+                                        gpointer user_data)
+{
+  InfinotedPluginSearch* plugin;
+  gchar* path;
+
+  plugin = (InfinotedPluginSearch*)user_data;
+  path = inf_browser_get_path(browser, iter);
+
+  if(inf_browser_is_subdirectory(browser, iter))
+  {
+    infinoted_plugin_util_search_index_remove_subtree(plugin->index, path);
+    infinoted_plugin_search_changed(plugin);
+  }
+  else if(infinoted_plugin_util_search_index_remove_document(plugin->index,
+                                                             path))
+  {
+    infinoted_plugin_search_changed(plugin);
+  }
+
+  g_free(path);
+}
+
+static void
+infinoted_plugin_search_query_free(gpointer data)
+{
+  InfinotedPluginSearchQuery* query;
+  query = (InfinotedPluginSearchQuery*)data;
+
+  g_object_unref(query->invocation);
+  g_slice_free(InfinotedPluginSearchQuery, query);
+}
+
+static void
+infinoted_plugin_search_query_dispatch_func(gpointer user_data)
+{
+  /* Main thread query handler */
+  InfinotedPluginSearchQuery* query;
+  InfinotedPluginSearch* plugin;
+  const gchar* text;
+  guint32 max_results;
+  gchar** results;
+
+  query = (InfinotedPluginSearchQuery*)user_data;
+  plugin = query->plugin;
+
+  g_mutex_lock(&plugin->mutex);
+  plugin->queries = g_slist_remove(plugin->queries, query);
+  g_mutex_unlock(&plugin->mutex);
+
+  g_variant_get(
+    g_dbus_method_invocation_get_parameters(query->invocation),
+    "(&su)",
+    &text,
+    &max_results
+  );
+
+  results = infinoted_plugin_util_search_index_query(
+    plugin->index,
+    text,
+    max_results
+  );
+
+  g_dbus_method_invocation_return_value(
+    query->invocation,
+    g_variant_new("(^as)", results)
+  );
+
+  g_strfreev(results);
+}
+
+static void
+infinoted_plugin_search_method_call_func(GDBusConnection* connection,
+                                         const gchar* sender,
+                                         const gchar* object_path,
+                                         const gchar* interface_name,
+                                         const gchar* method_name,
+                                         GVariant* parameters,
+                                         GDBusMethodInvocation* invocation,
+                                         gpointer user_data)
+{
+  /* Dispatch to the main thread, which owns the index */
+  InfinotedPluginSearch* plugin;
+  InfinotedPluginSearchQuery* query;
+
+  plugin = (InfinotedPluginSearch*)user_data;
+
+  if(strcmp(method_name, "search") != 0)
+  {
+    g_dbus_method_invocation_return_error_literal(
+      invocation,
+      G_DBUS_ERROR,
+      G_DBUS_ERROR_UNKNOWN_METHOD,
+      "Not implemented"
+    );
+
+    return;
+  }
+
+  query = g_slice_new(InfinotedPluginSearchQuery);
+  query->plugin = plugin;
+  query->invocation = g_object_ref(invocation);
+
+  g_mutex_lock(&plugin->mutex);
+  plugin->queries = g_slist_prepend(plugin->queries, query);
+
+  query->dispatch = inf_io_add_dispatch(
+    infinoted_plugin_manager_get_io(plugin->manager),
+    infinoted_plugin_search_query_dispatch_func,
+    query,
+    infinoted_plugin_search_query_free
+  );
+
+  g_mutex_unlock(&plugin->mutex);
+}
+
+static void
+infinoted_plugin_search_bus_acquired_func(GDBusConnection* connection,
+                                          const gchar* name,
+                                          gpointer user_data)
+{
+  GDBusNodeInfo* node_info;
+  GDBusInterfaceInfo* interface_info;
+  GDBusInterfaceVTable vtable;
+  GError* error;
+
+  node_info = g_dbus_node_info_new_for_xml(
+    infinoted_plugin_search_introspection,
+    NULL
+  );
+
+  g_assert(node_info != NULL);
+
+  interface_info = g_dbus_node_info_lookup_interface(
+    node_info,
+    "org.infinote.search"
+  );
+
+  g_assert(interface_info != NULL);
+
+  vtable.method_call = infinoted_plugin_search_method_call_func;
+  vtable.get_property = NULL;
+  vtable.set_property = NULL;
+
+  error = NULL;
+  g_dbus_connection_register_object(
+    connection,
+    "/org/infinote/infinoted",
+    interface_info,
+    &vtable,
+    user_data,
+    NULL,
+    &error
+  );
+
+  if(error != NULL)
+  {
+    g_warning("Failed to register D-Bus object: %s\n", error->message);
+    g_error_free(error);
+    error = NULL;
+  }
+
+  g_dbus_node_info_unref(node_info);
+}
+
+static void
+infinoted_plugin_search_name_acquired_func(GDBusConnection* connection,
+                                           const gchar* name,
+                                           gpointer user_data)
+{
+  /* nothing to do */
+}
+
+static void
+infinoted_plugin_search_name_lost_func(GDBusConnection* connection,
+                                       const gchar* name,
+                                       gpointer user_data)
+{
+  InfinotedPluginSearch* plugin;
+  plugin = (InfinotedPluginSearch*)user_data;
+
+  infinoted_log_warning(
+    infinoted_plugin_manager_get_log(plugin->manager),
+    "The name \"%s\" could not be acquired on the bus: "
+    "search queries are not available",
+    name
+  );
+}
+
+static gpointer
+infinoted_plugin_search_thread_func(gpointer plugin_info)
+{
+  InfinotedPluginSearch* plugin;
+  plugin = (InfinotedPluginSearch*)plugin_info;
+
+  g_mutex_lock(&plugin->mutex);
+  if(plugin->thread == NULL)
+  {
+    g_mutex_unlock(&plugin->mutex);
+    return NULL;
+  }
+
+  plugin->context = g_main_context_new();
+  g_main_context_push_thread_default(plugin->context);
+
+  plugin->loop = g_main_loop_new(plugin->context, FALSE);
+  g_mutex_unlock(&plugin->mutex);
+
+  plugin->id = g_bus_own_name(
+    plugin->bus_type,
+    plugin->bus_name,
+    G_BUS_NAME_OWNER_FLAGS_NONE,
+    infinoted_plugin_search_bus_acquired_func,
+    infinoted_plugin_search_name_acquired_func,
+    infinoted_plugin_search_name_lost_func,
+    plugin,
+    NULL
+  );
+
+  g_main_loop_run(plugin->loop);
+
+  g_bus_unown_name(plugin->id);
+  plugin->id = 0;
+
+  /* See the comment in infinoted-plugin-dbus.c: give the thread that GDBus
+   * started internally time to finish before we can be unloaded. */
+  g_usleep(100000);
+
+  g_mutex_lock(&plugin->mutex);
+  g_main_loop_unref(plugin->loop);
+  plugin->loop = NULL;
+
+  g_main_context_unref(plugin->context);
+  plugin->context = NULL;
+  g_mutex_unlock(&plugin->mutex);
+
+  return NULL;
+}
+
+static gboolean
+infinoted_plugin_search_deinitialize_thread_func(gpointer user_data)
+{
+  InfinotedPluginSearch* plugin;
+  plugin = (InfinotedPluginSearch*)user_data;
+
+  g_main_loop_quit(plugin->loop);
+  return FALSE;
+}
+
+static void
+infinoted_plugin_search_info_initialize(gpointer plugin_info)
+{
+  InfinotedPluginSearch* plugin;
+  plugin = (InfinotedPluginSearch*)plugin_info;
+
+  plugin->manager = NULL;
+  plugin->index_file = NULL;
+  plugin->interval = 5;
+  plugin->bus_type = G_BUS_TYPE_SESSION;
+  plugin->bus_name = g_strdup("org.infinote.infinoted.search");
+
+  plugin->index = NULL;
+  plugin->save_timeout = NULL;
+  plugin->sessions = NULL;
+
+  g_queue_init(&plugin->scan_queue);
+  plugin->scan_notes = NULL;
+  plugin->scan_seen = NULL;
+  plugin->scan_dispatch = NULL;
+
+  plugin->thread = NULL;
+  plugin->context = NULL;
+  plugin->loop = NULL;
+  plugin->id = 0;
+  plugin->queries = NULL;
+}
+
+static gboolean
+infinoted_plugin_search_initialize(InfinotedPluginManager* manager,
+                                   gpointer plugin_info,
+                                   GError** error)
+{
+  InfinotedPluginSearch* plugin;
+  InfdDirectory* directory;
+  InfdStorage* storage;
+  gchar* gio_path;
+  GModule* gio_module;
+  GError* local_error;
+
+  plugin = (InfinotedPluginSearch*)plugin_info;
+
+  /* Keep libgio loaded after we are unloaded, see the comment in
+   * infinoted-plugin-dbus.c for why this is required. */
+  gio_path = g_module_build_path(NULL, "gio-2.0");
+  gio_module = g_module_open(gio_path, 0);
+  g_free(gio_path);
+
+  if(gio_module == NULL)
+  {
+    g_set_error(
+      error,
+      g_quark_from_string("INFINOTED_PLUGIN_SEARCH_ERROR"),
+      0,
+      "%s",
+      g_module_error()
+    );
+
+    return FALSE;
+  }
+  else
+  {
+    g_module_make_resident(gio_module);
+    if(g_module_close(gio_module) != TRUE)
+    {
+      g_warning("Failed to close gio module: %s", g_module_error());
+    }
+  }
+
+  plugin->manager = manager;
+  plugin->index = infinoted_plugin_util_search_index_new();
+  plugin->sessions = g_hash_table_new(g_str_hash, g_str_equal);
+
+  if(plugin->index_file != NULL &&
+     g_file_test(plugin->index_file, G_FILE_TEST_EXISTS))
+  {
+    local_error = NULL;
+    infinoted_plugin_util_search_index_load(
+      plugin->index,
+      plugin->index_file,
+      &local_error
+    );
+
+    if(local_error != NULL)
+    {
+      /* Not fatal, the index is rebuilt from storage */
+      infinoted_log_warning(
+        infinoted_plugin_manager_get_log(manager),
+        _("Failed to read search index: %s"),
+        local_error->message
+      );
+
+      g_error_free(local_error);
+    }
+  }
+
+  directory = infinoted_plugin_manager_get_directory(manager);
+  storage = infd_directory_get_storage(directory);
+
+  g_signal_connect(
+    G_OBJECT(directory),
+    "node-removed",
+    G_CALLBACK(infinoted_plugin_search_node_removed_cb),
+    plugin
+  );
+
+  /* Index the documents that are not open in the background */
+  if(storage != NULL && INFD_IS_FILESYSTEM_STORAGE(storage))
+  {
+    plugin->scan_seen =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g_queue_push_tail(&plugin->scan_queue, g_strdup("/"));
+
+    plugin->scan_dispatch = inf_io_add_dispatch(
+      infinoted_plugin_search_get_io(plugin),
+      infinoted_plugin_search_scan_dispatch_func,
+      plugin,
+      NULL
+    );
+  }
+
+  g_mutex_init(&plugin->mutex);
+  g_mutex_lock(&plugin->mutex);
+
+  plugin->thread = g_thread_try_new(
+    "InfinotedPluginSearch",
+    infinoted_plugin_search_thread_func,
+    plugin_info,
+    error
+  );
+
+  g_mutex_unlock(&plugin->mutex);
+
+  if(plugin->thread == NULL)
+  {
+    g_mutex_clear(&plugin->mutex);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+infinoted_plugin_search_deinitialize(gpointer plugin_info)
+{
+  InfinotedPluginSearch* plugin;
+  InfinotedPluginSearchQuery* query;
+  GMainContext* ctx;
+  GSource* source;
+  GThread* thread;
+  InfIo* io;
+
+  plugin = (InfinotedPluginSearch*)plugin_info;
+
+  if(plugin->thread != NULL)
+  {
+    g_mutex_lock(&plugin->mutex);
+    thread = plugin->thread;
+    plugin->thread = NULL;
+
+    /* Tell the thread to quit */
+    if(plugin->loop != NULL)
+    {
+      ctx = g_main_loop_get_context(plugin->loop);
+      source = g_idle_source_new();
+
+      g_source_set_callback(
+        source,
+        infinoted_plugin_search_deinitialize_thread_func,
+        plugin,
+        NULL
+      );
+
+      g_source_attach(source, ctx);
+    }
+
+    g_mutex_unlock(&plugin->mutex);
+
+    g_thread_join(thread);
+    thread = NULL;
+
+    g_mutex_clear(&plugin->mutex);
+  }
+
+  if(plugin->manager != NULL)
+  {
+    io = infinoted_plugin_search_get_io(plugin);
+
+    /* The thread is gone, so no more queries can come in */
+    while(plugin->queries != NULL)
+    {
+      query = (InfinotedPluginSearchQuery*)plugin->queries->data;
+      plugin->queries =
+        g_slist_delete_link(plugin->queries, plugin->queries);
+      inf_io_remove_dispatch(io, query->dispatch);
+    }
+
+    if(plugin->scan_dispatch != NULL)
+      inf_io_remove_dispatch(io, plugin->scan_dispatch);
+
+    g_signal_handlers_disconnect_by_func(
+      G_OBJECT(infinoted_plugin_manager_get_directory(plugin->manager)),
+      G_CALLBACK(infinoted_plugin_search_node_removed_cb),
+      plugin
+    );
+
+    if(plugin->index_file != NULL)
+      infinoted_plugin_search_save(plugin);
+
+    g_queue_foreach(&plugin->scan_queue, (GFunc)g_free, NULL);
+    g_queue_clear(&plugin->scan_queue);
+    g_slist_free(plugin->scan_notes);
+    if(plugin->scan_seen != NULL)
+      g_hash_table_destroy(plugin->scan_seen);
+
+    g_hash_table_destroy(plugin->sessions);
+    infinoted_plugin_util_search_index_free(plugin->index);
+  }
+
+  g_free(plugin->index_file);
+  g_free(plugin->bus_name);
+}
+
+static void
+infinoted_plugin_search_session_added(const InfBrowserIter* iter,
+                                      InfSessionProxy* proxy,
+                                      gpointer plugin_info,
+                                      gpointer session_info)
+{
+  InfinotedPluginSearchSessionInfo* info;
+  InfSession* session;
+  gchar* seen_path;
+
+  info = (InfinotedPluginSearchSessionInfo*)session_info;
+  info->plugin = (InfinotedPluginSearch*)plugin_info;
+  info->proxy = proxy;
+  info->timeout = NULL;
+  g_object_ref(proxy);
+
+  info->path = inf_browser_get_path(
+    INF_BROWSER(infinoted_plugin_manager_get_directory(info->plugin->manager)),
+    iter
+  );
+
+  g_object_get(G_OBJECT(proxy), "session", &session, NULL);
+  info->buffer = INF_TEXT_BUFFER(inf_session_get_buffer(session));
+  g_object_ref(info->buffer);
+  g_object_unref(session);
+
+  g_hash_table_insert(info->plugin->sessions, info->path, info);
+
+  /* Make sure the storage scan does not drop this document */
+  if(info->plugin->scan_seen != NULL)
+  {
+    seen_path = g_strdup(info->path);
+    g_hash_table_insert(info->plugin->scan_seen, seen_path, seen_path);
+  }
+
+  g_signal_connect(
+    G_OBJECT(info->buffer),
+    "text-inserted",
+    G_CALLBACK(infinoted_plugin_search_text_inserted_cb),
+    info
+  );
+
+  g_signal_connect(
+    G_OBJECT(info->buffer),
+    "text-erased",
+    G_CALLBACK(infinoted_plugin_search_text_erased_cb),
+    info
+  );
+
+  infinoted_plugin_search_index_buffer(
+    info->plugin,
+    info->path,
+    0,
+    info->buffer
+  );
+}
+
+static void
+infinoted_plugin_search_session_removed(const InfBrowserIter* iter,
+                                        InfSessionProxy* proxy,
+                                        gpointer plugin_info,
+                                        gpointer session_info)
+{
+  InfinotedPluginSearchSessionInfo* info;
+  info = (InfinotedPluginSearchSessionInfo*)session_info;
+
+  /* Pick up changes that have not been indexed yet */
+  if(info->timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      infinoted_plugin_search_get_io(info->plugin),
+      info->timeout
+    );
+
+    info->timeout = NULL;
+    infinoted_plugin_search_session_timeout_cb(info);
+  }
+
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(info->buffer),
+    G_CALLBACK(infinoted_plugin_search_text_inserted_cb),
+    info
+  );
+
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(info->buffer),
+    G_CALLBACK(infinoted_plugin_search_text_erased_cb),
+    info
+  );
+
+  g_hash_table_remove(info->plugin->sessions, info->path);
+
+  g_free(info->path);
+  g_object_unref(info->buffer);
+  g_object_unref(info->proxy);
+}
+
+static gboolean
+infinoted_plugin_search_parameter_convert_bus_type(gpointer out,
+                                                   gpointer in,
+                                                   GError** error)
+{
+  gchar** in_str;
+  GBusType* out_val;
+
+  in_str = (gchar**)in;
+  out_val = (GBusType*)out;
+
+  if(strcmp(*in_str, "system") == 0)
+  {
+    *out_val = G_BUS_TYPE_SYSTEM;
+  }
+  else if(strcmp(*in_str, "session") == 0)
+  {
+    *out_val = G_BUS_TYPE_SESSION;
+  }
+  else
+  {
+    g_set_error(
+      error,
+      infinoted_parameter_error_quark(),
+      INFINOTED_PARAMETER_ERROR_INVALID_FLAG,
+      _("\"%s\" is not a valid bus type. Allowed values are "
+        "\"system\" or \"session\""),
+      *in_str
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static const InfinotedParameterInfo INFINOTED_PLUGIN_SEARCH_OPTIONS[] = {
+  {
+    "index-file",
+    INFINOTED_PARAMETER_STRING,
+    0,
+    offsetof(InfinotedPluginSearch, index_file),
+    infinoted_parameter_convert_filename,
+    0,
+    N_("File to store the search index in. If not given, the index is "
+       "rebuilt from all documents at every startup."),
+    N_("FILENAME")
+  }, {
+    "interval",
+    INFINOTED_PARAMETER_INT,
+    0,
+    offsetof(InfinotedPluginSearch, interval),
+    infinoted_parameter_convert_nonnegative,
+    0,
+    N_("Time, in seconds, after a change to an open document until it is "
+       "indexed again. [default=5]"),
+    N_("SECONDS")
+  }, {
+    "type",
+    INFINOTED_PARAMETER_STRING,
+    0,
+    offsetof(InfinotedPluginSearch, bus_type),
+    infinoted_plugin_search_parameter_convert_bus_type,
+    0,
+    N_("The bus type to use, either \"session\" or \"system\". "
+       "[default=session]"),
+    N_("TYPE")
+  }, {
+    "name",
+    INFINOTED_PARAMETER_STRING,
+    0,
+    offsetof(InfinotedPluginSearch, bus_name),
+    infinoted_parameter_convert_string,
+    0,
+    N_("The name to own on the bus. "
+       "[default=org.infinote.infinoted.search]"),
+    N_("NAME")
+  }, {
+    NULL,
+    0,
+    0,
+    0,
+    NULL
+  }
+};
+
+const InfinotedPlugin INFINOTED_PLUGIN = {
+  "search",
+  N_("Maintains a full-text index of all text documents and answers "
+     "search queries on D-Bus."),
+  INFINOTED_PLUGIN_SEARCH_OPTIONS,
+  sizeof(InfinotedPluginSearch),
+  0,
+  sizeof(InfinotedPluginSearchSessionInfo),
+  "InfTextSession",
+  infinoted_plugin_search_info_initialize,
+  infinoted_plugin_search_initialize,
+  infinoted_plugin_search_deinitialize,
+  NULL,
+  NULL,
+  infinoted_plugin_search_session_added,
+  infinoted_plugin_search_session_removed
+};
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,934 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* An inverted index mapping words to the documents containing them. A word
+ * is a run of alphanumeric characters or underscores, compared
+ * case-insensitively. Only the set of words of each document is stored, not
+ * their positions, so a query returns the documents that contain all of
+ * the words of the query. */
+
+#include <infinoted/plugins/util/infinoted-plugin-util-search-index.h>
+
+#include <libinfinity/inf-i18n.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Words shorter or longer than this (in characters) are not indexed */
+#define INFINOTED_PLUGIN_UTIL_SEARCH_MIN_TERM_LENGTH 2
+#define INFINOTED_PLUGIN_UTIL_SEARCH_MAX_TERM_LENGTH 64
+
+/* "INFSIDX" followed by the format version */
+static const gchar INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_MAGIC[8] =
+  { 'I', 'N', 'F', 'S', 'I', 'D', 'X', 1 };
+
+typedef struct _InfinotedPluginUtilSearchDocument
+  InfinotedPluginUtilSearchDocument;
+
+typedef struct _InfinotedPluginUtilSearchTerm InfinotedPluginUtilSearchTerm;
+struct _InfinotedPluginUtilSearchTerm {
+  gchar* text;
+  GHashTable* documents; /* set of InfinotedPluginUtilSearchDocument */
+};
+
+struct _InfinotedPluginUtilSearchDocument {
+  gchar* path;
+  gint64 mtime;
+  GPtrArray* terms; /* InfinotedPluginUtilSearchTerm */
+  guint id; /* only used while saving */
+};
+
+struct _InfinotedPluginUtilSearchTerms {
+  GHashTable* words; /* set of gchar* */
+  GString* word;
+  guint word_length;
+};
+
+struct _InfinotedPluginUtilSearchIndex {
+  GHashTable* documents; /* path -> InfinotedPluginUtilSearchDocument */
+  GHashTable* terms; /* text -> InfinotedPluginUtilSearchTerm */
+};
+
+static void
+infinoted_plugin_util_search_term_free(gpointer data)
+{
+  InfinotedPluginUtilSearchTerm* term;
+  term = (InfinotedPluginUtilSearchTerm*)data;
+
+  g_hash_table_destroy(term->documents);
+  g_free(term->text);
+  g_slice_free(InfinotedPluginUtilSearchTerm, term);
+}
+
+static void
+infinoted_plugin_util_search_document_free(gpointer data)
+{
+  InfinotedPluginUtilSearchDocument* document;
+  document = (InfinotedPluginUtilSearchDocument*)data;
+
+  g_ptr_array_free(document->terms, TRUE);
+  g_free(document->path);
+  g_slice_free(InfinotedPluginUtilSearchDocument, document);
+}
+
+static void
+infinoted_plugin_util_search_terms_finish_word(
+  InfinotedPluginUtilSearchTerms* terms)
+{
+  gchar* word;
+
+  if(terms->word_length >= INFINOTED_PLUGIN_UTIL_SEARCH_MIN_TERM_LENGTH &&
+     terms->word_length <= INFINOTED_PLUGIN_UTIL_SEARCH_MAX_TERM_LENGTH &&
+     g_hash_table_lookup(terms->words, terms->word->str) == NULL)
+  {
+    word = g_strndup(terms->word->str, terms->word->len);
+    g_hash_table_insert(terms->words, word, word);
+  }
+
+  g_string_truncate(terms->word, 0);
+  terms->word_length = 0;
+}
+
+/* Removes the document from all of its terms, and drops terms that are
+ * no longer used by any document. */
+static void
+infinoted_plugin_util_search_index_unlink(
+  InfinotedPluginUtilSearchIndex* index,
+  InfinotedPluginUtilSearchDocument* document)
+{
+  InfinotedPluginUtilSearchTerm* term;
+  guint i;
+
+  for(i = 0; i < document->terms->len; ++i)
+  {
+    term = g_ptr_array_index(document->terms, i);
+    g_hash_table_remove(term->documents, document);
+
+    if(g_hash_table_size(term->documents) == 0)
+      g_hash_table_remove(index->terms, term->text);
+  }
+
+  g_ptr_array_set_size(document->terms, 0);
+}
+
+static void
+infinoted_plugin_util_search_index_link(
+  InfinotedPluginUtilSearchIndex* index,
+  InfinotedPluginUtilSearchDocument* document,
+  const gchar* text,
+  gsize len)
+{
+  InfinotedPluginUtilSearchTerm* term;
+
+  term = g_hash_table_lookup(index->terms, text);
+  if(term == NULL)
+  {
+    term = g_slice_new(InfinotedPluginUtilSearchTerm);
+    term->text = g_strndup(text, len);
+    term->documents = g_hash_table_new(NULL, NULL);
+    g_hash_table_insert(index->terms, term->text, term);
+  }
+
+  if(g_hash_table_lookup(term->documents, document) == NULL)
+  {
+    g_hash_table_insert(term->documents, document, document);
+    g_ptr_array_add(document->terms, term);
+  }
+}
+
+static InfinotedPluginUtilSearchDocument*
+infinoted_plugin_util_search_index_ensure_document(
+  InfinotedPluginUtilSearchIndex* index,
+  const gchar* path,
+  gsize len)
+{
+  InfinotedPluginUtilSearchDocument* document;
+
+  document = g_hash_table_lookup(index->documents, path);
+  if(document == NULL)
+  {
+    document = g_slice_new(InfinotedPluginUtilSearchDocument);
+    document->path = g_strndup(path, len);
+    document->mtime = 0;
+    document->terms = g_ptr_array_new();
+    document->id = 0;
+    g_hash_table_insert(index->documents, document->path, document);
+  }
+  else
+  {
+    infinoted_plugin_util_search_index_unlink(index, document);
+  }
+
+  return document;
+}
+
+static gint
+infinoted_plugin_util_search_index_compare_size(gconstpointer a,
+                                                gconstpointer b)
+{
+  const InfinotedPluginUtilSearchTerm* first;
+  const InfinotedPluginUtilSearchTerm* second;
+  guint first_size;
+  guint second_size;
+
+  first = *(const InfinotedPluginUtilSearchTerm* const*)a;
+  second = *(const InfinotedPluginUtilSearchTerm* const*)b;
+  first_size = g_hash_table_size(first->documents);
+  second_size = g_hash_table_size(second->documents);
+
+  if(first_size < second_size) return -1;
+  if(first_size > second_size) return 1;
+  return 0;
+}
+
+static gint
+infinoted_plugin_util_search_index_compare_path(gconstpointer a,
+                                                gconstpointer b)
+{
+  return strcmp(*(const gchar* const*)a, *(const gchar* const*)b);
+}
+
+static gint
+infinoted_plugin_util_search_index_compare_uint(gconstpointer a,
+                                                gconstpointer b)
+{
+  guint first;
+  guint second;
+
+  first = *(const guint*)a;
+  second = *(const guint*)b;
+
+  if(first < second) return -1;
+  if(first > second) return 1;
+  return 0;
+}
+
+/*
+ * Serialization. Numbers are stored as variable-length integers with seven
+ * bits per byte, strings as their length followed by their bytes, and the
+ * document lists of terms as sorted, delta-encoded document numbers.
+ */
+
+static void
+infinoted_plugin_util_search_index_write_uint(GString* out,
+                                              guint64 value)
+{
+  while(value >= 0x80)
+  {
+    g_string_append_c(out, (gchar)((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+
+  g_string_append_c(out, (gchar)value);
+}
+
+static void
+infinoted_plugin_util_search_index_write_string(GString* out,
+                                                const gchar* str)
+{
+  gsize len;
+  len = strlen(str);
+
+  infinoted_plugin_util_search_index_write_uint(out, len);
+  g_string_append_len(out, str, len);
+}
+
+static gboolean
+infinoted_plugin_util_search_index_read_uint(const guchar** pos,
+                                             const guchar* end,
+                                             guint64* value)
+{
+  guint shift;
+
+  *value = 0;
+  for(shift = 0; shift < 64; shift += 7)
+  {
+    if(*pos == end) return FALSE;
+
+    *value |= (guint64)(**pos & 0x7f) << shift;
+    if((*((*pos)++) & 0x80) == 0)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static gboolean
+infinoted_plugin_util_search_index_read_string(const guchar** pos,
+                                               const guchar* end,
+                                               const gchar** str,
+                                               gsize* len)
+{
+  guint64 value;
+
+  if(!infinoted_plugin_util_search_index_read_uint(pos, end, &value))
+    return FALSE;
+  if(value > (guint64)(end - *pos))
+    return FALSE;
+
+  *str = (const gchar*)*pos;
+  *len = value;
+  *pos += value;
+  return TRUE;
+}
+
+static gboolean
+infinoted_plugin_util_search_index_parse(InfinotedPluginUtilSearchIndex* index,
+                                         const guchar* pos,
+                                         const guchar* end)
+{
+  InfinotedPluginUtilSearchDocument* document;
+  InfinotedPluginUtilSearchDocument** documents;
+  guint64 n_documents;
+  guint64 n_terms;
+  guint64 n_postings;
+  guint64 value;
+  const gchar* str;
+  gchar* key;
+  gsize len;
+  guint64 i;
+  guint64 j;
+  guint64 id;
+  gboolean result;
+
+  if(!infinoted_plugin_util_search_index_read_uint(&pos, end, &n_documents))
+    return FALSE;
+  /* Each document takes at least two bytes */
+  if(n_documents > (guint64)(end - pos) / 2)
+    return FALSE;
+
+  documents = g_new(InfinotedPluginUtilSearchDocument*, n_documents);
+  result = FALSE;
+
+  for(i = 0; i < n_documents; ++i)
+  {
+    if(!infinoted_plugin_util_search_index_read_string(&pos, end, &str, &len))
+      goto out;
+    if(!infinoted_plugin_util_search_index_read_uint(&pos, end, &value))
+      goto out;
+
+    key = g_strndup(str, len);
+    if(g_hash_table_lookup(index->documents, key) != NULL)
+    {
+      g_free(key);
+      goto out;
+    }
+
+    document = infinoted_plugin_util_search_index_ensure_document(
+      index,
+      key,
+      len
+    );
+
+    g_free(key);
+
+    document->mtime = (gint64)value;
+    documents[i] = document;
+  }
+
+  if(!infinoted_plugin_util_search_index_read_uint(&pos, end, &n_terms))
+    goto out;
+
+  for(i = 0; i < n_terms; ++i)
+  {
+    if(!infinoted_plugin_util_search_index_read_string(&pos, end, &str, &len))
+      goto out;
+    if(!infinoted_plugin_util_search_index_read_uint(&pos, end, &n_postings))
+      goto out;
+
+    key = g_strndup(str, len);
+    id = 0;
+
+    for(j = 0; j < n_postings; ++j)
+    {
+      if(!infinoted_plugin_util_search_index_read_uint(&pos, end, &value) ||
+         (j > 0 && value == 0) || value >= n_documents - id)
+      {
+        g_free(key);
+        goto out;
+      }
+
+      id += value;
+
+      infinoted_plugin_util_search_index_link(
+        index,
+        documents[id],
+        key,
+        len
+      );
+    }
+
+    g_free(key);
+  }
+
+  result = (pos == end);
+out:
+  g_free(documents);
+  return result;
+}
+
+/**
+ * infinoted_plugin_util_search_index_error_quark:
+ *
+ * Returns the error domain for errors that can occur when loading a search
+ * index from disk.
+ *
+ * Returns: A #GQuark.
+ */
+GQuark
+infinoted_plugin_util_search_index_error_quark(void)
+{
+  return g_quark_from_static_string(
+    "INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_ERROR"
+  );
+}
+
+/**
+ * infinoted_plugin_util_search_terms_new:
+ *
+ * Creates a new, empty set of search terms. Text can be added with
+ * infinoted_plugin_util_search_terms_add_text(), and the result can be
+ * stored in an index with infinoted_plugin_util_search_index_set_document().
+ *
+ * Returns: A new #InfinotedPluginUtilSearchTerms.
+ */
+InfinotedPluginUtilSearchTerms*
+infinoted_plugin_util_search_terms_new(void)
+{
+  InfinotedPluginUtilSearchTerms* terms;
+  terms = g_slice_new(InfinotedPluginUtilSearchTerms);
+
+  terms->words = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  terms->word = g_string_sized_new(
+    INFINOTED_PLUGIN_UTIL_SEARCH_MAX_TERM_LENGTH
+  );
+  terms->word_length = 0;
+
+  return terms;
+}
+
+/**
+ * infinoted_plugin_util_search_terms_add_text:
+ * @terms: A #InfinotedPluginUtilSearchTerms.
+ * @text: UTF-8 encoded text.
+ * @bytes: The number of bytes in @text.
+ *
+ * Adds the words of @text to @terms. A word that is cut at the end of
+ * @text is continued by the next call to this function, so a document
+ * can be added segment by segment.
+ */
+void
+infinoted_plugin_util_search_terms_add_text(
+  InfinotedPluginUtilSearchTerms* terms,
+  const gchar* text,
+  gsize bytes)
+{
+  const gchar* end;
+  gunichar c;
+
+  for(end = text + bytes; text < end; text = g_utf8_next_char(text))
+  {
+    c = g_utf8_get_char(text);
+    if(g_unichar_isalnum(c) || c == '_')
+    {
+      if(terms->word_length < INFINOTED_PLUGIN_UTIL_SEARCH_MAX_TERM_LENGTH)
+        g_string_append_unichar(terms->word, g_unichar_tolower(c));
+      ++terms->word_length;
+    }
+    else if(terms->word_length > 0)
+    {
+      infinoted_plugin_util_search_terms_finish_word(terms);
+    }
+  }
+}
+
+/**
+ * infinoted_plugin_util_search_terms_free:
+ * @terms: A #InfinotedPluginUtilSearchTerms.
+ *
+ * Releases all resources allocated for @terms.
+ */
+void
+infinoted_plugin_util_search_terms_free(InfinotedPluginUtilSearchTerms* terms)
+{
+  g_hash_table_destroy(terms->words);
+  g_string_free(terms->word, TRUE);
+  g_slice_free(InfinotedPluginUtilSearchTerms, terms);
+}
+
+/**
+ * infinoted_plugin_util_search_index_new:
+ *
+ * Creates a new, empty search index.
+ *
+ * Returns: A new #InfinotedPluginUtilSearchIndex. Free with
+ * infinoted_plugin_util_search_index_free().
+ */
+InfinotedPluginUtilSearchIndex*
+infinoted_plugin_util_search_index_new(void)
+{
+  InfinotedPluginUtilSearchIndex* index;
+  index = g_slice_new(InfinotedPluginUtilSearchIndex);
+
+  index->documents = g_hash_table_new_full(
+    g_str_hash,
+    g_str_equal,
+    NULL,
+    infinoted_plugin_util_search_document_free
+  );
+
+  index->terms = g_hash_table_new_full(
+    g_str_hash,
+    g_str_equal,
+    NULL,
+    infinoted_plugin_util_search_term_free
+  );
+
+  return index;
+}
+
+/**
+ * infinoted_plugin_util_search_index_free:
+ * @index: A #InfinotedPluginUtilSearchIndex.
+ *
+ * Releases all resources allocated for @index.
+ */
+void
+infinoted_plugin_util_search_index_free(InfinotedPluginUtilSearchIndex* index)
+{
+  g_hash_table_destroy(index->terms);
+  g_hash_table_destroy(index->documents);
+  g_slice_free(InfinotedPluginUtilSearchIndex, index);
+}
+
+/**
+ * infinoted_plugin_util_search_index_set_document:
+ * @index: A #InfinotedPluginUtilSearchIndex.
+ * @path: The path of the document in the directory.
+ * @mtime: The modification time of the document in storage.
+ * @terms: The words contained in the document. The index takes ownership.
+ *
+ * Adds the document at @path to @index, or replaces its words if it is
+ * already contained in @index. @mtime is not interpreted, but it can be
+ * queried with infinoted_plugin_util_search_index_lookup_document() to find
+ * out whether the document needs to be indexed again.
+ */
+void
+infinoted_plugin_util_search_index_set_document(
+  InfinotedPluginUtilSearchIndex* index,
+  const gchar* path,
+  gint64 mtime,
+  InfinotedPluginUtilSearchTerms* terms)
+{
+  InfinotedPluginUtilSearchDocument* document;
+  GHashTableIter iter;
+  gpointer key;
+
+  if(terms->word_length > 0)
+    infinoted_plugin_util_search_terms_finish_word(terms);
+
+  document = infinoted_plugin_util_search_index_ensure_document(
+    index,
+    path,
+    strlen(path)
+  );
+
+  document->mtime = mtime;
+
+  g_hash_table_iter_init(&iter, terms->words);
+  while(g_hash_table_iter_next(&iter, &key, NULL))
+  {
+    infinoted_plugin_util_search_index_link(
+      index,
+      document,
+      key,
+      strlen(key)
+    );
+  }
+
+  infinoted_plugin_util_search_terms_free(terms);
+}
+
+/**
+ * infinoted_plugin_util_search_index_remove_document:
+ * @index: A #InfinotedPluginUtilSearchIndex.
+ * @path: The path of a document in the directory.
+ *
+ * Removes the document at @path from @index.
+ *
+ * Returns: %TRUE if the document was contained in @index, %FALSE
+ * otherwise.
+ */
+gboolean
+infinoted_plugin_util_search_index_remove_document(
+  InfinotedPluginUtilSearchIndex* index,
+  const gchar* path)
+{
+  InfinotedPluginUtilSearchDocument* document;
+
+  document = g_hash_table_lookup(index->documents, path);
+  if(document == NULL) return FALSE;
+
+  infinoted_plugin_util_search_index_unlink(index, document);
+  g_hash_table_remove(index->documents, path);
+  return TRUE;
+}
+
+/**
+ * infinoted_plugin_util_search_index_lookup_document:
+ * @index: A #InfinotedPluginUtilSearchIndex.
+ * @path: The path of a document in the directory.
+ * @mtime: (out) (allow-none): Location to store the modification time of
+ * the document at the time it was indexed, or %NULL.
+ *
+ * Returns whether the document at @path is contained in @index.
+ *
+ * Returns: %TRUE if the document is contained in @index, %FALSE otherwise.
+ */
+gboolean
+infinoted_plugin_util_search_index_lookup_document(
+  InfinotedPluginUtilSearchIndex* index,
+  const gchar* path,
+  gint64* mtime)
+{
+  InfinotedPluginUtilSearchDocument* document;
+
+  document = g_hash_table_lookup(index->documents, path);
+  if(document == NULL) return FALSE;
+
+  if(mtime != NULL) *mtime = document->mtime;
+  return TRUE;
+}
+
+/**
+ * infinoted_plugin_util_search_index_remove_subtree:
+ * @index: A #InfinotedPluginUtilSearchIndex.
+ * @path: The path of a subdirectory in the directory.
+ *
+ * Removes all documents below the subdirectory at @path from @index.
+ */
+void
+infinoted_plugin_util_search_index_remove_subtree(
+  InfinotedPluginUtilSearchIndex* index,
+  const gchar* path)
+{
+  InfinotedPluginUtilSearchDocument* document;
+  GHashTableIter iter;
+  gpointer value;
+  gsize len;
+
+  len = strlen(path);
+  /* The root directory is the only path with a trailing slash */
+  if(len > 0 && path[len - 1] == '/')
+    --len;
+
+  g_hash_table_iter_init(&iter, index->documents);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+  {
+    document = (InfinotedPluginUtilSearchDocument*)value;
+    if(strncmp(document->path, path, len) != 0 || document->path[len] != '/')
+      continue;
+
+    infinoted_plugin_util_search_index_unlink(index, document);
+    g_hash_table_iter_remove(&iter);
+  }
+}
+
+/**
+ * infinoted_plugin_util_search_index_retain:
+ * @index: A #InfinotedPluginUtilSearchIndex.
+ * @paths: A set of document paths, with the paths as keys.
+ *
+ * Removes all documents from @index whose path is not contained in @paths.
+ */
+void
+infinoted_plugin_util_search_index_retain(
+  InfinotedPluginUtilSearchIndex* index,
+  GHashTable* paths)
+{
+  InfinotedPluginUtilSearchDocument* document;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init(&iter, index->documents);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+  {
+    document = (InfinotedPluginUtilSearchDocument*)value;
+    if(g_hash_table_lookup_extended(paths, document->path, NULL, NULL))
+      continue;
+
+    infinoted_plugin_util_search_index_unlink(index, document);
+    g_hash_table_iter_remove(&iter);
+  }
+}
+
+/**
+ * infinoted_plugin_util_search_index_get_n_documents:
+ * @index: A #InfinotedPluginUtilSearchIndex.
+ *
+ * Returns the number of documents in @index.
+ *
+ * Returns: The number of indexed documents.
+ */
+guint
+infinoted_plugin_util_search_index_get_n_documents(
+  InfinotedPluginUtilSearchIndex* index)
+{
+  return g_hash_table_size(index->documents);
+}
+
+/**
+ * infinoted_plugin_util_search_index_query:
+ * @index: A #InfinotedPluginUtilSearchIndex.
+ * @query: The words to search for, as UTF-8 text.
+ * @max_results: The maximum number of results to return, or 0 for no limit.
+ *
+ * Returns the paths of all documents that contain all words in @query,
+ * sorted alphabetically. Characters in @query that cannot be part of a word
+ * separate words, and words that are too short to be indexed are ignored.
+ *
+ * Returns: A %NULL-terminated list of paths. Free with g_strfreev().
+ */
+gchar**
+infinoted_plugin_util_search_index_query(InfinotedPluginUtilSearchIndex* index,
+                                         const gchar* query,
+                                         guint max_results)
+{
+  InfinotedPluginUtilSearchTerms* terms;
+  InfinotedPluginUtilSearchTerm* term;
+  InfinotedPluginUtilSearchDocument* document;
+  GPtrArray* query_terms;
+  GPtrArray* results;
+  GHashTableIter iter;
+  gpointer key;
+  guint i;
+
+  terms = infinoted_plugin_util_search_terms_new();
+  infinoted_plugin_util_search_terms_add_text(terms, query, strlen(query));
+  if(terms->word_length > 0)
+    infinoted_plugin_util_search_terms_finish_word(terms);
+
+  query_terms = g_ptr_array_new();
+  results = g_ptr_array_new();
+
+  g_hash_table_iter_init(&iter, terms->words);
+  while(g_hash_table_iter_next(&iter, &key, NULL))
+  {
+    term = g_hash_table_lookup(index->terms, key);
+    if(term == NULL)
+    {
+      /* No document can match */
+      g_ptr_array_set_size(query_terms, 0);
+      break;
+    }
+
+    g_ptr_array_add(query_terms, term);
+  }
+
+  if(query_terms->len > 0)
+  {
+    /* Walk the shortest document list, and check the others */
+    g_ptr_array_sort(
+      query_terms,
+      infinoted_plugin_util_search_index_compare_size
+    );
+
+    term = g_ptr_array_index(query_terms, 0);
+    g_hash_table_iter_init(&iter, term->documents);
+    while(g_hash_table_iter_next(&iter, &key, NULL))
+    {
+      document = (InfinotedPluginUtilSearchDocument*)key;
+
+      for(i = 1; i < query_terms->len; ++i)
+      {
+        term = g_ptr_array_index(query_terms, i);
+        if(g_hash_table_lookup(term->documents, document) == NULL)
+          break;
+      }
+
+      if(i == query_terms->len)
+        g_ptr_array_add(results, document->path);
+    }
+
+    g_ptr_array_sort(results, infinoted_plugin_util_search_index_compare_path);
+    if(max_results > 0 && results->len > max_results)
+      g_ptr_array_set_size(results, max_results);
+  }
+
+  for(i = 0; i < results->len; ++i)
+    g_ptr_array_index(results, i) = g_strdup(g_ptr_array_index(results, i));
+  g_ptr_array_add(results, NULL);
+
+  g_ptr_array_free(query_terms, TRUE);
+  infinoted_plugin_util_search_terms_free(terms);
+  return (gchar**)g_ptr_array_free(results, FALSE);
+}
+
+/**
+ * infinoted_plugin_util_search_index_save:
+ * @index: A #InfinotedPluginUtilSearchIndex.
+ * @filename: The file to write the index to.
+ * @error: Location to store error information, if any.
+ *
+ * Writes @index to @filename in a compact binary format. The file is
+ * replaced atomically.
+ *
+ * Returns: %TRUE on success, or %FALSE if an error occurred.
+ */
+gboolean
+infinoted_plugin_util_search_index_save(InfinotedPluginUtilSearchIndex* index,
+                                        const gchar* filename,
+                                        GError** error)
+{
+  InfinotedPluginUtilSearchDocument* document;
+  InfinotedPluginUtilSearchTerm* term;
+  GHashTableIter iter;
+  GHashTableIter doc_iter;
+  gpointer value;
+  GArray* ids;
+  GString* out;
+  guint id;
+  guint i;
+  gboolean result;
+
+  out = g_string_sized_new(4096);
+  g_string_append_len(
+    out,
+    INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_MAGIC,
+    sizeof(INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_MAGIC)
+  );
+
+  infinoted_plugin_util_search_index_write_uint(
+    out,
+    g_hash_table_size(index->documents)
+  );
+
+  id = 0;
+  g_hash_table_iter_init(&iter, index->documents);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+  {
+    document = (InfinotedPluginUtilSearchDocument*)value;
+    document->id = id++;
+
+    infinoted_plugin_util_search_index_write_string(out, document->path);
+    infinoted_plugin_util_search_index_write_uint(out, document->mtime);
+  }
+
+  infinoted_plugin_util_search_index_write_uint(
+    out,
+    g_hash_table_size(index->terms)
+  );
+
+  ids = g_array_new(FALSE, FALSE, sizeof(guint));
+  g_hash_table_iter_init(&iter, index->terms);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
+  {
+    term = (InfinotedPluginUtilSearchTerm*)value;
+
+    g_array_set_size(ids, 0);
+    g_hash_table_iter_init(&doc_iter, term->documents);
+    while(g_hash_table_iter_next(&doc_iter, &value, NULL))
+    {
+      document = (InfinotedPluginUtilSearchDocument*)value;
+      g_array_append_val(ids, document->id);
+    }
+
+    g_array_sort(ids, infinoted_plugin_util_search_index_compare_uint);
+
+    infinoted_plugin_util_search_index_write_string(out, term->text);
+    infinoted_plugin_util_search_index_write_uint(out, ids->len);
+
+    for(i = 0; i < ids->len; ++i)
+    {
+      infinoted_plugin_util_search_index_write_uint(
+        out,
+        g_array_index(ids, guint, i) -
+          (i > 0 ? g_array_index(ids, guint, i - 1) : 0)
+      );
+    }
+  }
+
+  g_array_free(ids, TRUE);
+
+  result = g_file_set_contents(filename, out->str, out->len, error);
+  g_string_free(out, TRUE);
+  return result;
+}
+
+/**
+ * infinoted_plugin_util_search_index_load:
+ * @index: A #InfinotedPluginUtilSearchIndex.
+ * @filename: A file written by infinoted_plugin_util_search_index_save().
+ * @error: Location to store error information, if any.
+ *
+ * Replaces the content of @index by the index stored in @filename. If an
+ * error occurs, @index is left empty.
+ *
+ * Returns: %TRUE on success, or %FALSE if an error occurred.
+ */
+gboolean
+infinoted_plugin_util_search_index_load(InfinotedPluginUtilSearchIndex* index,
+                                        const gchar* filename,
+                                        GError** error)
+{
+  gchar* content;
+  gsize length;
+  const guchar* pos;
+  gboolean result;
+
+  g_hash_table_remove_all(index->terms);
+  g_hash_table_remove_all(index->documents);
+
+  if(!g_file_get_contents(filename, &content, &length, error))
+    return FALSE;
+
+  result = FALSE;
+  if(length >= sizeof(INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_MAGIC) &&
+     memcmp(content, INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_MAGIC,
+            sizeof(INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_MAGIC)) == 0)
+  {
+    pos = (const guchar*)content;
+    pos += sizeof(INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_MAGIC);
+    result = infinoted_plugin_util_search_index_parse(
+      index,
+      pos,
+      (const guchar*)content + length
+    );
+  }
+
+  g_free(content);
+
+  if(result == FALSE)
+  {
+    g_hash_table_remove_all(index->terms);
+    g_hash_table_remove_all(index->documents);
+
+    g_set_error(
+      error,
+      infinoted_plugin_util_search_index_error_quark(),
+      INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_ERROR_INVALID_FORMAT,
+      _("\"%s\" is not a valid search index"),
+      filename
+    );
+  }
+
+  return result;
+}
+
+/* vim:set et sw=2 ts=2: */
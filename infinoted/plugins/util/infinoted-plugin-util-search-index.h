@@ -0,0 +1,112 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_H__
+#define __INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _InfinotedPluginUtilSearchIndex
+  InfinotedPluginUtilSearchIndex;
+
+typedef struct _InfinotedPluginUtilSearchTerms
+  InfinotedPluginUtilSearchTerms;
+
+typedef enum _InfinotedPluginUtilSearchIndexError
+{
+  INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_ERROR_INVALID_FORMAT
+} InfinotedPluginUtilSearchIndexError;
+
+GQuark
+infinoted_plugin_util_search_index_error_quark(void);
+
+InfinotedPluginUtilSearchTerms*
+infinoted_plugin_util_search_terms_new(void);
+
+void
+infinoted_plugin_util_search_terms_add_text(
+  InfinotedPluginUtilSearchTerms* terms,
+  const gchar* text,
+  gsize bytes);
+
+void
+infinoted_plugin_util_search_terms_free(InfinotedPluginUtilSearchTerms* terms);
+
+InfinotedPluginUtilSearchIndex*
+infinoted_plugin_util_search_index_new(void);
+
+void
+infinoted_plugin_util_search_index_free(
+  InfinotedPluginUtilSearchIndex* index);
+
+void
+infinoted_plugin_util_search_index_set_document(
+  InfinotedPluginUtilSearchIndex* index,
+  const gchar* path,
+  gint64 mtime,
+  InfinotedPluginUtilSearchTerms* terms);
+
+gboolean
+infinoted_plugin_util_search_index_remove_document(
+  InfinotedPluginUtilSearchIndex* index,
+  const gchar* path);
+
+gboolean
+infinoted_plugin_util_search_index_lookup_document(
+  InfinotedPluginUtilSearchIndex* index,
+  const gchar* path,
+  gint64* mtime);
+
+void
+infinoted_plugin_util_search_index_remove_subtree(
+  InfinotedPluginUtilSearchIndex* index,
+  const gchar* path);
+
+void
+infinoted_plugin_util_search_index_retain(
+  InfinotedPluginUtilSearchIndex* index,
+  GHashTable* paths);
+
+guint
+infinoted_plugin_util_search_index_get_n_documents(
+  InfinotedPluginUtilSearchIndex* index);
+
+gchar**
+infinoted_plugin_util_search_index_query(
+  InfinotedPluginUtilSearchIndex* index,
+  const gchar* query,
+  guint max_results);
+
+gboolean
+infinoted_plugin_util_search_index_save(InfinotedPluginUtilSearchIndex* index,
+                                        const gchar* filename,
+                                        GError** error);
+
+gboolean
+infinoted_plugin_util_search_index_load(InfinotedPluginUtilSearchIndex* index,
+                                        const gchar* filename,
+                                        GError** error);
+
+G_END_DECLS
+
+#endif /* __INFINOTED_PLUGIN_UTIL_SEARCH_INDEX_H__ */
+
+/* vim:set et sw=2 ts=2: */
@@ -236,6 +236,31 @@ inf_gtk_browser_model_filter_browser_iter_to_tree_iter(InfGtkBrowserModel* m,
   }
 }
 
+static gboolean
+inf_gtk_browser_model_filter_tree_iter_to_browser_iter(InfGtkBrowserModel* m,
+                                                       GtkTreeIter* tree_iter,
+                                                       InfBrowser** browser,
+                                                       InfBrowserIter* iter)
+{
+  GtkTreeModel* child_model;
+  GtkTreeIter child_iter;
+
+  child_model = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(m));
+
+  gtk_tree_model_filter_convert_iter_to_child_iter(
+    GTK_TREE_MODEL_FILTER(m),
+    &child_iter,
+    tree_iter
+  );
+
+  return inf_gtk_browser_model_tree_iter_to_browser_iter(
+    INF_GTK_BROWSER_MODEL(child_model),
+    &child_iter,
+    browser,
+    iter
+  );
+}
+
 /*
  * GType registration
  */
@@ -262,6 +287,8 @@ inf_gtk_browser_model_filter_browser_model_iface_init(
    * chars ;) */
   iface->browser_iter_to_tree_iter =
     inf_gtk_browser_model_filter_browser_iter_to_tree_iter;
+  iface->tree_iter_to_browser_iter =
+    inf_gtk_browser_model_filter_tree_iter_to_browser_iter;
 }
 
 /*
@@ -224,6 +224,31 @@ inf_gtk_browser_model_sort_browser_iter_to_tree_iter(InfGtkBrowserModel* mdl,
   }
 }
 
+static gboolean
+inf_gtk_browser_model_sort_tree_iter_to_browser_iter(InfGtkBrowserModel* m,
+                                                     GtkTreeIter* tree_iter,
+                                                     InfBrowser** browser,
+                                                     InfBrowserIter* iter)
+{
+  GtkTreeModel* child_model;
+  GtkTreeIter child_iter;
+
+  child_model = gtk_tree_model_sort_get_model(GTK_TREE_MODEL_SORT(m));
+
+  gtk_tree_model_sort_convert_iter_to_child_iter(
+    GTK_TREE_MODEL_SORT(m),
+    &child_iter,
+    tree_iter
+  );
+
+  return inf_gtk_browser_model_tree_iter_to_browser_iter(
+    INF_GTK_BROWSER_MODEL(child_model),
+    &child_iter,
+    browser,
+    iter
+  );
+}
+
 /*
  * GType registration
  */
@@ -249,6 +274,8 @@ inf_gtk_browser_model_sort_browser_model_iface_init(
    * be consistent, but a _bit_ too long to fit properly into 80 chars ;) */
   iface->browser_iter_to_tree_iter =
     inf_gtk_browser_model_sort_browser_iter_to_tree_iter;
+  iface->tree_iter_to_browser_iter =
+    inf_gtk_browser_model_sort_tree_iter_to_browser_iter;
 }
 
 /*
@@ -0,0 +1,1981 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:inf-gtk-browser-model-sorted
+ * @title: InfGtkBrowserModelSorted
+ * @short_description: Incrementally sorted and filtered browser model
+ * @include: libinfgtk/inf-gtk-browser-model-sorted.h
+ * @see_also: #InfGtkBrowserModelSort, #InfGtkBrowserModelFilter
+ * @stability: Unstable
+ *
+ * #InfGtkBrowserModelSorted shows the content of another
+ * #InfGtkBrowserModel with the nodes of each directory sorted by name,
+ * subdirectories first. Nodes can optionally be hidden with a
+ * #InfGtkBrowserModelSortedVisibleFunc. Toplevel rows are shown in the
+ * same order as in the child model.
+ *
+ * In contrast to #InfGtkBrowserModelSort and #InfGtkBrowserModelFilter,
+ * which need to update the whole directory level whenever a node is added,
+ * #InfGtkBrowserModelSorted reads directory contents directly from the
+ * #InfBrowser, and only once the content of a directory is requested. New
+ * nodes are inserted at their sorted position with a binary search. Nodes
+ * that are added while their directory is being explored are collected
+ * and inserted all at once when the exploration has finished, with a
+ * single reordering of the directory.
+ */
+
+#include <libinfgtk/inf-gtk-browser-model-sorted.h>
+#include <libinfinity/inf-signals.h>
+
+#include <string.h>
+
+typedef struct _InfGtkBrowserModelSortedNode InfGtkBrowserModelSortedNode;
+struct _InfGtkBrowserModelSortedNode {
+  InfGtkBrowserModelSorted* model;
+  /* NULL for toplevel nodes */
+  InfGtkBrowserModelSortedNode* parent;
+  /* Toplevel node this node belongs to, the node itself for toplevel
+   * nodes. */
+  InfGtkBrowserModelSortedNode* top;
+
+  /* Position in the parent's children or in the toplevel nodes, or NULL
+   * if the node is pending, i.e. not yet visible in the model. */
+  GSequenceIter* position;
+  /* Link in the parent's pending queue if the node is pending */
+  GList* pending_link;
+
+  /* Unused for toplevel nodes, which refer to the root node of their
+   * browser, if any. */
+  InfBrowserIter iter;
+  gboolean is_subdirectory;
+  gchar* collate_key;
+
+  /* Visible children, or NULL if they have not yet been requested */
+  GSequence* children;
+  /* Children added during exploration, not yet visible */
+  GQueue pending;
+  InfRequest* explore_request;
+
+  /* Scratch space for reordering */
+  guint offset;
+
+  /* Toplevel nodes only */
+  InfBrowser* browser;
+  GHashTable* nodes; /* node ID -> InfGtkBrowserModelSortedNode */
+};
+
+typedef struct _InfGtkBrowserModelSortedPrivate
+  InfGtkBrowserModelSortedPrivate;
+struct _InfGtkBrowserModelSortedPrivate {
+  gint stamp;
+
+  InfGtkBrowserModel* child_model;
+  GSequence* toplevel;
+
+  /* Node which is about to be removed from its browser, see the comment
+   * on the missing field in inf-gtk-browser-store.c. */
+  gpointer missing;
+
+  InfGtkBrowserModelSortedVisibleFunc visible_func;
+  gpointer visible_user_data;
+  GDestroyNotify visible_notify;
+};
+
+enum {
+  PROP_0,
+
+  PROP_CHILD_MODEL
+};
+
+/* If fewer nodes than this fraction of the directory size have been added
+ * during an exploration, they are inserted one by one instead of
+ * reordering the whole directory. */
+#define INF_GTK_BROWSER_MODEL_SORTED_REORDER_RATIO 16
+
+#define INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_GTK_TYPE_BROWSER_MODEL_SORTED, InfGtkBrowserModelSortedPrivate))
+
+static void inf_gtk_browser_model_sorted_tree_model_iface_init(GtkTreeModelIface* iface);
+static void inf_gtk_browser_model_sorted_browser_model_iface_init(InfGtkBrowserModelInterface* iface);
+G_DEFINE_TYPE_WITH_CODE(InfGtkBrowserModelSorted, inf_gtk_browser_model_sorted, G_TYPE_OBJECT,
+  G_ADD_PRIVATE(InfGtkBrowserModelSorted)
+  G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, inf_gtk_browser_model_sorted_tree_model_iface_init)
+  G_IMPLEMENT_INTERFACE(INF_GTK_TYPE_BROWSER_MODEL, inf_gtk_browser_model_sorted_browser_model_iface_init))
+
+static void
+inf_gtk_browser_model_sorted_node_added_cb(InfBrowser* browser,
+                                           InfBrowserIter* iter,
+                                           InfRequest* request,
+                                           gpointer user_data);
+
+static void
+inf_gtk_browser_model_sorted_node_removed_cb(InfBrowser* browser,
+                                             InfBrowserIter* iter,
+                                             InfRequest* request,
+                                             gpointer user_data);
+
+static void
+inf_gtk_browser_model_sorted_request_finished_cb(InfRequest* request,
+                                                 const InfRequestResult* res,
+                                                 const GError* error,
+                                                 gpointer user_data);
+
+/*
+ * Utility functions
+ */
+
+static void
+inf_gtk_browser_model_sorted_init_iter(InfGtkBrowserModelSorted* model,
+                                       GtkTreeIter* iter,
+                                       InfGtkBrowserModelSortedNode* node)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  iter->stamp = priv->stamp;
+  iter->user_data = node;
+  iter->user_data2 = NULL;
+  iter->user_data3 = NULL;
+}
+
+static GtkTreePath*
+inf_gtk_browser_model_sorted_get_node_path(InfGtkBrowserModelSortedNode* node)
+{
+  GtkTreePath* path;
+  path = gtk_tree_path_new();
+
+  for(; node != NULL; node = node->parent)
+  {
+    g_assert(node->position != NULL);
+
+    gtk_tree_path_prepend_index(
+      path,
+      g_sequence_iter_get_position(node->position)
+    );
+  }
+
+  return path;
+}
+
+static gint
+inf_gtk_browser_model_sorted_compare_func(gconstpointer a,
+                                          gconstpointer b,
+                                          gpointer user_data)
+{
+  const InfGtkBrowserModelSortedNode* first;
+  const InfGtkBrowserModelSortedNode* second;
+
+  first = (const InfGtkBrowserModelSortedNode*)a;
+  second = (const InfGtkBrowserModelSortedNode*)b;
+
+  /* Subdirectories first */
+  if(first->is_subdirectory != second->is_subdirectory)
+    return first->is_subdirectory ? -1 : 1;
+
+  return strcmp(first->collate_key, second->collate_key);
+}
+
+static gboolean
+inf_gtk_browser_model_sorted_is_visible(InfGtkBrowserModelSorted* model,
+                                        InfBrowser* browser,
+                                        const InfBrowserIter* iter)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  if(iter->node == priv->missing)
+    return FALSE;
+
+  if(priv->visible_func == NULL)
+    return TRUE;
+
+  return priv->visible_func(browser, iter, priv->visible_user_data);
+}
+
+/* Returns whether the browser node parent has a visible child other
+ * than except. */
+static gboolean
+inf_gtk_browser_model_sorted_has_visible_child(InfGtkBrowserModelSorted* model,
+                                               InfBrowser* browser,
+                                               const InfBrowserIter* parent,
+                                               const InfBrowserIter* except)
+{
+  InfBrowserIter iter;
+  gboolean result;
+
+  if(!inf_browser_is_subdirectory(browser, parent))
+    return FALSE;
+  if(!inf_browser_get_explored(browser, parent))
+    return FALSE;
+
+  iter = *parent;
+  for(result = inf_browser_get_child(browser, &iter);
+      result == TRUE;
+      result = inf_browser_get_next(browser, &iter))
+  {
+    if(except != NULL && iter.node_id == except->node_id)
+      continue;
+
+    if(inf_gtk_browser_model_sorted_is_visible(model, browser, &iter))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Sets iter to the browser node of the given node and returns TRUE, or
+ * returns FALSE if it is not available. */
+static gboolean
+inf_gtk_browser_model_sorted_node_get_iter(InfGtkBrowserModelSortedNode* node,
+                                           InfBrowserIter* iter)
+{
+  InfBrowserStatus status;
+
+  if(node->parent != NULL)
+  {
+    *iter = node->iter;
+    return TRUE;
+  }
+
+  if(node->browser == NULL)
+    return FALSE;
+
+  g_object_get(G_OBJECT(node->browser), "status", &status, NULL);
+  if(status != INF_BROWSER_OPEN)
+    return FALSE;
+
+  inf_browser_get_root(node->browser, iter);
+  return TRUE;
+}
+
+static InfGtkBrowserModelSortedNode*
+inf_gtk_browser_model_sorted_find_top(InfGtkBrowserModelSorted* model,
+                                      InfBrowser* browser)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* top;
+  GSequenceIter* iter;
+
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  for(iter = g_sequence_get_begin_iter(priv->toplevel);
+      !g_sequence_iter_is_end(iter);
+      iter = g_sequence_iter_next(iter))
+  {
+    top = (InfGtkBrowserModelSortedNode*)g_sequence_get(iter);
+    if(top->browser == browser)
+      return top;
+  }
+
+  return NULL;
+}
+
+static InfGtkBrowserModelSortedNode*
+inf_gtk_browser_model_sorted_lookup(InfGtkBrowserModelSortedNode* top,
+                                    const InfBrowserIter* iter)
+{
+  if(iter->node_id == 0)
+    return top;
+
+  return g_hash_table_lookup(top->nodes, GUINT_TO_POINTER(iter->node_id));
+}
+
+static void
+inf_gtk_browser_model_sorted_emit_inserted(InfGtkBrowserModelSortedNode* node)
+{
+  GtkTreePath* path;
+  GtkTreeIter iter;
+
+  path = inf_gtk_browser_model_sorted_get_node_path(node);
+  inf_gtk_browser_model_sorted_init_iter(node->model, &iter, node);
+  gtk_tree_model_row_inserted(GTK_TREE_MODEL(node->model), path, &iter);
+  gtk_tree_path_free(path);
+}
+
+static void
+inf_gtk_browser_model_sorted_emit_toggled(InfGtkBrowserModelSortedNode* node)
+{
+  GtkTreePath* path;
+  GtkTreeIter iter;
+
+  path = inf_gtk_browser_model_sorted_get_node_path(node);
+  inf_gtk_browser_model_sorted_init_iter(node->model, &iter, node);
+
+  gtk_tree_model_row_has_child_toggled(
+    GTK_TREE_MODEL(node->model),
+    path,
+    &iter
+  );
+
+  gtk_tree_path_free(path);
+}
+
+/*
+ * Node handling
+ */
+
+static InfGtkBrowserModelSortedNode*
+inf_gtk_browser_model_sorted_node_new_top(InfGtkBrowserModelSorted* model)
+{
+  InfGtkBrowserModelSortedNode* node;
+  node = g_slice_new(InfGtkBrowserModelSortedNode);
+
+  node->model = model;
+  node->parent = NULL;
+  node->top = node;
+  node->position = NULL;
+  node->pending_link = NULL;
+  node->iter.node_id = 0;
+  node->iter.node = NULL;
+  node->is_subdirectory = TRUE;
+  node->collate_key = NULL;
+  node->children = NULL;
+  g_queue_init(&node->pending);
+  node->explore_request = NULL;
+  node->offset = 0;
+  node->browser = NULL;
+  node->nodes = g_hash_table_new(NULL, NULL);
+
+  return node;
+}
+
+static InfGtkBrowserModelSortedNode*
+inf_gtk_browser_model_sorted_node_new(InfGtkBrowserModelSortedNode* parent,
+                                      const InfBrowserIter* iter)
+{
+  InfGtkBrowserModelSortedNode* node;
+  InfBrowser* browser;
+
+  browser = parent->top->browser;
+  node = g_slice_new(InfGtkBrowserModelSortedNode);
+
+  node->model = parent->model;
+  node->parent = parent;
+  node->top = parent->top;
+  node->position = NULL;
+  node->pending_link = NULL;
+  node->iter = *iter;
+  node->is_subdirectory = inf_browser_is_subdirectory(browser, iter);
+  node->collate_key = g_utf8_collate_key_for_filename(
+    inf_browser_get_node_name(browser, iter),
+    -1
+  );
+  node->children = NULL;
+  g_queue_init(&node->pending);
+  node->explore_request = NULL;
+  node->offset = 0;
+  node->browser = NULL;
+  node->nodes = NULL;
+
+  g_hash_table_insert(
+    node->top->nodes,
+    GUINT_TO_POINTER(iter->node_id),
+    node
+  );
+
+  return node;
+}
+
+static void
+inf_gtk_browser_model_sorted_node_free(InfGtkBrowserModelSortedNode* node);
+
+static void
+inf_gtk_browser_model_sorted_node_unset_request(
+  InfGtkBrowserModelSortedNode* node)
+{
+  if(node->explore_request != NULL)
+  {
+    inf_signal_handlers_disconnect_by_func(
+      node->explore_request,
+      G_CALLBACK(inf_gtk_browser_model_sorted_request_finished_cb),
+      node
+    );
+
+    g_object_unref(node->explore_request);
+    node->explore_request = NULL;
+  }
+}
+
+/* Frees all children and pending children of node, without notifying */
+static void
+inf_gtk_browser_model_sorted_node_release(InfGtkBrowserModelSortedNode* node)
+{
+  InfGtkBrowserModelSortedNode* child;
+  GSequenceIter* iter;
+
+  inf_gtk_browser_model_sorted_node_unset_request(node);
+
+  while(!g_queue_is_empty(&node->pending))
+  {
+    child = (InfGtkBrowserModelSortedNode*)g_queue_pop_head(&node->pending);
+    child->pending_link = NULL;
+    inf_gtk_browser_model_sorted_node_free(child);
+  }
+
+  if(node->children != NULL)
+  {
+    for(iter = g_sequence_get_begin_iter(node->children);
+        !g_sequence_iter_is_end(iter);
+        iter = g_sequence_iter_next(iter))
+    {
+      child = (InfGtkBrowserModelSortedNode*)g_sequence_get(iter);
+      inf_gtk_browser_model_sorted_node_free(child);
+    }
+
+    g_sequence_free(node->children);
+    node->children = NULL;
+  }
+}
+
+static void
+inf_gtk_browser_model_sorted_node_free(InfGtkBrowserModelSortedNode* node)
+{
+  inf_gtk_browser_model_sorted_node_release(node);
+
+  if(node->parent != NULL)
+  {
+    g_hash_table_remove(
+      node->top->nodes,
+      GUINT_TO_POINTER(node->iter.node_id)
+    );
+  }
+  else
+  {
+    g_assert(node->browser == NULL);
+    g_hash_table_destroy(node->nodes);
+  }
+
+  g_free(node->collate_key);
+  g_slice_free(InfGtkBrowserModelSortedNode, node);
+}
+
+/* Reads the visible children of node from the browser, if not done yet */
+static void
+inf_gtk_browser_model_sorted_node_populate(InfGtkBrowserModelSortedNode* node)
+{
+  InfGtkBrowserModelSortedNode* child;
+  InfBrowser* browser;
+  InfBrowserIter iter;
+  gboolean result;
+
+  if(node->children != NULL)
+    return;
+
+  /* Pending nodes are not part of the model yet */
+  g_assert(node->parent == NULL || node->position != NULL);
+
+  node->children = g_sequence_new(NULL);
+  if(!inf_gtk_browser_model_sorted_node_get_iter(node, &iter))
+    return;
+
+  browser = node->top->browser;
+  if(!inf_browser_is_subdirectory(browser, &iter))
+    return;
+  if(!inf_browser_get_explored(browser, &iter))
+    return;
+
+  for(result = inf_browser_get_child(browser, &iter);
+      result == TRUE;
+      result = inf_browser_get_next(browser, &iter))
+  {
+    if(inf_gtk_browser_model_sorted_is_visible(node->model, browser, &iter))
+    {
+      child = inf_gtk_browser_model_sorted_node_new(node, &iter);
+      child->position = g_sequence_append(node->children, child);
+    }
+  }
+
+  g_sequence_sort(
+    node->children,
+    inf_gtk_browser_model_sorted_compare_func,
+    NULL
+  );
+}
+
+/* Makes a new child visible at its sorted position */
+static void
+inf_gtk_browser_model_sorted_node_insert(InfGtkBrowserModelSortedNode* node,
+                                         InfGtkBrowserModelSortedNode* child)
+{
+  gboolean was_empty;
+
+  was_empty = g_sequence_iter_is_end(g_sequence_get_begin_iter(node->children));
+
+  child->position = g_sequence_insert_sorted(
+    node->children,
+    child,
+    inf_gtk_browser_model_sorted_compare_func,
+    NULL
+  );
+
+  inf_gtk_browser_model_sorted_emit_inserted(child);
+
+  if(was_empty)
+    inf_gtk_browser_model_sorted_emit_toggled(node);
+}
+
+/* Removes all children of node from the model */
+static void
+inf_gtk_browser_model_sorted_node_clear(InfGtkBrowserModelSortedNode* node)
+{
+  InfGtkBrowserModelSortedNode* child;
+  GSequenceIter* iter;
+  GtkTreePath* path;
+  GtkTreeIter tree_iter;
+  gboolean had_children;
+
+  if(node->children == NULL)
+    return;
+
+  /* Pending children have not been announced, so just drop them */
+  inf_gtk_browser_model_sorted_node_unset_request(node);
+  while(!g_queue_is_empty(&node->pending))
+  {
+    child = (InfGtkBrowserModelSortedNode*)g_queue_pop_head(&node->pending);
+    child->pending_link = NULL;
+    inf_gtk_browser_model_sorted_node_free(child);
+  }
+
+  had_children = FALSE;
+  path = inf_gtk_browser_model_sorted_get_node_path(node);
+  gtk_tree_path_append_index(path, 0);
+
+  for(iter = g_sequence_get_begin_iter(node->children);
+      !g_sequence_iter_is_end(iter);
+      iter = g_sequence_get_begin_iter(node->children))
+  {
+    child = (InfGtkBrowserModelSortedNode*)g_sequence_get(iter);
+    g_sequence_remove(iter);
+    inf_gtk_browser_model_sorted_node_free(child);
+
+    gtk_tree_model_row_deleted(GTK_TREE_MODEL(node->model), path);
+    had_children = TRUE;
+  }
+
+  gtk_tree_path_up(path);
+
+  if(had_children)
+  {
+    inf_gtk_browser_model_sorted_init_iter(node->model, &tree_iter, node);
+
+    gtk_tree_model_row_has_child_toggled(
+      GTK_TREE_MODEL(node->model),
+      path,
+      &tree_iter
+    );
+  }
+
+  gtk_tree_path_free(path);
+}
+
+/* Makes all pending children of node visible */
+static void
+inf_gtk_browser_model_sorted_node_flush(InfGtkBrowserModelSortedNode* node)
+{
+  InfGtkBrowserModelSortedNode* child;
+  GSequenceIter* iter;
+  GtkTreePath* path;
+  GtkTreeIter tree_iter;
+  guint old_length;
+  guint length;
+  gint* new_order;
+  gboolean reordered;
+  guint i;
+
+  inf_gtk_browser_model_sorted_node_unset_request(node);
+  if(g_queue_is_empty(&node->pending))
+    return;
+
+  old_length = g_sequence_get_length(node->children);
+
+  if(g_queue_get_length(&node->pending) <
+     old_length / INF_GTK_BROWSER_MODEL_SORTED_REORDER_RATIO)
+  {
+    while(!g_queue_is_empty(&node->pending))
+    {
+      child = (InfGtkBrowserModelSortedNode*)g_queue_pop_head(&node->pending);
+      child->pending_link = NULL;
+      inf_gtk_browser_model_sorted_node_insert(node, child);
+    }
+
+    return;
+  }
+
+  /* Append all new children, and then sort the directory once, instead
+   * of searching the position for each of them. */
+  while(!g_queue_is_empty(&node->pending))
+  {
+    child = (InfGtkBrowserModelSortedNode*)g_queue_pop_head(&node->pending);
+    child->pending_link = NULL;
+    child->position = g_sequence_append(node->children, child);
+
+    inf_gtk_browser_model_sorted_emit_inserted(child);
+    if(old_length == 0 && g_sequence_get_length(node->children) == 1)
+      inf_gtk_browser_model_sorted_emit_toggled(node);
+  }
+
+  i = 0;
+  for(iter = g_sequence_get_begin_iter(node->children);
+      !g_sequence_iter_is_end(iter);
+      iter = g_sequence_iter_next(iter))
+  {
+    child = (InfGtkBrowserModelSortedNode*)g_sequence_get(iter);
+    child->offset = i++;
+  }
+
+  length = i;
+
+  g_sequence_sort(
+    node->children,
+    inf_gtk_browser_model_sorted_compare_func,
+    NULL
+  );
+
+  new_order = g_malloc(sizeof(gint) * length);
+  reordered = FALSE;
+
+  i = 0;
+  for(iter = g_sequence_get_begin_iter(node->children);
+      !g_sequence_iter_is_end(iter);
+      iter = g_sequence_iter_next(iter))
+  {
+    child = (InfGtkBrowserModelSortedNode*)g_sequence_get(iter);
+    new_order[i] = child->offset;
+    if(child->offset != i) reordered = TRUE;
+    ++i;
+  }
+
+  if(reordered)
+  {
+    path = inf_gtk_browser_model_sorted_get_node_path(node);
+    inf_gtk_browser_model_sorted_init_iter(node->model, &tree_iter, node);
+
+    gtk_tree_model_rows_reordered(
+      GTK_TREE_MODEL(node->model),
+      path,
+      &tree_iter,
+      new_order
+    );
+
+    gtk_tree_path_free(path);
+  }
+
+  g_free(new_order);
+}
+
+static void
+inf_gtk_browser_model_sorted_top_set_browser(InfGtkBrowserModelSortedNode* top,
+                                             InfBrowser* browser)
+{
+  if(top->browser != NULL)
+  {
+    inf_signal_handlers_disconnect_by_func(
+      top->browser,
+      G_CALLBACK(inf_gtk_browser_model_sorted_node_added_cb),
+      top->model
+    );
+
+    inf_signal_handlers_disconnect_by_func(
+      top->browser,
+      G_CALLBACK(inf_gtk_browser_model_sorted_node_removed_cb),
+      top->model
+    );
+
+    g_object_unref(top->browser);
+  }
+
+  top->browser = browser;
+
+  if(browser != NULL)
+  {
+    g_object_ref(browser);
+
+    g_signal_connect_after(
+      G_OBJECT(browser),
+      "node-added",
+      G_CALLBACK(inf_gtk_browser_model_sorted_node_added_cb),
+      top->model
+    );
+
+    g_signal_connect_after(
+      G_OBJECT(browser),
+      "node-removed",
+      G_CALLBACK(inf_gtk_browser_model_sorted_node_removed_cb),
+      top->model
+    );
+  }
+}
+
+static gboolean
+inf_gtk_browser_model_sorted_get_child_iter(InfGtkBrowserModelSorted* model,
+                                            InfGtkBrowserModelSortedNode* node,
+                                            GtkTreeIter* child_iter)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  if(node->parent == NULL)
+  {
+    return gtk_tree_model_iter_nth_child(
+      GTK_TREE_MODEL(priv->child_model),
+      child_iter,
+      NULL,
+      g_sequence_iter_get_position(node->position)
+    );
+  }
+  else
+  {
+    return inf_gtk_browser_model_browser_iter_to_tree_iter(
+      priv->child_model,
+      node->top->browser,
+      &node->iter,
+      child_iter
+    );
+  }
+}
+
+/*
+ * Signal handlers
+ */
+
+static void
+inf_gtk_browser_model_sorted_request_finished_cb(InfRequest* request,
+                                                 const InfRequestResult* res,
+                                                 const GError* error,
+                                                 gpointer user_data)
+{
+  InfGtkBrowserModelSortedNode* node;
+  node = (InfGtkBrowserModelSortedNode*)user_data;
+
+  g_assert(node->explore_request == request);
+  inf_gtk_browser_model_sorted_node_flush(node);
+}
+
+static void
+inf_gtk_browser_model_sorted_node_added_cb(InfBrowser* browser,
+                                           InfBrowserIter* iter,
+                                           InfRequest* request,
+                                           gpointer user_data)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedNode* top;
+  InfGtkBrowserModelSortedNode* parent;
+  InfGtkBrowserModelSortedNode* child;
+  InfRequest* explore_request;
+  InfBrowserIter parent_iter;
+  gboolean result;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(user_data);
+  top = inf_gtk_browser_model_sorted_find_top(model, browser);
+  g_assert(top != NULL);
+
+  if(iter->node_id == 0)
+    return;
+
+  /* Can already be there if the directory was read by someone else's
+   * signal handler before we got notified. */
+  if(inf_gtk_browser_model_sorted_lookup(top, iter) != NULL)
+    return;
+
+  parent_iter = *iter;
+  result = inf_browser_get_parent(browser, &parent_iter);
+  g_assert(result == TRUE);
+
+  /* Ignore if the parent is not part of the model */
+  parent = inf_gtk_browser_model_sorted_lookup(top, &parent_iter);
+  if(parent == NULL || (parent->parent != NULL && parent->position == NULL))
+    return;
+
+  if(!inf_gtk_browser_model_sorted_is_visible(model, browser, iter))
+    return;
+
+  if(parent->children == NULL)
+  {
+    /* The content of the parent has not been requested yet, we only need
+     * to tell whether it has children now. */
+    if(!inf_gtk_browser_model_sorted_has_visible_child(model, browser,
+                                                       &parent_iter, iter))
+    {
+      inf_gtk_browser_model_sorted_emit_toggled(parent);
+    }
+
+    return;
+  }
+
+  child = inf_gtk_browser_model_sorted_node_new(parent, iter);
+
+  explore_request = inf_browser_get_pending_request(
+    browser,
+    &parent_iter,
+    "explore-node"
+  );
+
+  if(explore_request != NULL)
+  {
+    if(parent->explore_request != explore_request)
+    {
+      inf_gtk_browser_model_sorted_node_flush(parent);
+
+      parent->explore_request = explore_request;
+      g_object_ref(explore_request);
+
+      g_signal_connect(
+        G_OBJECT(explore_request),
+        "finished",
+        G_CALLBACK(inf_gtk_browser_model_sorted_request_finished_cb),
+        parent
+      );
+    }
+
+    g_queue_push_tail(&parent->pending, child);
+    child->pending_link = g_queue_peek_tail_link(&parent->pending);
+  }
+  else
+  {
+    inf_gtk_browser_model_sorted_node_insert(parent, child);
+  }
+}
+
+static void
+inf_gtk_browser_model_sorted_node_removed_cb(InfBrowser* browser,
+                                             InfBrowserIter* iter,
+                                             InfRequest* request,
+                                             gpointer user_data)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* top;
+  InfGtkBrowserModelSortedNode* node;
+  InfGtkBrowserModelSortedNode* parent;
+  InfBrowserIter parent_iter;
+  GtkTreePath* path;
+  GtkTreeIter tree_iter;
+  gboolean result;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(user_data);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+  top = inf_gtk_browser_model_sorted_find_top(model, browser);
+  g_assert(top != NULL);
+  g_assert(priv->missing == NULL);
+
+  /* The node is still present in the browser at this point, make sure
+   * it is not read again if the model is queried from within the signal
+   * emissions below. */
+  priv->missing = iter->node;
+
+  if(iter->node_id == 0)
+  {
+    /* The root node is removed, but the toplevel row stays since it
+     * represents the browser. Keep an empty list of children so that
+     * nodes of a new root are inserted as they are added. */
+    if(top->children == NULL)
+      top->children = g_sequence_new(NULL);
+    else
+      inf_gtk_browser_model_sorted_node_clear(top);
+
+    inf_gtk_browser_model_sorted_emit_toggled(top);
+  }
+  else
+  {
+    node = inf_gtk_browser_model_sorted_lookup(top, iter);
+    if(node != NULL)
+    {
+      parent = node->parent;
+
+      if(node->position == NULL)
+      {
+        /* Has not been announced yet */
+        g_queue_delete_link(&parent->pending, node->pending_link);
+        node->pending_link = NULL;
+        inf_gtk_browser_model_sorted_node_free(node);
+      }
+      else
+      {
+        path = inf_gtk_browser_model_sorted_get_node_path(node);
+        g_sequence_remove(node->position);
+        inf_gtk_browser_model_sorted_node_free(node);
+
+        gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), path);
+
+        if(g_sequence_iter_is_end(g_sequence_get_begin_iter(parent->children)))
+        {
+          gtk_tree_path_up(path);
+          inf_gtk_browser_model_sorted_init_iter(model, &tree_iter, parent);
+
+          gtk_tree_model_row_has_child_toggled(
+            GTK_TREE_MODEL(model),
+            path,
+            &tree_iter
+          );
+        }
+
+        gtk_tree_path_free(path);
+      }
+    }
+    else
+    {
+      parent_iter = *iter;
+      result = inf_browser_get_parent(browser, &parent_iter);
+      g_assert(result == TRUE);
+
+      /* If the content of the parent has not been requested yet, we only
+       * need to tell whether it still has children. */
+      parent = inf_gtk_browser_model_sorted_lookup(top, &parent_iter);
+      if(parent != NULL && parent->children == NULL &&
+         (parent->parent == NULL || parent->position != NULL))
+      {
+        priv->missing = NULL;
+        if(inf_gtk_browser_model_sorted_is_visible(model, browser, iter))
+        {
+          priv->missing = iter->node;
+          if(!inf_gtk_browser_model_sorted_has_visible_child(model, browser,
+                                                             &parent_iter,
+                                                             iter))
+          {
+            inf_gtk_browser_model_sorted_emit_toggled(parent);
+          }
+        }
+      }
+    }
+  }
+
+  priv->missing = NULL;
+}
+
+static void
+inf_gtk_browser_model_sorted_row_inserted_cb(GtkTreeModel* child_model,
+                                             GtkTreePath* path,
+                                             GtkTreeIter* iter,
+                                             gpointer user_data)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* top;
+  InfBrowser* browser;
+
+  /* Only toplevel rows are taken from the child model, the rest is read
+   * from the browsers directly. */
+  if(gtk_tree_path_get_depth(path) != 1)
+    return;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(user_data);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  top = inf_gtk_browser_model_sorted_node_new_top(model);
+
+  inf_gtk_browser_model_tree_iter_to_browser_iter(
+    INF_GTK_BROWSER_MODEL(child_model),
+    iter,
+    &browser,
+    NULL
+  );
+
+  inf_gtk_browser_model_sorted_top_set_browser(top, browser);
+
+  top->position = g_sequence_insert_before(
+    g_sequence_get_iter_at_pos(
+      priv->toplevel,
+      gtk_tree_path_get_indices(path)[0]
+    ),
+    top
+  );
+
+  inf_gtk_browser_model_sorted_emit_inserted(top);
+}
+
+static void
+inf_gtk_browser_model_sorted_row_deleted_cb(GtkTreeModel* child_model,
+                                            GtkTreePath* path,
+                                            gpointer user_data)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* top;
+  GSequenceIter* iter;
+  GtkTreePath* own_path;
+
+  if(gtk_tree_path_get_depth(path) != 1)
+    return;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(user_data);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  iter = g_sequence_get_iter_at_pos(
+    priv->toplevel,
+    gtk_tree_path_get_indices(path)[0]
+  );
+
+  top = (InfGtkBrowserModelSortedNode*)g_sequence_get(iter);
+  own_path = inf_gtk_browser_model_sorted_get_node_path(top);
+
+  g_sequence_remove(iter);
+  inf_gtk_browser_model_sorted_top_set_browser(top, NULL);
+  inf_gtk_browser_model_sorted_node_free(top);
+
+  gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), own_path);
+  gtk_tree_path_free(own_path);
+}
+
+static void
+inf_gtk_browser_model_sorted_row_changed_cb(GtkTreeModel* child_model,
+                                            GtkTreePath* path,
+                                            GtkTreeIter* iter,
+                                            gpointer user_data)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* top;
+  InfGtkBrowserModelSortedNode* node;
+  InfBrowser* browser;
+  InfBrowserIter browser_iter;
+  GtkTreePath* own_path;
+  GtkTreeIter own_iter;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(user_data);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  if(gtk_tree_path_get_depth(path) == 1)
+  {
+    node = (InfGtkBrowserModelSortedNode*)g_sequence_get(
+      g_sequence_get_iter_at_pos(
+        priv->toplevel,
+        gtk_tree_path_get_indices(path)[0]
+      )
+    );
+  }
+  else
+  {
+    if(!inf_gtk_browser_model_tree_iter_to_browser_iter(
+         INF_GTK_BROWSER_MODEL(child_model), iter, &browser, &browser_iter))
+    {
+      return;
+    }
+
+    top = inf_gtk_browser_model_sorted_find_top(model, browser);
+    if(top == NULL)
+      return;
+
+    node = inf_gtk_browser_model_sorted_lookup(top, &browser_iter);
+    if(node == NULL || node->position == NULL)
+      return;
+  }
+
+  own_path = inf_gtk_browser_model_sorted_get_node_path(node);
+  inf_gtk_browser_model_sorted_init_iter(model, &own_iter, node);
+  gtk_tree_model_row_changed(GTK_TREE_MODEL(model), own_path, &own_iter);
+  gtk_tree_path_free(own_path);
+}
+
+static void
+inf_gtk_browser_model_sorted_row_has_child_toggled_cb(GtkTreeModel* child,
+                                                      GtkTreePath* path,
+                                                      GtkTreeIter* iter,
+                                                      gpointer user_data)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* top;
+
+  /* Below the toplevel we notify ourselves, based on the browser */
+  if(gtk_tree_path_get_depth(path) != 1)
+    return;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(user_data);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  top = (InfGtkBrowserModelSortedNode*)g_sequence_get(
+    g_sequence_get_iter_at_pos(
+      priv->toplevel,
+      gtk_tree_path_get_indices(path)[0]
+    )
+  );
+
+  inf_gtk_browser_model_sorted_emit_toggled(top);
+}
+
+static void
+inf_gtk_browser_model_sorted_rows_reordered_cb(GtkTreeModel* child_model,
+                                               GtkTreePath* path,
+                                               GtkTreeIter* iter,
+                                               gpointer new_order,
+                                               gpointer user_data)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+  GSequenceIter** positions;
+  GSequenceIter* seq_iter;
+  guint length;
+  guint i;
+
+  if(gtk_tree_path_get_depth(path) != 0)
+    return;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(user_data);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  length = g_sequence_get_length(priv->toplevel);
+  positions = g_malloc(sizeof(GSequenceIter*) * length);
+
+  i = 0;
+  for(seq_iter = g_sequence_get_begin_iter(priv->toplevel);
+      !g_sequence_iter_is_end(seq_iter);
+      seq_iter = g_sequence_iter_next(seq_iter))
+  {
+    positions[i++] = seq_iter;
+  }
+
+  /* Moving preserves the iterators, so the nodes keep their positions */
+  for(i = 0; i < length; ++i)
+  {
+    g_sequence_move(
+      positions[((gint*)new_order)[i]],
+      g_sequence_get_end_iter(priv->toplevel)
+    );
+  }
+
+  g_free(positions);
+
+  gtk_tree_model_rows_reordered(GTK_TREE_MODEL(model), path, NULL, new_order);
+}
+
+static void
+inf_gtk_browser_model_sorted_set_browser_cb(InfGtkBrowserModel* child_model,
+                                            GtkTreePath* path,
+                                            GtkTreeIter* iter,
+                                            InfBrowser* old_browser,
+                                            InfBrowser* new_browser,
+                                            gpointer user_data)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* top;
+  GtkTreePath* own_path;
+  GtkTreeIter own_iter;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(user_data);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  g_assert(gtk_tree_path_get_depth(path) == 1);
+
+  top = (InfGtkBrowserModelSortedNode*)g_sequence_get(
+    g_sequence_get_iter_at_pos(
+      priv->toplevel,
+      gtk_tree_path_get_indices(path)[0]
+    )
+  );
+
+  if(top->browser != new_browser)
+  {
+    /* Remove the content of the old browser. The content of the new
+     * browser is read when it is requested. */
+    inf_gtk_browser_model_sorted_node_clear(top);
+    inf_gtk_browser_model_sorted_node_release(top);
+    inf_gtk_browser_model_sorted_top_set_browser(top, new_browser);
+  }
+
+  own_path = inf_gtk_browser_model_sorted_get_node_path(top);
+  inf_gtk_browser_model_sorted_init_iter(model, &own_iter, top);
+
+  inf_gtk_browser_model_set_browser(
+    INF_GTK_BROWSER_MODEL(model),
+    own_path,
+    &own_iter,
+    old_browser,
+    new_browser
+  );
+
+  /* The child model has notified about children of the new browser
+   * before we took it over. */
+  gtk_tree_model_row_has_child_toggled(
+    GTK_TREE_MODEL(model),
+    own_path,
+    &own_iter
+  );
+
+  gtk_tree_path_free(own_path);
+}
+
+/*
+ * GObject overrides
+ */
+
+static void
+inf_gtk_browser_model_sorted_init(InfGtkBrowserModelSorted* model)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  priv->stamp = g_random_int();
+  priv->child_model = NULL;
+  priv->toplevel = g_sequence_new(NULL);
+  priv->missing = NULL;
+  priv->visible_func = NULL;
+  priv->visible_user_data = NULL;
+  priv->visible_notify = NULL;
+}
+
+static void
+inf_gtk_browser_model_sorted_constructed(GObject* object)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* top;
+  InfBrowser* browser;
+  GtkTreeIter iter;
+
+  G_OBJECT_CLASS(inf_gtk_browser_model_sorted_parent_class)->constructed(
+    object
+  );
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(object);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  g_assert(priv->child_model != NULL);
+
+  if(gtk_tree_model_iter_children(GTK_TREE_MODEL(priv->child_model),
+                                  &iter, NULL))
+  {
+    do
+    {
+      top = inf_gtk_browser_model_sorted_node_new_top(model);
+
+      inf_gtk_browser_model_tree_iter_to_browser_iter(
+        priv->child_model,
+        &iter,
+        &browser,
+        NULL
+      );
+
+      inf_gtk_browser_model_sorted_top_set_browser(top, browser);
+      top->position = g_sequence_append(priv->toplevel, top);
+    } while(gtk_tree_model_iter_next(GTK_TREE_MODEL(priv->child_model),
+                                     &iter));
+  }
+
+  g_signal_connect(
+    G_OBJECT(priv->child_model),
+    "row-inserted",
+    G_CALLBACK(inf_gtk_browser_model_sorted_row_inserted_cb),
+    model
+  );
+
+  g_signal_connect(
+    G_OBJECT(priv->child_model),
+    "row-deleted",
+    G_CALLBACK(inf_gtk_browser_model_sorted_row_deleted_cb),
+    model
+  );
+
+  g_signal_connect(
+    G_OBJECT(priv->child_model),
+    "row-changed",
+    G_CALLBACK(inf_gtk_browser_model_sorted_row_changed_cb),
+    model
+  );
+
+  g_signal_connect(
+    G_OBJECT(priv->child_model),
+    "row-has-child-toggled",
+    G_CALLBACK(inf_gtk_browser_model_sorted_row_has_child_toggled_cb),
+    model
+  );
+
+  g_signal_connect(
+    G_OBJECT(priv->child_model),
+    "rows-reordered",
+    G_CALLBACK(inf_gtk_browser_model_sorted_rows_reordered_cb),
+    model
+  );
+
+  g_signal_connect_after(
+    G_OBJECT(priv->child_model),
+    "set-browser",
+    G_CALLBACK(inf_gtk_browser_model_sorted_set_browser_cb),
+    model
+  );
+}
+
+static void
+inf_gtk_browser_model_sorted_dispose(GObject* object)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* top;
+  GSequenceIter* iter;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(object);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  for(iter = g_sequence_get_begin_iter(priv->toplevel);
+      !g_sequence_iter_is_end(iter);
+      iter = g_sequence_get_begin_iter(priv->toplevel))
+  {
+    top = (InfGtkBrowserModelSortedNode*)g_sequence_get(iter);
+    g_sequence_remove(iter);
+
+    inf_gtk_browser_model_sorted_top_set_browser(top, NULL);
+    inf_gtk_browser_model_sorted_node_free(top);
+  }
+
+  if(priv->child_model != NULL)
+  {
+    inf_signal_handlers_disconnect_by_func(
+      priv->child_model,
+      G_CALLBACK(inf_gtk_browser_model_sorted_row_inserted_cb),
+      model
+    );
+
+    inf_signal_handlers_disconnect_by_func(
+      priv->child_model,
+      G_CALLBACK(inf_gtk_browser_model_sorted_row_deleted_cb),
+      model
+    );
+
+    inf_signal_handlers_disconnect_by_func(
+      priv->child_model,
+      G_CALLBACK(inf_gtk_browser_model_sorted_row_changed_cb),
+      model
+    );
+
+    inf_signal_handlers_disconnect_by_func(
+      priv->child_model,
+      G_CALLBACK(inf_gtk_browser_model_sorted_row_has_child_toggled_cb),
+      model
+    );
+
+    inf_signal_handlers_disconnect_by_func(
+      priv->child_model,
+      G_CALLBACK(inf_gtk_browser_model_sorted_rows_reordered_cb),
+      model
+    );
+
+    inf_signal_handlers_disconnect_by_func(
+      priv->child_model,
+      G_CALLBACK(inf_gtk_browser_model_sorted_set_browser_cb),
+      model
+    );
+
+    g_object_unref(priv->child_model);
+    priv->child_model = NULL;
+  }
+
+  if(priv->visible_notify != NULL)
+    priv->visible_notify(priv->visible_user_data);
+
+  priv->visible_func = NULL;
+  priv->visible_user_data = NULL;
+  priv->visible_notify = NULL;
+
+  G_OBJECT_CLASS(inf_gtk_browser_model_sorted_parent_class)->dispose(object);
+}
+
+static void
+inf_gtk_browser_model_sorted_finalize(GObject* object)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(object);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  g_sequence_free(priv->toplevel);
+
+  G_OBJECT_CLASS(inf_gtk_browser_model_sorted_parent_class)->finalize(object);
+}
+
+static void
+inf_gtk_browser_model_sorted_set_property(GObject* object,
+                                          guint prop_id,
+                                          const GValue* value,
+                                          GParamSpec* pspec)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(object);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  switch(prop_id)
+  {
+  case PROP_CHILD_MODEL:
+    g_assert(priv->child_model == NULL); /* construct only */
+    priv->child_model = INF_GTK_BROWSER_MODEL(g_value_dup_object(value));
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+inf_gtk_browser_model_sorted_get_property(GObject* object,
+                                          guint prop_id,
+                                          GValue* value,
+                                          GParamSpec* pspec)
+{
+  InfGtkBrowserModelSorted* model;
+  InfGtkBrowserModelSortedPrivate* priv;
+
+  model = INF_GTK_BROWSER_MODEL_SORTED(object);
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  switch(prop_id)
+  {
+  case PROP_CHILD_MODEL:
+    g_value_set_object(value, G_OBJECT(priv->child_model));
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+/*
+ * GtkTreeModel implementation
+ */
+
+static GtkTreeModelFlags
+inf_gtk_browser_model_sorted_get_flags(GtkTreeModel* model)
+{
+  return GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint
+inf_gtk_browser_model_sorted_get_n_columns(GtkTreeModel* model)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  return gtk_tree_model_get_n_columns(GTK_TREE_MODEL(priv->child_model));
+}
+
+static GType
+inf_gtk_browser_model_sorted_get_column_type(GtkTreeModel* model,
+                                             gint index)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  return gtk_tree_model_get_column_type(
+    GTK_TREE_MODEL(priv->child_model),
+    index
+  );
+}
+
+static gboolean
+inf_gtk_browser_model_sorted_get_iter(GtkTreeModel* model,
+                                      GtkTreeIter* iter,
+                                      GtkTreePath* path)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* node;
+  GSequence* level;
+  gint* indices;
+  gint depth;
+  gint i;
+
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+  depth = gtk_tree_path_get_depth(path);
+  indices = gtk_tree_path_get_indices(path);
+  if(depth == 0) return FALSE;
+
+  node = NULL;
+  level = priv->toplevel;
+
+  for(i = 0; i < depth; ++i)
+  {
+    if(node != NULL)
+    {
+      inf_gtk_browser_model_sorted_node_populate(node);
+      level = node->children;
+    }
+
+    if(indices[i] < 0 || indices[i] >= g_sequence_get_length(level))
+      return FALSE;
+
+    node = (InfGtkBrowserModelSortedNode*)g_sequence_get(
+      g_sequence_get_iter_at_pos(level, indices[i])
+    );
+  }
+
+  inf_gtk_browser_model_sorted_init_iter(
+    INF_GTK_BROWSER_MODEL_SORTED(model),
+    iter,
+    node
+  );
+
+  return TRUE;
+}
+
+static GtkTreePath*
+inf_gtk_browser_model_sorted_get_path(GtkTreeModel* model,
+                                      GtkTreeIter* iter)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  g_assert(iter->stamp == priv->stamp);
+  return inf_gtk_browser_model_sorted_get_node_path(iter->user_data);
+}
+
+static void
+inf_gtk_browser_model_sorted_get_value(GtkTreeModel* model,
+                                       GtkTreeIter* iter,
+                                       gint column,
+                                       GValue* value)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  GtkTreeIter child_iter;
+  gboolean result;
+
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+  g_assert(iter->stamp == priv->stamp);
+
+  result = inf_gtk_browser_model_sorted_get_child_iter(
+    INF_GTK_BROWSER_MODEL_SORTED(model),
+    iter->user_data,
+    &child_iter
+  );
+
+  if(result == TRUE)
+  {
+    gtk_tree_model_get_value(
+      GTK_TREE_MODEL(priv->child_model),
+      &child_iter,
+      column,
+      value
+    );
+  }
+  else
+  {
+    g_value_init(
+      value,
+      gtk_tree_model_get_column_type(GTK_TREE_MODEL(priv->child_model), column)
+    );
+  }
+}
+
+static gboolean
+inf_gtk_browser_model_sorted_iter_next(GtkTreeModel* model,
+                                       GtkTreeIter* iter)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* node;
+  GSequenceIter* next;
+
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+  g_assert(iter->stamp == priv->stamp);
+
+  node = (InfGtkBrowserModelSortedNode*)iter->user_data;
+  next = g_sequence_iter_next(node->position);
+  if(g_sequence_iter_is_end(next))
+    return FALSE;
+
+  iter->user_data = g_sequence_get(next);
+  return TRUE;
+}
+
+static gboolean
+inf_gtk_browser_model_sorted_iter_children(GtkTreeModel* model,
+                                           GtkTreeIter* iter,
+                                           GtkTreeIter* parent)
+{
+  return gtk_tree_model_iter_nth_child(model, iter, parent, 0);
+}
+
+static gboolean
+inf_gtk_browser_model_sorted_iter_has_child(GtkTreeModel* model,
+                                            GtkTreeIter* iter)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* node;
+  InfBrowserIter browser_iter;
+
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+  g_assert(iter->stamp == priv->stamp);
+
+  node = (InfGtkBrowserModelSortedNode*)iter->user_data;
+  if(node->children != NULL)
+    return !g_sequence_iter_is_end(g_sequence_get_begin_iter(node->children));
+
+  /* Don't read the whole directory just to find out whether it is empty */
+  if(!inf_gtk_browser_model_sorted_node_get_iter(node, &browser_iter))
+    return FALSE;
+
+  return inf_gtk_browser_model_sorted_has_visible_child(
+    INF_GTK_BROWSER_MODEL_SORTED(model),
+    node->top->browser,
+    &browser_iter,
+    NULL
+  );
+}
+
+static gint
+inf_gtk_browser_model_sorted_iter_n_children(GtkTreeModel* model,
+                                             GtkTreeIter* iter)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* node;
+
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  if(iter == NULL)
+    return g_sequence_get_length(priv->toplevel);
+
+  g_assert(iter->stamp == priv->stamp);
+
+  node = (InfGtkBrowserModelSortedNode*)iter->user_data;
+  inf_gtk_browser_model_sorted_node_populate(node);
+  return g_sequence_get_length(node->children);
+}
+
+static gboolean
+inf_gtk_browser_model_sorted_iter_nth_child(GtkTreeModel* model,
+                                            GtkTreeIter* iter,
+                                            GtkTreeIter* parent,
+                                            gint n)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* node;
+  GSequence* level;
+
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  if(parent == NULL)
+  {
+    level = priv->toplevel;
+  }
+  else
+  {
+    g_assert(parent->stamp == priv->stamp);
+
+    node = (InfGtkBrowserModelSortedNode*)parent->user_data;
+    inf_gtk_browser_model_sorted_node_populate(node);
+    level = node->children;
+  }
+
+  if(n < 0 || n >= g_sequence_get_length(level))
+    return FALSE;
+
+  node = (InfGtkBrowserModelSortedNode*)g_sequence_get(
+    g_sequence_get_iter_at_pos(level, n)
+  );
+
+  inf_gtk_browser_model_sorted_init_iter(
+    INF_GTK_BROWSER_MODEL_SORTED(model),
+    iter,
+    node
+  );
+
+  return TRUE;
+}
+
+static gboolean
+inf_gtk_browser_model_sorted_iter_parent(GtkTreeModel* model,
+                                         GtkTreeIter* iter,
+                                         GtkTreeIter* child)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* node;
+
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+  g_assert(child->stamp == priv->stamp);
+
+  node = (InfGtkBrowserModelSortedNode*)child->user_data;
+  if(node->parent == NULL)
+    return FALSE;
+
+  inf_gtk_browser_model_sorted_init_iter(
+    INF_GTK_BROWSER_MODEL_SORTED(model),
+    iter,
+    node->parent
+  );
+
+  return TRUE;
+}
+
+/*
+ * InfGtkBrowserModel implementation
+ */
+
+static void
+inf_gtk_browser_model_sorted_resolve(InfGtkBrowserModel* model,
+                                     InfDiscovery* discovery,
+                                     InfDiscoveryInfo* info)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  inf_gtk_browser_model_resolve(priv->child_model, discovery, info);
+}
+
+static gboolean
+inf_gtk_browser_model_sorted_browser_iter_to_tree_iter(InfGtkBrowserModel* m,
+                                                       InfBrowser* browser,
+                                                       const InfBrowserIter*i,
+                                                       GtkTreeIter* tree_iter)
+{
+  InfGtkBrowserModelSortedNode* top;
+  InfGtkBrowserModelSortedNode* node;
+  InfBrowserIter parent;
+  GArray* ancestors;
+  guint n;
+
+  top = inf_gtk_browser_model_sorted_find_top(
+    INF_GTK_BROWSER_MODEL_SORTED(m),
+    browser
+  );
+
+  if(top == NULL)
+    return FALSE;
+
+  if(i == NULL || i->node_id == 0)
+  {
+    inf_gtk_browser_model_sorted_init_iter(
+      INF_GTK_BROWSER_MODEL_SORTED(m),
+      tree_iter,
+      top
+    );
+
+    return TRUE;
+  }
+
+  node = inf_gtk_browser_model_sorted_lookup(top, i);
+  if(node == NULL)
+  {
+    /* Read the directories containing the node, from the root down */
+    ancestors = g_array_new(FALSE, FALSE, sizeof(InfBrowserIter));
+
+    parent = *i;
+    while(inf_browser_get_parent(browser, &parent) && parent.node_id != 0)
+      g_array_append_val(ancestors, parent);
+
+    node = top;
+    for(n = ancestors->len; n > 0 && node != NULL; --n)
+    {
+      inf_gtk_browser_model_sorted_node_populate(node);
+
+      node = inf_gtk_browser_model_sorted_lookup(
+        top,
+        &g_array_index(ancestors, InfBrowserIter, n - 1)
+      );
+
+      if(node != NULL && node->position == NULL)
+        node = NULL;
+    }
+
+    g_array_free(ancestors, TRUE);
+
+    if(node == NULL)
+      return FALSE;
+
+    inf_gtk_browser_model_sorted_node_populate(node);
+    node = inf_gtk_browser_model_sorted_lookup(top, i);
+  }
+
+  /* Hidden, or not yet visible */
+  if(node == NULL || node->position == NULL)
+    return FALSE;
+
+  inf_gtk_browser_model_sorted_init_iter(
+    INF_GTK_BROWSER_MODEL_SORTED(m),
+    tree_iter,
+    node
+  );
+
+  return TRUE;
+}
+
+static gboolean
+inf_gtk_browser_model_sorted_tree_iter_to_browser_iter(InfGtkBrowserModel* m,
+                                                       GtkTreeIter* tree_iter,
+                                                       InfBrowser** browser,
+                                                       InfBrowserIter* iter)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* node;
+  InfBrowserIter browser_iter;
+
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(m);
+  g_assert(tree_iter->stamp == priv->stamp);
+
+  node = (InfGtkBrowserModelSortedNode*)tree_iter->user_data;
+  if(browser != NULL)
+    *browser = node->top->browser;
+
+  if(!inf_gtk_browser_model_sorted_node_get_iter(node, &browser_iter))
+    return FALSE;
+
+  if(iter != NULL)
+    *iter = browser_iter;
+
+  return TRUE;
+}
+
+/*
+ * GType registration
+ */
+
+static void
+inf_gtk_browser_model_sorted_class_init(
+  InfGtkBrowserModelSortedClass* browser_model_sorted_class)
+{
+  GObjectClass* object_class;
+  object_class = G_OBJECT_CLASS(browser_model_sorted_class);
+
+  object_class->constructed = inf_gtk_browser_model_sorted_constructed;
+  object_class->dispose = inf_gtk_browser_model_sorted_dispose;
+  object_class->finalize = inf_gtk_browser_model_sorted_finalize;
+  object_class->set_property = inf_gtk_browser_model_sorted_set_property;
+  object_class->get_property = inf_gtk_browser_model_sorted_get_property;
+
+  g_object_class_install_property(
+    object_class,
+    PROP_CHILD_MODEL,
+    g_param_spec_object(
+      "child-model",
+      "Child model",
+      "The model whose content is sorted and filtered",
+      INF_GTK_TYPE_BROWSER_MODEL,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+    )
+  );
+}
+
+static void
+inf_gtk_browser_model_sorted_tree_model_iface_init(GtkTreeModelIface* iface)
+{
+  iface->get_flags = inf_gtk_browser_model_sorted_get_flags;
+  iface->get_n_columns = inf_gtk_browser_model_sorted_get_n_columns;
+  iface->get_column_type = inf_gtk_browser_model_sorted_get_column_type;
+  iface->get_iter = inf_gtk_browser_model_sorted_get_iter;
+  iface->get_path = inf_gtk_browser_model_sorted_get_path;
+  iface->get_value = inf_gtk_browser_model_sorted_get_value;
+  iface->iter_next = inf_gtk_browser_model_sorted_iter_next;
+  iface->iter_children = inf_gtk_browser_model_sorted_iter_children;
+  iface->iter_has_child = inf_gtk_browser_model_sorted_iter_has_child;
+  iface->iter_n_children = inf_gtk_browser_model_sorted_iter_n_children;
+  iface->iter_nth_child = inf_gtk_browser_model_sorted_iter_nth_child;
+  iface->iter_parent = inf_gtk_browser_model_sorted_iter_parent;
+}
+
+static void
+inf_gtk_browser_model_sorted_browser_model_iface_init(
+  InfGtkBrowserModelInterface* iface)
+{
+  iface->set_browser = NULL;
+  iface->resolve = inf_gtk_browser_model_sorted_resolve;
+  iface->browser_iter_to_tree_iter =
+    inf_gtk_browser_model_sorted_browser_iter_to_tree_iter;
+  iface->tree_iter_to_browser_iter =
+    inf_gtk_browser_model_sorted_tree_iter_to_browser_iter;
+}
+
+/*
+ * Public API.
+ */
+
+/**
+ * inf_gtk_browser_model_sorted_new: (constructor)
+ * @child_model: A #InfGtkBrowserModel.
+ *
+ * Creates a new #InfGtkBrowserModelSorted, showing the content of
+ * @child_model sorted by name.
+ *
+ * Returns: (transfer full): A new #InfGtkBrowserModelSorted.
+ **/
+InfGtkBrowserModelSorted*
+inf_gtk_browser_model_sorted_new(InfGtkBrowserModel* child_model)
+{
+  GObject* object;
+
+  g_return_val_if_fail(INF_GTK_IS_BROWSER_MODEL(child_model), NULL);
+
+  object = g_object_new(
+    INF_GTK_TYPE_BROWSER_MODEL_SORTED,
+    "child-model", child_model,
+    NULL
+  );
+
+  return INF_GTK_BROWSER_MODEL_SORTED(object);
+}
+
+/**
+ * inf_gtk_browser_model_sorted_get_child_model:
+ * @model: A #InfGtkBrowserModelSorted.
+ *
+ * Returns the model whose content @model shows.
+ *
+ * Returns: (transfer none): The child model of @model.
+ **/
+InfGtkBrowserModel*
+inf_gtk_browser_model_sorted_get_child_model(InfGtkBrowserModelSorted* model)
+{
+  g_return_val_if_fail(INF_GTK_IS_BROWSER_MODEL_SORTED(model), NULL);
+  return INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model)->child_model;
+}
+
+/**
+ * inf_gtk_browser_model_sorted_set_visible_func:
+ * @model: A #InfGtkBrowserModelSorted.
+ * @func: (scope notified) (allow-none): A function deciding which nodes
+ * are shown, or %NULL to show all nodes.
+ * @user_data: Additional data to pass to @func.
+ * @notify: A #GDestroyNotify to free @user_data, or %NULL.
+ *
+ * Sets a function which decides which nodes of the browsers in the child
+ * model are shown in @model. Toplevel rows are always shown. Since all
+ * directories need to be read again, the content of all toplevel rows is
+ * removed from the model when calling this function.
+ **/
+void
+inf_gtk_browser_model_sorted_set_visible_func(InfGtkBrowserModelSorted* model,
+                                              InfGtkBrowserModelSortedVisibleFunc func,
+                                              gpointer user_data,
+                                              GDestroyNotify notify)
+{
+  InfGtkBrowserModelSortedPrivate* priv;
+  InfGtkBrowserModelSortedNode* top;
+  GSequenceIter* iter;
+
+  g_return_if_fail(INF_GTK_IS_BROWSER_MODEL_SORTED(model));
+  priv = INF_GTK_BROWSER_MODEL_SORTED_PRIVATE(model);
+
+  if(priv->visible_notify != NULL)
+    priv->visible_notify(priv->visible_user_data);
+
+  priv->visible_func = func;
+  priv->visible_user_data = user_data;
+  priv->visible_notify = notify;
+
+  for(iter = g_sequence_get_begin_iter(priv->toplevel);
+      !g_sequence_iter_is_end(iter);
+      iter = g_sequence_iter_next(iter))
+  {
+    top = (InfGtkBrowserModelSortedNode*)g_sequence_get(iter);
+    if(top->children != NULL)
+    {
+      inf_gtk_browser_model_sorted_node_clear(top);
+      inf_gtk_browser_model_sorted_node_release(top);
+      inf_gtk_browser_model_sorted_emit_toggled(top);
+    }
+  }
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,84 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_GTK_BROWSER_MODEL_SORTED_H__
+#define __INF_GTK_BROWSER_MODEL_SORTED_H__
+
+#include <libinfgtk/inf-gtk-browser-model.h>
+
+#include <gtk/gtk.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define INF_GTK_TYPE_BROWSER_MODEL_SORTED                 (inf_gtk_browser_model_sorted_get_type())
+#define INF_GTK_BROWSER_MODEL_SORTED(obj)                 (G_TYPE_CHECK_INSTANCE_CAST((obj), INF_GTK_TYPE_BROWSER_MODEL_SORTED, InfGtkBrowserModelSorted))
+#define INF_GTK_BROWSER_MODEL_SORTED_CLASS(klass)         (G_TYPE_CHECK_CLASS_CAST((klass), INF_GTK_TYPE_BROWSER_MODEL_SORTED, InfGtkBrowserModelSortedClass))
+#define INF_GTK_IS_BROWSER_MODEL_SORTED(obj)              (G_TYPE_CHECK_INSTANCE_TYPE((obj), INF_GTK_TYPE_BROWSER_MODEL_SORTED))
+#define INF_GTK_IS_BROWSER_MODEL_SORTED_CLASS(klass)      (G_TYPE_CHECK_CLASS_TYPE((klass), INF_GTK_TYPE_BROWSER_MODEL_SORTED))
+#define INF_GTK_BROWSER_MODEL_SORTED_GET_CLASS(obj)       (G_TYPE_INSTANCE_GET_CLASS((obj), INF_GTK_TYPE_BROWSER_MODEL_SORTED, InfGtkBrowserModelSortedClass))
+
+typedef struct _InfGtkBrowserModelSorted InfGtkBrowserModelSorted;
+typedef struct _InfGtkBrowserModelSortedClass InfGtkBrowserModelSortedClass;
+
+/**
+ * InfGtkBrowserModelSortedVisibleFunc:
+ * @browser: The #InfBrowser the node belongs to.
+ * @iter: An #InfBrowserIter pointing to a node in @browser.
+ * @user_data: User data passed to
+ * inf_gtk_browser_model_sorted_set_visible_func().
+ *
+ * This function is called to determine whether the node @iter points to is
+ * shown in a #InfGtkBrowserModelSorted. The result must only depend on
+ * properties of the node that do not change, such as its name and type.
+ *
+ * Returns: %TRUE if the node is visible, or %FALSE otherwise.
+ */
+typedef gboolean(*InfGtkBrowserModelSortedVisibleFunc)(InfBrowser* browser,
+                                                       const InfBrowserIter* iter,
+                                                       gpointer user_data);
+
+struct _InfGtkBrowserModelSortedClass {
+  GObjectClass parent_class;
+};
+
+struct _InfGtkBrowserModelSorted {
+  GObject parent;
+};
+
+GType
+inf_gtk_browser_model_sorted_get_type(void) G_GNUC_CONST;
+
+InfGtkBrowserModelSorted*
+inf_gtk_browser_model_sorted_new(InfGtkBrowserModel* child_model);
+
+InfGtkBrowserModel*
+inf_gtk_browser_model_sorted_get_child_model(InfGtkBrowserModelSorted* model);
+
+void
+inf_gtk_browser_model_sorted_set_visible_func(InfGtkBrowserModelSorted* model,
+                                              InfGtkBrowserModelSortedVisibleFunc func,
+                                              gpointer user_data,
+                                              GDestroyNotify notify);
+
+G_END_DECLS
+
+#endif /* __INF_GTK_BROWSER_MODEL_SORTED_H__ */
+
+/* vim:set et sw=2 ts=2: */
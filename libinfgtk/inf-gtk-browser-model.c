@@ -215,4 +215,64 @@ inf_gtk_browser_model_browser_iter_to_tree_iter(InfGtkBrowserModel* model,
   return iface->browser_iter_to_tree_iter(model, browser, iter, tree_iter);
 }
 
+/**
+ * inf_gtk_browser_model_tree_iter_to_browser_iter:
+ * @model: A #InfGtkBrowserModel.
+ * @tree_iter: A #GtkTreeIter pointing to a row of @model.
+ * @browser: (out) (transfer none) (allow-none): Location to store the
+ * #InfBrowser of the row, or %NULL.
+ * @iter: (out) (allow-none): Location to store the node of the row, or
+ * %NULL.
+ *
+ * Retrieves the browser and the browser node a row of @model refers to.
+ * This is equivalent to reading the %INF_GTK_BROWSER_MODEL_COL_BROWSER and
+ * %INF_GTK_BROWSER_MODEL_COL_NODE columns with gtk_tree_model_get(), but
+ * does not take a reference on the browser or copy the node, so it is
+ * cheap enough to be used in cell data functions.
+ *
+ * @browser is set to %NULL if no browser is available for the row. @iter
+ * is only set if the browser is opened, since otherwise the row does not
+ * correspond to a node. For top-level rows, @iter is set to the root node.
+ *
+ * Returns: Whether @iter was set.
+ **/
+gboolean
+inf_gtk_browser_model_tree_iter_to_browser_iter(InfGtkBrowserModel* model,
+                                                GtkTreeIter* tree_iter,
+                                                InfBrowser** browser,
+                                                InfBrowserIter* iter)
+{
+  InfGtkBrowserModelInterface* iface;
+  InfBrowser* row_browser;
+  InfBrowserIter* row_iter;
+
+  g_return_val_if_fail(INF_GTK_IS_BROWSER_MODEL(model), FALSE);
+  g_return_val_if_fail(tree_iter != NULL, FALSE);
+
+  iface = INF_GTK_BROWSER_MODEL_GET_IFACE(model);
+  if(iface->tree_iter_to_browser_iter != NULL)
+    return iface->tree_iter_to_browser_iter(model, tree_iter, browser, iter);
+
+  /* Models which do not implement the function are read via the columns.
+   * The model keeps a reference on the browser of the row, so it is safe
+   * to drop ours. */
+  gtk_tree_model_get(
+    GTK_TREE_MODEL(model),
+    tree_iter,
+    INF_GTK_BROWSER_MODEL_COL_BROWSER, &row_browser,
+    INF_GTK_BROWSER_MODEL_COL_NODE, &row_iter,
+    -1
+  );
+
+  if(browser != NULL) *browser = row_browser;
+  if(row_browser != NULL) g_object_unref(row_browser);
+
+  if(row_iter == NULL)
+    return FALSE;
+
+  if(iter != NULL) *iter = *row_iter;
+  inf_browser_iter_free(row_iter);
+  return TRUE;
+}
+
 /* vim:set et sw=2 ts=2: */
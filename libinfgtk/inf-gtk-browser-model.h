@@ -118,6 +118,9 @@ typedef enum _InfGtkBrowserModelColumn {
  * @resolve: Virtual function for resolving a discovered infinote service.
  * @browser_iter_to_tree_iter: Virtual function for converting a
  * #InfBrowserIter to a #GtkTreeIter.
+ * @tree_iter_to_browser_iter: Virtual function for converting a
+ * #GtkTreeIter to a #InfBrowser and #InfBrowserIter. If it is %NULL, the
+ * browser and node columns are read instead.
  *
  * This structure contains virtual functions and signal handlers of the
  * #InfGtkBrowserModel interface.
@@ -144,6 +147,11 @@ struct _InfGtkBrowserModelInterface {
                                        InfBrowser* browser,
                                        const InfBrowserIter* iter,
                                        GtkTreeIter* tree_iter);
+
+  gboolean(*tree_iter_to_browser_iter)(InfGtkBrowserModel* model,
+                                       GtkTreeIter* tree_iter,
+                                       InfBrowser** browser,
+                                       InfBrowserIter* iter);
 };
 
 GType
@@ -170,6 +178,12 @@ inf_gtk_browser_model_browser_iter_to_tree_iter(InfGtkBrowserModel* model,
                                                 const InfBrowserIter* iter,
                                                 GtkTreeIter* tree_iter);
 
+gboolean
+inf_gtk_browser_model_tree_iter_to_browser_iter(InfGtkBrowserModel* model,
+                                                GtkTreeIter* tree_iter,
+                                                InfBrowser** browser,
+                                                InfBrowserIter* iter);
+
 G_END_DECLS
 
 #endif /* __INF_GTK_BROWSER_MODEL_H__ */
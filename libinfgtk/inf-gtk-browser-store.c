@@ -34,6 +34,13 @@
  * points to the toplevel node. Note that it does not hold the root node of
  * the item's browser (if present) because the iter should remain valid when
  * the browser is removed (we set GTK_TREE_MODEL_ITERS_PERSIST).
+ *
+ * Rows are not stored in the model but are read from the InfBrowser on
+ * demand. To avoid walking all siblings when a row is looked up by index,
+ * or when the index of a row is queried, each item keeps an index of the
+ * children of the directories that have been accessed this way. It is
+ * built lazily, the first time it is needed, and is kept up to date when
+ * nodes are added or removed.
  */
 
 typedef struct _InfGtkBrowserStoreItem InfGtkBrowserStoreItem;
@@ -50,8 +57,10 @@ struct _InfGtkBrowserStoreItem {
    * wasn't present anymore. */
   gpointer missing;
 
-  /* Running requests */
-  GSList* requests;
+  /* Running requests, as a set */
+  GHashTable* requests;
+  /* node ID -> InfGtkBrowserStoreDirectory */
+  GHashTable* directories;
   /* Saved node errors (during exploration/subscription) */
   GHashTable* node_errors;
 
@@ -65,6 +74,17 @@ struct _InfGtkBrowserStoreItem {
   InfGtkBrowserStoreItem* next;
 };
 
+typedef struct _InfGtkBrowserStoreDirectory InfGtkBrowserStoreDirectory;
+struct _InfGtkBrowserStoreDirectory {
+  /* Children of the directory in browser order, excluding the missing
+   * node of the item. */
+  GArray* children;
+  /* node ID -> index + 1. Only the first n_indexed children are indexed,
+   * the rest is indexed on demand. */
+  GHashTable* positions;
+  guint n_indexed;
+};
+
 typedef struct _InfGtkBrowserStoreRequestData InfGtkBrowserStoreRequestData;
 struct _InfGtkBrowserStoreRequestData {
   InfGtkBrowserStore* store;
@@ -160,6 +180,225 @@ inf_gtk_browser_store_find_item_by_discovery_info(InfGtkBrowserStore* store,
   return NULL;
 }
 
+static void
+inf_gtk_browser_store_directory_free(gpointer data)
+{
+  InfGtkBrowserStoreDirectory* directory;
+  directory = (InfGtkBrowserStoreDirectory*)data;
+
+  g_array_free(directory->children, TRUE);
+  g_hash_table_destroy(directory->positions);
+  g_slice_free(InfGtkBrowserStoreDirectory, directory);
+}
+
+/* Returns the index of the given explored directory node, building it if
+ * it does not exist yet. */
+static InfGtkBrowserStoreDirectory*
+inf_gtk_browser_store_item_get_directory(InfGtkBrowserStoreItem* item,
+                                         const InfBrowserIter* iter)
+{
+  InfGtkBrowserStoreDirectory* directory;
+  InfBrowserIter child;
+  gboolean result;
+
+  directory = g_hash_table_lookup(
+    item->directories,
+    GUINT_TO_POINTER(iter->node_id)
+  );
+
+  if(directory == NULL)
+  {
+    directory = g_slice_new(InfGtkBrowserStoreDirectory);
+    directory->children =
+      g_array_new(FALSE, FALSE, sizeof(InfBrowserIter));
+    directory->positions = g_hash_table_new(NULL, NULL);
+    directory->n_indexed = 0;
+
+    child = *iter;
+    for(result = inf_browser_get_child(item->browser, &child);
+        result == TRUE;
+        result = inf_browser_get_next(item->browser, &child))
+    {
+      if(child.node != item->missing)
+        g_array_append_val(directory->children, child);
+    }
+
+    g_hash_table_insert(
+      item->directories,
+      GUINT_TO_POINTER(iter->node_id),
+      directory
+    );
+  }
+
+  return directory;
+}
+
+static gboolean
+inf_gtk_browser_store_directory_find(InfGtkBrowserStoreDirectory* directory,
+                                     guint node_id,
+                                     guint* index)
+{
+  InfBrowserIter* child;
+  guint position;
+
+  /* Entries beyond n_indexed might be outdated, so verify the result */
+  position = GPOINTER_TO_UINT(
+    g_hash_table_lookup(directory->positions, GUINT_TO_POINTER(node_id))
+  );
+
+  if(position > 0 && position <= directory->children->len)
+  {
+    child = &g_array_index(directory->children, InfBrowserIter, position - 1);
+    if(child->node_id == node_id)
+    {
+      if(index != NULL) *index = position - 1;
+      return TRUE;
+    }
+  }
+
+  while(directory->n_indexed < directory->children->len)
+  {
+    child = &g_array_index(
+      directory->children,
+      InfBrowserIter,
+      directory->n_indexed
+    );
+
+    ++directory->n_indexed;
+
+    g_hash_table_insert(
+      directory->positions,
+      GUINT_TO_POINTER(child->node_id),
+      GUINT_TO_POINTER(directory->n_indexed)
+    );
+
+    if(child->node_id == node_id)
+    {
+      if(index != NULL) *index = directory->n_indexed - 1;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Removes the indices of the given node and all of its explored
+ * subdirectories. */
+static void
+inf_gtk_browser_store_item_drop_directories(InfGtkBrowserStoreItem* item,
+                                            const InfBrowserIter* iter)
+{
+  InfBrowserIter child;
+  gboolean result;
+
+  if(g_hash_table_size(item->directories) == 0)
+    return;
+
+  g_hash_table_remove(item->directories, GUINT_TO_POINTER(iter->node_id));
+
+  if(inf_browser_is_subdirectory(item->browser, iter) &&
+     inf_browser_get_explored(item->browser, iter))
+  {
+    child = *iter;
+    for(result = inf_browser_get_child(item->browser, &child);
+        result == TRUE;
+        result = inf_browser_get_next(item->browser, &child))
+    {
+      inf_gtk_browser_store_item_drop_directories(item, &child);
+    }
+  }
+}
+
+/* Called after iter has been added to the browser */
+static void
+inf_gtk_browser_store_item_node_added(InfGtkBrowserStoreItem* item,
+                                      const InfBrowserIter* parent,
+                                      const InfBrowserIter* iter)
+{
+  InfGtkBrowserStoreDirectory* directory;
+  InfBrowserIter next;
+  gboolean result;
+  guint position;
+
+  directory = g_hash_table_lookup(
+    item->directories,
+    GUINT_TO_POINTER(parent->node_id)
+  );
+
+  if(directory == NULL)
+    return;
+
+  /* The index might have been built by someone querying the model before
+   * we got notified, in which case it contains the new node already. */
+  if(inf_gtk_browser_store_directory_find(directory, iter->node_id, NULL))
+    return;
+
+  next = *iter;
+  if(inf_browser_get_next(item->browser, &next))
+  {
+    result = inf_gtk_browser_store_directory_find(
+      directory,
+      next.node_id,
+      &position
+    );
+
+    g_assert(result == TRUE);
+
+    /* Browsers typically prepend new nodes. Shifting the whole index for
+     * each of them would make adding many nodes quadratic, so rather drop
+     * the index in that case and rebuild it when it is needed again. */
+    if(position == 0)
+    {
+      g_hash_table_remove(
+        item->directories,
+        GUINT_TO_POINTER(parent->node_id)
+      );
+    }
+    else
+    {
+      g_array_insert_val(directory->children, position, *iter);
+      directory->n_indexed = MIN(directory->n_indexed, position);
+    }
+  }
+  else
+  {
+    g_array_append_val(directory->children, *iter);
+  }
+}
+
+/* Called before iter is removed from the browser */
+static void
+inf_gtk_browser_store_item_node_removed(InfGtkBrowserStoreItem* item,
+                                        const InfBrowserIter* parent,
+                                        const InfBrowserIter* iter)
+{
+  InfGtkBrowserStoreDirectory* directory;
+  gboolean result;
+  guint position;
+
+  inf_gtk_browser_store_item_drop_directories(item, iter);
+
+  directory = g_hash_table_lookup(
+    item->directories,
+    GUINT_TO_POINTER(parent->node_id)
+  );
+
+  if(directory != NULL)
+  {
+    result = inf_gtk_browser_store_directory_find(
+      directory,
+      iter->node_id,
+      &position
+    );
+
+    g_assert(result == TRUE);
+
+    g_array_remove_index(directory->children, position);
+    g_hash_table_remove(directory->positions, GUINT_TO_POINTER(iter->node_id));
+    directory->n_indexed = MIN(directory->n_indexed, position);
+  }
+}
+
 /*
  * Callback declarations
  */
@@ -235,7 +474,7 @@ inf_gtk_browser_store_item_request_remove(InfGtkBrowserStoreItem* item,
     item
   );
 
-  item->requests = g_slist_remove(item->requests, request);
+  g_hash_table_remove(item->requests, request);
 }
 
 static void
@@ -245,8 +484,8 @@ inf_gtk_browser_store_item_request_add(InfGtkBrowserStore* store,
 {
   InfGtkBrowserStoreRequestData* data;
 
-  g_assert(g_slist_find(item->requests, request) == NULL);
-  item->requests = g_slist_prepend(item->requests, request);
+  g_assert(!g_hash_table_contains(item->requests, request));
+  g_hash_table_add(item->requests, request);
 
   data = g_slice_new(InfGtkBrowserStoreRequestData);
   data->store = store;
@@ -284,7 +523,7 @@ inf_gtk_browser_store_request_finished_cb(InfRequest* request,
   data = (InfGtkBrowserStoreRequestData*)user_data;
   priv = INF_GTK_BROWSER_STORE_PRIVATE(data->store);
 
-  g_assert(g_slist_find(data->item->requests, request) != NULL);
+  g_assert(g_hash_table_contains(data->item->requests, request));
   g_assert(data->item->browser != NULL);
 
   /* request can be a explore-node or subscribe-session request */
@@ -337,7 +576,7 @@ inf_gtk_browser_store_request_unrefed_func(gpointer data,
   item = (InfGtkBrowserStoreItem*)data;
 
   /* No need to further unregister */
-  item->requests = g_slist_remove(item->requests, where_the_object_was);
+  g_hash_table_remove(item->requests, where_the_object_was);
 }
 
 static void
@@ -403,7 +642,13 @@ inf_gtk_browser_store_add_item_by_browser(InfGtkBrowserStore* store,
     NULL,
     (GDestroyNotify)g_error_free
   );
-  item->requests = NULL;
+  item->requests = g_hash_table_new(NULL, NULL);
+  item->directories = g_hash_table_new_full(
+    NULL,
+    NULL,
+    NULL,
+    inf_gtk_browser_store_directory_free
+  );
   item->error = NULL;
   item->next = NULL;
   
@@ -552,6 +797,8 @@ inf_gtk_browser_store_remove_item(InfGtkBrowserStore* store,
   if(item->error != NULL)
     g_error_free(item->error);
 
+  g_hash_table_unref(item->directories);
+  g_hash_table_unref(item->requests);
   g_hash_table_unref(item->node_errors);
   g_free(item->name);
   g_slice_free(InfGtkBrowserStoreItem, item);
@@ -673,6 +920,7 @@ inf_gtk_browser_store_browser_notify_status_cb(GObject* object,
   case INF_BROWSER_CLOSED:
     /* TODO: Do we want to go to disconnected state when error is not set? */
     item->status = INF_GTK_BROWSER_MODEL_ERROR;
+    g_hash_table_remove_all(item->directories);
 
     /* Set a "Disconnected" error if there is not already one set by
      * inf_gtk_browser_store_connection_error_cb() that has a more
@@ -734,14 +982,17 @@ inf_gtk_browser_store_node_added_cb(InfBrowser* browser,
 
   if(iter->node_id != 0)
   {
+    test_iter = *iter;
+    test_result = inf_browser_get_parent(browser, &test_iter);
+    g_assert(test_result == TRUE);
+
+    inf_gtk_browser_store_item_node_added(item, &test_iter, iter);
+
     path = gtk_tree_model_get_path(GTK_TREE_MODEL(store), &tree_iter);
     gtk_tree_model_row_inserted(GTK_TREE_MODEL(store), path, &tree_iter);
 
     /* If iter is the only node within its parent, we need to emit the
      * row-has-child-toggled signal. */
-    test_iter = *iter;
-    test_result = inf_browser_get_parent(browser, &test_iter);
-    g_assert(test_result == TRUE);
 
     /* Let tree_iter point to parent row for possible notification */
     tree_iter.user_data2 = GUINT_TO_POINTER(test_iter.node_id);
@@ -797,6 +1048,19 @@ inf_gtk_browser_store_node_removed_cb(InfBrowser* browser,
 
   path = gtk_tree_model_get_path(GTK_TREE_MODEL(store), &tree_iter);
 
+  if(iter->node_id != 0)
+  {
+    test_iter = *iter;
+    test_result = inf_browser_get_parent(browser, &test_iter);
+    g_assert(test_result == TRUE);
+
+    inf_gtk_browser_store_item_node_removed(item, &test_iter, iter);
+  }
+  else
+  {
+    g_hash_table_remove_all(item->directories);
+  }
+
   /* This is a small hack to have the item removed from the tree
    * model before it is removed from the InfcBrowser. */
 
@@ -811,9 +1075,6 @@ inf_gtk_browser_store_node_removed_cb(InfBrowser* browser,
     /* Note that at this point removed node is still in the browser. We have
      * to emit row-has-child-toggled if it is the only one in its
      * subdirectory. */
-    test_iter = *iter;
-    test_result = inf_browser_get_parent(browser, &test_iter);
-    g_assert(test_result == TRUE);
 
     /* Let tree_iter point to parent row for possible notification */
     tree_iter.user_data2 = GUINT_TO_POINTER(test_iter.node_id);
@@ -1241,6 +1502,7 @@ inf_gtk_browser_store_tree_model_get_iter(GtkTreeModel* model,
 {
   InfGtkBrowserStorePrivate* priv;
   InfGtkBrowserStoreItem* item;
+  InfGtkBrowserStoreDirectory* directory;
   InfBrowserIter browser_iter;
   gint* indices;
 
@@ -1277,22 +1539,12 @@ inf_gtk_browser_store_tree_model_get_iter(GtkTreeModel* model,
     if(inf_browser_get_explored(item->browser, &browser_iter) == FALSE)
       return FALSE;
 
-    if(inf_browser_get_child(item->browser, &browser_iter) == FALSE)
+    directory = inf_gtk_browser_store_item_get_directory(item, &browser_iter);
+    if((guint)indices[n] >= directory->children->len)
       return FALSE;
 
-    /* skip missing */
-    if(browser_iter.node == item->missing)
-      ++indices[n];
-
-    for(i = 0; i < (guint)indices[n]; ++ i)
-    {
-      if(inf_browser_get_next(item->browser, &browser_iter) == FALSE)
-        return FALSE;
-
-      /* skip missing */
-      if(browser_iter.node == item->missing)
-        ++indices[n];
-    }
+    browser_iter =
+      g_array_index(directory->children, InfBrowserIter, indices[n]);
   }
 
   iter->stamp = priv->stamp;
@@ -1311,7 +1563,9 @@ inf_gtk_browser_store_tree_model_get_path_impl(InfGtkBrowserStore* store,
                                                GtkTreePath* path)
 {
   InfGtkBrowserStorePrivate* priv;
+  InfGtkBrowserStoreDirectory* directory;
   InfBrowserIter cur_iter;
+  InfBrowserIter parent_iter;
   InfGtkBrowserStoreItem* cur;
   gboolean result;
   guint n;
@@ -1337,6 +1591,7 @@ inf_gtk_browser_store_tree_model_get_path_impl(InfGtkBrowserStore* store,
       path
     );
 
+    parent_iter = cur_iter;
     result = inf_browser_get_child(item->browser, &cur_iter);
     g_assert(result == TRUE);
 
@@ -1347,20 +1602,40 @@ inf_gtk_browser_store_tree_model_get_path_impl(InfGtkBrowserStore* store,
       g_assert(result == TRUE);
     }
 
-    n = 0;
-    while(cur_iter.node_id != iter->node_id)
+    /* New nodes are usually added at the front, so this is the common
+     * case when rows are inserted, and does not need the index. */
+    if(cur_iter.node_id == iter->node_id)
     {
-      result = inf_browser_get_next(item->browser, &cur_iter);
-      g_assert(result == TRUE);
+      n = 0;
+    }
+    else
+    {
+      directory = inf_gtk_browser_store_item_get_directory(item, &parent_iter);
+      result = inf_gtk_browser_store_directory_find(
+        directory,
+        iter->node_id,
+        &n
+      );
 
-      /* skip missing */
-      if(cur_iter.node == item->missing)
+      /* Can happen when the path of a new node is queried before we have
+       * been notified about it, in which case the index is outdated. */
+      if(result == FALSE)
       {
-        result = inf_browser_get_next(item->browser, &cur_iter);
+        g_hash_table_remove(
+          item->directories,
+          GUINT_TO_POINTER(parent_iter.node_id)
+        );
+
+        directory =
+          inf_gtk_browser_store_item_get_directory(item, &parent_iter);
+        result = inf_gtk_browser_store_directory_find(
+          directory,
+          iter->node_id,
+          &n
+        );
+
         g_assert(result == TRUE);
       }
-
-      ++n;
     }
 
     gtk_tree_path_append_index(path, n);
@@ -1719,8 +1994,8 @@ inf_gtk_browser_store_tree_model_iter_n_children(GtkTreeModel* model,
   InfGtkBrowserStorePrivate* priv;
   InfGtkBrowserStoreItem* item;
   InfGtkBrowserStoreItem* cur;
+  InfGtkBrowserStoreDirectory* directory;
   InfBrowserIter browser_iter;
-  gboolean result;
   guint n;
 
   priv = INF_GTK_BROWSER_STORE_PRIVATE(model);
@@ -1754,16 +2029,14 @@ inf_gtk_browser_store_tree_model_iter_n_children(GtkTreeModel* model,
     if(item->missing != NULL && browser_iter.node == item->missing)
       return 0;
 
-    n = 0;
-    for(result = inf_browser_get_child(item->browser, &browser_iter);
-        result == TRUE;
-        result = inf_browser_get_next(item->browser, &browser_iter))
+    if(!inf_browser_is_subdirectory(item->browser, &browser_iter) ||
+       !inf_browser_get_explored(item->browser, &browser_iter))
     {
-      if(browser_iter.node != item->missing)
-        ++n;
+      return 0;
     }
 
-    return n;
+    directory = inf_gtk_browser_store_item_get_directory(item, &browser_iter);
+    return directory->children->len;
   }
 }
 
@@ -1776,6 +2049,7 @@ inf_gtk_browser_store_tree_model_iter_nth_child(GtkTreeModel* model,
   InfGtkBrowserStorePrivate* priv;
   InfGtkBrowserStoreItem* item;
   InfGtkBrowserStoreItem* cur;
+  InfGtkBrowserStoreDirectory* directory;
   InfBrowserIter browser_iter;
   guint i;
 
@@ -1824,21 +2098,11 @@ inf_gtk_browser_store_tree_model_iter_nth_child(GtkTreeModel* model,
     if(inf_browser_get_explored(item->browser, &browser_iter) == FALSE)
       return FALSE;
 
-    if(inf_browser_get_child(item->browser, &browser_iter) == FALSE)
+    directory = inf_gtk_browser_store_item_get_directory(item, &browser_iter);
+    if((guint)n >= directory->children->len)
       return FALSE;
 
-    /* skip missing */
-    if(browser_iter.node == item->missing)
-      ++n;
-
-    for(i = 0; i < (guint)n; ++ i)
-    {
-      if(inf_browser_get_next(item->browser, &browser_iter) == FALSE)
-        return FALSE;
-
-      if(browser_iter.node == item->missing)
-        ++n;
-    }
+    browser_iter = g_array_index(directory->children, InfBrowserIter, n);
 
     iter->stamp = priv->stamp;
     iter->user_data = item;
@@ -1901,6 +2165,8 @@ inf_gtk_browser_store_browser_model_set_browser(InfGtkBrowserModel* model,
   InfGtkBrowserStoreItem* item;
 
   InfBrowserIter iter;
+  GHashTableIter request_iter;
+  gpointer request;
   guint n;
   gboolean had_children;
   InfBrowserStatus status;
@@ -1942,10 +2208,15 @@ inf_gtk_browser_store_browser_model_set_browser(InfGtkBrowserModel* model,
       }
     }
 
-    while(item->requests != NULL)
-      inf_gtk_browser_store_item_request_remove(item, item->requests->data);
+    g_hash_table_iter_init(&request_iter, item->requests);
+    while(g_hash_table_iter_next(&request_iter, &request, NULL))
+    {
+      g_hash_table_iter_steal(&request_iter);
+      inf_gtk_browser_store_item_request_remove(item, INF_REQUEST(request));
+    }
 
     g_hash_table_remove_all(item->node_errors);
+    g_hash_table_remove_all(item->directories);
 
     inf_signal_handlers_disconnect_by_func(
       G_OBJECT(item->browser),
@@ -2212,6 +2483,48 @@ inf_gtk_browser_store_browser_iter_to_tree_iter(InfGtkBrowserModel* model,
   return TRUE;
 }
 
+static gboolean
+inf_gtk_browser_store_tree_iter_to_browser_iter(InfGtkBrowserModel* model,
+                                                GtkTreeIter* tree_iter,
+                                                InfBrowser** browser,
+                                                InfBrowserIter* iter)
+{
+  InfGtkBrowserStorePrivate* priv;
+  InfGtkBrowserStoreItem* item;
+  InfBrowserStatus status;
+
+  g_assert(INF_GTK_IS_BROWSER_STORE(model));
+
+  priv = INF_GTK_BROWSER_STORE_PRIVATE(model);
+  g_assert(tree_iter->stamp == priv->stamp);
+
+  item = (InfGtkBrowserStoreItem*)tree_iter->user_data;
+  if(browser != NULL)
+    *browser = item->browser;
+
+  if(item->browser == NULL)
+    return FALSE;
+
+  g_object_get(G_OBJECT(item->browser), "status", &status, NULL);
+  if(status != INF_BROWSER_OPEN)
+    return FALSE;
+
+  if(iter != NULL)
+  {
+    if(tree_iter->user_data3 == NULL)
+    {
+      inf_browser_get_root(item->browser, iter);
+    }
+    else
+    {
+      iter->node_id = GPOINTER_TO_UINT(tree_iter->user_data2);
+      iter->node = tree_iter->user_data3;
+    }
+  }
+
+  return TRUE;
+}
+
 /*
  * GType registration
  */
@@ -2278,6 +2591,8 @@ inf_gtk_browser_store_browser_model_iface_init(
    * consistent, but a _bit_ too long to fit properly into 80 chars ;) */
   iface->browser_iter_to_tree_iter =
     inf_gtk_browser_store_browser_iter_to_tree_iter;
+  iface->tree_iter_to_browser_iter =
+    inf_gtk_browser_store_tree_iter_to_browser_iter;
 }
 
 /*
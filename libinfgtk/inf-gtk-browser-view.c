@@ -1977,7 +1977,7 @@ inf_gtk_browser_view_icon_data_func(GtkTreeViewColumn* column,
   InfGtkBrowserModelStatus status;
   InfDiscovery* discovery;
   InfBrowser* browser;
-  InfBrowserIter* browser_iter;
+  InfBrowserIter browser_iter;
   InfAclMask mask;
   const InfAclAccount* account;
   InfAclAccountId acc_id;
@@ -1986,13 +1986,17 @@ inf_gtk_browser_view_icon_data_func(GtkTreeViewColumn* column,
   if(gtk_tree_model_iter_parent(model, &iter_parent, iter))
   {
     /* Inner node */
-    gtk_tree_model_get(
-      model,
-      iter,
-      INF_GTK_BROWSER_MODEL_COL_BROWSER, &browser,
-      INF_GTK_BROWSER_MODEL_COL_NODE, &browser_iter,
-      -1
-    );
+    if(!inf_gtk_browser_model_tree_iter_to_browser_iter(
+         INF_GTK_BROWSER_MODEL(model),
+         iter,
+         &browser,
+         &browser_iter))
+    {
+      /* The row does not refer to a node (anymore), so there is nothing
+       * to show. */
+      g_object_set(G_OBJECT(renderer), "icon-name", NULL, NULL);
+      return;
+    }
 
     /* TODO: Set error icon if an error occured? */
 
@@ -2002,10 +2006,10 @@ inf_gtk_browser_view_icon_data_func(GtkTreeViewColumn* column,
     acc_id = 0;
     if(account != NULL) acc_id = account->id;
 
-    if(inf_browser_is_subdirectory(browser, browser_iter))
+    if(inf_browser_is_subdirectory(browser, &browser_iter))
     {
       inf_acl_mask_set1(&mask, INF_ACL_CAN_EXPLORE_NODE);
-      if(inf_browser_check_acl(browser, browser_iter, acc_id, &mask, NULL))
+      if(inf_browser_check_acl(browser, &browser_iter, acc_id, &mask, NULL))
         icon_name = "folder";
       else
         /* Would be nice to have a more appropriate icon for this */
@@ -2015,16 +2019,13 @@ inf_gtk_browser_view_icon_data_func(GtkTreeViewColumn* column,
     else
     {
       inf_acl_mask_set1(&mask, INF_ACL_CAN_SUBSCRIBE_SESSION);
-      if(inf_browser_check_acl(browser, browser_iter, acc_id, &mask, NULL))
+      if(inf_browser_check_acl(browser, &browser_iter, acc_id, &mask, NULL))
         icon_name = "text-x-generic"; /* appropriate? */
       else
         /* Would be nice to have a more appropriate icon for this */
         icon_name = "dialog-password";
       g_object_set(G_OBJECT(renderer), "icon-name", icon_name, NULL);
     }
-
-    inf_browser_iter_free(browser_iter);
-    g_object_unref(G_OBJECT(browser));
   }
   else
   {
@@ -2088,30 +2089,29 @@ inf_gtk_browser_view_name_data_func(GtkTreeViewColumn* column,
                                     gpointer user_data)
 {
   GtkTreeIter iter_parent;
-  InfcBrowser* browser;
-  InfBrowserIter* browser_iter;
+  InfBrowser* browser;
+  InfBrowserIter browser_iter;
   const gchar* name;
   gchar* top_name;
 
   if(gtk_tree_model_iter_parent(model, &iter_parent, iter))
   {
     /* Inner node */
-    gtk_tree_model_get(
-      model,
-      iter,
-      INF_GTK_BROWSER_MODEL_COL_BROWSER, &browser,
-      INF_GTK_BROWSER_MODEL_COL_NODE, &browser_iter,
-      -1
-    );
-    
+    if(!inf_gtk_browser_model_tree_iter_to_browser_iter(
+         INF_GTK_BROWSER_MODEL(model),
+         iter,
+         &browser,
+         &browser_iter))
+    {
+      g_object_set(G_OBJECT(renderer), "text", NULL, NULL);
+      return;
+    }
+
     /* TODO: Use another foreground color (or even background color?) when
      * we are subscribed or have sent a subscription request. */
 
-    name = inf_browser_get_node_name(INF_BROWSER(browser), browser_iter);
+    name = inf_browser_get_node_name(browser, &browser_iter);
     g_object_set(G_OBJECT(renderer), "text", name, NULL);
-
-    inf_browser_iter_free(browser_iter);
-    g_object_unref(G_OBJECT(browser));
   }
   else
   {
@@ -2136,8 +2136,7 @@ inf_gtk_browser_view_progress_data_func(GtkTreeViewColumn* column,
                                         gpointer user_data)
 {
   InfBrowser* browser;
-  InfBrowserStatus browser_status;
-  InfBrowserIter* browser_iter;
+  InfBrowserIter browser_iter;
   InfRequest* request;
   GObject* object;
   InfSessionProxy* proxy;
@@ -2148,106 +2147,89 @@ inf_gtk_browser_view_progress_data_func(GtkTreeViewColumn* column,
 
   progress_set = FALSE;
 
-  gtk_tree_model_get(
-    model,
-    iter,
-    INF_GTK_BROWSER_MODEL_COL_BROWSER, &browser,
-    -1
-  );
-
-  if(browser != NULL)
+  /* This only sets browser_iter if the browser is open */
+  if(inf_gtk_browser_model_tree_iter_to_browser_iter(
+       INF_GTK_BROWSER_MODEL(model),
+       iter,
+       &browser,
+       &browser_iter))
   {
-    g_object_get(G_OBJECT(browser), "status", &browser_status, NULL);
-    if(browser_status == INF_BROWSER_OPEN)
+    if(inf_browser_is_subdirectory(browser, &browser_iter))
     {
-      gtk_tree_model_get(
-        model,
-        iter,
-        INF_GTK_BROWSER_MODEL_COL_NODE, &browser_iter,
-        -1
+      request = inf_browser_get_pending_request(
+        browser,
+        &browser_iter,
+        "explore-node"
       );
 
-      if(inf_browser_is_subdirectory(browser, browser_iter))
+      if(request != NULL)
       {
-        request = inf_browser_get_pending_request(
-          browser,
-          browser_iter,
-          "explore-node"
+        g_object_get(
+          G_OBJECT(request),
+          "progress", &progress,
+          NULL
         );
 
-        if(request != NULL)
+        /* Progress can be at 1.0 if the all nodes have been explored but
+         * the request has not finished yet, since the <explore-end> tag by
+         * the server has not yet arrived. In that case we still don't show
+         * the progress bar anymore, since from the client's perspective
+         * everything has finished and all explored nodes are usable. */
+        if(progress < 1.0)
         {
-          g_object_get(
-            G_OBJECT(request),
-            "progress", &progress,
+          g_object_set(
+            G_OBJECT(renderer),
+            "visible", TRUE,
+            "value", (gint)(progress * 100 + 0.5),
+            "text", _("Exploring..."),
             NULL
           );
 
-          /* Progress can be at 1.0 if the all nodes have been explored but
-           * the request has not finished yet, since the <explore-end> tag by
-           * the server has not yet arrived. In that case we still don't show
-           * the progress bar anymore, since from the client's perspective
-           * everything has finished and all explored nodes are usable. */
-          if(progress < 1.0)
-          {
-            g_object_set(
-              G_OBJECT(renderer),
-              "visible", TRUE,
-              "value", (gint)(progress * 100 + 0.5),
-              "text", _("Exploring..."),
-              NULL
-            );
-
-            progress_set = TRUE;
-          }
+          progress_set = TRUE;
         }
       }
-      else if(INFC_IS_BROWSER(browser))
-      {
-        /* Show progress of either sync-in or synchronization
-         * due to subscription. Note that we only do this for
-         * InfcBrowser objects, not InfdDirectory objects. For an
-         * InfdDirectory during sync-in the node is not yet created,
-         * and synchronization to individual clients we cannot show
-         * easily in the GUI. */
-        proxy = INF_SESSION_PROXY(
-          infc_browser_iter_get_sync_in(INFC_BROWSER(browser), browser_iter));
-        if(proxy == NULL)
-          proxy = inf_browser_get_session(browser, browser_iter);
-
-        if(proxy != NULL)
-        {
-          connection = infc_browser_get_connection(INFC_BROWSER(browser));
-          g_assert(connection != NULL);
+    }
+    else if(INFC_IS_BROWSER(browser))
+    {
+      /* Show progress of either sync-in or synchronization
+       * due to subscription. Note that we only do this for
+       * InfcBrowser objects, not InfdDirectory objects. For an
+       * InfdDirectory during sync-in the node is not yet created,
+       * and synchronization to individual clients we cannot show
+       * easily in the GUI. */
+      proxy = INF_SESSION_PROXY(
+        infc_browser_iter_get_sync_in(INFC_BROWSER(browser), &browser_iter));
+      if(proxy == NULL)
+        proxy = inf_browser_get_session(browser, &browser_iter);
 
-          g_object_get(G_OBJECT(proxy), "session", &session, NULL);
-          if(inf_session_get_synchronization_status(session, connection) !=
-             INF_SESSION_SYNC_NONE)
-          {
-            progress = inf_session_get_synchronization_progress(
-              session,
-              connection
-            );
+      if(proxy != NULL)
+      {
+        connection = infc_browser_get_connection(INFC_BROWSER(browser));
+        g_assert(connection != NULL);
 
-            g_object_set(
-              G_OBJECT(renderer),
-              "visible", TRUE,
-              "value", (gint)(progress * 100 + 0.5),
-              "text", _("Synchronizing..."),
-              NULL
-            );
+        g_object_get(G_OBJECT(proxy), "session", &session, NULL);
+        if(inf_session_get_synchronization_status(session, connection) !=
+           INF_SESSION_SYNC_NONE)
+        {
+          progress = inf_session_get_synchronization_progress(
+            session,
+            connection
+          );
 
-            progress_set = TRUE;
-          }
+          g_object_set(
+            G_OBJECT(renderer),
+            "visible", TRUE,
+            "value", (gint)(progress * 100 + 0.5),
+            "text", _("Synchronizing..."),
+            NULL
+          );
 
-          g_object_unref(session);
+          progress_set = TRUE;
         }
-      }
 
-      inf_browser_iter_free(browser_iter);
+        g_object_unref(session);
+      }
     }
-
-    g_object_unref(browser);
   }
 
   if(!progress_set)
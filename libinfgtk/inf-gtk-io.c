@@ -17,13 +17,35 @@
  * MA 02110-1301, USA.
  */
 
+/* InfGtkIo integrates libinfinity's I/O into the default GLib main context.
+ *
+ * Watches are implemented as small GSources created with
+ * g_source_add_unix_fd(), so that the event mask of a watch can be changed
+ * in place with g_source_modify_unix_fd() instead of re-creating the source
+ * each time a connection starts or stops having data to send. On Windows,
+ * GIOChannel watches are used instead.
+ *
+ * Watches are indexed by socket and timeouts are kept in a hash set, so
+ * that looking up and removing them does not depend on how many of them
+ * there are.
+ *
+ * Dispatches are typically added from other threads. Instead of creating
+ * one idle source for each of them, which requires taking the lock of the
+ * main context, they are pushed onto a lock-free stack that is drained by a
+ * single dispatch source in the main thread. Removing a dispatch only marks
+ * it as removed; its memory is reclaimed when the stack is drained. */
+
 #include <libinfgtk/inf-gtk-io.h>
 #include <libinfinity/common/inf-io.h>
 
+#ifndef G_OS_WIN32
+# include <glib-unix.h>
+#endif
+
 struct _InfIoWatch {
   InfGtkIo* io;
   InfNativeSocket* socket;
-  guint id;
+  GSource* source;
   InfIoWatchFunc func;
   gpointer user_data;
   GDestroyNotify notify;
@@ -44,16 +66,28 @@ struct _InfIoTimeout {
 
 struct _InfIoDispatch {
   InfGtkIo* io;
-  guint id;
   InfIoDispatchFunc func;
   gpointer user_data;
   GDestroyNotify notify;
+
+  /* Link in the dispatch queue */
+  InfIoDispatch* next;
+  /* Set when the dispatch has either been run or been removed, protected
+   * by the shared mutex. */
+  gboolean removed;
 };
 
-typedef struct _InfGtkIoSharedMutex InfGtkIoSharedMutex;
-struct _InfGtkIoSharedMutex {
+/* State that needs to outlive the InfGtkIo object, since main loop
+ * callbacks that are already pending when the InfGtkIo is finalized still
+ * need to access it. */
+typedef struct _InfGtkIoShared InfGtkIoShared;
+struct _InfGtkIoShared {
   GMutex mutex;
   int ref;
+
+  /* Lock-free stack of dispatches that have not yet been run, in reverse
+   * order of insertion. */
+  InfIoDispatch* dispatch_queue;
 };
 
 typedef struct _InfGtkIoUserdata InfGtkIoUserdata;
@@ -61,21 +95,37 @@ struct _InfGtkIoUserdata {
   union {
     InfIoWatch* watch;
     InfIoTimeout* timeout;
-    InfIoDispatch* dispatch;
   } shared;
 
-  InfGtkIoSharedMutex* mutex;
+  InfGtkIoShared* mutex;
+};
+
+#ifndef G_OS_WIN32
+typedef gboolean(*InfGtkIoWatchSourceFunc)(GIOCondition, gpointer);
+
+typedef struct _InfGtkIoWatchSource InfGtkIoWatchSource;
+struct _InfGtkIoWatchSource {
+  GSource source;
+  gpointer tag;
+};
+#endif
+
+typedef struct _InfGtkIoDispatchSource InfGtkIoDispatchSource;
+struct _InfGtkIoDispatchSource {
+  GSource source;
+  InfGtkIo* io;
+  InfGtkIoShared* shared;
 };
 
 typedef struct _InfGtkIoPrivate InfGtkIoPrivate;
 struct _InfGtkIoPrivate {
   /* TODO: GMainContext */
 
-  InfGtkIoSharedMutex* mutex;
+  InfGtkIoShared* mutex;
 
-  GSList* watches;
-  GSList* timeouts;
-  GSList* dispatchs;
+  GHashTable* watches; /* InfNativeSocket* -> InfIoWatch* */
+  GHashTable* timeouts; /* set of InfIoTimeout* */
+  GSource* dispatch_source;
 };
 
 #define INF_GTK_IO_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_GTK_TYPE_IO, InfGtkIoPrivate))
@@ -85,6 +135,21 @@ G_DEFINE_TYPE_WITH_CODE(InfGtkIo, inf_gtk_io, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfGtkIo)
   G_IMPLEMENT_INTERFACE(INF_TYPE_IO, inf_gtk_io_io_iface_init))
 
+static void
+inf_gtk_io_shared_unref(InfGtkIoShared* shared)
+{
+  /* Note that we cannot lock the mutex here, because this function might or
+   * might not be called with it being locked already. However in this case
+   * we can use an atomic operation instead. */
+  if(g_atomic_int_dec_and_test(&shared->ref) == TRUE)
+  {
+    g_assert(shared->dispatch_queue == NULL);
+
+    g_mutex_clear(&shared->mutex);
+    g_slice_free(InfGtkIoShared, shared);
+  }
+}
+
 static void
 inf_gtk_io_userdata_free(gpointer data)
 {
@@ -92,17 +157,7 @@ inf_gtk_io_userdata_free(gpointer data)
   userdata = (InfGtkIoUserdata*)data;
 
   /* Note that the shared members may already be invalid at this point */
-
-  /* Note also that we cannot lock the mutex here, because this function
-   * might or might not be called with it being locked already. However in
-   * this case we can use an atomic operation instead. */
-
-  if(g_atomic_int_dec_and_test(&userdata->mutex->ref) == TRUE)
-  {
-    g_mutex_clear(&userdata->mutex->mutex);
-    g_slice_free(InfGtkIoSharedMutex, userdata->mutex);
-  }
-
+  inf_gtk_io_shared_unref(userdata->mutex);
   g_slice_free(InfGtkIoUserdata, userdata);
 }
 
@@ -117,7 +172,7 @@ inf_gtk_io_watch_new(InfGtkIo* io,
   watch = g_slice_new(InfIoWatch);
   watch->io = io;
   watch->socket = socket;
-  watch->id = 0;
+  watch->source = NULL;
   watch->func = func;
   watch->user_data = user_data;
   watch->notify = notify;
@@ -171,10 +226,11 @@ inf_gtk_io_dispatch_new(InfGtkIo* io,
   dispatch = g_slice_new(InfIoDispatch);
 
   dispatch->io = io;
-  dispatch->id = 0;
   dispatch->func = func;
   dispatch->user_data = user_data;
   dispatch->notify = notify;
+  dispatch->next = NULL;
+  dispatch->removed = FALSE;
   return dispatch;
 }
 
@@ -187,20 +243,53 @@ inf_gtk_io_dispatch_free(InfIoDispatch* dispatch)
   g_slice_free(InfIoDispatch, dispatch);
 }
 
-static InfIoWatch*
-inf_gtk_io_watch_lookup(InfGtkIo* io,
-                        InfNativeSocket* socket)
+static void
+inf_gtk_io_dispatch_queue_push(InfGtkIoShared* shared,
+                               InfIoDispatch* dispatch)
 {
-  InfGtkIoPrivate* priv;
-  GSList* item;
+  InfIoDispatch* head;
 
-  priv = INF_GTK_IO_PRIVATE(io);
+  do
+  {
+    head = g_atomic_pointer_get(&shared->dispatch_queue);
+    dispatch->next = head;
+  } while(!g_atomic_pointer_compare_and_exchange(
+    &shared->dispatch_queue,
+    head,
+    dispatch
+  ));
+}
+
+/* Takes all queued dispatches off the queue, and returns them in the order
+ * they have been added. Must only be called from one thread at a time,
+ * which is the case since it is only called from the main thread. */
+static InfIoDispatch*
+inf_gtk_io_dispatch_queue_steal(InfGtkIoShared* shared)
+{
+  InfIoDispatch* head;
+  InfIoDispatch* next;
+  InfIoDispatch* result;
 
-  for(item = priv->watches; item != NULL; item = g_slist_next(item))
-    if( ((InfIoWatch*)item->data)->socket == socket)
-      return (InfIoWatch*)item->data;
+  do
+  {
+    head = g_atomic_pointer_get(&shared->dispatch_queue);
+  } while(head != NULL &&
+          !g_atomic_pointer_compare_and_exchange(
+            &shared->dispatch_queue,
+            head,
+            NULL
+          ));
+
+  result = NULL;
+  while(head != NULL)
+  {
+    next = head->next;
+    head->next = result;
+    result = head;
+    head = next;
+  }
 
-  return NULL;
+  return result;
 }
 
 static void
@@ -209,13 +298,14 @@ inf_gtk_io_init(InfGtkIo* io)
   InfGtkIoPrivate* priv;
   priv = INF_GTK_IO_PRIVATE(io);
 
-  priv->mutex = g_slice_new(InfGtkIoSharedMutex);
+  priv->mutex = g_slice_new(InfGtkIoShared);
   g_mutex_init(&priv->mutex->mutex);
   priv->mutex->ref = 1;
+  priv->mutex->dispatch_queue = NULL;
 
-  priv->watches = NULL;
-  priv->timeouts = NULL;
-  priv->dispatchs = NULL;
+  priv->watches = g_hash_table_new(NULL, NULL);
+  priv->timeouts = g_hash_table_new(NULL, NULL);
+  priv->dispatch_source = NULL;
 }
 
 static void
@@ -223,39 +313,60 @@ inf_gtk_io_finalize(GObject* object)
 {
   InfGtkIo* io;
   InfGtkIoPrivate* priv;
-  GSList* item;
+  GHashTableIter iter;
+  gpointer value;
+  InfIoWatch* watch;
+  InfIoTimeout* timeout;
+  InfIoDispatch* dispatch;
+  InfIoDispatch* next;
 
   io = INF_GTK_IO(object);
   priv = INF_GTK_IO_PRIVATE(io);
 
   g_mutex_lock(&priv->mutex->mutex);
 
-  for(item = priv->watches; item != NULL; item = g_slist_next(item))
+  g_hash_table_iter_init(&iter, priv->watches);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
   {
+    watch = (InfIoWatch*)value;
+
     /* We have a stack-ref on the InfGtkIo when exeucting the callback */
-    g_assert( ((InfIoWatch*)item->data)->executing == FALSE);
+    g_assert(watch->executing == FALSE);
 
-    if( ((InfIoWatch*)item->data)->id != 0)
-      g_source_remove( ((InfIoWatch*)item->data)->id);
-    inf_gtk_io_watch_free((InfIoWatch*)item->data);
+    g_source_destroy(watch->source);
+    g_source_unref(watch->source);
+    inf_gtk_io_watch_free(watch);
   }
-  g_slist_free(priv->watches);
+  g_hash_table_destroy(priv->watches);
 
-  for(item = priv->timeouts; item != NULL; item = g_slist_next(item))
+  g_hash_table_iter_init(&iter, priv->timeouts);
+  while(g_hash_table_iter_next(&iter, &value, NULL))
   {
-    if( ((InfIoTimeout*)item->data)->id != 0)
-      g_source_remove( ((InfIoTimeout*)item->data)->id);
-    inf_gtk_io_timeout_free((InfIoTimeout*)item->data);
+    timeout = (InfIoTimeout*)value;
+    g_source_remove(timeout->id);
+    inf_gtk_io_timeout_free(timeout);
   }
-  g_slist_free(priv->timeouts);
+  g_hash_table_destroy(priv->timeouts);
 
-  for(item = priv->dispatchs; item != NULL; item = g_slist_next(item))
+  if(priv->dispatch_source != NULL)
   {
-    if( ((InfIoDispatch*)item->data)->id != 0)
-      g_source_remove( ((InfIoDispatch*)item->data)->id);
-    inf_gtk_io_dispatch_free((InfIoDispatch*)item->data);
+    g_source_destroy(priv->dispatch_source);
+    g_source_unref(priv->dispatch_source);
   }
-  g_slist_free(priv->dispatchs);
+
+  /* The dispatch source holds a reference on the InfGtkIo while it runs
+   * dispatches, so no other thread can be draining the queue right now. */
+  dispatch = inf_gtk_io_dispatch_queue_steal(priv->mutex);
+  while(dispatch != NULL)
+  {
+    next = dispatch->next;
+    if(dispatch->removed)
+      g_slice_free(InfIoDispatch, dispatch);
+    else
+      inf_gtk_io_dispatch_free(dispatch);
+    dispatch = next;
+  }
+
   g_mutex_unlock(&priv->mutex->mutex);
 
   /* some callback userdata might still have a reference to the mutex, and
@@ -263,11 +374,7 @@ inf_gtk_io_finalize(GObject* object)
    * callback function will do nothing since g_source_is_destroyed() will
    * return FALSE since we removed all sources above. But we need to keep
    * the mutex alive so that the callbacks can check. */
-  if(g_atomic_int_dec_and_test(&priv->mutex->ref))
-  {
-    g_mutex_clear(&priv->mutex->mutex);
-    g_slice_free(InfGtkIoSharedMutex, priv->mutex);
-  }
+  inf_gtk_io_shared_unref(priv->mutex);
 
   G_OBJECT_CLASS(inf_gtk_io_parent_class)->finalize(object);
 }
@@ -305,8 +412,7 @@ inf_gtk_io_inf_events_from_glib_events(GIOCondition cond)
 }
 
 static gboolean
-inf_gtk_io_watch_func(GIOChannel* channel,
-                      GIOCondition condition,
+inf_gtk_io_watch_func(GIOCondition condition,
                       gpointer user_data)
 {
   InfGtkIoUserdata* userdata;
@@ -325,13 +431,13 @@ inf_gtk_io_watch_func(GIOChannel* channel,
     priv = INF_GTK_IO_PRIVATE(watch->io);
 
     g_assert(priv->mutex->ref > 1); /* Both InfGtkIo and we have a reference */
-    g_assert(g_slist_find(priv->watches, watch) != NULL);
+    g_assert(g_hash_table_lookup(priv->watches, watch->socket) == watch);
 
     watch->executing = TRUE;
     g_mutex_unlock(&userdata->mutex->mutex);
 
     /* Note that at this point the watch object could be removed from the
-     * list, but, since executing is set to TRUE, it is not freed. */
+     * table, but, since executing is set to TRUE, it is not freed. */
 
     watch->func(
       watch->socket,
@@ -361,6 +467,81 @@ inf_gtk_io_watch_func(GIOChannel* channel,
   return TRUE;
 }
 
+#ifdef G_OS_WIN32
+static gboolean
+inf_gtk_io_watch_channel_func(GIOChannel* channel,
+                              GIOCondition condition,
+                              gpointer user_data)
+{
+  return inf_gtk_io_watch_func(condition, user_data);
+}
+#else
+static gboolean
+inf_gtk_io_watch_source_dispatch(GSource* source,
+                                 GSourceFunc callback,
+                                 gpointer user_data)
+{
+  InfGtkIoWatchSource* watch_source;
+  GIOCondition condition;
+
+  watch_source = (InfGtkIoWatchSource*)source;
+  condition = g_source_query_unix_fd(source, watch_source->tag);
+
+  return ((InfGtkIoWatchSourceFunc)callback)(condition, user_data);
+}
+
+static GSourceFuncs inf_gtk_io_watch_source_funcs = {
+  NULL,
+  NULL,
+  inf_gtk_io_watch_source_dispatch,
+  NULL
+};
+#endif
+
+/* Creates and attaches the source for watch, which takes ownership of
+ * data. Must be called with the mutex being locked. */
+static void
+inf_gtk_io_watch_attach(InfIoWatch* watch,
+                        GIOCondition condition,
+                        InfGtkIoUserdata* data)
+{
+#ifdef G_OS_WIN32
+  GIOChannel* channel;
+
+  channel = g_io_channel_win32_new_socket(*watch->socket);
+  watch->source = g_io_create_watch(channel, condition);
+  g_io_channel_unref(channel);
+
+  g_source_set_callback(
+    watch->source,
+    (GSourceFunc)inf_gtk_io_watch_channel_func,
+    data,
+    inf_gtk_io_userdata_free
+  );
+#else
+  InfGtkIoWatchSource* watch_source;
+
+  watch->source = g_source_new(
+    &inf_gtk_io_watch_source_funcs,
+    sizeof(InfGtkIoWatchSource)
+  );
+
+  watch_source = (InfGtkIoWatchSource*)watch->source;
+  watch_source->tag =
+    g_source_add_unix_fd(watch->source, *watch->socket, condition);
+
+  g_source_set_callback(
+    watch->source,
+    (GSourceFunc)inf_gtk_io_watch_func,
+    data,
+    inf_gtk_io_userdata_free
+  );
+#endif
+
+  g_source_set_priority(watch->source, G_PRIORITY_DEFAULT);
+  g_source_attach(watch->source, NULL);
+}
+
 static gboolean
 inf_gtk_io_timeout_func(gpointer user_data)
 {
@@ -378,8 +559,8 @@ inf_gtk_io_timeout_func(gpointer user_data)
     priv = INF_GTK_IO_PRIVATE(timeout->io);
 
     g_assert(priv->mutex->ref > 1); /* Both InfGtkIo and we have a reference */
-    g_assert(g_slist_find(priv->timeouts, timeout) != NULL);
-    priv->timeouts = g_slist_remove(priv->timeouts, timeout);
+    if(g_hash_table_remove(priv->timeouts, timeout) == FALSE)
+      g_assert_not_reached();
     g_mutex_unlock(&userdata->mutex->mutex);
 
     timeout->func(timeout->user_data);
@@ -394,37 +575,101 @@ inf_gtk_io_timeout_func(gpointer user_data)
 }
 
 static gboolean
-inf_gtk_io_dispatch_func(gpointer user_data)
+inf_gtk_io_dispatch_source_prepare(GSource* source,
+                                   gint* timeout)
 {
+  InfGtkIoDispatchSource* dispatch_source;
+  dispatch_source = (InfGtkIoDispatchSource*)source;
+
+  *timeout = -1;
+  return g_atomic_pointer_get(&dispatch_source->shared->dispatch_queue) !=
+    NULL;
+}
+
+static gboolean
+inf_gtk_io_dispatch_source_check(GSource* source)
+{
+  InfGtkIoDispatchSource* dispatch_source;
+  dispatch_source = (InfGtkIoDispatchSource*)source;
+
+  return g_atomic_pointer_get(&dispatch_source->shared->dispatch_queue) !=
+    NULL;
+}
+
+static gboolean
+inf_gtk_io_dispatch_source_dispatch(GSource* source,
+                                    GSourceFunc callback,
+                                    gpointer user_data)
+{
+  InfGtkIoDispatchSource* dispatch_source;
+  InfGtkIoShared* shared;
+  InfGtkIo* io;
   InfIoDispatch* dispatch;
-  InfGtkIoPrivate* priv;
-  InfGtkIoUserdata* userdata;
+  InfIoDispatch* next;
 
-  userdata = (InfGtkIoUserdata*)user_data;
-  g_mutex_lock(&userdata->mutex->mutex);
-  if(!g_source_is_destroyed(g_main_current_source()))
+  dispatch_source = (InfGtkIoDispatchSource*)source;
+  shared = dispatch_source->shared;
+
+  g_mutex_lock(&shared->mutex);
+  if(g_source_is_destroyed(source))
   {
-    /* At this point we know that InfGtkIo is still alive because otherwise
-     * the source would have been destroyed in _finalize. */
-    dispatch = userdata->shared.dispatch;
-    priv = INF_GTK_IO_PRIVATE(dispatch->io);
+    g_mutex_unlock(&shared->mutex);
+    return FALSE;
+  }
 
-    g_assert(priv->mutex->ref > 1); /* Both InfGtkIo and we have a reference */
-    g_assert(g_slist_find(priv->dispatchs, dispatch) != NULL);
-    priv->dispatchs = g_slist_remove(priv->dispatchs, dispatch);
-    g_mutex_unlock(&userdata->mutex->mutex);
+  /* At this point we know that InfGtkIo is still alive because otherwise
+   * the source would have been destroyed in _finalize. Keep it alive until
+   * all dispatches we take off the queue have been run, since otherwise
+   * _finalize would not see them. */
+  io = dispatch_source->io;
+  g_object_ref(io);
+  g_mutex_unlock(&shared->mutex);
 
-    dispatch->func(dispatch->user_data);
-    inf_gtk_io_dispatch_free(dispatch);
-  }
-  else
+  dispatch = inf_gtk_io_dispatch_queue_steal(shared);
+  while(dispatch != NULL)
   {
-    g_mutex_unlock(&userdata->mutex->mutex);
+    next = dispatch->next;
+
+    g_mutex_lock(&shared->mutex);
+    if(dispatch->removed)
+    {
+      /* Removed before it had a chance to run; the notify function has
+       * already been called by inf_gtk_io_io_remove_dispatch(). */
+      g_mutex_unlock(&shared->mutex);
+      g_slice_free(InfIoDispatch, dispatch);
+    }
+    else
+    {
+      dispatch->removed = TRUE;
+      g_mutex_unlock(&shared->mutex);
+
+      dispatch->func(dispatch->user_data);
+      inf_gtk_io_dispatch_free(dispatch);
+    }
+
+    dispatch = next;
   }
 
-  return FALSE;
+  g_object_unref(io);
+  return TRUE;
+}
+
+static void
+inf_gtk_io_dispatch_source_finalize(GSource* source)
+{
+  InfGtkIoDispatchSource* dispatch_source;
+  dispatch_source = (InfGtkIoDispatchSource*)source;
+
+  inf_gtk_io_shared_unref(dispatch_source->shared);
 }
 
+static GSourceFuncs inf_gtk_io_dispatch_source_funcs = {
+  inf_gtk_io_dispatch_source_prepare,
+  inf_gtk_io_dispatch_source_check,
+  inf_gtk_io_dispatch_source_dispatch,
+  inf_gtk_io_dispatch_source_finalize
+};
+
 static InfIoWatch*
 inf_gtk_io_io_add_watch(InfIo* io,
                         InfNativeSocket* socket,
@@ -436,13 +681,11 @@ inf_gtk_io_io_add_watch(InfIo* io,
   InfGtkIoPrivate* priv;
   InfIoWatch* watch;
   InfGtkIoUserdata* data;
-  GIOChannel* channel;
 
   priv = INF_GTK_IO_PRIVATE(io);
 
   g_mutex_lock(&priv->mutex->mutex);
-  watch = inf_gtk_io_watch_lookup(INF_GTK_IO(io), socket);
-  if(watch != NULL)
+  if(g_hash_table_contains(priv->watches, socket))
   {
     g_mutex_unlock(&priv->mutex->mutex);
     return NULL;
@@ -461,24 +704,13 @@ inf_gtk_io_io_add_watch(InfIo* io,
   data->mutex = priv->mutex;
   g_atomic_int_inc(&data->mutex->ref);
 
-#ifdef G_OS_WIN32
-  channel = g_io_channel_win32_new_socket(*socket);
-#else
-  channel = g_io_channel_unix_new(*socket);
-#endif
-
-  watch->id = g_io_add_watch_full(
-    channel,
-    G_PRIORITY_DEFAULT,
+  inf_gtk_io_watch_attach(
+    watch,
     inf_gtk_io_inf_events_to_glib_events(events),
-    inf_gtk_io_watch_func,
-    data,
-    inf_gtk_io_userdata_free
+    data
   );
 
-  g_io_channel_unref(channel);
-
-  priv->watches = g_slist_prepend(priv->watches, watch);
+  g_hash_table_insert(priv->watches, socket, watch);
   g_mutex_unlock(&priv->mutex->mutex);
 
   return watch;
@@ -490,38 +722,44 @@ inf_gtk_io_io_update_watch(InfIo* io,
                            InfIoEvent events)
 {
   InfGtkIoPrivate* priv;
+#ifdef G_OS_WIN32
   InfGtkIoUserdata* data;
-  GIOChannel* channel;
+  GSource* source;
+#endif
 
   priv = INF_GTK_IO_PRIVATE(io);
   g_mutex_lock(&priv->mutex->mutex);
 
-  g_assert(g_slist_find(priv->watches, watch) != NULL);
+  g_assert(g_hash_table_lookup(priv->watches, watch->socket) == watch);
 
+#ifdef G_OS_WIN32
   data = g_slice_new(InfGtkIoUserdata);
   data->shared.watch = watch;
   data->mutex = priv->mutex;
   g_atomic_int_inc(&data->mutex->ref);
-  g_mutex_unlock(&priv->mutex->mutex);
 
-  g_source_remove(watch->id);
+  source = watch->source;
+  inf_gtk_io_watch_attach(
+    watch,
+    inf_gtk_io_inf_events_to_glib_events(events),
+    data
+  );
 
-#ifdef G_OS_WIN32
-  channel = g_io_channel_win32_new_socket(*watch->socket);
-#else
-  channel = g_io_channel_unix_new(*watch->socket);
-#endif
+  g_mutex_unlock(&priv->mutex->mutex);
 
-  watch->id = g_io_add_watch_full(
-    channel,
-    G_PRIORITY_DEFAULT,
-    inf_gtk_io_inf_events_to_glib_events(events),
-    inf_gtk_io_watch_func,
-    data,
-    inf_gtk_io_userdata_free
+  g_source_destroy(source);
+  g_source_unref(source);
+#else
+  /* Change the event mask of the existing source, so that we do not need
+   * to create a new source every time the outgoing queue runs empty. */
+  g_source_modify_unix_fd(
+    watch->source,
+    ((InfGtkIoWatchSource*)watch->source)->tag,
+    inf_gtk_io_inf_events_to_glib_events(events)
   );
 
-  g_io_channel_unref(channel);
+  g_mutex_unlock(&priv->mutex->mutex);
+#endif
 }
 
 static void
@@ -529,15 +767,15 @@ inf_gtk_io_io_remove_watch(InfIo* io,
                            InfIoWatch* watch)
 {
   InfGtkIoPrivate* priv;
-  guint watch_id;
+  GSource* source;
 
   priv = INF_GTK_IO_PRIVATE(io);
   g_mutex_lock(&priv->mutex->mutex);
 
-  g_assert(g_slist_find(priv->watches, watch) != NULL);
+  g_assert(g_hash_table_lookup(priv->watches, watch->socket) == watch);
 
-  priv->watches = g_slist_remove(priv->watches, watch);
-  watch_id = watch->id;
+  g_hash_table_remove(priv->watches, watch->socket);
+  source = watch->source;
 
   if(watch->executing)
   {
@@ -558,7 +796,8 @@ inf_gtk_io_io_remove_watch(InfIo* io,
   /* Note that we can do this safely without having locked the mutex because
    * if the callback function is currently being invoked then its user_data
    * will not be destroyed immediately. */
-  g_source_remove(watch_id);
+  g_source_destroy(source);
+  g_source_unref(source);
 }
 
 static InfIoTimeout*
@@ -590,7 +829,7 @@ inf_gtk_io_io_add_timeout(InfIo* io,
     inf_gtk_io_userdata_free
   );
 
-  priv->timeouts = g_slist_prepend(priv->timeouts, timeout);
+  g_hash_table_add(priv->timeouts, timeout);
   g_mutex_unlock(&priv->mutex->mutex);
 
   return timeout;
@@ -605,8 +844,8 @@ inf_gtk_io_io_remove_timeout(InfIo* io,
   priv = INF_GTK_IO_PRIVATE(io);
 
   g_mutex_lock(&priv->mutex->mutex);
-  g_assert(g_slist_find(priv->timeouts, timeout) != NULL);
-  priv->timeouts = g_slist_remove(priv->timeouts, timeout);
+  if(g_hash_table_remove(priv->timeouts, timeout) == FALSE)
+    g_assert_not_reached();
   g_mutex_unlock(&priv->mutex->mutex);
 
   /* Note that we can do this safely without having locked the mutex because
@@ -625,27 +864,15 @@ inf_gtk_io_io_add_dispatch(InfIo* io,
 {
   InfGtkIoPrivate* priv;
   InfIoDispatch* dispatch;
-  InfGtkIoUserdata* data;
 
   priv = INF_GTK_IO_PRIVATE(io);
   dispatch = inf_gtk_io_dispatch_new(INF_GTK_IO(io), func, user_data, notify);
 
-  data = g_slice_new(InfGtkIoUserdata);
-  data->shared.dispatch = dispatch;
-  data->mutex = priv->mutex;
-
-  g_mutex_lock(&priv->mutex->mutex);
-  g_atomic_int_inc(&data->mutex->ref);
-
-  dispatch->id = g_idle_add_full(
-    G_PRIORITY_DEFAULT_IDLE,
-    inf_gtk_io_dispatch_func,
-    data,
-    inf_gtk_io_userdata_free
-  );
-
-  priv->dispatchs = g_slist_prepend(priv->dispatchs, dispatch);
-  g_mutex_unlock(&priv->mutex->mutex);
+  /* This does not take any lock, and it does not need to touch the main
+   * context except for waking it up, so that the dispatch source notices
+   * the new entry in its prepare function. */
+  inf_gtk_io_dispatch_queue_push(priv->mutex, dispatch);
+  g_main_context_wakeup(NULL);
 
   return dispatch;
 }
@@ -659,16 +886,37 @@ inf_gtk_io_io_remove_dispatch(InfIo* io,
   priv = INF_GTK_IO_PRIVATE(io);
 
   g_mutex_lock(&priv->mutex->mutex);
-  g_assert(g_slist_find(priv->dispatchs, dispatch) != NULL);
-  priv->dispatchs = g_slist_remove(priv->dispatchs, dispatch);
+  g_assert(dispatch->removed == FALSE);
+  dispatch->removed = TRUE;
   g_mutex_unlock(&priv->mutex->mutex);
 
-  /* Note that we can do this safely without having locked the mutex because
-   * if the callback function is currently being invoked then its user_data
-   * will not be destroyed immediately. */
-  g_source_remove(dispatch->id);
+  /* The dispatch stays in the queue, it is freed when the dispatch source
+   * takes it off. Only release the user data now. */
+  if(dispatch->notify)
+    dispatch->notify(dispatch->user_data);
+}
+
+static void
+inf_gtk_io_constructed(GObject* object)
+{
+  InfGtkIoPrivate* priv;
+  InfGtkIoDispatchSource* dispatch_source;
+
+  G_OBJECT_CLASS(inf_gtk_io_parent_class)->constructed(object);
+  priv = INF_GTK_IO_PRIVATE(object);
+
+  priv->dispatch_source = g_source_new(
+    &inf_gtk_io_dispatch_source_funcs,
+    sizeof(InfGtkIoDispatchSource)
+  );
+
+  dispatch_source = (InfGtkIoDispatchSource*)priv->dispatch_source;
+  dispatch_source->io = INF_GTK_IO(object);
+  dispatch_source->shared = priv->mutex;
+  g_atomic_int_inc(&priv->mutex->ref);
 
-  inf_gtk_io_dispatch_free(dispatch);
+  g_source_set_priority(priv->dispatch_source, G_PRIORITY_DEFAULT_IDLE);
+  g_source_attach(priv->dispatch_source, NULL);
 }
 
 static void
@@ -677,6 +925,7 @@ inf_gtk_io_class_init(InfGtkIoClass* io_class)
   GObjectClass* object_class;
   object_class = G_OBJECT_CLASS(io_class);
 
+  object_class->constructed = inf_gtk_io_constructed;
   object_class->finalize = inf_gtk_io_finalize;
 }
 
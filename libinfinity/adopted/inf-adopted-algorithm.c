@@ -60,16 +60,22 @@
 
 /* TODO: Do only cleanup if too much entries in cache? */
 
-/* TODO: If users are not issuing any requests for some time, and we can be
- * sure that we do not need to transform any requests, then remove them from
- * the users array (users_begin, users_end). Readd users as soon as they
- * issue buffer-altering requests. This way we keep the asymptotic complexity
- * dynamically as O(active users^2). */
+/* Unavailable users whose requests have all been removed from the request
+ * log, and which every other user has acknowledged, are retired in
+ * inf_adopted_algorithm_cleanup(): they are removed from the users array
+ * (users_begin, users_end), since no request can ever need to be
+ * transformed against them again. Their component is the same in every
+ * state vector we can still encounter. Users are readded as soon as they
+ * become available again or issue requests. This way we keep the
+ * asymptotic complexity dynamically as O(active users^2). The users stay in
+ * the user table, so that their authorship information remains valid. */
 
 #include <libinfinity/adopted/inf-adopted-algorithm.h>
 #include <libinfinity/inf-signals.h>
 #include <libinfinity/inf-i18n.h>
 
+#include <string.h>
+
 typedef struct _InfAdoptedAlgorithmLocalUser InfAdoptedAlgorithmLocalUser;
 struct _InfAdoptedAlgorithmLocalUser {
   InfAdoptedUser* user;
@@ -95,6 +101,9 @@ struct _InfAdoptedAlgorithmPrivate {
   InfAdoptedUser** users_begin;
   InfAdoptedUser** users_end;
 
+  /* Users removed from the users array, see above */
+  GPtrArray* retired_users;
+
   GSList* local_users;
 };
 
@@ -145,7 +154,9 @@ inf_adopted_algorithm_least_common_successor(InfAdoptedAlgorithm* algorithm,
   guint id;
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
-  result = inf_adopted_state_vector_new();
+
+  /* Components of retired users are equal in both vectors */
+  result = inf_adopted_state_vector_copy(first);
 
   for(user = priv->users_begin; user != priv->users_end; ++ user)
   {
@@ -183,7 +194,9 @@ inf_adopted_algorithm_least_common_predecessor(InfAdoptedAlgorithm* algorithm,
   guint id;
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
-  result = inf_adopted_state_vector_new();
+
+  /* Components of retired users are equal in both vectors */
+  result = inf_adopted_state_vector_copy(first);
 
   for(user = priv->users_begin; user != priv->users_end; ++ user)
   {
@@ -366,6 +379,142 @@ inf_adopted_algorithm_add_user(InfAdoptedAlgorithm* algorithm,
   priv->users_begin[user_count - 1] = user;
 }
 
+/* Returns whether the two state vectors have the same components for all
+ * retired users. The requests of retired users have been removed from the
+ * log, so no request can be translated from one state to the other if they
+ * differ in such a component. */
+static gboolean
+inf_adopted_algorithm_retired_equal(InfAdoptedAlgorithm* algorithm,
+                                    InfAdoptedStateVector* first,
+                                    InfAdoptedStateVector* second)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  guint user_id;
+  guint i;
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  for(i = 0; i < priv->retired_users->len; ++i)
+  {
+    user_id = inf_user_get_id(INF_USER(priv->retired_users->pdata[i]));
+    if(inf_adopted_state_vector_get(first, user_id) !=
+       inf_adopted_state_vector_get(second, user_id))
+    {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/* Returns whether the given user in the users array can be retired. */
+static gboolean
+inf_adopted_algorithm_can_retire_user(InfAdoptedAlgorithm* algorithm,
+                                      InfAdoptedUser* user)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  InfAdoptedRequestLog* log;
+  InfAdoptedUser** user_it;
+  InfAdoptedRequest* request;
+  guint id;
+  guint n;
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  if(inf_user_get_status(INF_USER(user)) != INF_USER_UNAVAILABLE)
+    return FALSE;
+
+  /* All of the user's requests must have been removed from the log */
+  log = inf_adopted_user_get_request_log(user);
+  if(inf_adopted_request_log_get_begin(log) !=
+     inf_adopted_request_log_get_end(log))
+  {
+    return FALSE;
+  }
+
+  id = inf_user_get_id(INF_USER(user));
+  n = inf_adopted_state_vector_get(priv->current, id);
+
+  for(user_it = priv->users_begin; user_it != priv->users_end; ++ user_it)
+  {
+    if(*user_it == user) continue;
+
+    /* Every available user needs to have processed all of the user's
+     * requests. Unavailable users are resynchronized when they rejoin, in
+     * the same way as for inf_adopted_algorithm_cleanup(). */
+    if(inf_user_get_status(INF_USER(*user_it)) != INF_USER_UNAVAILABLE)
+    {
+      if(inf_adopted_state_vector_get(
+           inf_adopted_user_get_vector(*user_it), id) != n)
+      {
+        return FALSE;
+      }
+    }
+
+    /* No request still in a log may precede any of the user's requests,
+     * otherwise it would need to be transformed against them. The oldest
+     * request in a log has the smallest component. */
+    log = inf_adopted_user_get_request_log(*user_it);
+    if(inf_adopted_request_log_get_begin(log) !=
+       inf_adopted_request_log_get_end(log))
+    {
+      request = inf_adopted_request_log_get_request(
+        log,
+        inf_adopted_request_log_get_begin(log)
+      );
+
+      if(inf_adopted_state_vector_get(
+           inf_adopted_request_get_vector(request), id) != n)
+      {
+        return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+static void
+inf_adopted_algorithm_retire_user(InfAdoptedAlgorithm* algorithm,
+                                  InfAdoptedUser** user_it)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  g_ptr_array_add(priv->retired_users, *user_it);
+
+  /* Keep the order of the remaining users, so that requests are always
+   * translated along the same path. */
+  memmove(
+    user_it,
+    user_it + 1,
+    (priv->users_end - user_it - 1) * sizeof(InfAdoptedUser*)
+  );
+
+  --priv->users_end;
+}
+
+static void
+inf_adopted_algorithm_reactivate_user(InfAdoptedAlgorithm* algorithm,
+                                      InfAdoptedUser* user)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  guint user_count;
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  if(g_ptr_array_remove_fast(priv->retired_users, user))
+  {
+    /* Do not use inf_adopted_algorithm_add_user(), since the current state
+     * already contains the user's component. */
+    user_count = (priv->users_end - priv->users_begin) + 1;
+    priv->users_begin =
+      g_realloc(priv->users_begin, sizeof(InfAdoptedUser*) * user_count);
+    priv->users_end = priv->users_begin + user_count;
+    priv->users_begin[user_count - 1] = user;
+  }
+}
+
 static void
 inf_adopted_algorithm_add_local_user(InfAdoptedAlgorithm* algorithm,
                                      InfAdoptedUser* user)
@@ -375,6 +524,8 @@ inf_adopted_algorithm_add_local_user(InfAdoptedAlgorithm* algorithm,
   InfAdoptedRequestLog* log;
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  inf_adopted_algorithm_reactivate_user(algorithm, user);
+
   local = g_slice_new(InfAdoptedAlgorithmLocalUser);
   local->user = user;
   log = inf_adopted_user_get_request_log(user);
@@ -457,6 +608,11 @@ inf_adopted_algorithm_buffer_states_equivalent(InfAdoptedAlgorithm* algorithm,
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
 
+  /* The requests of retired users are no longer available, so we cannot
+   * tell whether they cancel out. */
+  if(!inf_adopted_algorithm_retired_equal(algorithm, first, second))
+    return FALSE;
+
   for(user_it = priv->users_begin; user_it != priv->users_end; ++ user_it)
   {
     user = *user_it;
@@ -1045,6 +1201,7 @@ inf_adopted_algorithm_init(InfAdoptedAlgorithm* algorithm)
    * reference anyway. */
   priv->users_begin = NULL;
   priv->users_end = NULL;
+  priv->retired_users = g_ptr_array_new();
 
   priv->local_users = NULL;
 }
@@ -1115,6 +1272,9 @@ inf_adopted_algorithm_dispose(GObject* object)
     inf_adopted_algorithm_local_user_free(algorithm, priv->local_users->data);
 
   g_free(priv->users_begin);
+  priv->users_begin = NULL;
+  priv->users_end = NULL;
+  g_ptr_array_set_size(priv->retired_users, 0);
 
   if(priv->buffer != NULL)
   {
@@ -1168,6 +1328,7 @@ inf_adopted_algorithm_finalize(GObject* object)
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
 
   inf_adopted_state_vector_free(priv->current);
+  g_ptr_array_free(priv->retired_users, TRUE);
 
   G_OBJECT_CLASS(inf_adopted_algorithm_parent_class)->finalize(object);
 }
@@ -1738,6 +1899,16 @@ inf_adopted_algorithm_translate_request(InfAdoptedAlgorithm* algorithm,
     NULL
   );
 
+  /* Otherwise the translation would need requests of retired users */
+  g_return_val_if_fail(
+    inf_adopted_algorithm_retired_equal(
+      algorithm,
+      inf_adopted_request_get_vector(request),
+      to
+    ),
+    NULL
+  );
+
   /* If the request affects the buffer, then it might have been cached
    * earlier. */
   if(inf_adopted_request_affects_buffer(request))
@@ -1806,10 +1977,12 @@ inf_adopted_algorithm_translate_request(InfAdoptedAlgorithm* algorithm,
  * In this case the function returns %FALSE and @error is set. Possible
  * reasons for this include @request being an %INF_ADOPTED_REQUEST_UNDO or
  * %INF_ADOPTED_REQUEST_REDO request without there being an operation to
- * undo or redo, or if the translated operation cannot be applied to the
- * buffer. This usually means that the input @request was invalid. However,
- * this is not considered a programmer error because typically requests are
- * received from untrusted input sources such as network connections.
+ * undo or redo, if @request was made in a state which does not include all
+ * requests of a user retired by inf_adopted_algorithm_cleanup(), or if the
+ * translated operation cannot be applied to the buffer. This usually means
+ * that the input @request was invalid. However, this is not considered a
+ * programmer error because typically requests are received from untrusted
+ * input sources such as network connections.
  * Note that there cannot be any runtime errors if @apply is set to %FALSE.
  * In that case it is safe to call the function with %NULL error.
  *
@@ -1867,6 +2040,34 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
 
   /* not re-entrant */
   g_return_val_if_fail(priv->execute_request == NULL, FALSE);
+
+  /* A request that has not seen all requests of a retired user cannot be
+   * transformed anymore, since these requests are gone. This can only happen
+   * with invalid input. */
+  if(!inf_adopted_algorithm_retired_equal(
+       algorithm,
+       inf_adopted_request_get_vector(request),
+       priv->current))
+  {
+    request_str = inf_adopted_state_vector_to_string(
+      inf_adopted_request_get_vector(request)
+    );
+
+    g_set_error(
+      error,
+      g_quark_from_static_string("INF_ADOPTED_ALGORITHM_ERROR"),
+      INF_ADOPTED_ALGORITHM_ERROR_FAILED,
+      _("Request \"%s\" refers to requests of a user which have already "
+        "been removed"),
+      request_str
+    );
+
+    g_free(request_str);
+    return FALSE;
+  }
+
+  /* Other requests need to be transformed against this one from now on */
+  inf_adopted_algorithm_reactivate_user(algorithm, user);
   priv->execute_request = request;
 
   inf_adopted_request_set_execute_time(request, g_get_real_time());
@@ -2056,6 +2257,11 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
  * This function can be called after every executed request to keep memory use
  * to a minimum, or it can be called in regular intervals, or it can also be
  * omitted if the request history should be preserved.
+ *
+ * Users that have left the session and whose requests have all been removed
+ * and processed by every participant are retired, meaning that requests no
+ * longer need to be transformed against them. They stay in the user table,
+ * and are automatically reactivated when they rejoin the session.
  **/
 void
 inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm)
@@ -2069,18 +2275,30 @@ inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm)
   InfAdoptedStateVector* req_vec;
   InfAdoptedStateVector* low_vec;
   gboolean req_before_lcp;
+  InfAdoptedUser* retired;
   guint n;
   guint id;
   guint vdiff;
+  guint i;
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
-  g_assert(priv->users_begin != priv->users_end);
+  g_assert(priv->users_begin != priv->users_end ||
+           priv->retired_users->len > 0);
 
   /* We don't do cleanup in case the total log size is G_MAXUINT, which
    * means we keep all requests without limit. */
   if(priv->max_total_log_size == G_MAXUINT)
     return;
 
+  /* Retired users that have rejoined the session need to be taken into
+   * account for the lcp again. */
+  for(i = priv->retired_users->len; i > 0; --i)
+  {
+    retired = INF_ADOPTED_USER(priv->retired_users->pdata[i - 1]);
+    if(inf_user_get_status(INF_USER(retired)) != INF_USER_UNAVAILABLE)
+      inf_adopted_algorithm_reactivate_user(algorithm, retired);
+  }
+
   /* We remove every request whose "lower related" request has a greater
    * vdiff to the lcp then max-total-log-size from both request log and
    * the request cache. The lcp is a common state that _all_ sites are
@@ -2173,6 +2391,17 @@ inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm)
   }
 
   inf_adopted_state_vector_free(lcp);
+
+  /* Retire users which are gone and whose requests have all been removed
+   * above, so that we no longer need to consider them when transforming. */
+  user = priv->users_begin;
+  while(user != priv->users_end)
+  {
+    if(inf_adopted_algorithm_can_retire_user(algorithm, *user))
+      inf_adopted_algorithm_retire_user(algorithm, user);
+    else
+      ++user;
+  }
 }
 
 /**
@@ -65,6 +65,7 @@ typedef struct _InfAdoptedSessionPrivate InfAdoptedSessionPrivate;
 struct _InfAdoptedSessionPrivate {
   InfIo* io;
   guint max_total_log_size;
+  InfTimingPolicy* timing_policy;
 
   InfAdoptedAlgorithm* algorithm;
   GSList* local_users; /* having zero or one item in 99.9% of all cases */
@@ -84,6 +85,8 @@ enum {
   PROP_IO,
   PROP_MAX_TOTAL_LOG_SIZE,
 
+  PROP_TIMING_POLICY,
+
   /* read only */
   PROP_ALGORITHM
 };
@@ -99,8 +102,6 @@ enum {
 static guint session_signals[LAST_SIGNAL];
 
 static GQuark inf_adopted_session_error_quark;
-/* TODO: This should perhaps be a property: */
-static const int INF_ADOPTED_SESSION_NOOP_INTERVAL = 30;
 
 G_DEFINE_TYPE_WITH_CODE(InfAdoptedSession, inf_adopted_session, INF_TYPE_SESSION,
   G_ADD_PRIVATE(InfAdoptedSession))
@@ -323,8 +324,10 @@ inf_adopted_session_schedule_noop_timer(InfAdoptedSession* session)
   if(priv->next_noop_user != NULL)
   {
     current = time(NULL);
-    sched =
-      priv->next_noop_user->noop_time + INF_ADOPTED_SESSION_NOOP_INTERVAL;
+    sched = priv->next_noop_user->noop_time +
+      inf_timing_policy_get_noop_interval(
+        inf_adopted_session_get_timing_policy(session)
+      );
 
     if(sched >= current)
       sched -= current;
@@ -799,6 +802,7 @@ inf_adopted_session_init(InfAdoptedSession* session)
 
   priv->io = NULL;
   priv->max_total_log_size = 2048;
+  priv->timing_policy = NULL;
   priv->algorithm = NULL;
   priv->local_users = NULL;
   priv->noop_timeout = NULL;
@@ -923,6 +927,12 @@ inf_adopted_session_dispose(GObject* object)
     priv->algorithm = NULL;
   }
 
+  if(priv->timing_policy != NULL)
+  {
+    g_object_unref(priv->timing_policy);
+    priv->timing_policy = NULL;
+  }
+
   if(priv->io != NULL)
   {
     g_object_unref(G_OBJECT(priv->io));
@@ -966,6 +976,15 @@ inf_adopted_session_set_property(GObject* object,
   case PROP_MAX_TOTAL_LOG_SIZE:
     priv->max_total_log_size = g_value_get_uint(value);
     break;
+  case PROP_TIMING_POLICY:
+    if(priv->timing_policy != NULL)
+      g_object_unref(priv->timing_policy);
+
+    /* If unset, inf_adopted_session_get_timing_policy() falls back to the
+     * policy of the communication manager. This is not looked up here since
+     * the communication manager might not be set yet during construction. */
+    priv->timing_policy = INF_TIMING_POLICY(g_value_dup_object(value));
+    break;
   case PROP_ALGORITHM:
     /* read only */
   default:
@@ -993,6 +1012,13 @@ inf_adopted_session_get_property(GObject* object,
     break;
   case PROP_MAX_TOTAL_LOG_SIZE:
     g_value_set_uint(value, priv->max_total_log_size);
+    break;
+  case PROP_TIMING_POLICY:
+    g_value_set_object(
+      value,
+      G_OBJECT(inf_adopted_session_get_timing_policy(session))
+    );
+
     break;
   case PROP_ALGORITHM:
     g_value_set_object(value, G_OBJECT(priv->algorithm));
@@ -1623,6 +1649,19 @@ inf_adopted_session_class_init(InfAdoptedSessionClass* adopted_session_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_TIMING_POLICY,
+    g_param_spec_object(
+      "timing-policy",
+      "Timing policy",
+      "The policy which determines the no-op interval. If unset, the "
+      "policy of the session's communication manager is used",
+      INF_TYPE_TIMING_POLICY,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT
+    )
+  );
+
   g_object_class_install_property(
     object_class,
     PROP_ALGORITHM,
@@ -1655,6 +1694,36 @@ inf_adopted_session_get_io(InfAdoptedSession* session)
   return INF_ADOPTED_SESSION_PRIVATE(session)->io;
 }
 
+/**
+ * inf_adopted_session_get_timing_policy:
+ * @session: A #InfAdoptedSession.
+ *
+ * Returns the #InfTimingPolicy used by @session. If no policy has been set
+ * for @session explicitly, this is the policy of the session's
+ * #InfCommunicationManager, or the default policy if the session has no
+ * communication manager.
+ *
+ * Returns: (transfer none): A #InfTimingPolicy.
+ **/
+InfTimingPolicy*
+inf_adopted_session_get_timing_policy(InfAdoptedSession* session)
+{
+  InfAdoptedSessionPrivate* priv;
+  InfCommunicationManager* manager;
+
+  g_return_val_if_fail(INF_ADOPTED_IS_SESSION(session), NULL);
+  priv = INF_ADOPTED_SESSION_PRIVATE(session);
+
+  if(priv->timing_policy != NULL)
+    return priv->timing_policy;
+
+  manager = inf_session_get_communication_manager(INF_SESSION(session));
+  if(manager != NULL)
+    return inf_communication_manager_get_timing_policy(manager);
+
+  return inf_timing_policy_get_default();
+}
+
 /**
  * inf_adopted_session_get_algorithm:
  * @session: A #InfAdoptedSession.
@@ -24,6 +24,7 @@
 #include <libinfinity/adopted/inf-adopted-operation.h>
 #include <libinfinity/common/inf-session.h>
 #include <libinfinity/common/inf-io.h>
+#include <libinfinity/common/inf-timing-policy.h>
 
 #include <glib-object.h>
 
@@ -123,6 +124,9 @@ inf_adopted_session_get_type(void);
 InfIo*
 inf_adopted_session_get_io(InfAdoptedSession* session);
 
+InfTimingPolicy*
+inf_adopted_session_get_timing_policy(InfAdoptedSession* session);
+
 InfAdoptedAlgorithm*
 inf_adopted_session_get_algorithm(InfAdoptedSession* session);
 
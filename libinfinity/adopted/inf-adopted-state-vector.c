@@ -120,7 +120,9 @@ inf_adopted_state_vector_insert(InfAdoptedStateVector* vec,
 
   if(vec->max_size <= vec->size)
   {
-    vec->max_size += 5;
+    /* Grow geometrically so that building a vector with many users does
+     * not reallocate for every other insertion. */
+    vec->max_size = vec->max_size * 2 + 5;
     vec->data = g_realloc(vec->data,
                 vec->max_size * sizeof(InfAdoptedStateVectorComponent));
   }
@@ -144,6 +146,131 @@ inf_adopted_state_vector_insert(InfAdoptedStateVector* vec,
   return comp;
 }
 
+/* Appends "id:n" to str, preceded by a ';' if str is not empty. This is
+ * called for every component when serializing, so avoid printf here. */
+static void
+inf_adopted_state_vector_append_component(GString* str,
+                                          guint id,
+                                          guint n)
+{
+  gchar buf[2 * 10 + 2];
+  gchar* pos;
+
+  pos = buf + sizeof(buf);
+
+  do { *--pos = '0' + n % 10; n /= 10; } while(n > 0);
+  *--pos = ':';
+  do { *--pos = '0' + id % 10; id /= 10; } while(id > 0);
+
+  if(str->len > 0)
+    g_string_append_c(str, ';');
+  g_string_append_len(str, pos, buf + sizeof(buf) - pos);
+}
+
+/* Merges the components in str into those of orig, in a single pass that
+ * writes every component of the result exactly once. Returns NULL without
+ * setting error if str is not sorted by ID, in which case the caller needs
+ * to take the slow path that can detect duplicate IDs. Sets error and
+ * returns NULL if str is malformed. */
+static InfAdoptedStateVector*
+inf_adopted_state_vector_merge_string(const InfAdoptedStateVector* orig,
+                                      const gchar* str,
+                                      GError** error)
+{
+  InfAdoptedStateVector* vec;
+  const char* strpos;
+  char* endpos;
+  gsize orig_pos;
+  gsize n_comps;
+  guint id;
+  guint prev_id;
+  guint n;
+
+  /* The result has at most as many components as orig and str together,
+   * so a single allocation is enough. */
+  n_comps = (*str != '\0') ? 1 : 0;
+  for(strpos = str; *strpos != '\0'; ++strpos)
+    if(*strpos == ';')
+      ++n_comps;
+
+  vec = inf_adopted_state_vector_new();
+  vec->max_size = orig->size + n_comps;
+  if(vec->max_size > 0)
+  {
+    vec->data =
+      g_malloc(vec->max_size * sizeof(InfAdoptedStateVectorComponent));
+  }
+
+  orig_pos = 0;
+  prev_id = 0;
+  strpos = str;
+  while(*strpos)
+  {
+    id = strtoul(strpos, &endpos, 10);
+    if(*endpos != ':')
+    {
+      g_set_error_literal(
+        error,
+        inf_adopted_state_vector_error_quark(),
+        INF_ADOPTED_STATE_VECTOR_BAD_FORMAT,
+        _("Expected \":\" after ID")
+      );
+
+      inf_adopted_state_vector_free(vec);
+      return NULL;
+    }
+
+    if(strpos != str && id <= prev_id)
+    {
+      inf_adopted_state_vector_free(vec);
+      return NULL;
+    }
+
+    strpos = endpos + 1; /* step over ':' */
+    n = strtoul(strpos, &endpos, 10);
+
+    if(*endpos != ';' && *endpos != '\0')
+    {
+      g_set_error(
+        error,
+        inf_adopted_state_vector_error_quark(),
+        INF_ADOPTED_STATE_VECTOR_BAD_FORMAT,
+        _("Expected ';' or end of string after component of ID '%u'"),
+        id
+      );
+
+      inf_adopted_state_vector_free(vec);
+      return NULL;
+    }
+
+    while(orig_pos < orig->size && orig->data[orig_pos].id < id)
+      vec->data[vec->size++] = orig->data[orig_pos++];
+
+    vec->data[vec->size].id = id;
+    vec->data[vec->size].n = n;
+    if(orig_pos < orig->size && orig->data[orig_pos].id == id)
+      vec->data[vec->size].n += orig->data[orig_pos++].n;
+    ++vec->size;
+
+    prev_id = id;
+    strpos = endpos;
+    if(*strpos != '\0') ++ strpos; /* step over ';' */
+  }
+
+  if(orig_pos < orig->size)
+  {
+    memcpy(
+      vec->data + vec->size,
+      orig->data + orig_pos,
+      (orig->size - orig_pos) * sizeof(InfAdoptedStateVectorComponent)
+    );
+
+    vec->size += orig->size - orig_pos;
+  }
+
+  return vec;
+}
+
 /**
  * inf_adopted_state_vector_error_quark:
  *
@@ -682,10 +809,11 @@ inf_adopted_state_vector_to_string(const InfAdoptedStateVector* vec)
 
     if(component->n > 0)
     {
-      if(str->len > 0)
-        g_string_append_c(str, ';');
-
-      g_string_append_printf(str, "%u:%u", component->id, component->n);
+      inf_adopted_state_vector_append_component(
+        str,
+        component->id,
+        component->n
+      );
     }
   }
 
@@ -822,8 +950,11 @@ inf_adopted_state_vector_to_string_diff(const InfAdoptedStateVector* vec,
     {
       /* There does not seem to be a corresponding entry in orig_comp, so
        * it is implicitely zero. */
-      if(str->len > 0) g_string_append_c(str, ';');
-      g_string_append_printf(str, "%u:%u", vec_comp->id, vec_comp->n);
+      inf_adopted_state_vector_append_component(
+        str,
+        vec_comp->id,
+        vec_comp->n
+      );
 
       ++vec_pos;
 
@@ -838,10 +969,8 @@ inf_adopted_state_vector_to_string_diff(const InfAdoptedStateVector* vec,
 
     if(vec_comp->n > orig_comp->n)
     {
-      if(str->len > 0) g_string_append_c(str, ';');
-      g_string_append_printf(
+      inf_adopted_state_vector_append_component(
         str,
-        "%u:%u",
         vec_comp->id,
         vec_comp->n - orig_comp->n
       );
@@ -857,8 +986,11 @@ inf_adopted_state_vector_to_string_diff(const InfAdoptedStateVector* vec,
     vec_comp = vec->data + vec_pos;
     if (vec_comp->n > 0)
     {
-      if(str->len > 0) g_string_append_c(str, ';');
-      g_string_append_printf(str, "%u:%u", vec_comp->id, vec_comp->n);
+      inf_adopted_state_vector_append_component(
+        str,
+        vec_comp->id,
+        vec_comp->n
+      );
     }
 
     ++vec_pos;
@@ -894,6 +1026,12 @@ inf_adopted_state_vector_from_string_diff(const gchar* str,
   g_return_val_if_fail(str != NULL, NULL);
   g_return_val_if_fail(orig != NULL, NULL);
 
+  /* inf_adopted_state_vector_to_string_diff() writes the components sorted
+   * by ID, so usually we can merge them with orig in a single pass. */
+  vec = inf_adopted_state_vector_merge_string(orig, str, error);
+  if(vec != NULL) return vec;
+  if(error != NULL && *error != NULL) return NULL;
+
   vec = inf_adopted_state_vector_from_string(str, error);
   if(vec == NULL) return NULL;
 
@@ -42,6 +42,7 @@
 #include <gnutls/x509.h>
 
 #include <string.h>
+#include <errno.h>
 
 #define X509_BEGIN_1 "-----BEGIN CERTIFICATE-----"
 #define X509_BEGIN_2 "-----BEGIN X509 CERTIFICATE-----"
@@ -49,10 +50,6 @@
 #define X509_END_1   "-----END CERTIFICATE-----"
 #define X509_END_2   "-----END X509 CERTIFICATE----"
 
-typedef enum _InfCertUtilError {
-  INF_CERT_UTIL_ERROR_DUPLICATE_HOST_ENTRY
-} InfCertUtilError;
-
 /*
  * Helper functions
  */
@@ -327,6 +324,181 @@ inf_cert_util_free_array(GPtrArray* array,
   }
 }
 
+static void
+inf_cert_util_free_certificate_entry(gpointer cert)
+{
+  /* Certificate map entries parsed with
+   * inf_cert_util_parse_certificate_map() can be NULL for removed hosts. */
+  if(cert != NULL)
+    gnutls_x509_crt_deinit((gnutls_x509_crt_t)cert);
+}
+
+static void
+inf_cert_util_set_errno_error(GError** error,
+                              int save_errno)
+{
+  g_set_error_literal(
+    error,
+    G_FILE_ERROR,
+    g_file_error_from_errno(save_errno),
+    g_strerror(save_errno)
+  );
+}
+
+/* Parses the certificate map in content, which must be nul-terminated and
+ * is modified in the process, into table. Later entries for the same host
+ * replace earlier ones. An entry with an empty certificate removes the
+ * host, or, if keep_removals is TRUE, maps it to NULL. */
+static gboolean
+inf_cert_util_parse_certificate_map_impl(GHashTable* table,
+                                         gchar* content,
+                                         gsize size,
+                                         gboolean keep_removals,
+                                         GError** error)
+{
+  GError* local_error;
+
+  gchar* out_buf;
+  gsize out_buf_len;
+  gchar* pos;
+  gchar* prev;
+  gchar* next;
+  gchar* sep;
+
+  gsize len;
+  gsize out_len;
+  gint base64_state;
+  guint base64_save;
+
+  gnutls_datum_t data;
+  gnutls_x509_crt_t cert;
+  int res;
+
+  out_buf = NULL;
+  out_buf_len = 0;
+  for(prev = content; prev != NULL; prev = next)
+  {
+    pos = strchr(prev, '\n');
+    next = NULL;
+
+    if(pos == NULL)
+      pos = content + size;
+    else
+      next = pos + 1;
+
+    sep = inf_cert_util_memrchr(prev, ':', pos - prev);
+    if(sep == NULL) continue; /* ignore line */
+
+    *sep = '\0';
+
+    /* An empty certificate removes a previous entry for this host */
+    len = (pos - (sep + 1));
+    if(len == 0)
+    {
+      if(keep_removals)
+        g_hash_table_insert(table, g_strdup(prev), NULL);
+      else
+        g_hash_table_remove(table, prev);
+      continue;
+    }
+
+    /* decode base64, import DER certificate */
+    out_len = len / 4 * 3 + 3;
+
+    if(out_len > out_buf_len)
+    {
+      out_buf = g_realloc(out_buf, out_len);
+      out_buf_len = out_len;
+    }
+
+    base64_state = 0;
+    base64_save = 0;
+
+    out_len = g_base64_decode_step(
+      sep + 1,
+      len,
+      out_buf,
+      &base64_state,
+      &base64_save
+    );
+
+    cert = NULL;
+    res = gnutls_x509_crt_init(&cert);
+    if(res == GNUTLS_E_SUCCESS)
+    {
+      data.data = out_buf;
+      data.size = out_len;
+      res = gnutls_x509_crt_import(cert, &data, GNUTLS_X509_FMT_DER);
+    }
+
+    if(res != GNUTLS_E_SUCCESS)
+    {
+      local_error = NULL;
+      inf_gnutls_set_error(&local_error, res);
+
+      g_propagate_prefixed_error(
+        error,
+        local_error,
+        _("Failed to read certificate for host \"%s\""),
+        prev
+      );
+
+      if(cert != NULL)
+        gnutls_x509_crt_deinit(cert);
+
+      g_free(out_buf);
+      return FALSE;
+    }
+
+    g_hash_table_insert(table, g_strdup(prev), cert);
+  }
+
+  g_free(out_buf);
+  return TRUE;
+}
+
+/* Appends a single certificate map line for the given host to string */
+static gboolean
+inf_cert_util_write_certificate_map_entry(GString* string,
+                                          const gchar* hostname,
+                                          gnutls_x509_crt_t cert,
+                                          GError** error)
+{
+  size_t size;
+  int res;
+  gchar* buffer;
+  gchar* encoded_cert;
+
+  size = 0;
+  res = gnutls_x509_crt_export(cert, GNUTLS_X509_FMT_DER, NULL, &size);
+  g_assert(res != GNUTLS_E_SUCCESS);
+
+  buffer = NULL;
+  if(res == GNUTLS_E_SHORT_MEMORY_BUFFER)
+  {
+    buffer = g_malloc(size);
+    res = gnutls_x509_crt_export(cert, GNUTLS_X509_FMT_DER, buffer, &size);
+  }
+
+  if(res != GNUTLS_E_SUCCESS)
+  {
+    g_free(buffer);
+    inf_gnutls_set_error(error, res);
+    return FALSE;
+  }
+
+  encoded_cert = g_base64_encode(buffer, size);
+  g_free(buffer);
+
+  g_string_append(string, hostname);
+  g_string_append_c(string, ':');
+  g_string_append(string, encoded_cert);
+  g_string_append_c(string, '\n');
+
+  g_free(encoded_cert);
+  return TRUE;
+}
+
 /*
  * Public API.
  */
@@ -1059,6 +1231,14 @@ inf_cert_util_copy_certificate(gnutls_x509_crt_t src,
  * per line, where each entry consists of the hostname, then a colon
  * character (':'), and then the base64-encoded certificate in DER format.
  *
+ * If a hostname appears more than once, the last entry for it takes
+ * precedence, and an entry with an empty certificate removes the hostname
+ * from the map. Note that older versions of libinfinity reject files in which
+ * a hostname appears more than once, so files which might be read by older
+ * versions should only ever contain one entry per hostname. Neither
+ * inf_cert_util_write_certificate_map() nor
+ * inf_cert_util_append_certificate_map() produce such entries on their own.
+ *
  * If the file with the given filename does not exist, an empty hash table
  * is returned and the function succeeds.
  *
@@ -1074,22 +1254,7 @@ inf_cert_util_read_certificate_map(const gchar* filename,
   gchar* content;
   gsize size;
   GError* local_error;
-
-  gchar* out_buf;
-  gsize out_buf_len;
-  gchar* pos;
-  gchar* prev;
-  gchar* next;
-  gchar* sep;
-
-  gsize len;
-  gsize out_len;
-  gint base64_state;
-  guint base64_save;
-
-  gnutls_datum_t data;
-  gnutls_x509_crt_t cert;
-  int res;
+  gboolean result;
 
   table = g_hash_table_new_full(
     g_str_hash,
@@ -1105,6 +1270,7 @@ inf_cert_util_read_certificate_map(const gchar* filename,
     if(local_error->domain == G_FILE_ERROR &&
        local_error->code == G_FILE_ERROR_NOENT)
     {
+      g_error_free(local_error);
       return table;
     }
 
@@ -1113,94 +1279,78 @@ inf_cert_util_read_certificate_map(const gchar* filename,
     return NULL;
   }
 
-  out_buf = NULL;
-  out_buf_len = 0;
-  prev = content;
-  for(prev = content; prev != NULL; prev = next)
-  {
-    pos = strchr(prev, '\n');
-    next = NULL;
-
-    if(pos == NULL)
-      pos = content + size;
-    else
-      next = pos + 1;
-
-    sep = inf_cert_util_memrchr(prev, ':', pos - prev);
-    if(sep == NULL) continue; /* ignore line */
-
-    *sep = '\0';
-    if(g_hash_table_lookup(table, prev) != NULL)
-    {
-      g_set_error(
-        error,
-        g_quark_from_static_string("INF_CERT_UTIL_ERROR"),
-        INF_CERT_UTIL_ERROR_DUPLICATE_HOST_ENTRY,
-        _("Certificate for host \"%s\" appears twice"),
-        prev
-      );
-
-      g_hash_table_destroy(table);
-      g_free(out_buf);
-      g_free(content);
-      return NULL;
-    }
+  result = inf_cert_util_parse_certificate_map_impl(
+    table,
+    content,
+    size,
+    FALSE,
+    error
+  );
 
-    /* decode base64, import DER certificate */
-    len = (pos - (sep + 1));
-    out_len = len * 3 / 4;
+  g_free(content);
 
-    if(out_len > out_buf_len)
-    {
-      out_buf = g_realloc(out_buf, out_len);
-      out_buf_len = out_len;
-    }
+  if(result == FALSE)
+  {
+    g_hash_table_destroy(table);
+    return NULL;
+  }
 
-    base64_state = 0;
-    base64_save = 0;
+  return table;
+}
 
-    out_len = g_base64_decode_step(
-      sep + 1,
-      len,
-      out_buf,
-      &base64_state,
-      &base64_save
-    );
+/**
+ * inf_cert_util_parse_certificate_map:
+ * @data: (array length=size): Certificate map entries, in the format
+ * described in inf_cert_util_read_certificate_map().
+ * @size: The number of bytes in @data.
+ * @error: Location to store error information, if any.
+ *
+ * Parses certificate map entries from a memory buffer. Unlike
+ * inf_cert_util_read_certificate_map(), the returned table also contains
+ * hostnames whose entry has been removed, mapped to %NULL, so that the
+ * result can be applied to a map that was read previously. This is useful
+ * to pick up entries which have been appended to a certificate map file.
+ *
+ * Returns: (transfer container) (element-type string gnutls_x509_crt_t):
+ * A hash table with the parsed entries, or %NULL on error. Use
+ * g_hash_table_unref() to free the hash table when no longer needed.
+ */
+GHashTable*
+inf_cert_util_parse_certificate_map(const gchar* data,
+                                    gsize size,
+                                    GError** error)
+{
+  GHashTable* table;
+  gchar* content;
+  gboolean result;
 
-    cert = NULL;
-    res = gnutls_x509_crt_init(&cert);
-    if(res == GNUTLS_E_SUCCESS)
-    {
-      data.data = out_buf;
-      data.size = out_len;
-      res = gnutls_x509_crt_import(cert, &data, GNUTLS_X509_FMT_DER);
-    }
+  g_return_val_if_fail(data != NULL || size == 0, NULL);
 
-    if(res != GNUTLS_E_SUCCESS)
-    {
-      inf_gnutls_set_error(&local_error, res);
+  table = g_hash_table_new_full(
+    g_str_hash,
+    g_str_equal,
+    g_free,
+    (GDestroyNotify)inf_cert_util_free_certificate_entry
+  );
 
-      g_propagate_prefixed_error(
-        error,
-        local_error,
-        _("Failed to read certificate for host \"%s\""),
-        prev
-      );
+  content = g_strndup(data, size);
 
-      if(cert != NULL)
-        gnutls_x509_crt_deinit(cert);
+  result = inf_cert_util_parse_certificate_map_impl(
+    table,
+    content,
+    size,
+    TRUE,
+    error
+  );
 
-      g_hash_table_destroy(table);
-      g_free(out_buf);
-      g_free(content);
-      return NULL;
-    }
+  g_free(content);
 
-    g_hash_table_insert(table, g_strdup(prev), cert);
+  if(result == FALSE)
+  {
+    g_hash_table_destroy(table);
+    return NULL;
   }
 
-  g_free(out_buf);
-  g_free(content);
   return table;
 }
 
@@ -1226,59 +1376,33 @@ inf_cert_util_write_certificate_map(GHashTable* cert_map,
                                     const gchar* filename,
                                     GError** error)
 {
-  gchar* dirname;
   GString* string;
 
   GHashTableIter iter;
   gpointer key;
   gpointer value;
-  const gchar* hostname;
-  gnutls_x509_crt_t cert;
-
-  size_t size;
-  int res;
-  gchar* buffer;
-  gchar* encoded_cert;
+  gboolean result;
 
   string = g_string_sized_new(4096 * g_hash_table_size(cert_map));
 
   g_hash_table_iter_init(&iter, cert_map);
   while(g_hash_table_iter_next(&iter, &key, &value))
   {
-    hostname = (const gchar*)key;
-    cert = (gnutls_x509_crt_t)value;
-
-    size = 0;
-    res = gnutls_x509_crt_export(cert, GNUTLS_X509_FMT_DER, NULL, &size);
-    g_assert(res != GNUTLS_E_SUCCESS);
-
-    buffer = NULL;
-    if(res == GNUTLS_E_SHORT_MEMORY_BUFFER)
-    {
-      buffer = g_malloc(size);
-      res = gnutls_x509_crt_export(cert, GNUTLS_X509_FMT_DER, buffer, &size);
-    }
+    result = inf_cert_util_write_certificate_map_entry(
+      string,
+      (const gchar*)key,
+      (gnutls_x509_crt_t)value,
+      error
+    );
 
-    if(res != GNUTLS_E_SUCCESS)
+    if(result == FALSE)
     {
-      g_free(buffer);
       g_string_free(string, TRUE);
-      inf_gnutls_set_error(error, res);
       return FALSE;
     }
-
-    encoded_cert = g_base64_encode(buffer, size);
-    g_free(buffer);
-    
-    g_string_append(string, hostname);
-    g_string_append_c(string, ':');
-    g_string_append(string, encoded_cert);
-    g_string_append_c(string, '\n');
-
-    g_free(encoded_cert);
   }
 
-  g_file_set_contents(
+  result = g_file_set_contents(
     filename,
     string->str,
     string->len,
@@ -1286,6 +1410,85 @@ inf_cert_util_write_certificate_map(GHashTable* cert_map,
   );
 
   g_string_free(string, TRUE);
+  return result;
+}
+
+/**
+ * inf_cert_util_append_certificate_map:
+ * @filename: The name of the file containing the certificate map.
+ * @hostname: The hostname to add.
+ * @cert: The certificate for @hostname.
+ * @error: Location to store error information, if any.
+ *
+ * Adds a single entry to the certificate map stored in @filename, without
+ * rewriting the rest of the file. If the file does not exist, it is
+ * created.
+ *
+ * @hostname should not yet have an entry in the file. Otherwise it would
+ * appear twice, which older versions of libinfinity cannot read; see
+ * inf_cert_util_read_certificate_map(). To change or remove an existing
+ * entry, rewrite the whole file with inf_cert_util_write_certificate_map().
+ *
+ * Returns: %TRUE on success or %FALSE on error.
+ */
+gboolean
+inf_cert_util_append_certificate_map(const gchar* filename,
+                                     const gchar* hostname,
+                                     gnutls_x509_crt_t cert,
+                                     GError** error)
+{
+  GString* string;
+  FILE* file;
+  int save_errno;
+  gboolean result;
+
+  g_return_val_if_fail(filename != NULL, FALSE);
+  g_return_val_if_fail(hostname != NULL, FALSE);
+  g_return_val_if_fail(cert != NULL, FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  string = g_string_sized_new(4096);
+  result = inf_cert_util_write_certificate_map_entry(
+    string,
+    hostname,
+    cert,
+    error
+  );
+
+  if(result == FALSE)
+  {
+    g_string_free(string, TRUE);
+    return FALSE;
+  }
+
+  file = g_fopen(filename, "ab");
+  if(file == NULL)
+  {
+    save_errno = errno;
+    g_string_free(string, TRUE);
+    inf_cert_util_set_errno_error(error, save_errno);
+    return FALSE;
+  }
+
+  /* Write the line at once, so that a concurrent reader sees either the
+   * complete entry or none of it, as far as the OS permits. */
+  if(fwrite(string->str, 1, string->len, file) != string->len)
+  {
+    save_errno = errno;
+    fclose(file);
+    g_string_free(string, TRUE);
+    inf_cert_util_set_errno_error(error, save_errno);
+    return FALSE;
+  }
+
+  g_string_free(string, TRUE);
+
+  if(fclose(file) != 0)
+  {
+    inf_cert_util_set_errno_error(error, errno);
+    return FALSE;
+  }
+
   return TRUE;
 }
 
@@ -47,6 +47,13 @@
  * the same certificate, it is accepted automatically. If a different
  * certificate than the pinned one is being presented, then
  * the #InfCertificateVerify::check-certificate signal is emitted again.
+ *
+ * The file with pinned certificates is parsed only once and shared by all
+ * #InfCertificateVerify objects using it. When the file changes, only the
+ * entries that have been appended to it are read again, and certificates
+ * for new hosts are appended to the file instead of rewriting it. Replacing
+ * or removing a pinned certificate still rewrites the file, so that it can
+ * be read by older versions of libinfinity.
  */
 
 /* TODO: OCSP. We probably should only do OCSP stapling, and support
@@ -68,6 +75,11 @@
 
 #include <gnutls/x509.h>
 
+#include <glib/gstdio.h>
+
+#include <string.h>
+#include <errno.h>
+
 static const GFlagsValue inf_certificate_verify_flags_values[] = {
   {
     INF_CERTIFICATE_VERIFY_HOSTNAME_MISMATCH,
@@ -88,10 +100,39 @@ static const GFlagsValue inf_certificate_verify_flags_values[] = {
   }
 };
 
+/* Size of a SHA-256 digest */
+#define INF_CERTIFICATE_VERIFY_FINGERPRINT_SIZE 32
+
+typedef struct _InfCertificateVerifyKnownHost InfCertificateVerifyKnownHost;
+struct _InfCertificateVerifyKnownHost {
+  gnutls_x509_crt_t certificate;
+  guchar fingerprint[INF_CERTIFICATE_VERIFY_FINGERPRINT_SIZE];
+};
+
+/* The parsed content of a known hosts file. It is shared by all
+ * InfCertificateVerify objects using the same file, and is kept up to date
+ * with the file on disk by re-reading only what has been appended to it
+ * since the last time it was read. */
+typedef struct _InfCertificateVerifyKnownHosts InfCertificateVerifyKnownHosts;
+struct _InfCertificateVerifyKnownHosts {
+  guint ref_count;
+  gchar* filename;
+
+  /* hostname -> InfCertificateVerifyKnownHost */
+  GHashTable* hosts;
+
+  /* State of the file when it was last read */
+  gboolean loaded;
+  guint64 inode;
+  goffset size;
+  gint64 mtime;
+  goffset offset; /* number of bytes parsed, up to the last full line */
+};
+
 typedef struct _InfCertificateVerifyQuery InfCertificateVerifyQuery;
 struct _InfCertificateVerifyQuery {
   InfCertificateVerify* verify;
-  GHashTable* known_hosts;
+  gnutls_x509_crt_t known_certificate;
   InfXmppConnection* connection;
   InfCertificateChain* certificate_chain;
 };
@@ -100,6 +141,7 @@ typedef struct _InfCertificateVerifyPrivate InfCertificateVerifyPrivate;
 struct _InfCertificateVerifyPrivate {
   InfXmppManager* xmpp_manager;
   gchar* known_hosts_filename;
+  InfCertificateVerifyKnownHosts* known_hosts;
   GSList* queries;
 };
 
@@ -121,6 +163,11 @@ static guint certificate_verify_signals[LAST_SIGNAL];
 
 #define INF_CERTIFICATE_VERIFY_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TYPE_CERTIFICATE_VERIFY, InfCertificateVerifyPrivate))
 
+/* Maps filenames to InfCertificateVerifyKnownHosts. The lock protects both
+ * the map and the content of all InfCertificateVerifyKnownHosts. */
+static GHashTable* inf_certificate_verify_known_hosts_cache;
+G_LOCK_DEFINE_STATIC(inf_certificate_verify_known_hosts_cache);
+
 INF_DEFINE_FLAGS_TYPE(InfCertificateVerifyFlags, inf_certificate_verify_flags, inf_certificate_verify_flags_values)
 G_DEFINE_TYPE_WITH_CODE(InfCertificateVerify, inf_certificate_verify, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfCertificateVerify))
@@ -134,7 +181,7 @@ inf_certificate_verify_find_query(InfCertificateVerify* verify,
   InfCertificateVerifyQuery* query;
 
   priv = INF_CERTIFICATE_VERIFY_PRIVATE(verify);
-  for(item = priv->queries; item != NULL; item == item->next)
+  for(item = priv->queries; item != NULL; item = item->next)
   {
     query = (InfCertificateVerifyQuery*)item->data;
     if(query->connection == connection)
@@ -145,91 +192,437 @@ inf_certificate_verify_find_query(InfCertificateVerify* verify,
 }
 
 static void
-inf_certificate_verify_notify_status_cb(GObject* object,
-                                        GParamSpec* pspec,
-                                        gpointer user_data);
+inf_certificate_verify_set_errno_error(GError** error,
+                                       int save_errno)
+{
+  g_set_error_literal(
+    error,
+    G_FILE_ERROR,
+    g_file_error_from_errno(save_errno),
+    g_strerror(save_errno)
+  );
+}
+
+static gboolean
+inf_certificate_verify_get_fingerprint(gnutls_x509_crt_t cert,
+                                       guchar* fingerprint,
+                                       GError** error)
+{
+  size_t size;
+  int ret;
+
+  size = INF_CERTIFICATE_VERIFY_FINGERPRINT_SIZE;
+  ret = gnutls_x509_crt_get_fingerprint(
+    cert,
+    GNUTLS_DIG_SHA256,
+    fingerprint,
+    &size
+  );
+
+  if(ret != GNUTLS_E_SUCCESS)
+  {
+    inf_gnutls_set_error(error, ret);
+    return FALSE;
+  }
+
+  g_assert(size == INF_CERTIFICATE_VERIFY_FINGERPRINT_SIZE);
+  return TRUE;
+}
 
 static void
-inf_certificate_verify_query_free(InfCertificateVerifyQuery* query,
-                                  gboolean emit_cancelled)
+inf_certificate_verify_known_host_free(gpointer data)
 {
-  InfCertificateVerify* verify;
-  InfXmppConnection* connection;
+  InfCertificateVerifyKnownHost* known_host;
+  known_host = (InfCertificateVerifyKnownHost*)data;
 
-  verify = query->verify;
+  if(known_host != NULL)
+  {
+    gnutls_x509_crt_deinit(known_host->certificate);
+    g_slice_free(InfCertificateVerifyKnownHost, known_host);
+  }
+}
 
-  inf_signal_handlers_disconnect_by_func(
-    G_OBJECT(query->connection),
-    G_CALLBACK(inf_certificate_verify_notify_status_cb),
-    query
-  );
+/* Takes ownership of cert, also on error */
+static InfCertificateVerifyKnownHost*
+inf_certificate_verify_known_host_new(gnutls_x509_crt_t cert,
+                                      GError** error)
+{
+  InfCertificateVerifyKnownHost* known_host;
 
-  connection = query->connection;
-  inf_certificate_chain_unref(query->certificate_chain);
-  g_hash_table_unref(query->known_hosts);
-  g_slice_free(InfCertificateVerifyQuery, query);
+  known_host = g_slice_new(InfCertificateVerifyKnownHost);
+  known_host->certificate = cert;
 
-  if(emit_cancelled)
+  if(!inf_certificate_verify_get_fingerprint(cert,
+                                             known_host->fingerprint,
+                                             error))
   {
-    g_signal_emit(
-      verify,
-      certificate_verify_signals[CHECK_CANCELLED],
-      0,
-      connection
+    inf_certificate_verify_known_host_free(known_host);
+    return NULL;
+  }
+
+  return known_host;
+}
+
+static InfCertificateVerifyKnownHosts*
+inf_certificate_verify_known_hosts_ref(const gchar* filename)
+{
+  InfCertificateVerifyKnownHosts* known_hosts;
+
+  G_LOCK(inf_certificate_verify_known_hosts_cache);
+
+  if(inf_certificate_verify_known_hosts_cache == NULL)
+  {
+    inf_certificate_verify_known_hosts_cache =
+      g_hash_table_new(g_str_hash, g_str_equal);
+  }
+
+  known_hosts = g_hash_table_lookup(
+    inf_certificate_verify_known_hosts_cache,
+    filename
+  );
+
+  if(known_hosts == NULL)
+  {
+    known_hosts = g_slice_new(InfCertificateVerifyKnownHosts);
+    known_hosts->ref_count = 0;
+    known_hosts->filename = g_strdup(filename);
+
+    known_hosts->hosts = g_hash_table_new_full(
+      g_str_hash,
+      g_str_equal,
+      g_free,
+      inf_certificate_verify_known_host_free
+    );
+
+    known_hosts->loaded = FALSE;
+    known_hosts->inode = 0;
+    known_hosts->size = 0;
+    known_hosts->mtime = 0;
+    known_hosts->offset = 0;
+
+    g_hash_table_insert(
+      inf_certificate_verify_known_hosts_cache,
+      known_hosts->filename,
+      known_hosts
     );
   }
 
-  g_object_unref(connection);
+  ++known_hosts->ref_count;
+
+  G_UNLOCK(inf_certificate_verify_known_hosts_cache);
+  return known_hosts;
 }
 
 static void
-inf_certificate_verify_set_known_hosts(InfCertificateVerify* verify,
-                                       const gchar* known_hosts_filename)
+inf_certificate_verify_known_hosts_unref(
+  InfCertificateVerifyKnownHosts* known_hosts)
 {
-  InfCertificateVerifyPrivate* priv;
-  priv = INF_CERTIFICATE_VERIFY_PRIVATE(verify);
+  G_LOCK(inf_certificate_verify_known_hosts_cache);
 
-  /* TODO: If there are running queries, the we need to load the new hosts
-   * file and then change it in all queries. */
-  g_assert(priv->queries == NULL);
+  g_assert(known_hosts->ref_count > 0);
+  if(--known_hosts->ref_count == 0)
+  {
+    g_hash_table_remove(
+      inf_certificate_verify_known_hosts_cache,
+      known_hosts->filename
+    );
 
-  g_free(priv->known_hosts_filename);
-  priv->known_hosts_filename = g_strdup(known_hosts_filename);
+    g_hash_table_destroy(known_hosts->hosts);
+    g_free(known_hosts->filename);
+    g_slice_free(InfCertificateVerifyKnownHosts, known_hosts);
+  }
+
+  G_UNLOCK(inf_certificate_verify_known_hosts_cache);
 }
 
-static GHashTable*
-inf_certificate_verify_ref_known_hosts(InfCertificateVerify* verify,
-                                       GError** error)
+static gchar*
+inf_certificate_verify_known_hosts_read(
+  InfCertificateVerifyKnownHosts* known_hosts,
+  goffset offset,
+  gsize* size,
+  GError** error)
 {
-  InfCertificateVerifyPrivate* priv;
-  InfCertificateVerifyQuery* query;
+  FILE* file;
+  GString* string;
+  gchar buffer[4096];
+  size_t len;
+  int save_errno;
+
+  file = g_fopen(known_hosts->filename, "rb");
+  if(file == NULL)
+  {
+    inf_certificate_verify_set_errno_error(error, errno);
+    return NULL;
+  }
 
-  priv = INF_CERTIFICATE_VERIFY_PRIVATE(verify);
-  if(priv->queries != NULL)
+  if(offset > 0 && fseek(file, (long)offset, SEEK_SET) != 0)
   {
-    query = (InfCertificateVerifyQuery*)priv->queries->data;
-    g_hash_table_ref(query->known_hosts);
-    return query->known_hosts;
+    save_errno = errno;
+    fclose(file);
+    inf_certificate_verify_set_errno_error(error, save_errno);
+    return NULL;
   }
-  else
+
+  string = g_string_sized_new(sizeof(buffer));
+  while((len = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    g_string_append_len(string, buffer, len);
+
+  if(ferror(file))
+  {
+    save_errno = errno;
+    fclose(file);
+    g_string_free(string, TRUE);
+    inf_certificate_verify_set_errno_error(error, save_errno);
+    return NULL;
+  }
+
+  fclose(file);
+
+  *size = string->len;
+  return g_string_free(string, FALSE);
+}
+
+/* Makes sure that the in-memory known hosts reflect the file on disk. If
+ * the file has only grown since it was last read, only the new lines are
+ * parsed. Must be called with the cache lock held. */
+static gboolean
+inf_certificate_verify_known_hosts_update(
+  InfCertificateVerifyKnownHosts* known_hosts,
+  GError** error)
+{
+  GStatBuf st;
+  int save_errno;
+  goffset offset;
+
+  gchar* content;
+  gsize size;
+  gchar* end;
+  gsize parsed;
+
+  GHashTable* entries;
+  GHashTable* changes;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  InfCertificateVerifyKnownHost* known_host;
+
+  if(g_stat(known_hosts->filename, &st) != 0)
+  {
+    save_errno = errno;
+    if(save_errno != ENOENT)
+    {
+      inf_certificate_verify_set_errno_error(error, save_errno);
+      return FALSE;
+    }
+
+    /* No file means no known hosts */
+    g_hash_table_remove_all(known_hosts->hosts);
+    known_hosts->loaded = TRUE;
+    known_hosts->inode = 0;
+    known_hosts->size = 0;
+    known_hosts->mtime = 0;
+    known_hosts->offset = 0;
+    return TRUE;
+  }
+
+  if(known_hosts->loaded == TRUE &&
+     known_hosts->inode == (guint64)st.st_ino &&
+     known_hosts->size == (goffset)st.st_size &&
+     known_hosts->mtime == (gint64)st.st_mtime)
+  {
+    return TRUE;
+  }
+
+  /* If the file has been replaced or truncated, then read it completely.
+   * Otherwise it has only been appended to. */
+  offset = known_hosts->offset;
+  if(known_hosts->loaded == FALSE ||
+     known_hosts->inode != (guint64)st.st_ino ||
+     (goffset)st.st_size < known_hosts->offset)
+  {
+    offset = 0;
+  }
+
+  content = inf_certificate_verify_known_hosts_read(
+    known_hosts,
+    offset,
+    &size,
+    error
+  );
+
+  if(content == NULL)
+    return FALSE;
+
+  /* When picking up appended entries, only parse complete lines, since a
+   * partial line at the end might still be written to. */
+  end = content + size;
+  if(offset > 0)
+    while(end > content && end[-1] != '\n')
+      --end;
+
+  parsed = end - content;
+  entries = inf_cert_util_parse_certificate_map(content, parsed, error);
+  if(entries == NULL)
+  {
+    g_free(content);
+    return FALSE;
+  }
+
+  g_free(content);
+
+  /* Compute all fingerprints before touching the known hosts, so that they
+   * stay intact if there is an error. Removed hosts map to NULL. */
+  changes = g_hash_table_new_full(
+    g_str_hash,
+    g_str_equal,
+    g_free,
+    inf_certificate_verify_known_host_free
+  );
+
+  g_hash_table_iter_init(&iter, entries);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    g_hash_table_iter_steal(&iter);
+    known_host = NULL;
+
+    if(value != NULL)
+    {
+      known_host = inf_certificate_verify_known_host_new(
+        (gnutls_x509_crt_t)value,
+        error
+      );
+
+      if(known_host == NULL)
+      {
+        g_free(key);
+        g_hash_table_destroy(entries);
+        g_hash_table_destroy(changes);
+        return FALSE;
+      }
+    }
+
+    g_hash_table_insert(changes, key, known_host);
+  }
+
+  g_hash_table_destroy(entries);
+
+  if(offset == 0)
+    g_hash_table_remove_all(known_hosts->hosts);
+
+  g_hash_table_iter_init(&iter, changes);
+  while(g_hash_table_iter_next(&iter, &key, &value))
   {
-    return inf_cert_util_read_certificate_map(
-      priv->known_hosts_filename,
-      error
+    g_hash_table_iter_steal(&iter);
+
+    if(value != NULL)
+    {
+      g_hash_table_insert(known_hosts->hosts, key, value);
+    }
+    else
+    {
+      g_hash_table_remove(known_hosts->hosts, key);
+      g_free(key);
+    }
+  }
+
+  g_hash_table_destroy(changes);
+
+  known_hosts->loaded = TRUE;
+  known_hosts->inode = st.st_ino;
+  known_hosts->size = st.st_size;
+  known_hosts->mtime = st.st_mtime;
+  known_hosts->offset = offset + parsed;
+
+  return TRUE;
+}
+
+/* Rewrites the known hosts file with only the current entries. Must be
+ * called with the cache lock held. */
+static gboolean
+inf_certificate_verify_known_hosts_compact(
+  InfCertificateVerifyKnownHosts* known_hosts,
+  GError** error)
+{
+  GHashTable* table;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  GStatBuf st;
+  gboolean result;
+
+  table = g_hash_table_new(g_str_hash, g_str_equal);
+
+  g_hash_table_iter_init(&iter, known_hosts->hosts);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    g_hash_table_insert(
+      table,
+      key,
+      ((InfCertificateVerifyKnownHost*)value)->certificate
     );
   }
+
+  result = inf_cert_util_write_certificate_map(
+    table,
+    known_hosts->filename,
+    error
+  );
+
+  g_hash_table_destroy(table);
+
+  if(result == FALSE)
+    return FALSE;
+
+  /* The file now contains exactly what we have in memory, so there is no
+   * need to read it again. */
+  if(g_stat(known_hosts->filename, &st) == 0)
+  {
+    known_hosts->inode = st.st_ino;
+    known_hosts->size = st.st_size;
+    known_hosts->mtime = st.st_mtime;
+    known_hosts->offset = st.st_size;
+  }
+  else
+  {
+    known_hosts->loaded = FALSE;
+  }
+
+  return TRUE;
 }
 
+/* Sets or, if cert is NULL, removes the pinned certificate for hostname
+ * and records the change in the known hosts file. Must be called with the
+ * cache lock held. */
 static gboolean
-inf_certificate_verify_write_known_hosts(InfCertificateVerify* verify,
-                                         GHashTable* table,
-                                         GError** error)
+inf_certificate_verify_known_hosts_set(
+  InfCertificateVerifyKnownHosts* known_hosts,
+  const gchar* hostname,
+  gnutls_x509_crt_t cert,
+  GError** error)
 {
-  InfCertificateVerifyPrivate* priv;
+  InfCertificateVerifyKnownHost* known_host;
   gchar* dirname;
+  gboolean replaces;
+
+  replaces = g_hash_table_lookup(known_hosts->hosts, hostname) != NULL;
+  if(cert == NULL && !replaces)
+    return TRUE;
+
+  if(cert != NULL)
+  {
+    cert = inf_cert_util_copy_certificate(cert, error);
+    if(cert == NULL) return FALSE;
+
+    known_host = inf_certificate_verify_known_host_new(cert, error);
+    if(known_host == NULL) return FALSE;
+
+    g_hash_table_insert(known_hosts->hosts, g_strdup(hostname), known_host);
+  }
+  else
+  {
+    g_hash_table_remove(known_hosts->hosts, hostname);
+  }
 
-  priv = INF_CERTIFICATE_VERIFY_PRIVATE(verify);
-  
   /* Note that we pin the whole certificate and not only the public key of
    * our known hosts. This allows us to differentiate two cases when a
    * host presents a new certificate:
@@ -240,7 +633,7 @@ inf_certificate_verify_write_known_hosts(InfCertificateVerify* verify,
    *       message saying that the certificate change was unexpected, and
    *       unless it was expected the host should not be trusted.
    */
-  dirname = g_path_get_dirname(priv->known_hosts_filename);
+  dirname = g_path_get_dirname(known_hosts->filename);
   if(!inf_file_util_create_directory(dirname, 0755, error))
   {
     g_free(dirname);
@@ -249,32 +642,40 @@ inf_certificate_verify_write_known_hosts(InfCertificateVerify* verify,
 
   g_free(dirname);
 
-  return inf_cert_util_write_certificate_map(
-    table,
-    priv->known_hosts_filename,
+  /* Only append to the file if this adds a new host. Overriding or
+   * removing an entry rewrites the whole file instead, so that every host
+   * appears only once. Older versions of libinfinity reject files with
+   * duplicate hosts, and the file is shared between clients of different
+   * versions. */
+  if(cert == NULL || replaces)
+    return inf_certificate_verify_known_hosts_compact(known_hosts, error);
+
+  /* The appended line is picked up by the next update, which finds the
+   * same entry that is already in memory. */
+  return inf_cert_util_append_certificate_map(
+    known_hosts->filename,
+    hostname,
+    cert,
     error
   );
 }
 
 static void
-inf_certificate_verify_write_known_hosts_with_warning(
-  InfCertificateVerify* verify,
-  GHashTable* table)
+inf_certificate_verify_known_hosts_set_with_warning(
+  InfCertificateVerifyKnownHosts* known_hosts,
+  const gchar* hostname,
+  gnutls_x509_crt_t cert)
 {
-  InfCertificateVerifyPrivate* priv;
   GError* error;
-  gboolean result;
-
-  priv = INF_CERTIFICATE_VERIFY_PRIVATE(verify);
   error = NULL;
 
-  result = inf_certificate_verify_write_known_hosts(verify, table, &error);
+  inf_certificate_verify_known_hosts_set(known_hosts, hostname, cert, &error);
 
   if(error != NULL)
   {
     g_warning(
       _("Failed to write file with known hosts \"%s\": %s"),
-      priv->known_hosts_filename,
+      known_hosts->filename,
       error->message
     );
 
@@ -282,6 +683,70 @@ inf_certificate_verify_write_known_hosts_with_warning(
   }
 }
 
+static void
+inf_certificate_verify_notify_status_cb(GObject* object,
+                                        GParamSpec* pspec,
+                                        gpointer user_data);
+
+static void
+inf_certificate_verify_query_free(InfCertificateVerifyQuery* query,
+                                  gboolean emit_cancelled)
+{
+  InfCertificateVerify* verify;
+  InfXmppConnection* connection;
+
+  verify = query->verify;
+
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(query->connection),
+    G_CALLBACK(inf_certificate_verify_notify_status_cb),
+    query
+  );
+
+  connection = query->connection;
+  inf_certificate_chain_unref(query->certificate_chain);
+  if(query->known_certificate != NULL)
+    gnutls_x509_crt_deinit(query->known_certificate);
+  g_slice_free(InfCertificateVerifyQuery, query);
+
+  if(emit_cancelled)
+  {
+    g_signal_emit(
+      verify,
+      certificate_verify_signals[CHECK_CANCELLED],
+      0,
+      connection
+    );
+  }
+
+  g_object_unref(connection);
+}
+
+static void
+inf_certificate_verify_set_known_hosts(InfCertificateVerify* verify,
+                                       const gchar* known_hosts_filename)
+{
+  InfCertificateVerifyPrivate* priv;
+  priv = INF_CERTIFICATE_VERIFY_PRIVATE(verify);
+
+  /* Running queries keep their own copy of the pinned certificate, and
+   * look up the new file once they are checked. */
+  if(priv->known_hosts != NULL)
+  {
+    inf_certificate_verify_known_hosts_unref(priv->known_hosts);
+    priv->known_hosts = NULL;
+  }
+
+  g_free(priv->known_hosts_filename);
+  priv->known_hosts_filename = g_strdup(known_hosts_filename);
+
+  if(known_hosts_filename != NULL)
+  {
+    priv->known_hosts =
+      inf_certificate_verify_known_hosts_ref(known_hosts_filename);
+  }
+}
+
 static void
 inf_certificate_verify_notify_status_cb(GObject* object,
                                         GParamSpec* pspec,
@@ -326,9 +791,10 @@ inf_certificate_verify_certificate_func(InfXmppConnection* connection,
 
   int ret;
   unsigned int verify_result;
-  GHashTable* table;
+  InfCertificateVerifyKnownHost* known_host;
+  guchar fingerprint[INF_CERTIFICATE_VERIFY_FINGERPRINT_SIZE];
+  gboolean is_pinned;
   gboolean cert_equal;
-  time_t expiration_time;
 
   InfCertificateVerifyQuery* query;
   GError* error;
@@ -389,28 +855,71 @@ inf_certificate_verify_certificate_func(InfXmppConnection* connection,
 
   /* Look up the host in our database of pinned certificates if we could not
    * fully verify the certificate, i.e. if either the issuer is not known or
-   * the hostname of the connection does not match the certificate. */
-  table = NULL;
-  if(error == NULL)
+   * the hostname of the connection does not match the certificate. The
+   * database is shared and only re-read if the file has changed, and the
+   * fingerprints of pinned certificates are computed only once. */
+  known_cert = NULL;
+  is_pinned = FALSE;
+  cert_equal = FALSE;
+
+  if(error == NULL && priv->known_hosts != NULL)
   {
-    known_cert = NULL;
+    G_LOCK(inf_certificate_verify_known_hosts_cache);
+
     if(!match_hostname || !issuer_known)
     {
       /* If we cannot load the known host file, then cancel the connection.
        * Otherwise it might happen that someone shows us a certificate that we
        * tell the user we don't know, if though actually for that host we
        * expect a different certificate. */
-      table = inf_certificate_verify_ref_known_hosts(verify, &error);
-      if(table != NULL)
-        known_cert = g_hash_table_lookup(table, hostname);
+      if(inf_certificate_verify_known_hosts_update(priv->known_hosts, &error))
+      {
+        known_host = g_hash_table_lookup(priv->known_hosts->hosts, hostname);
+        if(known_host != NULL)
+        {
+          is_pinned = TRUE;
+
+          if(inf_certificate_verify_get_fingerprint(presented_cert,
+                                                    fingerprint,
+                                                    &error))
+          {
+            cert_equal = memcmp(
+              known_host->fingerprint,
+              fingerprint,
+              INF_CERTIFICATE_VERIFY_FINGERPRINT_SIZE
+            ) == 0;
+
+            /* The pinned certificate is handed out with the
+             * check-certificate signal, and it needs to stay valid even if
+             * the known hosts change in the meanwhile. */
+            if(!cert_equal)
+            {
+              known_cert = inf_cert_util_copy_certificate(
+                known_host->certificate,
+                &error
+              );
+            }
+          }
+        }
+      }
     }
     else
     {
-      /* Load the known hosts file so that we can remove the entry belonging
-       * to this host from it, if it's in there. However, it does not really
-       * matter whether opening the file succeeds or not. */
-      table = inf_certificate_verify_ref_known_hosts(verify, NULL);
+      /* Remove the pinned entry if we now have a valid certificate for
+       * this host. It does not really matter whether reading the known
+       * hosts file succeeds or not. */
+      inf_certificate_verify_known_hosts_update(priv->known_hosts, NULL);
+      if(g_hash_table_lookup(priv->known_hosts->hosts, hostname) != NULL)
+      {
+        inf_certificate_verify_known_hosts_set_with_warning(
+          priv->known_hosts,
+          hostname,
+          NULL
+        );
+      }
     }
+
+    G_UNLOCK(inf_certificate_verify_known_hosts_cache);
   }
 
   /* Next, configure the flags for the dialog to be shown based on the
@@ -419,15 +928,9 @@ inf_certificate_verify_certificate_func(InfXmppConnection* connection,
   flags = 0;
   if(error == NULL)
   {
-    if(known_cert != NULL)
+    if(is_pinned)
     {
-      cert_equal = inf_cert_util_compare_fingerprint(
-        known_cert,
-        presented_cert,
-        &error
-      );
-
-      if(error == NULL && cert_equal == FALSE)
+      if(cert_equal == FALSE)
       {
         if(!match_hostname)
           flags |= INF_CERTIFICATE_VERIFY_HOSTNAME_MISMATCH;
@@ -452,30 +955,17 @@ inf_certificate_verify_certificate_func(InfXmppConnection* connection,
   {
     if(flags == 0)
     {
-      if(match_hostname && issuer_known)
-      {
-        /* Remove the pinned entry if we now have a valid certificate for
-         * this host. */
-        if(table != NULL && g_hash_table_remove(table, hostname) == TRUE)
-        {
-          inf_certificate_verify_write_known_hosts_with_warning(
-            verify,
-            table
-          );
-        }
-      }
-
       inf_xmpp_connection_certificate_verify_continue(connection);
     }
     else
     {
       query = g_slice_new(InfCertificateVerifyQuery);
       query->verify = verify;
-      query->known_hosts = table;
+      query->known_certificate = known_cert;
       query->connection = connection;
       query->certificate_chain = chain;
 
-      table = NULL;
+      known_cert = NULL;
 
       g_object_ref(query->connection);
       inf_certificate_chain_ref(chain);
@@ -494,7 +984,7 @@ inf_certificate_verify_certificate_func(InfXmppConnection* connection,
         0,
         connection,
         chain,
-        known_cert,
+        query->known_certificate,
         flags
       );
     }
@@ -505,7 +995,7 @@ inf_certificate_verify_certificate_func(InfXmppConnection* connection,
     g_error_free(error);
   }
 
-  if(table != NULL) g_hash_table_unref(table);
+  if(known_cert != NULL) gnutls_x509_crt_deinit(known_cert);
   g_free(hostname);
 }
 
@@ -537,6 +1027,8 @@ inf_certificate_verify_init(InfCertificateVerify* verify)
 
   priv->xmpp_manager = NULL;
   priv->known_hosts_filename = NULL;
+  priv->known_hosts = NULL;
+  priv->queries = NULL;
 }
 
 static void
@@ -580,6 +1072,7 @@ inf_certificate_verify_finalize(GObject* object)
 
   inf_certificate_verify_set_known_hosts(verify, NULL);
   g_assert(priv->known_hosts_filename == NULL);
+  g_assert(priv->known_hosts == NULL);
 
   G_OBJECT_CLASS(inf_certificate_verify_parent_class)->finalize(object);
 }
@@ -818,7 +1311,8 @@ inf_certificate_verify_checked(InfCertificateVerify* verify,
 
   gchar* hostname;
   gnutls_x509_crt_t cert;
-  gnutls_x509_crt_t known_cert;
+  InfCertificateVerifyKnownHost* known_host;
+  guchar fingerprint[INF_CERTIFICATE_VERIFY_FINGERPRINT_SIZE];
   GError* error;
   gboolean cert_equal;
 
@@ -832,7 +1326,7 @@ inf_certificate_verify_checked(InfCertificateVerify* verify,
 
   g_object_ref(connection);
 
-  if(result == TRUE)
+  if(result == TRUE && priv->known_hosts != NULL)
   {
     g_object_get(
       G_OBJECT(query->connection),
@@ -844,17 +1338,25 @@ inf_certificate_verify_checked(InfCertificateVerify* verify,
      * already, to avoid unnecessary disk I/O. */
     cert =
       inf_certificate_chain_get_own_certificate(query->certificate_chain);
-    known_cert = g_hash_table_lookup(query->known_hosts, hostname);
+
+    G_LOCK(inf_certificate_verify_known_hosts_cache);
+
+    /* Pick up changes made by others while the check was running */
+    inf_certificate_verify_known_hosts_update(priv->known_hosts, NULL);
+    known_host = g_hash_table_lookup(priv->known_hosts->hosts, hostname);
 
     error = NULL;
     cert_equal = FALSE;
-    if(known_cert != NULL)
+    if(inf_certificate_verify_get_fingerprint(cert, fingerprint, &error))
     {
-      cert_equal = inf_cert_util_compare_fingerprint(
-        cert,
-        known_cert,
-        &error
-      );
+      if(known_host != NULL)
+      {
+        cert_equal = memcmp(
+          known_host->fingerprint,
+          fingerprint,
+          INF_CERTIFICATE_VERIFY_FINGERPRINT_SIZE
+        ) == 0;
+      }
     }
 
     if(error != NULL)
@@ -863,21 +1365,20 @@ inf_certificate_verify_checked(InfCertificateVerify* verify,
         _("Failed to add certificate to list of pinned certificates: %s"),
         error->message
       );
+
+      g_error_free(error);
     }
     else if(!cert_equal)
     {
-      cert = inf_cert_util_copy_certificate(cert, &error);
-      g_hash_table_insert(query->known_hosts, hostname, cert);
-
-      inf_certificate_verify_write_known_hosts_with_warning(
-        query->verify,
-        query->known_hosts
+      inf_certificate_verify_known_hosts_set_with_warning(
+        priv->known_hosts,
+        hostname,
+        cert
       );
     }
-    else
-    {
-      g_free(hostname);
-    }
+
+    G_UNLOCK(inf_certificate_verify_known_hosts_cache);
+    g_free(hostname);
   }
 
   priv->queries = g_slist_remove(priv->queries, query);
@@ -27,6 +27,14 @@
  * session per server, and it can be enabled via infd_directory_enable_chat().
  * Clients can subscribe to the chat session via
  * infc_browser_subscribe_chat().
+ *
+ * On synchronization, only the most recent #InfChatSession:sync-history
+ * messages are sent if that property is set. Subscribers can page older
+ * messages with inf_chat_session_fetch_history(), which are served from the
+ * archive file set with inf_chat_session_set_archive_file(), or from the
+ * chat buffer if there is no archive. Archived messages whose author is not
+ * in the session anymore are attributed to an unavailable #InfUser with ID
+ * 0 which is not part of the session's user table.
  **/
 
 #include <libinfinity/common/inf-chat-session.h>
@@ -47,16 +55,51 @@ struct _InfChatSessionLogUserlistForeachData {
   guint users_total;
 };
 
+typedef struct _InfChatSessionArchiveEntry InfChatSessionArchiveEntry;
+struct _InfChatSessionArchiveEntry {
+  gint64 time;
+  long offset;
+};
+
 typedef struct _InfChatSessionPrivate InfChatSessionPrivate;
 struct _InfChatSessionPrivate {
   gchar* log_filename;
   FILE* log_file;
+
+  gchar* archive_filename;
+  FILE* archive_file;
+  /* Time and file offset of every record in the archive, oldest first */
+  GArray* archive_index;
+  /* Offset behind the last complete record in the archive */
+  long archive_end;
+  guint archive_size;
+
+  /* Authors of history messages that are not in the user table, by name.
+   * These are never added to the user table, but kept alive here since
+   * the chat buffer does not hold references on the users of its
+   * messages. */
+  GHashTable* history_users;
+
+  guint sync_history;
+
+  /* Paging position for fetching older messages from the remote side */
+  gboolean history_pending;
+  gboolean history_more;
+  gboolean history_have_cursor;
+  gint64 history_time;
+  guint history_skip;
 };
 
 enum {
   PROP_0,
 
-  PROP_LOG_FILE
+  PROP_LOG_FILE,
+  PROP_ARCHIVE_FILE,
+  PROP_ARCHIVE_SIZE,
+  PROP_SYNC_HISTORY,
+
+  /* read only */
+  PROP_HISTORY_AVAILABLE
 };
 
 enum {
@@ -68,6 +111,18 @@ enum {
 
 #define INF_CHAT_SESSION_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TYPE_CHAT_SESSION, InfChatSessionPrivate))
 
+/* The archive file starts with this magic, followed by the records. Each
+ * record consists of a fixed-size header (8 bytes time, 1 byte message type,
+ * 4 bytes user name length and 4 bytes text length, all big endian),
+ * followed by the user name and the message text. */
+#define INF_CHAT_SESSION_ARCHIVE_MAGIC "infchat1"
+#define INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN 8
+#define INF_CHAT_SESSION_ARCHIVE_HEADER_LEN 17
+
+/* Maximum number of messages sent in reply to a single fetch-history
+ * request, so that a single request cannot make us build huge replies. */
+#define INF_CHAT_SESSION_MAX_HISTORY_FETCH 256
+
 static guint chat_session_signals[LAST_SIGNAL];
 static GQuark inf_chat_session_error_quark;
 
@@ -156,6 +211,57 @@ inf_chat_session_message_type_from_string(const gchar* string,
  * Message XML functions
  */
 
+/* Returns the author of a history message from its name. If there is no
+ * such user in the session, for example because the message was archived
+ * before the server was restarted, then an unavailable user which is not
+ * part of the user table is made up for it. Such users have the ID 0, which
+ * is never assigned to a real user. */
+static InfUser*
+inf_chat_session_lookup_history_user(InfChatSession* session,
+                                     const gchar* name)
+{
+  InfChatSessionPrivate* priv;
+  InfUser* user;
+
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+
+  user = inf_user_table_lookup_user_by_name(
+    inf_session_get_user_table(INF_SESSION(session)),
+    name
+  );
+
+  if(user != NULL)
+    return user;
+
+  if(priv->history_users == NULL)
+  {
+    priv->history_users = g_hash_table_new_full(
+      g_str_hash,
+      g_str_equal,
+      g_free,
+      g_object_unref
+    );
+  }
+
+  user = g_hash_table_lookup(priv->history_users, name);
+  if(user == NULL)
+  {
+    user = INF_USER(
+      g_object_new(
+        INF_TYPE_USER,
+        "id", 0,
+        "name", name,
+        "status", INF_USER_UNAVAILABLE,
+        NULL
+      )
+    );
+
+    g_hash_table_insert(priv->history_users, g_strdup(name), user);
+  }
+
+  return user;
+}
+
 static xmlNodePtr
 inf_chat_session_message_to_xml(InfChatSession* session,
                                 const InfChatBufferMessage* message,
@@ -176,11 +282,25 @@ inf_chat_session_message_to_xml(InfChatSession* session,
   if(for_sync)
     inf_xml_util_set_attribute_long(xml, "time", (long)message->time);
 
-  inf_xml_util_set_attribute_uint(
-    xml,
-    "user",
-    inf_user_get_id(message->user)
-  );
+  /* Authors of archived messages that are not in the session are sent by
+   * name, since the other side does not know them by ID. */
+  if(inf_user_get_id(message->user) == 0)
+  {
+    g_assert(for_sync);
+    inf_xml_util_set_attribute(
+      xml,
+      "user-name",
+      inf_user_get_name(message->user)
+    );
+  }
+  else
+  {
+    inf_xml_util_set_attribute_uint(
+      xml,
+      "user",
+      inf_user_get_id(message->user)
+    );
+  }
 
   if(message->text != NULL)
     inf_xml_util_add_child_text(xml, message->text, message->length);
@@ -201,6 +321,7 @@ inf_chat_session_message_from_xml(InfChatSession* session,
   InfChatBufferMessageFlags message_flags;
   long message_time;
   guint user_id;
+  xmlChar* user_name;
   InfUserTable* user_table;
   InfUser* user;
 
@@ -254,23 +375,42 @@ inf_chat_session_message_from_xml(InfChatSession* session,
     message_time = time(NULL);
   }
 
-  if(!inf_xml_util_get_attribute_uint_required(xml, "user", &user_id, error))
-    return FALSE;
-
-  user_table = inf_session_get_user_table(INF_SESSION(session));
-  user = inf_user_table_lookup_user_by_id(user_table, user_id);
+  user_name = NULL;
+  if(for_sync)
+    user_name = inf_xml_util_get_attribute(xml, "user-name");
 
-  if(user == NULL)
+  if(user_name != NULL)
   {
-    g_set_error(
-      error,
-      inf_chat_session_error_quark,
-      INF_CHAT_SESSION_ERROR_NO_SUCH_USER,
-      _("No such user with ID \"%u\""),
-      user_id
+    user = inf_chat_session_lookup_history_user(
+      session,
+      (const gchar*)user_name
     );
 
-    return FALSE;
+    xmlFree(user_name);
+  }
+  else
+  {
+    if(!inf_xml_util_get_attribute_uint_required(xml, "user", &user_id,
+                                                 error))
+    {
+      return FALSE;
+    }
+
+    user_table = inf_session_get_user_table(INF_SESSION(session));
+    user = inf_user_table_lookup_user_by_id(user_table, user_id);
+
+    if(user == NULL)
+    {
+      g_set_error(
+        error,
+        inf_chat_session_error_quark,
+        INF_CHAT_SESSION_ERROR_NO_SUCH_USER,
+        _("No such user with ID \"%u\""),
+        user_id
+      );
+
+      return FALSE;
+    }
   }
 
   if(message_type != INF_CHAT_BUFFER_MESSAGE_USERJOIN &&
@@ -400,32 +540,634 @@ inf_chat_session_log_userlist(InfChatSession* session)
   time_t cur_time;
   struct tm* tm;
 
-  priv = INF_CHAT_SESSION_PRIVATE(session);
-  if(priv->log_file != NULL)
-  {
-    cur_time = time(NULL);
-    tm = localtime(&cur_time);
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+  if(priv->log_file != NULL)
+  {
+    cur_time = time(NULL);
+    tm = localtime(&cur_time);
+
+    data.time_str = inf_chat_session_strdup_strftime("%c", tm, NULL);
+    data.log_file = priv->log_file;
+    data.users_total = 0;
+
+    inf_user_table_foreach_user(
+      inf_session_get_user_table(INF_SESSION(session)),
+      inf_chat_session_log_userlist_foreach_func,
+      &data
+    );
+
+    fprintf(
+      data.log_file,
+      _("%s --- %u users total\n"),
+      data.time_str,
+      data.users_total
+    );
+
+    g_free(data.time_str);
+    fflush(data.log_file);
+  }
+}
+
+/*
+ * Archive functions
+ */
+
+static void
+inf_chat_session_set_errno_error(GError** error,
+                                 int save_errno)
+{
+  g_set_error_literal(
+    error,
+    G_FILE_ERROR,
+    g_file_error_from_errno(save_errno),
+    strerror(save_errno)
+  );
+}
+
+static void
+inf_chat_session_archive_encode_header(guchar* header,
+                                       gint64 time,
+                                       InfChatBufferMessageType type,
+                                       guint32 name_len,
+                                       guint32 text_len)
+{
+  guint64 be_time;
+  guint32 be_name_len;
+  guint32 be_text_len;
+
+  be_time = GUINT64_TO_BE((guint64)time);
+  be_name_len = GUINT32_TO_BE(name_len);
+  be_text_len = GUINT32_TO_BE(text_len);
+
+  memcpy(header, &be_time, 8);
+  header[8] = (guchar)type;
+  memcpy(header + 9, &be_name_len, 4);
+  memcpy(header + 13, &be_text_len, 4);
+}
+
+static void
+inf_chat_session_archive_decode_header(const guchar* header,
+                                       gint64* time,
+                                       guint* type,
+                                       guint32* name_len,
+                                       guint32* text_len)
+{
+  guint64 be_time;
+  guint32 be_name_len;
+  guint32 be_text_len;
+
+  memcpy(&be_time, header, 8);
+  memcpy(&be_name_len, header + 9, 4);
+  memcpy(&be_text_len, header + 13, 4);
+
+  *time = (gint64)GUINT64_FROM_BE(be_time);
+  *type = header[8];
+  *name_len = GUINT32_FROM_BE(be_name_len);
+  *text_len = GUINT32_FROM_BE(be_text_len);
+}
+
+/* Reads the record offsets of an archive file into index, and stores the
+ * offset behind the last complete record in end. A partially written record
+ * at the end of the file, for example because the server crashed while
+ * writing it, is ignored and overwritten by the next record. */
+static gboolean
+inf_chat_session_archive_scan(FILE* file,
+                              const gchar* filename,
+                              GArray* index,
+                              long* end,
+                              GError** error)
+{
+  gchar magic[INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN];
+  guchar header[INF_CHAT_SESSION_ARCHIVE_HEADER_LEN];
+  InfChatSessionArchiveEntry entry;
+  guint type;
+  guint32 name_len;
+  guint32 text_len;
+  long size;
+  long record_len;
+
+  if(fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) == -1)
+  {
+    inf_chat_session_set_errno_error(error, errno);
+    return FALSE;
+  }
+
+  if(size == 0)
+  {
+    /* This is a new archive */
+    if(fseek(file, 0, SEEK_SET) != 0 ||
+       fwrite(INF_CHAT_SESSION_ARCHIVE_MAGIC, 1,
+              INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN, file) !=
+         INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN ||
+       fflush(file) != 0)
+    {
+      inf_chat_session_set_errno_error(error, errno);
+      return FALSE;
+    }
+
+    *end = INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN;
+    return TRUE;
+  }
+
+  if(fseek(file, 0, SEEK_SET) != 0 ||
+     size < INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN ||
+     fread(magic, 1, INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN, file) !=
+       INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN ||
+     memcmp(magic, INF_CHAT_SESSION_ARCHIVE_MAGIC,
+            INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN) != 0)
+  {
+    g_set_error(
+      error,
+      inf_chat_session_error_quark,
+      INF_CHAT_SESSION_ERROR_ARCHIVE_CORRUPT,
+      _("\"%s\" is not a chat archive"),
+      filename
+    );
+
+    return FALSE;
+  }
+
+  entry.offset = INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN;
+  while(entry.offset + INF_CHAT_SESSION_ARCHIVE_HEADER_LEN <= size)
+  {
+    if(fread(header, 1, INF_CHAT_SESSION_ARCHIVE_HEADER_LEN, file) !=
+       INF_CHAT_SESSION_ARCHIVE_HEADER_LEN)
+    {
+      break;
+    }
+
+    inf_chat_session_archive_decode_header(
+      header,
+      &entry.time,
+      &type,
+      &name_len,
+      &text_len
+    );
+
+    record_len = INF_CHAT_SESSION_ARCHIVE_HEADER_LEN;
+    record_len += (long)name_len + (long)text_len;
+
+    if(type > INF_CHAT_BUFFER_MESSAGE_USERPART ||
+       entry.offset + record_len > size)
+    {
+      break;
+    }
+
+    g_array_append_val(index, entry);
+    entry.offset += record_len;
+
+    if(fseek(file, entry.offset, SEEK_SET) != 0)
+    {
+      inf_chat_session_set_errno_error(error, errno);
+      return FALSE;
+    }
+  }
+
+  if(ferror(file))
+  {
+    inf_chat_session_set_errno_error(error, errno);
+    return FALSE;
+  }
+
+  *end = entry.offset;
+  return TRUE;
+}
+
+/* Drops the older half of the archive when it grew beyond its maximum
+ * size. The file is rewritten atomically, so that the archive stays intact
+ * if this fails. */
+static void
+inf_chat_session_archive_compact(InfChatSession* session)
+{
+  InfChatSessionPrivate* priv;
+  InfChatSessionArchiveEntry* entry;
+  GError* error;
+  gchar* data;
+  guint keep;
+  guint first;
+  long begin;
+  long len;
+  gboolean result;
+  guint i;
+
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+
+  keep = MAX(priv->archive_size / 2, 1);
+  g_assert(priv->archive_index->len > keep);
+  first = priv->archive_index->len - keep;
+
+  begin = g_array_index(
+    priv->archive_index,
+    InfChatSessionArchiveEntry,
+    first
+  ).offset;
+
+  len = priv->archive_end - begin;
+
+  data = g_malloc(INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN + len);
+  memcpy(
+    data,
+    INF_CHAT_SESSION_ARCHIVE_MAGIC,
+    INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN
+  );
+
+  if(fseek(priv->archive_file, begin, SEEK_SET) != 0 ||
+     fread(data + INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN, 1, len,
+           priv->archive_file) != (size_t)len)
+  {
+    g_warning(
+      "Failed to compact chat archive \"%s\": %s\n",
+      priv->archive_filename,
+      strerror(errno)
+    );
+
+    g_free(data);
+    return;
+  }
+
+  /* Close the file while replacing it, which is required on Windows */
+  fclose(priv->archive_file);
+
+  error = NULL;
+  result = g_file_set_contents(
+    priv->archive_filename,
+    data,
+    INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN + len,
+    &error
+  );
+
+  g_free(data);
+
+  if(result == FALSE)
+  {
+    g_warning(
+      "Failed to compact chat archive \"%s\": %s\n",
+      priv->archive_filename,
+      error->message
+    );
+
+    g_error_free(error);
+  }
+
+  priv->archive_file = fopen(priv->archive_filename, "r+b");
+  if(priv->archive_file == NULL)
+  {
+    g_warning(
+      "Failed to reopen chat archive \"%s\": %s\n",
+      priv->archive_filename,
+      strerror(errno)
+    );
+
+    /* Stop archiving */
+    g_free(priv->archive_filename);
+    priv->archive_filename = NULL;
+    g_array_free(priv->archive_index, TRUE);
+    priv->archive_index = NULL;
+    priv->archive_end = 0;
+    return;
+  }
+
+  if(result == TRUE)
+  {
+    g_array_remove_range(priv->archive_index, 0, first);
+    for(i = 0; i < priv->archive_index->len; ++i)
+    {
+      entry = &g_array_index(
+        priv->archive_index,
+        InfChatSessionArchiveEntry,
+        i
+      );
+
+      entry->offset -= begin - INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN;
+    }
+
+    priv->archive_end = INF_CHAT_SESSION_ARCHIVE_MAGIC_LEN + len;
+  }
+}
+
+static void
+inf_chat_session_archive_message(InfChatSession* session,
+                                 const InfChatBufferMessage* message)
+{
+  InfChatSessionPrivate* priv;
+  InfChatSessionArchiveEntry entry;
+  guchar header[INF_CHAT_SESSION_ARCHIVE_HEADER_LEN];
+  const gchar* name;
+  gsize name_len;
+
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+
+  if(priv->archive_file != NULL)
+  {
+    name = inf_user_get_name(message->user);
+    name_len = strlen(name);
+
+    inf_chat_session_archive_encode_header(
+      header,
+      message->time,
+      message->type,
+      name_len,
+      message->length
+    );
+
+    if(fseek(priv->archive_file, priv->archive_end, SEEK_SET) != 0 ||
+       fwrite(header, 1, INF_CHAT_SESSION_ARCHIVE_HEADER_LEN,
+              priv->archive_file) != INF_CHAT_SESSION_ARCHIVE_HEADER_LEN ||
+       fwrite(name, 1, name_len, priv->archive_file) != name_len ||
+       (message->length > 0 &&
+        fwrite(message->text, 1, message->length, priv->archive_file) !=
+          message->length) ||
+       fflush(priv->archive_file) != 0)
+    {
+      g_warning(
+        "Failed to write to chat archive \"%s\": %s\n",
+        priv->archive_filename,
+        strerror(errno)
+      );
+
+      return;
+    }
+
+    entry.time = message->time;
+    entry.offset = priv->archive_end;
+    g_array_append_val(priv->archive_index, entry);
+
+    priv->archive_end += INF_CHAT_SESSION_ARCHIVE_HEADER_LEN;
+    priv->archive_end += name_len + message->length;
+
+    if(priv->archive_size > 0 &&
+       priv->archive_index->len > priv->archive_size)
+    {
+      inf_chat_session_archive_compact(session);
+    }
+  }
+}
+
+/* Reads the n-th record from the archive. Returns FALSE if the record
+ * cannot be read. */
+static gboolean
+inf_chat_session_archive_read_message(InfChatSession* session,
+                                      guint n,
+                                      InfChatBufferMessage* message)
+{
+  InfChatSessionPrivate* priv;
+  InfChatSessionArchiveEntry* entry;
+  guchar header[INF_CHAT_SESSION_ARCHIVE_HEADER_LEN];
+  gint64 time;
+  guint type;
+  guint32 name_len;
+  guint32 text_len;
+  gchar* name;
+  InfUser* user;
+
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+  entry = &g_array_index(priv->archive_index, InfChatSessionArchiveEntry, n);
+
+  if(fseek(priv->archive_file, entry->offset, SEEK_SET) != 0)
+    return FALSE;
+
+  if(fread(header, 1, INF_CHAT_SESSION_ARCHIVE_HEADER_LEN,
+           priv->archive_file) != INF_CHAT_SESSION_ARCHIVE_HEADER_LEN)
+  {
+    return FALSE;
+  }
+
+  inf_chat_session_archive_decode_header(
+    header,
+    &time,
+    &type,
+    &name_len,
+    &text_len
+  );
+
+  name = g_malloc(name_len + 1);
+  if(fread(name, 1, name_len, priv->archive_file) != name_len)
+  {
+    g_free(name);
+    return FALSE;
+  }
+
+  name[name_len] = '\0';
+
+  /* Users are referred to by name in the archive, since user IDs are only
+   * valid within one session, and users are not kept across restarts. */
+  user = inf_chat_session_lookup_history_user(session, name);
+  g_free(name);
+
+  if(type == INF_CHAT_BUFFER_MESSAGE_USERJOIN ||
+     type == INF_CHAT_BUFFER_MESSAGE_USERPART)
+  {
+    message->text = NULL;
+    message->length = 0;
+  }
+  else
+  {
+    message->text = g_malloc(text_len + 1);
+    if(fread(message->text, 1, text_len, priv->archive_file) != text_len)
+    {
+      g_free(message->text);
+      return FALSE;
+    }
+
+    message->text[text_len] = '\0';
+    message->length = text_len;
+  }
+
+  message->type = type;
+  message->user = user;
+  message->time = time;
+  message->flags = INF_CHAT_BUFFER_MESSAGE_BACKLOG;
+  return TRUE;
+}
+
+/*
+ * History paging
+ */
+
+/* History is served from the archive if there is one, and from the chat
+ * buffer otherwise. These functions abstract over the two. */
+static guint
+inf_chat_session_history_get_n_messages(InfChatSession* session)
+{
+  InfChatSessionPrivate* priv;
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+
+  if(priv->archive_index != NULL)
+    return priv->archive_index->len;
+
+  return inf_chat_buffer_get_n_messages(
+    INF_CHAT_BUFFER(inf_session_get_buffer(INF_SESSION(session)))
+  );
+}
+
+static gint64
+inf_chat_session_history_get_time(InfChatSession* session,
+                                  guint n)
+{
+  InfChatSessionPrivate* priv;
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+
+  if(priv->archive_index != NULL)
+  {
+    return g_array_index(
+      priv->archive_index,
+      InfChatSessionArchiveEntry,
+      n
+    ).time;
+  }
+
+  return inf_chat_buffer_get_message(
+    INF_CHAT_BUFFER(inf_session_get_buffer(INF_SESSION(session))),
+    n
+  )->time;
+}
+
+/* Returns the number of history messages with a time less than or equal to
+ * the given time. */
+static guint
+inf_chat_session_history_upper_bound(InfChatSession* session,
+                                     gint64 time)
+{
+  guint begin;
+  guint end;
+  guint n;
+
+  begin = 0;
+  end = inf_chat_session_history_get_n_messages(session);
+
+  while(begin != end)
+  {
+    n = (begin + end) / 2;
+    if(inf_chat_session_history_get_time(session, n) <= time)
+      begin = n + 1;
+    else
+      end = n;
+  }
+
+  return begin;
+}
+
+static gboolean
+inf_chat_session_handle_fetch_history(InfChatSession* session,
+                                      InfXmlConnection* connection,
+                                      xmlNodePtr xml,
+                                      GError** error)
+{
+  InfChatSessionPrivate* priv;
+  InfCommunicationGroup* group;
+  GError* local_error;
+  glong before;
+  gboolean has_time;
+  guint skip;
+  guint count;
+  guint begin;
+  guint end;
+  guint i;
+  InfChatBufferMessage message;
+  const InfChatBufferMessage* buffer_message;
+  xmlNodePtr reply;
+  xmlNodePtr child;
+  gint64 next_time;
+  guint missing;
+
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+  group = inf_session_get_subscription_group(INF_SESSION(session));
+
+  if(group == NULL)
+  {
+    g_set_error_literal(
+      error,
+      inf_chat_session_error_quark,
+      INF_CHAT_SESSION_ERROR_FAILED,
+      _("History can only be requested by subscribed connections")
+    );
+
+    return FALSE;
+  }
+
+  local_error = NULL;
+  has_time =
+    inf_xml_util_get_attribute_long(xml, "time", &before, &local_error);
+  if(local_error != NULL)
+  {
+    g_propagate_error(error, local_error);
+    return FALSE;
+  }
+
+  if(!inf_xml_util_get_attribute_uint_required(xml, "skip", &skip, error))
+    return FALSE;
+  if(!inf_xml_util_get_attribute_uint_required(xml, "count", &count, error))
+    return FALSE;
+
+  count = MIN(count, INF_CHAT_SESSION_MAX_HISTORY_FETCH);
+
+  /* The requester has the newest skip messages up to and including the
+   * given time already, so send the count messages before these. */
+  if(has_time)
+    end = inf_chat_session_history_upper_bound(session, before);
+  else
+    end = inf_chat_session_history_get_n_messages(session);
+
+  end = (end > skip) ? end - skip : 0;
+  begin = (end > count) ? end - count : 0;
+
+  reply = xmlNewNode(NULL, (const xmlChar*)"history");
+  missing = 0;
+
+  for(i = begin; i < end; ++i)
+  {
+    if(priv->archive_index != NULL)
+    {
+      if(!inf_chat_session_archive_read_message(session, i, &message))
+      {
+        g_warning(
+          "Failed to read message %u from chat archive \"%s\"",
+          i,
+          priv->archive_filename
+        );
+
+        ++missing;
+        continue;
+      }
+
+      child = inf_chat_session_message_to_xml(session, &message, TRUE);
+      g_free(message.text);
+    }
+    else
+    {
+      buffer_message = inf_chat_buffer_get_message(
+        INF_CHAT_BUFFER(inf_session_get_buffer(INF_SESSION(session))),
+        i
+      );
+
+      child = inf_chat_session_message_to_xml(session, buffer_message, TRUE);
+    }
 
-    data.time_str = inf_chat_session_strdup_strftime("%c", tm, NULL);
-    data.log_file = priv->log_file;
-    data.users_total = 0;
+    xmlAddChild(reply, child);
+  }
 
-    inf_user_table_foreach_user(
-      inf_session_get_user_table(INF_SESSION(session)),
-      inf_chat_session_log_userlist_foreach_func,
-      &data
+  /* Tell the requester where to continue with the next request, since
+   * messages that we could not send would otherwise not advance its
+   * position. */
+  if(begin < end)
+  {
+    next_time = inf_chat_session_history_get_time(session, begin);
+    inf_xml_util_set_attribute_long(reply, "time", (long)next_time);
+    inf_xml_util_set_attribute_uint(
+      reply,
+      "skip",
+      inf_chat_session_history_upper_bound(session, next_time) - begin
     );
+  }
 
-    fprintf(
-      data.log_file,
-      _("%s --- %u users total\n"),
-      data.time_str,
-      data.users_total
-    );
+  /* Let the requester know that its history has gaps */
+  if(missing > 0)
+    inf_xml_util_set_attribute_uint(reply, "missing", missing);
 
-    g_free(data.time_str);
-    fflush(data.log_file);
-  }
+  inf_xml_util_set_attribute(reply, "more", begin > 0 ? "true" : "false");
+
+  inf_communication_group_send_message(group, connection, reply);
+  return TRUE;
 }
 
 /*
@@ -483,6 +1225,116 @@ inf_chat_session_receive_message(InfChatSession* session,
   return TRUE;
 }
 
+static gboolean
+inf_chat_session_handle_history(InfChatSession* session,
+                                InfXmlConnection* connection,
+                                xmlNodePtr xml,
+                                GError** error)
+{
+  InfChatSessionPrivate* priv;
+  InfChatBufferMessage message;
+  GError* local_error;
+  xmlNodePtr child;
+  xmlChar* more;
+  glong next_time;
+  guint next_skip;
+  guint missing;
+
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+
+  if(!priv->history_pending)
+  {
+    g_set_error_literal(
+      error,
+      inf_chat_session_error_quark,
+      INF_CHAT_SESSION_ERROR_UNEXPECTED_HISTORY,
+      _("Received history messages which were not requested")
+    );
+
+    return FALSE;
+  }
+
+  priv->history_pending = FALSE;
+
+  for(child = xml->children; child != NULL; child = child->next)
+  {
+    if(child->type != XML_ELEMENT_NODE) continue;
+    if(strcmp((const char*)child->name, "message") != 0) continue;
+
+    if(!inf_chat_session_message_from_xml(session, &message, child, TRUE,
+                                          error))
+    {
+      return FALSE;
+    }
+
+    g_signal_emit(
+      session,
+      chat_session_signals[RECEIVE_MESSAGE],
+      0,
+      &message
+    );
+
+    g_free(message.text);
+  }
+
+  local_error = NULL;
+  if(inf_xml_util_get_attribute_long(xml, "time", &next_time, &local_error))
+  {
+    if(!inf_xml_util_get_attribute_uint_required(xml, "skip", &next_skip,
+                                                 error))
+    {
+      return FALSE;
+    }
+
+    priv->history_have_cursor = TRUE;
+    priv->history_time = next_time;
+    priv->history_skip = next_skip;
+  }
+  else if(local_error != NULL)
+  {
+    g_propagate_error(error, local_error);
+    return FALSE;
+  }
+
+  more = inf_xml_util_get_attribute(xml, "more");
+  if(more != NULL && strcmp((const char*)more, "true") == 0)
+    priv->history_more = TRUE;
+  else
+    priv->history_more = FALSE;
+
+  if(more != NULL)
+    xmlFree(more);
+
+  g_object_notify(G_OBJECT(session), "history-available");
+
+  /* The paging position has been advanced past messages that the other
+   * side failed to read, so report them as an error instead of dropping
+   * them silently. */
+  local_error = NULL;
+  if(inf_xml_util_get_attribute_uint(xml, "missing", &missing, &local_error))
+  {
+    if(missing > 0)
+    {
+      g_set_error(
+        error,
+        inf_chat_session_error_quark,
+        INF_CHAT_SESSION_ERROR_ARCHIVE_CORRUPT,
+        _("%u history messages could not be read from the archive"),
+        missing
+      );
+
+      return FALSE;
+    }
+  }
+  else if(local_error != NULL)
+  {
+    g_propagate_error(error, local_error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 static void
 inf_chat_session_user_join(InfChatSession* session,
                            InfUser* user)
@@ -606,6 +1458,21 @@ inf_chat_session_init(InfChatSession* session)
 
   priv->log_filename = NULL;
   priv->log_file = NULL;
+
+  priv->archive_filename = NULL;
+  priv->archive_file = NULL;
+  priv->archive_index = NULL;
+  priv->archive_end = 0;
+  priv->archive_size = 4096;
+  priv->history_users = NULL;
+
+  priv->sync_history = 0;
+
+  priv->history_pending = FALSE;
+  priv->history_more = TRUE;
+  priv->history_have_cursor = FALSE;
+  priv->history_time = 0;
+  priv->history_skip = 0;
 }
 
 static void
@@ -719,6 +1586,10 @@ inf_chat_session_finalize(GObject* object)
   priv = INF_CHAT_SESSION_PRIVATE(session);
 
   inf_chat_session_set_log_file(session, NULL, NULL);
+  inf_chat_session_set_archive_file(session, NULL, NULL);
+
+  if(priv->history_users != NULL)
+    g_hash_table_destroy(priv->history_users);
 
   G_OBJECT_CLASS(inf_chat_session_parent_class)->finalize(object);
 }
@@ -749,6 +1620,24 @@ inf_chat_session_set_property(GObject* object,
       g_error_free(error);
     }
 
+    break;
+  case PROP_ARCHIVE_FILE:
+    error = NULL;
+
+    if(!inf_chat_session_set_archive_file(session,
+                                          g_value_get_string(value),
+                                          &error))
+    {
+      g_warning("Failed to set archive file: %s\n", error->message);
+      g_error_free(error);
+    }
+
+    break;
+  case PROP_ARCHIVE_SIZE:
+    priv->archive_size = g_value_get_uint(value);
+    break;
+  case PROP_SYNC_HISTORY:
+    priv->sync_history = g_value_get_uint(value);
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -773,6 +1662,18 @@ inf_chat_session_get_property(GObject* object,
   case PROP_LOG_FILE:
     g_value_set_string(value, priv->log_filename);
     break;
+  case PROP_ARCHIVE_FILE:
+    g_value_set_string(value, priv->archive_filename);
+    break;
+  case PROP_ARCHIVE_SIZE:
+    g_value_set_uint(value, priv->archive_size);
+    break;
+  case PROP_SYNC_HISTORY:
+    g_value_set_uint(value, priv->sync_history);
+    break;
+  case PROP_HISTORY_AVAILABLE:
+    g_value_set_boolean(value, priv->history_more);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -787,19 +1688,29 @@ static void
 inf_chat_session_to_xml_sync(InfSession* session,
                              xmlNodePtr parent)
 {
+  InfChatSessionPrivate* priv;
   InfChatBuffer* buffer;
   InfSessionClass* parent_class;
   const InfChatBufferMessage* message;
   xmlNodePtr child;
+  guint n_messages;
   guint i;
 
+  priv = INF_CHAT_SESSION_PRIVATE(session);
   buffer = INF_CHAT_BUFFER(inf_session_get_buffer(session));
   parent_class = INF_SESSION_CLASS(inf_chat_session_parent_class);
 
   g_assert(parent_class->to_xml_sync != NULL);
   parent_class->to_xml_sync(session, parent);
 
-  for(i = 0; i < inf_chat_buffer_get_n_messages(buffer); ++i)
+  /* Only synchronize the most recent messages if requested. Older messages
+   * can be fetched with inf_chat_session_fetch_history() on demand. */
+  n_messages = inf_chat_buffer_get_n_messages(buffer);
+  i = 0;
+  if(priv->sync_history > 0 && n_messages > priv->sync_history)
+    i = n_messages - priv->sync_history;
+
+  for(; i < n_messages; ++i)
   {
     message = inf_chat_buffer_get_message(buffer, i);
 
@@ -861,6 +1772,29 @@ inf_chat_session_process_xml_run(InfSession* session,
     else
       return INF_COMMUNICATION_SCOPE_GROUP;
   }
+  else if(strcmp((const char*)xml->name, "fetch-history") == 0)
+  {
+    inf_chat_session_handle_fetch_history(
+      INF_CHAT_SESSION(session),
+      connection,
+      xml,
+      error
+    );
+
+    /* History is only sent to the requesting connection */
+    return INF_COMMUNICATION_SCOPE_PTP;
+  }
+  else if(strcmp((const char*)xml->name, "history") == 0)
+  {
+    inf_chat_session_handle_history(
+      INF_CHAT_SESSION(session),
+      connection,
+      xml,
+      error
+    );
+
+    return INF_COMMUNICATION_SCOPE_PTP;
+  }
   else
   {
     parent_class = INF_SESSION_CLASS(inf_chat_session_parent_class);
@@ -874,10 +1808,40 @@ inf_chat_session_synchronization_complete(InfSession* session,
                                           InfXmlConnection* connection)
 {
   InfSessionClass* parent_class;
+  InfChatSessionPrivate* priv;
+  InfChatBuffer* buffer;
+  const InfChatBufferMessage* message;
+  guint n_messages;
+  guint i;
 
   if(inf_session_get_status(session) == INF_SESSION_SYNCHRONIZING)
+  {
     inf_chat_session_log_userlist(INF_CHAT_SESSION(session));
 
+    /* Remember the position of the oldest synchronized message, to know
+     * where to continue when fetching older messages. If we did not get
+     * any message then there are no older messages either. */
+    priv = INF_CHAT_SESSION_PRIVATE(session);
+    buffer = INF_CHAT_BUFFER(inf_session_get_buffer(session));
+    n_messages = inf_chat_buffer_get_n_messages(buffer);
+
+    if(n_messages > 0)
+    {
+      message = inf_chat_buffer_get_message(buffer, 0);
+      for(i = 1; i < n_messages; ++i)
+        if(inf_chat_buffer_get_message(buffer, i)->time != message->time)
+          break;
+
+      priv->history_have_cursor = TRUE;
+      priv->history_time = message->time;
+      priv->history_skip = i;
+    }
+    else
+    {
+      priv->history_more = FALSE;
+    }
+  }
+
   parent_class = INF_SESSION_CLASS(inf_chat_session_parent_class);
   g_assert(parent_class->synchronization_complete != NULL);
   parent_class->synchronization_complete(session, connection);
@@ -991,11 +1955,15 @@ inf_chat_session_receive_message_handler(InfChatSession* session,
     session
   );
 
-  /* Backlog messages (received during synchronization) are not yet logged.
-   * We will need to parse the last messages in the log first and check
-   * whether they have already been logged. */
-  if(inf_session_get_status(INF_SESSION(session)) == INF_SESSION_RUNNING)
+  /* Backlog messages (received during synchronization or as requested
+   * history) are not yet logged. We will need to parse the last messages in
+   * the log first and check whether they have already been logged. */
+  if(inf_session_get_status(INF_SESSION(session)) == INF_SESSION_RUNNING &&
+     (message->flags & INF_CHAT_BUFFER_MESSAGE_BACKLOG) == 0)
+  {
     inf_chat_session_log_message(session, message);
+    inf_chat_session_archive_message(session, message);
+  }
 }
 
 static void
@@ -1009,6 +1977,7 @@ inf_chat_session_send_message_handler(InfChatSession* session,
   inf_session_send_to_subscriptions(INF_SESSION(session), xml);
 
   inf_chat_session_log_message(session, message);
+  inf_chat_session_archive_message(session, message);
 }
 
 /*
@@ -1060,6 +2029,59 @@ inf_chat_session_class_init(InfChatSessionClass* chat_session_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_ARCHIVE_FILE,
+    g_param_spec_string(
+      "archive-file",
+      "Archive file",
+      "The file into which to archive messages for later history requests",
+      NULL,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_ARCHIVE_SIZE,
+    g_param_spec_uint(
+      "archive-size",
+      "Archive size",
+      "The maximum number of messages kept in the archive, or 0 for no limit",
+      0,
+      G_MAXUINT,
+      4096,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_SYNC_HISTORY,
+    g_param_spec_uint(
+      "sync-history",
+      "Synchronized history",
+      "The maximum number of messages sent on synchronization, or 0 to "
+      "send all messages in the buffer",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_HISTORY_AVAILABLE,
+    g_param_spec_boolean(
+      "history-available",
+      "History available",
+      "Whether older messages can be fetched from the remote side",
+      TRUE,
+      G_PARAM_READABLE
+    )
+  );
+
   /**
    * InfChatSession::receive-message:
    * @session: The #InfChatSession that is receiving a message.
@@ -1273,4 +2295,185 @@ inf_chat_session_set_log_file(InfChatSession* session,
   return TRUE;
 }
 
+/**
+ * inf_chat_session_set_archive_file:
+ * @session: A #InfChatSession.
+ * @archive_file: (type filename) (allow-none): A filename to archive
+ * messages into, or %NULL.
+ * @error: Location to store error information, if any.
+ *
+ * Sets a file into which all messages are appended in a compact binary
+ * format. Other than the log file set with inf_chat_session_set_log_file(),
+ * the archive is used to reply to history requests made with
+ * inf_chat_session_fetch_history(), so that older messages can be paged
+ * from disk instead of being kept in memory or being sent to every
+ * subscriber on synchronization. The file is created if it does not exist.
+ * If a previous archive file was set, then it is closed before opening the
+ * new file.
+ *
+ * When the archive contains more than #InfChatSession:archive-size
+ * messages, the older half of it is dropped.
+ *
+ * Returns: %TRUE if the archive file could be opened, %FALSE otherwise (in
+ * which case @error is set).
+ */
+gboolean
+inf_chat_session_set_archive_file(InfChatSession* session,
+                                  const gchar* archive_file,
+                                  GError** error)
+{
+  InfChatSessionPrivate* priv;
+  FILE* new_file;
+  GArray* new_index;
+  long new_end;
+
+  g_return_val_if_fail(INF_IS_CHAT_SESSION(session), FALSE);
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+
+  /* Open and index the new archive before doing anything else, so that we
+   * keep the current archive if this fails. */
+  new_file = NULL;
+  new_index = NULL;
+  new_end = 0;
+
+  if(archive_file != NULL)
+  {
+    new_file = fopen(archive_file, "r+b");
+    if(new_file == NULL && errno == ENOENT)
+      new_file = fopen(archive_file, "w+b");
+
+    if(new_file == NULL)
+    {
+      inf_chat_session_set_errno_error(error, errno);
+      return FALSE;
+    }
+
+    new_index = g_array_new(FALSE, FALSE, sizeof(InfChatSessionArchiveEntry));
+    if(!inf_chat_session_archive_scan(new_file, archive_file, new_index,
+                                      &new_end, error))
+    {
+      g_array_free(new_index, TRUE);
+      fclose(new_file);
+      return FALSE;
+    }
+  }
+
+  if(priv->archive_file != NULL)
+  {
+    fclose(priv->archive_file);
+    g_array_free(priv->archive_index, TRUE);
+  }
+
+  g_free(priv->archive_filename);
+
+  priv->archive_filename = g_strdup(archive_file);
+  priv->archive_file = new_file;
+  priv->archive_index = new_index;
+  priv->archive_end = new_end;
+
+  return TRUE;
+}
+
+/**
+ * inf_chat_session_fetch_history:
+ * @session: A #InfChatSession.
+ * @connection: The #InfXmlConnection to request the history from.
+ * @count: The maximum number of messages to fetch.
+ *
+ * Requests up to @count messages that are older than all messages received
+ * so far from @connection, which is typically the connection to the server
+ * that @session was synchronized from. This is useful when the server has
+ * been configured to only send the most recent messages on synchronization,
+ * see #InfChatSession:sync-history.
+ *
+ * The messages are added to the session's #InfChatBuffer as backlog
+ * messages and the #InfChatSession::receive-message signal is emitted for
+ * each of them when the reply arrives. Note that the buffer drops messages
+ * that are older than all other messages when it is full.
+ *
+ * Only one request can be in progress at a time. If there is already a
+ * request in progress, or if inf_chat_session_get_history_available()
+ * returns %FALSE, then this function does nothing.
+ */
+void
+inf_chat_session_fetch_history(InfChatSession* session,
+                               InfXmlConnection* connection,
+                               guint count)
+{
+  InfChatSessionPrivate* priv;
+  InfCommunicationGroup* group;
+  InfChatBuffer* buffer;
+  const InfChatBufferMessage* message;
+  guint n_messages;
+  guint skip;
+  xmlNodePtr xml;
+
+  g_return_if_fail(INF_IS_CHAT_SESSION(session));
+  g_return_if_fail(INF_IS_XML_CONNECTION(connection));
+  g_return_if_fail(count > 0);
+
+  priv = INF_CHAT_SESSION_PRIVATE(session);
+  group = inf_session_get_subscription_group(INF_SESSION(session));
+
+  g_return_if_fail(
+    inf_session_get_status(INF_SESSION(session)) == INF_SESSION_RUNNING
+  );
+
+  g_return_if_fail(group != NULL);
+
+  if(priv->history_pending || !priv->history_more)
+    return;
+
+  xml = xmlNewNode(NULL, (const xmlChar*)"fetch-history");
+
+  if(priv->history_have_cursor)
+  {
+    inf_xml_util_set_attribute_long(xml, "time", (long)priv->history_time);
+    inf_xml_util_set_attribute_uint(xml, "skip", priv->history_skip);
+  }
+  else
+  {
+    /* We were not synchronized, so start from the oldest message we have */
+    buffer = INF_CHAT_BUFFER(inf_session_get_buffer(INF_SESSION(session)));
+    n_messages = inf_chat_buffer_get_n_messages(buffer);
+
+    if(n_messages > 0)
+    {
+      message = inf_chat_buffer_get_message(buffer, 0);
+      for(skip = 1; skip < n_messages; ++skip)
+        if(inf_chat_buffer_get_message(buffer, skip)->time != message->time)
+          break;
+
+      inf_xml_util_set_attribute_long(xml, "time", (long)message->time);
+      inf_xml_util_set_attribute_uint(xml, "skip", skip);
+    }
+    else
+    {
+      inf_xml_util_set_attribute_uint(xml, "skip", 0);
+    }
+  }
+
+  inf_xml_util_set_attribute_uint(xml, "count", count);
+
+  priv->history_pending = TRUE;
+  inf_communication_group_send_message(group, connection, xml);
+}
+
+/**
+ * inf_chat_session_get_history_available:
+ * @session: A #InfChatSession.
+ *
+ * Returns whether there might be messages older than the ones received so
+ * far which can be requested with inf_chat_session_fetch_history().
+ *
+ * Returns: %FALSE if the remote side has indicated that there are no older
+ * messages, or %TRUE otherwise.
+ */
+gboolean
+inf_chat_session_get_history_available(InfChatSession* session)
+{
+  g_return_val_if_fail(INF_IS_CHAT_SESSION(session), FALSE);
+  return INF_CHAT_SESSION_PRIVATE(session)->history_more;
+}
+
 /* vim:set et sw=2 ts=2: */
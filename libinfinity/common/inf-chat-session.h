@@ -42,6 +42,10 @@ typedef struct _InfChatSessionClass InfChatSessionClass;
  * @INF_CHAT_SESSION_ERROR_TYPE_INVALID: An invalid message type was sent.
  * @INF_CHAT_SESSION_ERROR_NO_SUCH_USER: A message referred to a nonexisting
  * user.
+ * @INF_CHAT_SESSION_ERROR_UNEXPECTED_HISTORY: History messages were received
+ * without having been requested with inf_chat_session_fetch_history().
+ * @INF_CHAT_SESSION_ERROR_ARCHIVE_CORRUPT: The chat archive file is not a
+ * valid archive, or messages requested from it could not be read.
  * @INF_CHAT_SESSION_ERROR_FAILED: Generic error code when no further reason
  * of failure is known.
  *
@@ -51,6 +55,8 @@ typedef struct _InfChatSessionClass InfChatSessionClass;
 typedef enum _InfChatSessionError {
   INF_CHAT_SESSION_ERROR_TYPE_INVALID,
   INF_CHAT_SESSION_ERROR_NO_SUCH_USER,
+  INF_CHAT_SESSION_ERROR_UNEXPECTED_HISTORY,
+  INF_CHAT_SESSION_ERROR_ARCHIVE_CORRUPT,
 
   INF_CHAT_SESSION_ERROR_FAILED
 } InfChatSessionError;
@@ -101,6 +107,19 @@ inf_chat_session_set_log_file(InfChatSession* session,
                               const gchar* log_file,
                               GError** error);
 
+gboolean
+inf_chat_session_set_archive_file(InfChatSession* session,
+                                  const gchar* archive_file,
+                                  GError** error);
+
+void
+inf_chat_session_fetch_history(InfChatSession* session,
+                               InfXmlConnection* connection,
+                               guint count);
+
+gboolean
+inf_chat_session_get_history_available(InfChatSession* session);
+
 G_END_DECLS
 
 #endif /* __INF_CHAT_SESSION_H__ */
@@ -0,0 +1,48 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_NAME_RESOLVER_PRIVATE_H__
+#define __INF_NAME_RESOLVER_PRIVATE_H__
+
+#include <libinfinity/common/inf-ip-address.h>
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void
+_inf_name_resolver_reset_cache(guint ttl,
+                               guint size);
+
+void
+_inf_name_resolver_add_to_cache(const gchar* hostname,
+                                const gchar* service,
+                                const gchar* srv,
+                                const InfIpAddress* const* addresses,
+                                const guint* ports,
+                                guint n_addresses,
+                                const gchar* const* backup_targets,
+                                guint backup_port,
+                                guint n_backup_targets);
+
+G_END_DECLS
+
+#endif /* __INF_NAME_RESOLVER_PRIVATE_H__ */
+
+/* vim:set et sw=2 ts=2: */
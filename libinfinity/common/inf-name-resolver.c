@@ -34,9 +34,18 @@
  *
  * There can at most be one hostname lookup at a time. If you need more than
  * one concurrent hostname lookup, use multiple #InfNameResolver objects.
+ *
+ * Successful lookups are cached process-wide, so that many resolvers looking
+ * up the same hostname, for example when reconnecting a large number of
+ * connections to the same server, only query DNS once. Cached results are
+ * kept for at most one minute, or for the TTL of the SRV records if that is
+ * shorter, since getaddrinfo() does not report the TTL of address records.
+ * A lookup answered from the cache still emits #InfNameResolver::resolved
+ * asynchronously.
  **/
 
 #include <libinfinity/common/inf-name-resolver.h>
+#include <libinfinity/common/inf-name-resolver-private.h>
 #include <libinfinity/common/inf-async-operation.h>
 #include <libinfinity/inf-i18n.h>
 
@@ -78,6 +87,7 @@ struct _InfNameResolverSRV {
   guint priority;
   guint weight;
   guint port;
+  guint ttl;
   gchar* address;
 };
 
@@ -92,9 +102,18 @@ struct _InfNameResolverResult {
   InfNameResolverSRV* srvs;
   guint n_srvs;
 
+  /* How long the result can be cached, in seconds */
+  guint ttl;
+
   GError* error;
 };
 
+typedef struct _InfNameResolverCacheItem InfNameResolverCacheItem;
+struct _InfNameResolverCacheItem {
+  InfNameResolverResult result;
+  gint64 expires;
+};
+
 typedef struct _InfNameResolverPrivate InfNameResolverPrivate;
 struct _InfNameResolverPrivate {
   InfIo* io;
@@ -103,6 +122,7 @@ struct _InfNameResolverPrivate {
   gchar* srv;
 
   InfAsyncOperation* operation;
+  InfIoDispatch* dispatch;
 
   /* Output */
   InfNameResolverResult result;
@@ -127,6 +147,19 @@ enum {
 
 static guint name_resolver_signals[LAST_SIGNAL];
 
+/* Maximum time in seconds for which a lookup result is cached */
+static const guint INF_NAME_RESOLVER_CACHE_TTL = 60;
+/* Maximum number of hostnames in the cache */
+static const guint INF_NAME_RESOLVER_CACHE_SIZE = 256;
+
+/* Shared by all resolvers, which might run in different threads. The mutex
+ * protects the table as well as the limits, which can only be changed by
+ * tests, see _inf_name_resolver_set_cache_limits(). */
+static GMutex inf_name_resolver_cache_mutex;
+static GHashTable* inf_name_resolver_cache;
+static guint inf_name_resolver_cache_ttl = INF_NAME_RESOLVER_CACHE_TTL;
+static guint inf_name_resolver_cache_size = INF_NAME_RESOLVER_CACHE_SIZE;
+
 G_DEFINE_TYPE_WITH_CODE(InfNameResolver, inf_name_resolver, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfNameResolver))
 
@@ -137,9 +170,37 @@ inf_name_resolver_result_nullify(InfNameResolverResult* result)
   result->n_entries = 0;
   result->srvs = NULL;
   result->n_srvs = 0;
+  result->ttl = 0;
   result->error = NULL;
 }
 
+/* Copies the entries and SRV records, but not the error */
+static void
+inf_name_resolver_result_copy(InfNameResolverResult* dest,
+                              const InfNameResolverResult* src)
+{
+  guint i;
+
+  dest->entries = g_new(InfNameResolverEntry, src->n_entries);
+  dest->n_entries = src->n_entries;
+  for(i = 0; i < src->n_entries; ++i)
+  {
+    dest->entries[i].address = inf_ip_address_copy(src->entries[i].address);
+    dest->entries[i].port = src->entries[i].port;
+  }
+
+  dest->srvs = g_new(InfNameResolverSRV, src->n_srvs);
+  dest->n_srvs = src->n_srvs;
+  for(i = 0; i < src->n_srvs; ++i)
+  {
+    dest->srvs[i] = src->srvs[i];
+    dest->srvs[i].address = g_strdup(src->srvs[i].address);
+  }
+
+  dest->ttl = src->ttl;
+  dest->error = NULL;
+}
+
 static void
 inf_name_resolver_result_cleanup(InfNameResolverResult* result)
 {
@@ -168,6 +229,137 @@ inf_name_resolver_result_free(gpointer result_ptr)
   g_slice_free(InfNameResolverResult, result);
 }
 
+static void
+inf_name_resolver_cache_item_free(gpointer item_ptr)
+{
+  InfNameResolverCacheItem* item;
+
+  item = (InfNameResolverCacheItem*)item_ptr;
+
+  inf_name_resolver_result_cleanup(&item->result);
+  g_slice_free(InfNameResolverCacheItem, item);
+}
+
+static gchar*
+inf_name_resolver_cache_key(const gchar* hostname,
+                            const gchar* service,
+                            const gchar* srv)
+{
+  /* Newlines cannot occur in hostnames or service names */
+  return g_strdup_printf(
+    "%s\n%s\n%s",
+    hostname != NULL ? hostname : "",
+    service != NULL ? service : "",
+    srv != NULL ? srv : ""
+  );
+}
+
+static guint
+inf_name_resolver_cache_get_ttl(void)
+{
+  guint ttl;
+
+  g_mutex_lock(&inf_name_resolver_cache_mutex);
+  ttl = inf_name_resolver_cache_ttl;
+  g_mutex_unlock(&inf_name_resolver_cache_mutex);
+
+  return ttl;
+}
+
+static gboolean
+inf_name_resolver_cache_lookup(InfNameResolverPrivate* priv,
+                               InfNameResolverResult* result)
+{
+  InfNameResolverCacheItem* item;
+  gchar* key;
+  gboolean found;
+
+  key = inf_name_resolver_cache_key(priv->hostname, priv->service, priv->srv);
+  found = FALSE;
+
+  g_mutex_lock(&inf_name_resolver_cache_mutex);
+
+  if(inf_name_resolver_cache != NULL)
+  {
+    item = g_hash_table_lookup(inf_name_resolver_cache, key);
+    if(item != NULL)
+    {
+      if(item->expires > g_get_monotonic_time())
+      {
+        inf_name_resolver_result_copy(result, &item->result);
+        found = TRUE;
+      }
+      else
+      {
+        g_hash_table_remove(inf_name_resolver_cache, key);
+      }
+    }
+  }
+
+  g_mutex_unlock(&inf_name_resolver_cache_mutex);
+
+  g_free(key);
+  return found;
+}
+
+static void
+inf_name_resolver_cache_insert(const gchar* hostname,
+                               const gchar* service,
+                               const gchar* srv,
+                               const InfNameResolverResult* result)
+{
+  InfNameResolverCacheItem* item;
+  GHashTableIter iter;
+  gpointer value;
+  gint64 now;
+
+  if(result->ttl == 0 || result->n_entries == 0 || result->error != NULL)
+    return;
+
+  now = g_get_monotonic_time();
+  g_mutex_lock(&inf_name_resolver_cache_mutex);
+
+  if(inf_name_resolver_cache == NULL)
+  {
+    inf_name_resolver_cache = g_hash_table_new_full(
+      g_str_hash,
+      g_str_equal,
+      g_free,
+      inf_name_resolver_cache_item_free
+    );
+  }
+
+  /* Make room by dropping expired results. If that is not enough, then
+   * don't cache the new result. */
+  if(g_hash_table_size(inf_name_resolver_cache) >=
+     inf_name_resolver_cache_size)
+  {
+    g_hash_table_iter_init(&iter, inf_name_resolver_cache);
+    while(g_hash_table_iter_next(&iter, NULL, &value))
+    {
+      item = (InfNameResolverCacheItem*)value;
+      if(item->expires <= now)
+        g_hash_table_iter_remove(&iter);
+    }
+  }
+
+  if(g_hash_table_size(inf_name_resolver_cache) <
+     inf_name_resolver_cache_size)
+  {
+    item = g_slice_new(InfNameResolverCacheItem);
+    inf_name_resolver_result_copy(&item->result, result);
+    item->expires = now + (gint64)result->ttl * G_USEC_PER_SEC;
+
+    g_hash_table_replace(
+      inf_name_resolver_cache,
+      inf_name_resolver_cache_key(hostname, service, srv),
+      item
+    );
+  }
+
+  g_mutex_unlock(&inf_name_resolver_cache_mutex);
+}
+
 /* Worker thread */
 
 #ifndef G_OS_WIN32
@@ -323,6 +515,7 @@ inf_name_resolver_parse_srv_record(const char* msg,
   srv->priority = prio;
   srv->weight = weight;
   srv->port = port;
+  srv->ttl = ttl;
   srv->address = g_strdup(buf);
   return cur;
 }
@@ -448,6 +641,7 @@ inf_name_resolver_lookup_srv(const gchar* query,
     srv.priority = item->Data.SRV.wPriority;
     srv.weight = item->Data.SRV.wWeight;
     srv.port = item->Data.SRV.wPort;
+    srv.ttl = item->dwTtl;
     srv.address = g_strdup(item->Data.SRV.pNameTarget); // TODO: utf16_to_utf8?
     g_array_append_val(array, srv);
   }
@@ -564,6 +758,56 @@ inf_name_resolver_lookup_srv(const gchar* query,
 #endif
 }
 
+/* Reorders the addresses so that IPv4 and IPv6 addresses alternate, keeping
+ * the preference of getaddrinfo() within each family. This way, a client
+ * racing connection attempts to the addresses in turn quickly tries the
+ * other family if one of them is broken, see RFC 8305. */
+static void
+inf_name_resolver_interleave_families(GArray* array)
+{
+  GArray* families[2];
+  InfNameResolverEntry* entry;
+  guint first;
+  guint i;
+  guint j;
+  guint k;
+
+  if(array->len < 3) return;
+
+  families[0] = g_array_new(FALSE, FALSE, sizeof(InfNameResolverEntry));
+  families[1] = g_array_new(FALSE, FALSE, sizeof(InfNameResolverEntry));
+
+  first = inf_ip_address_get_family(
+    g_array_index(array, InfNameResolverEntry, 0).address
+  );
+
+  for(i = 0; i < array->len; ++i)
+  {
+    entry = &g_array_index(array, InfNameResolverEntry, i);
+    if(inf_ip_address_get_family(entry->address) == first)
+      g_array_append_val(families[0], *entry);
+    else
+      g_array_append_val(families[1], *entry);
+  }
+
+  for(i = 0, j = 0, k = 0; i < array->len; ++i)
+  {
+    if(k >= families[1]->len || (j < families[0]->len && i % 2 == 0))
+    {
+      g_array_index(array, InfNameResolverEntry, i) =
+        g_array_index(families[0], InfNameResolverEntry, j++);
+    }
+    else
+    {
+      g_array_index(array, InfNameResolverEntry, i) =
+        g_array_index(families[1], InfNameResolverEntry, k++);
+    }
+  }
+
+  g_array_free(families[0], TRUE);
+  g_array_free(families[1], TRUE);
+}
+
 static InfNameResolverEntry*
 inf_name_resolver_lookup_a_aaaa(const gchar* hostname,
                                 const gchar* service,
@@ -638,6 +882,7 @@ inf_name_resolver_lookup_a_aaaa(const gchar* hostname,
     }
 
     freeaddrinfo(res);
+    inf_name_resolver_interleave_families(array);
 
     *n_entries = array->len;
     return (InfNameResolverEntry*)g_array_free(array, FALSE);
@@ -717,11 +962,13 @@ inf_name_resolver_resolve(const gchar* hostname,
   InfNameResolverResult* result;
   gchar* query;
   GError* error;
+  guint i;
 
   error = NULL;
 
   result = g_slice_new(InfNameResolverResult);
   inf_name_resolver_result_nullify(result);
+  result->ttl = inf_name_resolver_cache_get_ttl();
 
   /* Look up a SRV record */
   if(srv != NULL)
@@ -749,6 +996,9 @@ inf_name_resolver_resolve(const gchar* hostname,
     }
     else if(result->n_srvs > 0)
     {
+      for(i = 0; i < result->n_srvs; ++i)
+        result->ttl = MIN(result->ttl, result->srvs[i].ttl);
+
       result->entries = inf_name_resolver_resolve_srv(
         &result->srvs,
         &result->n_srvs,
@@ -831,6 +1081,7 @@ inf_name_resolver_backup_run_func(gpointer* run_data,
 
   g_assert(result->n_srvs > 0);
 
+  result->ttl = 0;
   result->error = NULL;
 
   result->entries = inf_name_resolver_resolve_srv(
@@ -872,6 +1123,32 @@ inf_name_resolver_done_func(gpointer run_data,
   /* Nullify this so that the destroy notify lets the data alive */
   inf_name_resolver_result_nullify(result);
 
+  inf_name_resolver_cache_insert(
+    priv->hostname,
+    priv->service,
+    priv->srv,
+    &priv->result
+  );
+
+  g_signal_emit(
+    G_OBJECT(resolver),
+    name_resolver_signals[RESOLVED],
+    0,
+    priv->result.error
+  );
+}
+
+static void
+inf_name_resolver_cached_func(gpointer user_data)
+{
+  InfNameResolver* resolver;
+  InfNameResolverPrivate* priv;
+
+  resolver = INF_NAME_RESOLVER(user_data);
+  priv = INF_NAME_RESOLVER_PRIVATE(resolver);
+
+  priv->dispatch = NULL;
+
   g_signal_emit(
     G_OBJECT(resolver),
     name_resolver_signals[RESOLVED],
@@ -940,6 +1217,7 @@ inf_name_resolver_init(InfNameResolver* resolver)
   priv->srv = NULL;
 
   priv->operation = NULL;
+  priv->dispatch = NULL;
 
   inf_name_resolver_result_nullify(&priv->result);
 }
@@ -959,6 +1237,12 @@ inf_name_resolver_dispose(GObject* object)
     priv->operation = NULL;
   }
 
+  if(priv->dispatch != NULL)
+  {
+    inf_io_remove_dispatch(priv->io, priv->dispatch);
+    priv->dispatch = NULL;
+  }
+
   if(priv->io != NULL)
   {
     g_object_unref(G_OBJECT(priv->io));
@@ -1268,10 +1552,23 @@ inf_name_resolver_start(InfNameResolver* resolver,
 
   priv = INF_NAME_RESOLVER_PRIVATE(resolver);
   g_return_val_if_fail(priv->operation == NULL, FALSE);
+  g_return_val_if_fail(priv->dispatch == NULL, FALSE);
 
   inf_name_resolver_result_cleanup(&priv->result);
   inf_name_resolver_result_nullify(&priv->result);
 
+  if(inf_name_resolver_cache_lookup(priv, &priv->result))
+  {
+    priv->dispatch = inf_io_add_dispatch(
+      priv->io,
+      inf_name_resolver_cached_func,
+      resolver,
+      NULL
+    );
+
+    return TRUE;
+  }
+
   priv->operation = inf_async_operation_new(
     priv->io,
     inf_name_resolver_run_func,
@@ -1320,6 +1617,7 @@ inf_name_resolver_lookup_backup(InfNameResolver* resolver,
 
   priv = INF_NAME_RESOLVER_PRIVATE(resolver);
   g_return_val_if_fail(priv->operation == NULL, FALSE);
+  g_return_val_if_fail(priv->dispatch == NULL, FALSE);
 
   if(priv->result.n_srvs == 0)
     return FALSE;
@@ -1369,7 +1667,7 @@ inf_name_resolver_finished(InfNameResolver* resolver)
 
   priv = INF_NAME_RESOLVER_PRIVATE(resolver);
 
-  if(priv->operation != NULL)
+  if(priv->operation != NULL || priv->dispatch != NULL)
     return FALSE;
 
   return TRUE;
@@ -1443,4 +1741,67 @@ inf_name_resolver_get_port(InfNameResolver* resolver,
   return priv->result.entries[index].port;
 }
 
+/* Used by the tests to control the cache without waiting for its limits to
+ * be reached. Clears the cache and sets its limits, with the TTL given in
+ * seconds. */
+void
+_inf_name_resolver_reset_cache(guint ttl,
+                               guint size)
+{
+  g_mutex_lock(&inf_name_resolver_cache_mutex);
+
+  inf_name_resolver_cache_ttl = ttl;
+  inf_name_resolver_cache_size = size;
+
+  if(inf_name_resolver_cache != NULL)
+    g_hash_table_remove_all(inf_name_resolver_cache);
+
+  g_mutex_unlock(&inf_name_resolver_cache_mutex);
+}
+
+/* Used by the tests to make a lookup resolve to the given addresses, with
+ * the given SRV targets available as backup. The entry is subject to the
+ * same limits as the result of an actual lookup, so it might not be added
+ * if the cache is full. */
+void
+_inf_name_resolver_add_to_cache(const gchar* hostname,
+                                const gchar* service,
+                                const gchar* srv,
+                                const InfIpAddress* const* addresses,
+                                const guint* ports,
+                                guint n_addresses,
+                                const gchar* const* backup_targets,
+                                guint backup_port,
+                                guint n_backup_targets)
+{
+  InfNameResolverResult result;
+  guint i;
+
+  result.entries = g_new(InfNameResolverEntry, n_addresses);
+  result.n_entries = n_addresses;
+  for(i = 0; i < n_addresses; ++i)
+  {
+    result.entries[i].address = inf_ip_address_copy(addresses[i]);
+    result.entries[i].port = ports[i];
+  }
+
+  result.ttl = inf_name_resolver_cache_get_ttl();
+
+  result.srvs = g_new(InfNameResolverSRV, n_backup_targets);
+  result.n_srvs = n_backup_targets;
+  for(i = 0; i < n_backup_targets; ++i)
+  {
+    result.srvs[i].priority = 0;
+    result.srvs[i].weight = 0;
+    result.srvs[i].port = backup_port;
+    result.srvs[i].ttl = result.ttl;
+    result.srvs[i].address = g_strdup(backup_targets[i]);
+  }
+
+  result.error = NULL;
+
+  inf_name_resolver_cache_insert(hostname, service, srv, &result);
+  inf_name_resolver_result_cleanup(&result);
+}
+
 /* vim:set et sw=2 ts=2: */
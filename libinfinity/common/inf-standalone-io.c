@@ -28,7 +28,10 @@
  * #InfStandaloneIo is a simple implementation of the #InfIo interface. It
  * implements a basic application event loop with support for listening on
  * sockets, scheduling timeouts and inter-thread notifications. The class
- * is fully thread-safe.
+ * is fully thread-safe. Dispatches added with inf_io_add_dispatch() do not
+ * contend on the lock protecting watches and timeouts; they are kept in a
+ * queue with a lock of its own, and run in batches by the thread running
+ * the loop.
  *
  * This class can be perfectly used for all functions in libinfinity that
  * require a #InfIo object to wait for events. If, on top of that more
@@ -49,7 +52,11 @@
 #else
 # include <poll.h>
 # include <errno.h>
+# include <fcntl.h>
 # include <unistd.h>
+# ifdef __linux__
+#  include <sys/eventfd.h>
+# endif
 #endif /* !G_OS_WIN32 */
 
 #include <string.h>
@@ -118,9 +125,19 @@ struct _InfStandaloneIoPrivate {
   InfIoWatch** watches;
 
   GList* timeouts;
-  GList* dispatchs;
+
+  /* Dispatches that have not yet been run, in the order they were added,
+   * and a map from each of them to its link in the queue. These are
+   * protected by dispatch_mutex instead of mutex. A dispatch is only freed
+   * after it has been taken out of both with dispatch_mutex held, so that
+   * removing a dispatch which is being run concurrently finds nothing
+   * instead of touching freed memory. */
+  GMutex dispatch_mutex;
+  GQueue dispatch_queue;
+  GHashTable* dispatch_links;
 
 #ifndef G_OS_WIN32
+  /* On Linux, both ends refer to the same eventfd */
   int wakeup_pipe[2];
 #endif
 
@@ -168,6 +185,155 @@ inf_standalone_io_timeval_diff(GTimeVal* first,
          (first->tv_usec+500)/1000 - (second->tv_usec+500)/1000;
 }
 
+/* Takes the oldest dispatch off the dispatch queue, or returns NULL if
+ * there is none. The dispatch cannot be removed anymore afterwards. */
+static InfIoDispatch*
+inf_standalone_io_dispatch_queue_pop(InfStandaloneIoPrivate* priv)
+{
+  InfIoDispatch* dispatch;
+
+  g_mutex_lock(&priv->dispatch_mutex);
+
+  dispatch = g_queue_pop_head(&priv->dispatch_queue);
+  if(dispatch != NULL)
+    g_hash_table_remove(priv->dispatch_links, dispatch);
+
+  g_mutex_unlock(&priv->dispatch_mutex);
+  return dispatch;
+}
+
+/* Returns the number of dispatches which have not yet been run */
+static guint
+inf_standalone_io_dispatch_queue_length(InfStandaloneIoPrivate* priv)
+{
+  guint length;
+
+  g_mutex_lock(&priv->dispatch_mutex);
+  length = g_queue_get_length(&priv->dispatch_queue);
+  g_mutex_unlock(&priv->dispatch_mutex);
+
+  return length;
+}
+
+/* Signals the wakeup event, so that a poll in progress returns. Unlike
+ * inf_standalone_io_wakeup() this does not require the mutex. */
+static void
+inf_standalone_io_wakeup_signal(InfStandaloneIoPrivate* priv)
+{
+#ifdef G_OS_WIN32
+  gchar* error_message;
+#else
+# ifdef __linux__
+  guint64 value;
+# else
+  char c;
+# endif
+  ssize_t ret;
+#endif
+
+#ifdef G_OS_WIN32
+  if(WSASetEvent(priv->events[0]) == FALSE)
+  {
+    error_message = g_win32_error_message(WSAGetLastError());
+
+    g_warning(
+      "WSASetEvent() failed when attempting to wake up the main loop: %s",
+      error_message
+    );
+
+    g_free(error_message);
+  }
+#else
+# ifdef __linux__
+  value = 1;
+  ret = write(priv->wakeup_pipe[1], &value, sizeof(value));
+# else
+  c = 'c';
+  ret = write(priv->wakeup_pipe[1], &c, 1);
+# endif
+
+  /* If the pipe is full, then the main loop is going to wake up anyway */
+  if(ret == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+  {
+    g_warning(
+      "write() failed when attempting to wake up the main loop: %s",
+      strerror(errno)
+    );
+
+    /* TODO: Is there anything we could do here?
+     * Try to re-establish pipe? */
+  }
+#endif
+}
+
+#ifndef G_OS_WIN32
+/* Consumes all pending wakeup calls, so that the next poll blocks again */
+static void
+inf_standalone_io_wakeup_drain(InfStandaloneIoPrivate* priv)
+{
+#ifdef __linux__
+  guint64 buf;
+#else
+  char buf[64];
+#endif
+  ssize_t ret;
+
+  do
+  {
+    ret = read(priv->wakeup_pipe[0], &buf, sizeof(buf));
+  } while(ret == sizeof(buf) || (ret == -1 && errno == EINTR));
+
+  if(ret == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+  {
+    g_warning("read() on wakeup pipe failed: %s", strerror(errno));
+    /* TODO: Is there anything we could do here?
+     * Try to re-establish pipe? */
+  }
+  else if(ret == 0)
+  {
+    g_warning("Wakeup pipe received EOF");
+    /* TODO: Is there anything we could do here?
+     * Try to re-establish pipe? */
+  }
+}
+#endif
+
+/* Runs all dispatches which are queued, without holding the mutex.
+ * Dispatches that are added while running the batch are run in the next
+ * iteration, so that they do not starve watches and timeouts. */
+static void
+inf_standalone_io_run_dispatches(InfStandaloneIo* io)
+{
+  InfStandaloneIoPrivate* priv;
+  InfIoDispatch* dispatch;
+  guint count;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  count = inf_standalone_io_dispatch_queue_length(priv);
+  if(count == 0)
+    return;
+
+  g_mutex_unlock(&priv->mutex);
+
+  /* Dispatches are taken off the queue one by one, so that the ones later
+   * in the batch can still be removed while earlier ones are running. */
+  for(; count > 0; --count)
+  {
+    dispatch = inf_standalone_io_dispatch_queue_pop(priv);
+    if(dispatch == NULL)
+      break;
+
+    dispatch->func(dispatch->user_data);
+    if(dispatch->notify)
+      dispatch->notify(dispatch->user_data);
+
+    g_slice_free(InfIoDispatch, dispatch);
+  }
+
+  g_mutex_lock(&priv->mutex);
+}
+
 /* Run one iteration of the main loop. Call this only with the mutex locked
  * and a local reference added to io. */
 static void
@@ -183,22 +349,18 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
   GTimeVal current;
   InfIoWatch* watch;
   InfIoTimeout* cur_timeout;
-  InfIoDispatch* dispatch;
   guint elapsed;
 
 #ifdef G_OS_WIN32
   gchar* error_message;
   WSANETWORKEVENTS wsa_events;
   const InfStandaloneIoEventTableEntry* entry;
-#else
-  ssize_t ret;
-  char buf[1];
 #endif
 
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
   /* Find number of milliseconds to wait */
-  if(priv->dispatchs != NULL)
+  if(inf_standalone_io_dispatch_queue_length(priv) > 0)
   {
     /* TODO: Don't even poll */
     timeout = 0;
@@ -377,28 +539,7 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
             }
             else
             {
-              ret = read(priv->events[0].fd, &buf, 1);
-              if(ret == -1)
-              {
-                g_warning(
-                  "read() on wakeup pipe failed: %s",
-                  strerror(errno)
-                );
-
-                /* TODO: Is there anything we could do here?
-                 * Try to re-establish pipe? */
-              }
-              else if(ret == 0)
-              {
-                g_warning("Wakeup pipe received EOF");
-                /* TODO: Is there anything we could do here?
-                 * Try to re-establish pipe? */
-              }
-              else
-              {
-                /* this is what we send as wakeup call */
-                g_assert(buf[0] == 'c');
-              }
+              inf_standalone_io_wakeup_drain(priv);
             }
           }
           else
@@ -430,20 +571,8 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
   }
 #endif
 
-  /* neither timeout nor IO fired, so try a dispatched message */
-  if(priv->dispatchs != NULL)
-  {
-    dispatch = (InfIoDispatch*)priv->dispatchs->data;
-    priv->dispatchs = g_list_delete_link(priv->dispatchs, priv->dispatchs);
-    g_mutex_unlock(&priv->mutex);
-
-    dispatch->func(dispatch->user_data);
-    if(dispatch->notify)
-      dispatch->notify(dispatch->user_data);
-    g_slice_free(InfIoDispatch, dispatch);
-
-    g_mutex_lock(&priv->mutex);
-  }
+  /* neither timeout nor IO fired, so run the dispatched messages */
+  inf_standalone_io_run_dispatches(io);
 }
 
 static void
@@ -458,6 +587,7 @@ inf_standalone_io_init(InfStandaloneIo* io)
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
   g_mutex_init(&priv->mutex);
+  g_mutex_init(&priv->dispatch_mutex);
 
   priv->fd_size = 0;
   priv->fd_alloc = 4;
@@ -477,8 +607,27 @@ inf_standalone_io_init(InfStandaloneIo* io)
   {
     ++priv->fd_size;
   }
+#elif defined(__linux__)
+  priv->wakeup_pipe[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(priv->wakeup_pipe[0] == -1)
+  {
+    g_error("Failed to create wakeup eventfd: %s", strerror(errno));
+  }
+  else
+  {
+    priv->wakeup_pipe[1] = priv->wakeup_pipe[0];
+
+    priv->events[0].fd = priv->wakeup_pipe[0];
+    priv->events[0].events = POLLIN | POLLERR;
+    priv->events[0].revents = 0;
+    ++priv->fd_size;
+  }
 #else
-  if(pipe(priv->wakeup_pipe) == -1)
+  /* Both ends are non-blocking, so that draining the pipe does not block,
+   * and waking up the loop does not block when the pipe is full. */
+  if(pipe(priv->wakeup_pipe) == -1 ||
+     fcntl(priv->wakeup_pipe[0], F_SETFL, O_NONBLOCK) == -1 ||
+     fcntl(priv->wakeup_pipe[1], F_SETFL, O_NONBLOCK) == -1)
   {
     g_error("Failed to create wakeup pipe: %s", strerror(errno));
   }
@@ -493,7 +642,8 @@ inf_standalone_io_init(InfStandaloneIo* io)
 
   priv->watches = g_malloc(sizeof(InfIoWatch*) * (priv->fd_alloc - 1) );
   priv->timeouts = NULL;
-  priv->dispatchs = NULL;
+  g_queue_init(&priv->dispatch_queue);
+  priv->dispatch_links = g_hash_table_new(NULL, NULL);
 
   priv->polling = FALSE;
   priv->loop_running = FALSE;
@@ -549,14 +699,15 @@ inf_standalone_io_finalize(GObject* object)
     g_slice_free(InfIoTimeout, timeout);
   }
 
-  for(item = priv->dispatchs; item != NULL; item = g_list_next(item))
+  while((dispatch = inf_standalone_io_dispatch_queue_pop(priv)) != NULL)
   {
-    dispatch = (InfIoDispatch*)item->data;
     if(dispatch->notify)
       dispatch->notify(dispatch->user_data);
     g_slice_free(InfIoDispatch, dispatch);
   }
 
+  g_hash_table_destroy(priv->dispatch_links);
+
 #ifdef G_OS_WIN32
   for(i = 0; i < priv->fd_size; ++ i)
   {
@@ -572,7 +723,6 @@ inf_standalone_io_finalize(GObject* object)
   g_free(priv->events);
   g_free(priv->watches);
   g_list_free(priv->timeouts);
-  g_list_free(priv->dispatchs);
 
 #ifndef G_OS_WIN32
   if(close(priv->wakeup_pipe[0]) == -1)
@@ -583,7 +733,8 @@ inf_standalone_io_finalize(GObject* object)
     );
   }
 
-  if(close(priv->wakeup_pipe[1]) == -1)
+  if(priv->wakeup_pipe[1] != priv->wakeup_pipe[0] &&
+     close(priv->wakeup_pipe[1]) == -1)
   {
     g_warning(
       "Failed to close writing end of wakeup pipe: %s",
@@ -594,6 +745,7 @@ inf_standalone_io_finalize(GObject* object)
 
   g_mutex_unlock(&priv->mutex);
   g_mutex_clear(&priv->mutex);
+  g_mutex_clear(&priv->dispatch_mutex);
 
   G_OBJECT_CLASS(inf_standalone_io_parent_class)->finalize(object);
 }
@@ -640,53 +792,10 @@ inf_standalone_io_wakeup(InfStandaloneIo* io)
    * runs in? */
 
   InfStandaloneIoPrivate* priv;
-#ifndef G_OS_WIN32
-  char c;
-  ssize_t ret;
-#else
-  gchar* error_message;
-#endif
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
   if(priv->polling)
-  {
-#ifdef G_OS_WIN32
-    if(WSASetEvent(priv->events[0]) == FALSE)
-    {
-      error_message = g_win32_error_message(WSAGetLastError());
-
-      g_warning(
-        "WSASetEvent() failed when attempting to wake up the main loop: %s",
-        error_message
-      );
-
-      g_free(error_message);
-    }
-#else
-    c = 'c';
-    ret = write(priv->wakeup_pipe[1], &c, 1);
-    if(ret == -1)
-    {
-      g_warning(
-        "write() failed when attempting to wake up the main loop: %s",
-        strerror(errno)
-      );
-
-      /* TODO: Is there anything we could do here?
-       * Try to re-establish pipe? */
-    }
-    else if(ret == 0)
-    {
-      g_warning(
-        "Received EOF from weakup pipe when attempting to wake "
-        "up the main loop"
-      );
-
-      /* TODO: Is there anything we could do here?
-       * Try to re-establish pipe? */
-    }
-#endif
-  }
+    inf_standalone_io_wakeup_signal(priv);
 }
 
 static InfIoWatch*
@@ -1009,6 +1118,7 @@ inf_standalone_io_io_add_dispatch(InfIo* io,
 {
   InfStandaloneIoPrivate* priv;
   InfIoDispatch* dispatch;
+  gboolean was_empty;
 
   priv = INF_STANDALONE_IO_PRIVATE(io);
   dispatch = g_slice_new(InfIoDispatch);
@@ -1017,10 +1127,23 @@ inf_standalone_io_io_add_dispatch(InfIo* io,
   dispatch->user_data = user_data;
   dispatch->notify = notify;
 
-  g_mutex_lock(&priv->mutex);
-  priv->dispatchs = g_list_prepend(priv->dispatchs, dispatch);
-  inf_standalone_io_wakeup(INF_STANDALONE_IO(io));
-  g_mutex_unlock(&priv->mutex);
+  /* This only takes dispatch_mutex, not the mutex protecting watches and
+   * timeouts. Only the dispatch which makes the queue non-empty needs to
+   * wake up the loop, all others are run in the same batch. */
+  g_mutex_lock(&priv->dispatch_mutex);
+
+  g_queue_push_tail(&priv->dispatch_queue, dispatch);
+  g_hash_table_insert(
+    priv->dispatch_links,
+    dispatch,
+    g_queue_peek_tail_link(&priv->dispatch_queue)
+  );
+
+  was_empty = g_queue_get_length(&priv->dispatch_queue) == 1;
+  g_mutex_unlock(&priv->dispatch_mutex);
+
+  if(was_empty)
+    inf_standalone_io_wakeup_signal(priv);
 
   return dispatch;
 }
@@ -1030,29 +1153,29 @@ inf_standalone_io_io_remove_dispatch(InfIo* io,
                                      InfIoDispatch* dispatch)
 {
   InfStandaloneIoPrivate* priv;
-  GList* item;
+  GList* link;
 
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
-  g_mutex_lock(&priv->mutex);
+  /* If the dispatch is not found, then it has already been taken off the
+   * queue by the loop, and is being run or has been run and freed. It is
+   * too late to remove it then, and the dispatch must not be touched. */
+  g_mutex_lock(&priv->dispatch_mutex);
 
-  item = g_list_find(priv->dispatchs, dispatch);
-  if(item != NULL)
+  link = g_hash_table_lookup(priv->dispatch_links, dispatch);
+  if(link != NULL)
   {
-    priv->dispatchs = g_list_delete_link(priv->dispatchs, item);
-    g_mutex_unlock(&priv->mutex);
+    g_queue_delete_link(&priv->dispatch_queue, link);
+    g_hash_table_remove(priv->dispatch_links, dispatch);
+  }
+
+  g_mutex_unlock(&priv->dispatch_mutex);
 
+  if(link != NULL)
+  {
     if(dispatch->notify)
       dispatch->notify(dispatch->user_data);
-
     g_slice_free(InfIoDispatch, dispatch);
-
-    /* No need to wake up the main loop; it might run into its timeout sooner
-     * than necessary now, but that's OK. */
-  }
-  else
-  {
-    g_mutex_unlock(&priv->mutex);
   }
 }
 
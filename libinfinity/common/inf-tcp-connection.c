@@ -38,6 +38,11 @@
  * When the hostname has been resolved and a connection has been made, the
  * #InfTcpConnection:remote-address and #InfTcpConnection:remote-port
  * properties are updated to reflect the address actually connected to.
+ *
+ * If the hostname resolves to multiple addresses and connecting to one of
+ * them does not succeed within 250 milliseconds, a connection attempt to
+ * the next address is started in parallel, without giving up the first
+ * one. The first attempt to succeed is used, and the others are cancelled.
  **/
 
 #include <libinfinity/common/inf-tcp-connection.h>
@@ -62,6 +67,9 @@
 # include <arpa/inet.h>
 # include <unistd.h>
 # include <fcntl.h>
+# ifdef __linux__
+#  include <netinet/tcp.h>
+# endif
 
 # include <errno.h>
 # include <string.h>
@@ -89,6 +97,14 @@ static const GEnumValue inf_tcp_connection_status_values[] = {
   }
 };
 
+typedef struct _InfTcpConnectionAttempt InfTcpConnectionAttempt;
+struct _InfTcpConnectionAttempt {
+  InfTcpConnection* connection;
+  InfNativeSocket socket;
+  InfIoWatch* watch;
+  guint index;
+};
+
 typedef struct _InfTcpConnectionPrivate InfTcpConnectionPrivate;
 struct _InfTcpConnectionPrivate {
   InfIo* io;
@@ -98,6 +114,11 @@ struct _InfTcpConnectionPrivate {
   InfNameResolver* resolver;
   guint resolver_index;
 
+  /* Earlier connection attempts to other resolved addresses that are still
+   * pending while connecting to the address at resolver_index. */
+  GSList* attempts;
+  InfIoTimeout* attempt_timeout;
+
   InfTcpConnectionStatus status;
   InfNativeSocket socket;
   InfKeepalive keepalive;
@@ -142,6 +163,10 @@ enum {
 
 static guint tcp_connection_signals[LAST_SIGNAL];
 
+/* Time in milliseconds after which we start connecting to the next resolved
+ * address if the current attempt did not succeed yet, see RFC 8305. */
+static const guint INF_TCP_CONNECTION_ATTEMPT_DELAY = 250;
+
 INF_DEFINE_ENUM_TYPE(InfTcpConnectionStatus, inf_tcp_connection_status, inf_tcp_connection_status_values)
 G_DEFINE_TYPE_WITH_CODE(InfTcpConnection, inf_tcp_connection, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfTcpConnection))
@@ -274,6 +299,41 @@ inf_tcp_connection_io(InfNativeSocket* socket,
                       InfIoEvent events,
                       gpointer user_data);
 
+static void
+inf_tcp_connection_attempt_free(InfTcpConnection* connection,
+                                InfTcpConnectionAttempt* attempt)
+{
+  InfTcpConnectionPrivate* priv;
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+
+  inf_io_remove_watch(priv->io, attempt->watch);
+  if(attempt->socket != INVALID_SOCKET)
+    closesocket(attempt->socket);
+
+  g_slice_free(InfTcpConnectionAttempt, attempt);
+}
+
+static void
+inf_tcp_connection_cancel_attempts(InfTcpConnection* connection)
+{
+  InfTcpConnectionPrivate* priv;
+  InfTcpConnectionAttempt* attempt;
+
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+
+  if(priv->attempt_timeout != NULL)
+  {
+    inf_io_remove_timeout(priv->io, priv->attempt_timeout);
+    priv->attempt_timeout = NULL;
+  }
+
+  while(priv->attempts != NULL)
+  {
+    attempt = (InfTcpConnectionAttempt*)priv->attempts->data;
+    priv->attempts = g_slist_delete_link(priv->attempts, priv->attempts);
+    inf_tcp_connection_attempt_free(connection, attempt);
+  }
+}
 
 static void
 inf_tcp_connection_connected(InfTcpConnection* connection)
@@ -281,6 +341,8 @@ inf_tcp_connection_connected(InfTcpConnection* connection)
   InfTcpConnectionPrivate* priv;
   priv = INF_TCP_CONNECTION_PRIVATE(connection);
 
+  inf_tcp_connection_cancel_attempts(connection);
+
   priv->status = INF_TCP_CONNECTION_CONNECTED;
   priv->front_pos = 0;
   priv->back_pos = 0;
@@ -334,6 +396,125 @@ static gboolean
 inf_tcp_connection_open_with_resolver(InfTcpConnection* connection,
                                       GError** error);
 
+static void
+inf_tcp_connection_attempt_io(InfNativeSocket* socket,
+                              InfIoEvent events,
+                              gpointer user_data)
+{
+  InfTcpConnectionAttempt* attempt;
+  InfTcpConnection* connection;
+  InfTcpConnectionPrivate* priv;
+  socklen_t len;
+  int errcode;
+  GError* error;
+
+  attempt = (InfTcpConnectionAttempt*)user_data;
+  connection = attempt->connection;
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+
+  len = sizeof(int);
+#ifdef G_OS_WIN32
+  getsockopt(attempt->socket, SOL_SOCKET, SO_ERROR, (char*)&errcode, &len);
+#else
+  getsockopt(attempt->socket, SOL_SOCKET, SO_ERROR, &errcode, &len);
+#endif
+
+  g_object_ref(connection);
+  priv->attempts = g_slist_remove(priv->attempts, attempt);
+
+  if(errcode == 0)
+  {
+    /* This attempt won the race, so it replaces the current one */
+    if(priv->watch != NULL)
+    {
+      priv->events = 0;
+
+      inf_io_remove_watch(priv->io, priv->watch);
+      priv->watch = NULL;
+    }
+
+    if(priv->socket != INVALID_SOCKET)
+      closesocket(priv->socket);
+
+    priv->socket = attempt->socket;
+    priv->resolver_index = attempt->index;
+
+    attempt->socket = INVALID_SOCKET;
+    inf_tcp_connection_attempt_free(connection, attempt);
+
+    inf_tcp_connection_connected(connection);
+  }
+  else
+  {
+    inf_tcp_connection_attempt_free(connection, attempt);
+
+    /* If the current attempt has failed as well and there are no more
+     * addresses to try, then this was the last chance. */
+    if(priv->attempts == NULL && priv->socket == INVALID_SOCKET &&
+       inf_name_resolver_finished(priv->resolver))
+    {
+      error = NULL;
+      inf_native_socket_make_error(errcode, &error);
+
+      priv->resolver_index = 0;
+
+      g_signal_emit(
+        G_OBJECT(connection),
+        tcp_connection_signals[ERROR_],
+        0,
+        error
+      );
+
+      g_error_free(error);
+    }
+  }
+
+  g_object_unref(connection);
+}
+
+static void
+inf_tcp_connection_attempt_timeout_func(gpointer user_data)
+{
+  InfTcpConnection* connection;
+  InfTcpConnectionPrivate* priv;
+  InfTcpConnectionAttempt* attempt;
+
+  connection = INF_TCP_CONNECTION(user_data);
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+  priv->attempt_timeout = NULL;
+
+  g_assert(priv->status == INF_TCP_CONNECTION_CONNECTING);
+  g_assert(priv->socket != INVALID_SOCKET && priv->watch != NULL);
+
+  /* Keep the current attempt running in the background, and start
+   * connecting to the next address. */
+  attempt = g_slice_new(InfTcpConnectionAttempt);
+  attempt->connection = connection;
+  attempt->socket = priv->socket;
+  attempt->index = priv->resolver_index;
+
+  priv->events = 0;
+  inf_io_remove_watch(priv->io, priv->watch);
+  priv->watch = NULL;
+  priv->socket = INVALID_SOCKET;
+
+  attempt->watch = inf_io_add_watch(
+    priv->io,
+    &attempt->socket,
+    INF_IO_OUTGOING | INF_IO_ERROR,
+    inf_tcp_connection_attempt_io,
+    attempt,
+    NULL
+  );
+
+  priv->attempts = g_slist_prepend(priv->attempts, attempt);
+  ++priv->resolver_index;
+
+  g_object_ref(connection);
+  inf_tcp_connection_open_with_resolver(connection, NULL);
+  g_object_unref(connection);
+}
+
 /* Handles when an error occurred during connection. Returns FALSE when the
  * error was fatal. In this case, it has already emitted the "error" signal.
  * Returns TRUE, if another connection attempt is made. */
@@ -359,6 +540,13 @@ inf_tcp_connection_connection_error(InfTcpConnection* connection,
     priv->watch = NULL;
   }
 
+  /* Try the next address right away instead of waiting for the delay */
+  if(priv->attempt_timeout != NULL)
+  {
+    inf_io_remove_timeout(priv->io, priv->attempt_timeout);
+    priv->attempt_timeout = NULL;
+  }
+
   if(priv->resolver != NULL)
   {
     /* Try next address, if there is one */
@@ -372,6 +560,10 @@ inf_tcp_connection_connection_error(InfTcpConnection* connection,
 
     /* No new addresses available */
     priv->resolver_index = 0;
+
+    /* Wait for the result of the attempts that are still in progress */
+    if(priv->attempts != NULL)
+      return TRUE;
   }
 
   g_signal_emit(
@@ -512,6 +704,23 @@ inf_tcp_connection_open_real(InfTcpConnection* connection,
       NULL
     );
 
+    /* If this takes long, then race a connection to the next address
+     * against this one. */
+    if(priv->resolver != NULL &&
+       priv->resolver_index + 1 <
+         inf_name_resolver_get_n_addresses(priv->resolver))
+    {
+      g_assert(priv->attempt_timeout == NULL);
+
+      priv->attempt_timeout = inf_io_add_timeout(
+        priv->io,
+        INF_TCP_CONNECTION_ATTEMPT_DELAY,
+        inf_tcp_connection_attempt_timeout_func,
+        connection,
+        NULL
+      );
+    }
+
     if(priv->status != INF_TCP_CONNECTION_CONNECTING)
     {
       priv->status = INF_TCP_CONNECTION_CONNECTING;
@@ -683,6 +892,7 @@ inf_tcp_connection_io_outgoing(InfTcpConnection* connection)
 
   socklen_t len;
   int errcode;
+  GError* error;
 
   gconstpointer data;
   guint data_len;
@@ -704,7 +914,11 @@ inf_tcp_connection_io_outgoing(InfTcpConnection* connection)
     }
     else
     {
-      inf_tcp_connection_system_error(connection, errcode);
+      /* Try the next address, if any */
+      error = NULL;
+      inf_native_socket_make_error(errcode, &error);
+      inf_tcp_connection_connection_error(connection, error);
+      g_error_free(error);
     }
 
     break;
@@ -902,6 +1116,8 @@ inf_tcp_connection_init(InfTcpConnection* connection)
   priv->watch = NULL;
   priv->resolver = NULL;
   priv->resolver_index = 0;
+  priv->attempts = NULL;
+  priv->attempt_timeout = NULL;
   priv->status = INF_TCP_CONNECTION_CLOSED;
   priv->socket = INVALID_SOCKET;
   priv->keepalive.mask = 0;
@@ -1182,6 +1398,8 @@ inf_tcp_connection_error(InfTcpConnection* connection,
     priv->watch = NULL;
   }
 
+  inf_tcp_connection_cancel_attempts(connection);
+
   if(priv->status != INF_TCP_CONNECTION_CLOSED)
   {
     priv->status = INF_TCP_CONNECTION_CLOSED;
@@ -1588,6 +1806,8 @@ inf_tcp_connection_close(InfTcpConnection* connection)
     priv->watch = NULL;
   }
 
+  inf_tcp_connection_cancel_attempts(connection);
+
   priv->front_pos = 0;
   priv->back_pos = 0;
 
@@ -1797,6 +2017,40 @@ inf_tcp_connection_get_keepalive(InfTcpConnection* connection)
   return &INF_TCP_CONNECTION_PRIVATE(connection)->keepalive;
 }
 
+/**
+ * inf_tcp_connection_get_round_trip_time:
+ * @connection: A #InfTcpConnection.
+ *
+ * Returns the smoothed round trip time of @connection as estimated by the
+ * operating system's TCP stack. If @connection is not connected, or the
+ * platform does not provide this information, the function returns 0.
+ *
+ * Returns: The round trip time in microseconds, or 0.
+ **/
+guint
+inf_tcp_connection_get_round_trip_time(InfTcpConnection* connection)
+{
+  InfTcpConnectionPrivate* priv;
+#if defined(__linux__) && defined(TCP_INFO)
+  struct tcp_info info;
+  socklen_t len;
+#endif
+
+  g_return_val_if_fail(INF_IS_TCP_CONNECTION(connection), 0);
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+
+  if(priv->status != INF_TCP_CONNECTION_CONNECTED)
+    return 0;
+
+#if defined(__linux__) && defined(TCP_INFO)
+  len = sizeof(info);
+  if(getsockopt(priv->socket, IPPROTO_TCP, TCP_INFO, &info, &len) == 0)
+    return info.tcpi_rtt;
+#endif
+
+  return 0;
+}
+
 /* Creates a new TCP connection from an accepted socket. This is only used
  * by InfdTcpServer and should not be considered regular API. Do not call
  * this function. Language bindings should not wrap it. */
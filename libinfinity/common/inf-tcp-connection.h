@@ -145,6 +145,9 @@ inf_tcp_connection_set_keepalive(InfTcpConnection* connection,
 const InfKeepalive*
 inf_tcp_connection_get_keepalive(InfTcpConnection* connection);
 
+guint
+inf_tcp_connection_get_round_trip_time(InfTcpConnection* connection);
+
 G_END_DECLS
 
 #endif /* __INF_TCP_CONNECTION_H__ */
@@ -0,0 +1,632 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:inf-timing-policy
+ * @title: InfTimingPolicy
+ * @short_description: Timeouts and throttling adapted to network conditions
+ * @include: libinfinity/common/inf-timing-policy.h
+ * @stability: Unstable
+ *
+ * #InfTimingPolicy holds the timing parameters which influence latency and
+ * throughput of collaborative editing: how long an idle session stays in
+ * memory, how often no-op requests are sent, how often caret movements are
+ * broadcast and how many messages are queued on a connection at once.
+ *
+ * The configured values serve as a baseline. If the
+ * #InfTimingPolicy:adaptive property is set, the policy derives effective
+ * values from them using the round trip time and load reported by
+ * inf_timing_policy_add_round_trip_time() and inf_timing_policy_set_load().
+ * Otherwise, which is the default, the effective values are the configured
+ * ones. The effective values are what #InfdDirectory, #InfAdoptedSession,
+ * #InfTextSession and #InfCommunicationRegistry actually use; they are
+ * exposed as read-only properties so that they can be monitored.
+ *
+ * Sessions and the communication registry use the policy of their
+ * #InfCommunicationManager, and #InfdDirectory sets its policy on its
+ * communication manager. Unless configured otherwise, all objects share the
+ * policy returned by inf_timing_policy_get_default().
+ */
+
+#include <libinfinity/common/inf-timing-policy.h>
+
+typedef struct _InfTimingPolicyPrivate InfTimingPolicyPrivate;
+struct _InfTimingPolicyPrivate {
+  guint save_timeout;
+  guint noop_interval;
+  guint caret_update_interval;
+  guint inner_queue_limit;
+  gboolean adaptive;
+
+  guint round_trip_time; /* smoothed, in microseconds */
+  guint load;
+
+  guint effective_save_timeout;
+  guint effective_noop_interval;
+  guint effective_caret_update_interval;
+  guint effective_inner_queue_limit;
+};
+
+enum {
+  PROP_0,
+
+  PROP_SAVE_TIMEOUT,
+  PROP_NOOP_INTERVAL,
+  PROP_CARET_UPDATE_INTERVAL,
+  PROP_INNER_QUEUE_LIMIT,
+  PROP_ADAPTIVE,
+  PROP_LOAD,
+
+  /* read only */
+  PROP_ROUND_TRIP_TIME,
+  PROP_EFFECTIVE_SAVE_TIMEOUT,
+  PROP_EFFECTIVE_NOOP_INTERVAL,
+  PROP_EFFECTIVE_CARET_UPDATE_INTERVAL,
+  PROP_EFFECTIVE_INNER_QUEUE_LIMIT
+};
+
+#define INF_TIMING_POLICY_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TYPE_TIMING_POLICY, InfTimingPolicyPrivate))
+
+G_DEFINE_TYPE_WITH_CODE(InfTimingPolicy, inf_timing_policy, G_TYPE_OBJECT,
+  G_ADD_PRIVATE(InfTimingPolicy))
+
+/* Load above which the policy starts to trade latency for throughput */
+static const guint INF_TIMING_POLICY_LOAD_REFERENCE = 100;
+/* Round trip time, in microseconds, per step of the inner queue limit */
+static const guint INF_TIMING_POLICY_RTT_REFERENCE = 100000;
+
+static const guint INF_TIMING_POLICY_MIN_SAVE_TIMEOUT = 5000;
+static const guint INF_TIMING_POLICY_MAX_NOOP_FACTOR = 4;
+static const guint INF_TIMING_POLICY_MAX_INNER_QUEUE_LIMIT = 64;
+
+static void
+inf_timing_policy_update(InfTimingPolicy* policy)
+{
+  InfTimingPolicyPrivate* priv;
+  guint save_timeout;
+  guint noop_interval;
+  guint caret_update_interval;
+  guint inner_queue_limit;
+  guint64 value;
+
+  priv = INF_TIMING_POLICY_PRIVATE(policy);
+
+  save_timeout = priv->save_timeout;
+  noop_interval = priv->noop_interval;
+  caret_update_interval = priv->caret_update_interval;
+  inner_queue_limit = priv->inner_queue_limit;
+
+  if(priv->adaptive)
+  {
+    /* With many clients, unload idle sessions earlier to keep memory usage
+     * in check, but do not thrash sessions which are only briefly idle. */
+    if(priv->load > INF_TIMING_POLICY_LOAD_REFERENCE &&
+       save_timeout > INF_TIMING_POLICY_MIN_SAVE_TIMEOUT)
+    {
+      value = (guint64)save_timeout * INF_TIMING_POLICY_LOAD_REFERENCE;
+      value /= priv->load;
+      save_timeout = MAX(value, INF_TIMING_POLICY_MIN_SAVE_TIMEOUT);
+    }
+
+    /* No-op requests only serve to clean up request logs, so send fewer of
+     * them when the server is busy. */
+    value = (guint64)noop_interval * MIN(
+      1 + priv->load / INF_TIMING_POLICY_LOAD_REFERENCE,
+      INF_TIMING_POLICY_MAX_NOOP_FACTOR
+    );
+
+    noop_interval = MIN(value, G_MAXUINT);
+
+    /* Caret updates sent faster than the round trip time only pile up in
+     * the network. */
+    caret_update_interval =
+      MAX(caret_update_interval, priv->round_trip_time / 1000);
+
+    /* Keep more messages in flight on high-latency links so that the
+     * connection does not run dry between two batches. */
+    if(inner_queue_limit < INF_TIMING_POLICY_MAX_INNER_QUEUE_LIMIT)
+    {
+      value = (guint64)inner_queue_limit *
+        (1 + priv->round_trip_time / INF_TIMING_POLICY_RTT_REFERENCE);
+      inner_queue_limit = MIN(value, INF_TIMING_POLICY_MAX_INNER_QUEUE_LIMIT);
+    }
+  }
+
+  g_object_freeze_notify(G_OBJECT(policy));
+
+  if(save_timeout != priv->effective_save_timeout)
+  {
+    priv->effective_save_timeout = save_timeout;
+    g_object_notify(G_OBJECT(policy), "effective-save-timeout");
+  }
+
+  if(noop_interval != priv->effective_noop_interval)
+  {
+    priv->effective_noop_interval = noop_interval;
+    g_object_notify(G_OBJECT(policy), "effective-noop-interval");
+  }
+
+  if(caret_update_interval != priv->effective_caret_update_interval)
+  {
+    priv->effective_caret_update_interval = caret_update_interval;
+    g_object_notify(G_OBJECT(policy), "effective-caret-update-interval");
+  }
+
+  if(inner_queue_limit != priv->effective_inner_queue_limit)
+  {
+    priv->effective_inner_queue_limit = inner_queue_limit;
+    g_object_notify(G_OBJECT(policy), "effective-inner-queue-limit");
+  }
+
+  g_object_thaw_notify(G_OBJECT(policy));
+}
+
+static void
+inf_timing_policy_init(InfTimingPolicy* policy)
+{
+  InfTimingPolicyPrivate* priv;
+  priv = INF_TIMING_POLICY_PRIVATE(policy);
+
+  priv->save_timeout = 60000;
+  priv->noop_interval = 30;
+  priv->caret_update_interval = 0;
+  priv->inner_queue_limit = 5;
+  priv->adaptive = FALSE;
+
+  priv->round_trip_time = 0;
+  priv->load = 0;
+
+  /* Without measurements the effective values equal the configured ones */
+  priv->effective_save_timeout = priv->save_timeout;
+  priv->effective_noop_interval = priv->noop_interval;
+  priv->effective_caret_update_interval = priv->caret_update_interval;
+  priv->effective_inner_queue_limit = priv->inner_queue_limit;
+}
+
+static void
+inf_timing_policy_set_property(GObject* object,
+                               guint prop_id,
+                               const GValue* value,
+                               GParamSpec* pspec)
+{
+  InfTimingPolicy* policy;
+  InfTimingPolicyPrivate* priv;
+
+  policy = INF_TIMING_POLICY(object);
+  priv = INF_TIMING_POLICY_PRIVATE(policy);
+
+  switch(prop_id)
+  {
+  case PROP_SAVE_TIMEOUT:
+    priv->save_timeout = g_value_get_uint(value);
+    break;
+  case PROP_NOOP_INTERVAL:
+    priv->noop_interval = g_value_get_uint(value);
+    break;
+  case PROP_CARET_UPDATE_INTERVAL:
+    priv->caret_update_interval = g_value_get_uint(value);
+    break;
+  case PROP_INNER_QUEUE_LIMIT:
+    priv->inner_queue_limit = g_value_get_uint(value);
+    break;
+  case PROP_ADAPTIVE:
+    priv->adaptive = g_value_get_boolean(value);
+    break;
+  case PROP_LOAD:
+    priv->load = g_value_get_uint(value);
+    break;
+  case PROP_ROUND_TRIP_TIME:
+  case PROP_EFFECTIVE_SAVE_TIMEOUT:
+  case PROP_EFFECTIVE_NOOP_INTERVAL:
+  case PROP_EFFECTIVE_CARET_UPDATE_INTERVAL:
+  case PROP_EFFECTIVE_INNER_QUEUE_LIMIT:
+    /* read only */
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    return;
+  }
+
+  inf_timing_policy_update(policy);
+}
+
+static void
+inf_timing_policy_get_property(GObject* object,
+                               guint prop_id,
+                               GValue* value,
+                               GParamSpec* pspec)
+{
+  InfTimingPolicy* policy;
+  InfTimingPolicyPrivate* priv;
+
+  policy = INF_TIMING_POLICY(object);
+  priv = INF_TIMING_POLICY_PRIVATE(policy);
+
+  switch(prop_id)
+  {
+  case PROP_SAVE_TIMEOUT:
+    g_value_set_uint(value, priv->save_timeout);
+    break;
+  case PROP_NOOP_INTERVAL:
+    g_value_set_uint(value, priv->noop_interval);
+    break;
+  case PROP_CARET_UPDATE_INTERVAL:
+    g_value_set_uint(value, priv->caret_update_interval);
+    break;
+  case PROP_INNER_QUEUE_LIMIT:
+    g_value_set_uint(value, priv->inner_queue_limit);
+    break;
+  case PROP_ADAPTIVE:
+    g_value_set_boolean(value, priv->adaptive);
+    break;
+  case PROP_LOAD:
+    g_value_set_uint(value, priv->load);
+    break;
+  case PROP_ROUND_TRIP_TIME:
+    g_value_set_uint(value, priv->round_trip_time);
+    break;
+  case PROP_EFFECTIVE_SAVE_TIMEOUT:
+    g_value_set_uint(value, priv->effective_save_timeout);
+    break;
+  case PROP_EFFECTIVE_NOOP_INTERVAL:
+    g_value_set_uint(value, priv->effective_noop_interval);
+    break;
+  case PROP_EFFECTIVE_CARET_UPDATE_INTERVAL:
+    g_value_set_uint(value, priv->effective_caret_update_interval);
+    break;
+  case PROP_EFFECTIVE_INNER_QUEUE_LIMIT:
+    g_value_set_uint(value, priv->effective_inner_queue_limit);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+inf_timing_policy_class_init(InfTimingPolicyClass* policy_class)
+{
+  GObjectClass* object_class;
+  object_class = G_OBJECT_CLASS(policy_class);
+
+  object_class->set_property = inf_timing_policy_set_property;
+  object_class->get_property = inf_timing_policy_get_property;
+
+  g_object_class_install_property(
+    object_class,
+    PROP_SAVE_TIMEOUT,
+    g_param_spec_uint(
+      "save-timeout",
+      "Save timeout",
+      "Time in milliseconds a session needs to be idle before it is "
+      "unloaded from memory",
+      0,
+      G_MAXUINT,
+      60000,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_NOOP_INTERVAL,
+    g_param_spec_uint(
+      "noop-interval",
+      "No-op interval",
+      "Time in seconds after which a no-op request is sent to announce the "
+      "local state to other users",
+      1,
+      G_MAXUINT,
+      30,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_CARET_UPDATE_INTERVAL,
+    g_param_spec_uint(
+      "caret-update-interval",
+      "Caret update interval",
+      "Minimum time in milliseconds between two caret updates of the "
+      "same user",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_INNER_QUEUE_LIMIT,
+    g_param_spec_uint(
+      "inner-queue-limit",
+      "Inner queue limit",
+      "Maximum number of messages of a group enqueued on a connection at "
+      "the same time",
+      1,
+      G_MAXUINT,
+      5,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_ADAPTIVE,
+    g_param_spec_boolean(
+      "adaptive",
+      "Adaptive",
+      "Whether to adapt the effective values to round trip time and load",
+      FALSE,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_LOAD,
+    g_param_spec_uint(
+      "load",
+      "Load",
+      "The number of clients currently being served",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_ROUND_TRIP_TIME,
+    g_param_spec_uint(
+      "round-trip-time",
+      "Round trip time",
+      "Smoothed round trip time in microseconds, or 0 if unknown",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READABLE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_EFFECTIVE_SAVE_TIMEOUT,
+    g_param_spec_uint(
+      "effective-save-timeout",
+      "Effective save timeout",
+      "The save timeout currently in use, in milliseconds",
+      0,
+      G_MAXUINT,
+      60000,
+      G_PARAM_READABLE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_EFFECTIVE_NOOP_INTERVAL,
+    g_param_spec_uint(
+      "effective-noop-interval",
+      "Effective no-op interval",
+      "The no-op interval currently in use, in seconds",
+      0,
+      G_MAXUINT,
+      30,
+      G_PARAM_READABLE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_EFFECTIVE_CARET_UPDATE_INTERVAL,
+    g_param_spec_uint(
+      "effective-caret-update-interval",
+      "Effective caret update interval",
+      "The caret update interval currently in use, in milliseconds",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READABLE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_EFFECTIVE_INNER_QUEUE_LIMIT,
+    g_param_spec_uint(
+      "effective-inner-queue-limit",
+      "Effective inner queue limit",
+      "The inner queue limit currently in use",
+      0,
+      G_MAXUINT,
+      5,
+      G_PARAM_READABLE
+    )
+  );
+}
+
+/*
+ * Public API
+ */
+
+/**
+ * inf_timing_policy_new: (constructor)
+ *
+ * Creates a new #InfTimingPolicy with default values. Most applications
+ * want to use inf_timing_policy_get_default() instead, so that all objects
+ * share the same measurements.
+ *
+ * Returns: (transfer full): A new #InfTimingPolicy. Free with
+ * g_object_unref() when no longer needed.
+ */
+InfTimingPolicy*
+inf_timing_policy_new(void)
+{
+  GObject* object;
+  object = g_object_new(INF_TYPE_TIMING_POLICY, NULL);
+  return INF_TIMING_POLICY(object);
+}
+
+/**
+ * inf_timing_policy_get_default:
+ *
+ * Returns the default #InfTimingPolicy. Objects for which no policy is set
+ * explicitly use this one.
+ *
+ * Returns: (transfer none): A #InfTimingPolicy. It should not be unrefed
+ * or freed.
+ */
+InfTimingPolicy*
+inf_timing_policy_get_default(void)
+{
+  static gsize default_timing_policy = 0;
+
+  if(g_once_init_enter(&default_timing_policy))
+  {
+    g_once_init_leave(
+      &default_timing_policy,
+      (gsize)inf_timing_policy_new()
+    );
+  }
+
+  return INF_TIMING_POLICY((gpointer)default_timing_policy);
+}
+
+/**
+ * inf_timing_policy_add_round_trip_time:
+ * @policy: A #InfTimingPolicy.
+ * @rtt: A measured round trip time, in microseconds.
+ *
+ * Adds a round trip time sample to @policy. The samples are smoothed in the
+ * same way TCP smoothes its round trip time estimate, so that a single slow
+ * connection does not dominate the effective values. A sample of 0 is
+ * ignored.
+ */
+void
+inf_timing_policy_add_round_trip_time(InfTimingPolicy* policy,
+                                      guint rtt)
+{
+  InfTimingPolicyPrivate* priv;
+  gint64 diff;
+
+  g_return_if_fail(INF_IS_TIMING_POLICY(policy));
+  priv = INF_TIMING_POLICY_PRIVATE(policy);
+
+  if(rtt == 0) return;
+
+  if(priv->round_trip_time == 0)
+  {
+    priv->round_trip_time = rtt;
+  }
+  else
+  {
+    diff = (gint64)rtt - (gint64)priv->round_trip_time;
+    priv->round_trip_time += diff / 8;
+  }
+
+  g_object_notify(G_OBJECT(policy), "round-trip-time");
+  inf_timing_policy_update(policy);
+}
+
+/**
+ * inf_timing_policy_set_load:
+ * @policy: A #InfTimingPolicy.
+ * @load: The number of clients currently being served.
+ *
+ * Sets the current load for @policy. This is equivalent to setting the
+ * #InfTimingPolicy:load property.
+ */
+void
+inf_timing_policy_set_load(InfTimingPolicy* policy,
+                           guint load)
+{
+  g_return_if_fail(INF_IS_TIMING_POLICY(policy));
+
+  if(INF_TIMING_POLICY_PRIVATE(policy)->load != load)
+    g_object_set(G_OBJECT(policy), "load", load, NULL);
+}
+
+/**
+ * inf_timing_policy_get_save_timeout:
+ * @policy: A #InfTimingPolicy.
+ *
+ * Returns the time a session needs to be idle before it is stored and
+ * unloaded from memory.
+ *
+ * Returns: The effective save timeout, in milliseconds.
+ */
+guint
+inf_timing_policy_get_save_timeout(InfTimingPolicy* policy)
+{
+  g_return_val_if_fail(INF_IS_TIMING_POLICY(policy), 0);
+  return INF_TIMING_POLICY_PRIVATE(policy)->effective_save_timeout;
+}
+
+/**
+ * inf_timing_policy_get_noop_interval:
+ * @policy: A #InfTimingPolicy.
+ *
+ * Returns the time after which a local user which has not issued any
+ * request sends a no-op request, so that other sites learn which requests
+ * it has processed.
+ *
+ * Returns: The effective no-op interval, in seconds.
+ */
+guint
+inf_timing_policy_get_noop_interval(InfTimingPolicy* policy)
+{
+  g_return_val_if_fail(INF_IS_TIMING_POLICY(policy), 0);
+  return INF_TIMING_POLICY_PRIVATE(policy)->effective_noop_interval;
+}
+
+/**
+ * inf_timing_policy_get_caret_update_interval:
+ * @policy: A #InfTimingPolicy.
+ *
+ * Returns the minimum time between two caret updates of the same user.
+ *
+ * Returns: The effective caret update interval, in milliseconds.
+ */
+guint
+inf_timing_policy_get_caret_update_interval(InfTimingPolicy* policy)
+{
+  g_return_val_if_fail(INF_IS_TIMING_POLICY(policy), 0);
+  return INF_TIMING_POLICY_PRIVATE(policy)->effective_caret_update_interval;
+}
+
+/**
+ * inf_timing_policy_get_inner_queue_limit:
+ * @policy: A #InfTimingPolicy.
+ *
+ * Returns the maximum number of messages of a single group which are
+ * enqueued on a connection at the same time.
+ *
+ * Returns: The effective inner queue limit.
+ */
+guint
+inf_timing_policy_get_inner_queue_limit(InfTimingPolicy* policy)
+{
+  g_return_val_if_fail(INF_IS_TIMING_POLICY(policy), 0);
+  return INF_TIMING_POLICY_PRIVATE(policy)->effective_inner_queue_limit;
+}
+
+/* vim:set et sw=2 ts=2: */
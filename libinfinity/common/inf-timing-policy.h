@@ -0,0 +1,91 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_TIMING_POLICY_H__
+#define __INF_TIMING_POLICY_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define INF_TYPE_TIMING_POLICY                 (inf_timing_policy_get_type())
+#define INF_TIMING_POLICY(obj)                 (G_TYPE_CHECK_INSTANCE_CAST((obj), INF_TYPE_TIMING_POLICY, InfTimingPolicy))
+#define INF_TIMING_POLICY_CLASS(klass)         (G_TYPE_CHECK_CLASS_CAST((klass), INF_TYPE_TIMING_POLICY, InfTimingPolicyClass))
+#define INF_IS_TIMING_POLICY(obj)              (G_TYPE_CHECK_INSTANCE_TYPE((obj), INF_TYPE_TIMING_POLICY))
+#define INF_IS_TIMING_POLICY_CLASS(klass)      (G_TYPE_CHECK_CLASS_TYPE((klass), INF_TYPE_TIMING_POLICY))
+#define INF_TIMING_POLICY_GET_CLASS(obj)       (G_TYPE_INSTANCE_GET_CLASS((obj), INF_TYPE_TIMING_POLICY, InfTimingPolicyClass))
+
+typedef struct _InfTimingPolicy InfTimingPolicy;
+typedef struct _InfTimingPolicyClass InfTimingPolicyClass;
+
+/**
+ * InfTimingPolicyClass:
+ *
+ * This structure does not contain any public fields.
+ */
+struct _InfTimingPolicyClass {
+  /*< private >*/
+  GObjectClass parent_class;
+};
+
+/**
+ * InfTimingPolicy:
+ *
+ * #InfTimingPolicy is an opaque data type. You should only access it
+ * via the public API functions.
+ */
+struct _InfTimingPolicy {
+  /*< private >*/
+  GObject parent;
+};
+
+GType
+inf_timing_policy_get_type(void) G_GNUC_CONST;
+
+InfTimingPolicy*
+inf_timing_policy_new(void);
+
+InfTimingPolicy*
+inf_timing_policy_get_default(void);
+
+void
+inf_timing_policy_add_round_trip_time(InfTimingPolicy* policy,
+                                      guint rtt);
+
+void
+inf_timing_policy_set_load(InfTimingPolicy* policy,
+                           guint load);
+
+guint
+inf_timing_policy_get_save_timeout(InfTimingPolicy* policy);
+
+guint
+inf_timing_policy_get_noop_interval(InfTimingPolicy* policy);
+
+guint
+inf_timing_policy_get_caret_update_interval(InfTimingPolicy* policy);
+
+guint
+inf_timing_policy_get_inner_queue_limit(InfTimingPolicy* policy);
+
+G_END_DECLS
+
+#endif /* __INF_TIMING_POLICY_H__ */
+
+/* vim:set et sw=2 ts=2: */
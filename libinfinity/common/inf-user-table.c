@@ -42,13 +42,28 @@ struct _InfUserTableForeachUserData {
   gpointer user_data;
 };
 
+typedef struct _InfUserTableEntry InfUserTableEntry;
+struct _InfUserTableEntry {
+  InfUser* user;
+
+  /* The name under which the user is stored in the name index. Only one
+   * user per name is indexed; others with the same name are not. */
+  gchar* name;
+  gboolean indexed;
+
+  /* Links into the availables and locals queues, or NULL */
+  GList* available_link;
+  GList* local_link;
+};
+
 typedef struct _InfUserTablePrivate InfUserTablePrivate;
 struct _InfUserTablePrivate {
-  GHashTable* table;
-  /* TODO: It would be smarter to map the hash table to a helper struct
-   * which stores the user availability, locality and the InfUser object */
-  GSList* availables;
-  GSList* locals;
+  GHashTable* table; /* id -> InfUserTableEntry */
+  GHashTable* names; /* name -> InfUserTableEntry */
+  guint n_unindexed;
+
+  GQueue availables;
+  GQueue locals;
 };
 
 enum {
@@ -81,23 +96,135 @@ inf_user_table_is_local(InfUser* user)
   return TRUE;
 }
 
+static InfUserTableEntry*
+inf_user_table_lookup_entry(InfUserTable* user_table,
+                            InfUser* user)
+{
+  InfUserTablePrivate* priv;
+  InfUserTableEntry* entry;
+
+  priv = INF_USER_TABLE_PRIVATE(user_table);
+  entry = g_hash_table_lookup(
+    priv->table,
+    GUINT_TO_POINTER(inf_user_get_id(user))
+  );
+
+  g_assert(entry != NULL && entry->user == user);
+  return entry;
+}
+
+static void
+inf_user_table_entry_free(gpointer data)
+{
+  InfUserTableEntry* entry;
+  entry = (InfUserTableEntry*)data;
+
+  g_free(entry->name);
+  g_slice_free(InfUserTableEntry, entry);
+}
+
+static void
+inf_user_table_index_name(InfUserTable* user_table,
+                          InfUserTableEntry* entry)
+{
+  InfUserTablePrivate* priv;
+  const gchar* name;
+
+  priv = INF_USER_TABLE_PRIVATE(user_table);
+
+  name = inf_user_get_name(entry->user);
+  entry->name = g_strdup(name != NULL ? name : "");
+
+  if(g_hash_table_lookup(priv->names, entry->name) == NULL)
+  {
+    g_hash_table_insert(priv->names, entry->name, entry);
+    entry->indexed = TRUE;
+  }
+  else
+  {
+    entry->indexed = FALSE;
+    ++priv->n_unindexed;
+  }
+}
+
+static void
+inf_user_table_unindex_name(InfUserTable* user_table,
+                            InfUserTableEntry* entry)
+{
+  InfUserTablePrivate* priv;
+  InfUserTableEntry* other;
+  GHashTableIter iter;
+  gpointer value;
+
+  priv = INF_USER_TABLE_PRIVATE(user_table);
+
+  if(entry->indexed)
+  {
+    g_hash_table_remove(priv->names, entry->name);
+    entry->indexed = FALSE;
+
+    /* If there is another user with the same name, then index that one
+     * instead. This only happens if names are not kept unique, so the
+     * linear search is acceptable. */
+    if(priv->n_unindexed > 0)
+    {
+      g_hash_table_iter_init(&iter, priv->table);
+      while(g_hash_table_iter_next(&iter, NULL, &value))
+      {
+        other = (InfUserTableEntry*)value;
+        if(other != entry && !other->indexed &&
+           strcmp(other->name, entry->name) == 0)
+        {
+          g_hash_table_insert(priv->names, other->name, other);
+          other->indexed = TRUE;
+          --priv->n_unindexed;
+          break;
+        }
+      }
+    }
+  }
+  else
+  {
+    g_assert(priv->n_unindexed > 0);
+    --priv->n_unindexed;
+  }
+
+  g_free(entry->name);
+  entry->name = NULL;
+}
+
+static void
+inf_user_table_notify_name_cb(GObject* object,
+                              GParamSpec* pspec,
+                              gpointer user_data)
+{
+  InfUserTable* user_table;
+  InfUserTableEntry* entry;
+
+  user_table = INF_USER_TABLE(user_data);
+  entry = inf_user_table_lookup_entry(user_table, INF_USER(object));
+
+  inf_user_table_unindex_name(user_table, entry);
+  inf_user_table_index_name(user_table, entry);
+}
+
 static void
 inf_user_table_check_local_cb(GObject* object,
                               GParamSpec* pspec,
                               gpointer user_data)
 {
   InfUserTable* user_table;
-  InfUserTablePrivate* priv;
+  InfUserTableEntry* entry;
   InfUser* user;
-  GSList* available_item;
-  GSList* local_item;
+  GList* available_item;
+  GList* local_item;
 
   user_table = INF_USER_TABLE(user_data);
-  priv = INF_USER_TABLE_PRIVATE(user_table);
   user = INF_USER(object);
+  entry = inf_user_table_lookup_entry(user_table, user);
 
-  available_item = g_slist_find(priv->availables, user);
-  local_item = g_slist_find(priv->locals, user);
+  available_item = entry->available_link;
+  local_item = entry->local_link;
 
   if(inf_user_get_status(user) != INF_USER_UNAVAILABLE &&
      available_item == NULL)
@@ -152,6 +279,12 @@ inf_user_table_unref_user(InfUserTable* user_table,
     user_table
   );
 
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(user),
+    G_CALLBACK(inf_user_table_notify_name_cb),
+    user_table
+  );
+
   g_object_unref(user);
 }
 
@@ -160,25 +293,16 @@ inf_user_table_dispose_foreach_func(gpointer key,
                                     gpointer value,
                                     gpointer user_data)
 {
-  inf_user_table_unref_user(INF_USER_TABLE(user_data), INF_USER(value));
+  InfUserTableEntry* entry;
+  entry = (InfUserTableEntry*)value;
+
+  inf_user_table_unref_user(INF_USER_TABLE(user_data), entry->user);
 }
 
 /*
  * User table callbacks.
  */
 
-static gboolean
-inf_user_table_lookup_user_by_name_func(gpointer key,
-                                        gpointer value,
-                                        gpointer data)
-{
-  const gchar* user_name;
-  user_name = inf_user_get_name(INF_USER(value));
-
-  if(strcmp(user_name, (const gchar*)data) == 0) return TRUE;
-  return FALSE;
-}
-
 static void
 inf_user_table_foreach_user_func(gpointer key,
                                  gpointer value,
@@ -187,7 +311,7 @@ inf_user_table_foreach_user_func(gpointer key,
   InfUserTableForeachUserData* data;
   data = (InfUserTableForeachUserData*)user_data;
 
-  data->func(INF_USER(value), data->user_data);
+  data->func(((InfUserTableEntry*)value)->user, data->user_data);
 }
 
 static void
@@ -196,9 +320,19 @@ inf_user_table_init(InfUserTable* user_table)
   InfUserTablePrivate* priv;
   priv = INF_USER_TABLE_PRIVATE(user_table);
 
-  priv->table = g_hash_table_new_full(NULL, NULL, NULL, NULL);
-  priv->availables = NULL;
-  priv->locals = NULL;
+  priv->table = g_hash_table_new_full(
+    NULL,
+    NULL,
+    NULL,
+    inf_user_table_entry_free
+  );
+
+  /* Keys are owned by the entries */
+  priv->names = g_hash_table_new(g_str_hash, g_str_equal);
+  priv->n_unindexed = 0;
+
+  g_queue_init(&priv->availables);
+  g_queue_init(&priv->locals);
 }
 
 static void
@@ -210,11 +344,8 @@ inf_user_table_dispose(GObject* object)
   user_table = INF_USER_TABLE(object);
   priv = INF_USER_TABLE_PRIVATE(user_table);
 
-  g_slist_free(priv->locals);
-  priv->locals = NULL;
-
-  g_slist_free(priv->availables);
-  priv->availables = NULL;
+  g_queue_clear(&priv->locals);
+  g_queue_clear(&priv->availables);
 
   g_hash_table_foreach(
     priv->table,
@@ -222,6 +353,8 @@ inf_user_table_dispose(GObject* object)
     user_table
   );
 
+  g_hash_table_remove_all(priv->names);
+  priv->n_unindexed = 0;
   g_hash_table_remove_all(priv->table);
   G_OBJECT_CLASS(inf_user_table_parent_class)->dispose(object);
 }
@@ -235,6 +368,7 @@ inf_user_table_finalize(GObject* object)
   user_table = INF_USER_TABLE(object);
   priv = INF_USER_TABLE_PRIVATE(user_table);
 
+  g_hash_table_destroy(priv->names);
   g_hash_table_destroy(priv->table);
 
   G_OBJECT_CLASS(inf_user_table_parent_class)->finalize(object);
@@ -245,6 +379,7 @@ inf_user_table_add_user_handler(InfUserTable* user_table,
                                 InfUser* user)
 {
   InfUserTablePrivate* priv;
+  InfUserTableEntry* entry;
   guint id;
 
   priv = INF_USER_TABLE_PRIVATE(user_table);
@@ -253,7 +388,13 @@ inf_user_table_add_user_handler(InfUserTable* user_table,
   g_assert(id > 0);
   g_assert(g_hash_table_lookup(priv->table, GUINT_TO_POINTER(id)) == NULL);
 
-  g_hash_table_insert(priv->table, GUINT_TO_POINTER(id), user);
+  entry = g_slice_new(InfUserTableEntry);
+  entry->user = user;
+  entry->available_link = NULL;
+  entry->local_link = NULL;
+  inf_user_table_index_name(user_table, entry);
+
+  g_hash_table_insert(priv->table, GUINT_TO_POINTER(id), entry);
   g_object_ref(user);
 
   g_signal_connect(
@@ -263,6 +404,13 @@ inf_user_table_add_user_handler(InfUserTable* user_table,
     user_table
   );
 
+  g_signal_connect(
+    G_OBJECT(user),
+    "notify::name",
+    G_CALLBACK(inf_user_table_notify_name_cb),
+    user_table
+  );
+
   if(inf_user_get_status(user) != INF_USER_UNAVAILABLE)
   {
     g_signal_emit(
@@ -289,6 +437,7 @@ inf_user_table_remove_user_handler(InfUserTable* user_table,
                                    InfUser* user)
 {
   InfUserTablePrivate* priv;
+  InfUserTableEntry* entry;
   guint id;
 
   priv = INF_USER_TABLE_PRIVATE(user_table);
@@ -314,8 +463,10 @@ inf_user_table_remove_user_handler(InfUserTable* user_table,
     );
   }
 
+  entry = inf_user_table_lookup_entry(user_table, user);
+  inf_user_table_unindex_name(user_table, entry);
+
   inf_user_table_unref_user(user_table, user);
-  g_assert(g_hash_table_lookup(priv->table, GUINT_TO_POINTER(id)) == user);
   g_hash_table_remove(priv->table, GUINT_TO_POINTER(id));
 }
 
@@ -324,10 +475,14 @@ inf_user_table_add_available_user(InfUserTable* user_table,
                                   InfUser* user)
 {
   InfUserTablePrivate* priv;
+  InfUserTableEntry* entry;
+
   priv = INF_USER_TABLE_PRIVATE(user_table);
+  entry = inf_user_table_lookup_entry(user_table, user);
 
-  g_assert(g_slist_find(priv->availables, user) == NULL);
-  priv->availables = g_slist_prepend(priv->availables, user);
+  g_assert(entry->available_link == NULL);
+  g_queue_push_head(&priv->availables, user);
+  entry->available_link = priv->availables.head;
 }
 
 static void
@@ -335,10 +490,14 @@ inf_user_table_remove_available_user(InfUserTable* user_table,
                                      InfUser* user)
 {
   InfUserTablePrivate* priv;
+  InfUserTableEntry* entry;
+
   priv = INF_USER_TABLE_PRIVATE(user_table);
+  entry = inf_user_table_lookup_entry(user_table, user);
 
-  g_assert(g_slist_find(priv->availables, user) != NULL);
-  priv->availables = g_slist_remove(priv->availables, user);
+  g_assert(entry->available_link != NULL);
+  g_queue_delete_link(&priv->availables, entry->available_link);
+  entry->available_link = NULL;
 }
 
 static void
@@ -346,10 +505,14 @@ inf_user_table_add_local_user(InfUserTable* user_table,
                               InfUser* user)
 {
   InfUserTablePrivate* priv;
+  InfUserTableEntry* entry;
+
   priv = INF_USER_TABLE_PRIVATE(user_table);
+  entry = inf_user_table_lookup_entry(user_table, user);
 
-  g_assert(g_slist_find(priv->locals, user) == NULL);
-  priv->locals = g_slist_prepend(priv->locals, user);
+  g_assert(entry->local_link == NULL);
+  g_queue_push_head(&priv->locals, user);
+  entry->local_link = priv->locals.head;
 }
 
 static void
@@ -357,10 +520,14 @@ inf_user_table_remove_local_user(InfUserTable* user_table,
                                  InfUser* user)
 {
   InfUserTablePrivate* priv;
+  InfUserTableEntry* entry;
+
   priv = INF_USER_TABLE_PRIVATE(user_table);
+  entry = inf_user_table_lookup_entry(user_table, user);
 
-  g_assert(g_slist_find(priv->locals, user) != NULL);
-  priv->locals = g_slist_remove(priv->locals, user);
+  g_assert(entry->local_link != NULL);
+  g_queue_delete_link(&priv->locals, entry->local_link);
+  entry->local_link = NULL;
 }
 
 static void
@@ -593,12 +760,15 @@ inf_user_table_lookup_user_by_id(InfUserTable* user_table,
                                  guint id)
 {
   InfUserTablePrivate* priv;
+  InfUserTableEntry* entry;
 
   g_return_val_if_fail(INF_IS_USER_TABLE(user_table), NULL);
 
   priv = INF_USER_TABLE_PRIVATE(user_table);
+  entry = g_hash_table_lookup(priv->table, GUINT_TO_POINTER(id));
 
-  return INF_USER(g_hash_table_lookup(priv->table, GUINT_TO_POINTER(id)));
+  if(entry == NULL) return NULL;
+  return entry->user;
 }
 
 /**
@@ -615,20 +785,16 @@ inf_user_table_lookup_user_by_name(InfUserTable* user_table,
                                    const gchar* name)
 {
   InfUserTablePrivate* priv;
-  InfUser* user;
+  InfUserTableEntry* entry;
 
   g_return_val_if_fail(INF_IS_USER_TABLE(user_table), NULL);
   g_return_val_if_fail(name != NULL, NULL);
 
   priv = INF_USER_TABLE_PRIVATE(user_table);
+  entry = g_hash_table_lookup(priv->names, name);
 
-  user = g_hash_table_find(
-    priv->table,
-    inf_user_table_lookup_user_by_name_func,
-    *(gpointer*) (gpointer) &name /* cast const away without warning */
-  );
-
-  return user;
+  if(entry == NULL) return NULL;
+  return entry->user;
 }
 
 /**
@@ -680,14 +846,14 @@ inf_user_table_foreach_local_user(InfUserTable* user_table,
                                   gpointer user_data)
 {
   InfUserTablePrivate* priv;
-  GSList* item;
+  GList* item;
 
   g_return_if_fail(INF_IS_USER_TABLE(user_table));
   g_return_if_fail(func != NULL);
 
   priv = INF_USER_TABLE_PRIVATE(user_table);
   
-  for(item = priv->locals; item != NULL; item = g_slist_next(item))
+  for(item = priv->locals.head; item != NULL; item = g_list_next(item))
     func(INF_USER(item->data), user_data);
 }
 
@@ -182,6 +182,13 @@ struct _InfXmppConnectionPrivate {
   xmlNodePtr root;
   xmlNodePtr cur;
 
+  /* Limits for incoming stanzas, and the size and depth of the stanza that
+   * is currently being parsed. */
+  guint max_stanza_size;
+  guint max_stanza_depth;
+  gsize stanza_size;
+  guint stanza_depth;
+
   /* Transport layer security */
   gnutls_session_t session;
   InfCertificateCredentials* creds;
@@ -208,6 +215,8 @@ enum {
   PROP_LOCAL_HOSTNAME,
   PROP_REMOTE_HOSTNAME,
   PROP_SECURITY_POLICY,
+  PROP_MAX_STANZA_SIZE,
+  PROP_MAX_STANZA_DEPTH,
 
   PROP_TLS_ENABLED,
   PROP_CREDENTIALS,
@@ -226,6 +235,11 @@ enum {
 
 #define INF_XMPP_CONNECTION_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TYPE_XMPP_CONNECTION, InfXmppConnectionPrivate))
 
+/* Large payloads such as session synchronizations are split into many small
+ * messages, so a single stanza should never come close to this. */
+#define INF_XMPP_CONNECTION_DEFAULT_MAX_STANZA_SIZE (16 * 1024 * 1024)
+#define INF_XMPP_CONNECTION_DEFAULT_MAX_STANZA_DEPTH 128
+
 static GQuark inf_xmpp_connection_stream_error_quark;
 static GQuark inf_xmpp_connection_auth_error_quark;
 
@@ -674,6 +688,9 @@ inf_xmpp_connection_clear(InfXmppConnection* xmpp)
       priv->root = NULL;
       priv->cur = NULL;
     }
+
+    priv->stanza_size = 0;
+    priv->stanza_depth = 0;
   }
 
   while(priv->messages != NULL)
@@ -1866,6 +1883,66 @@ inf_xmpp_connection_sasl_init(InfXmppConnection* xmpp,
  * XMPP messaging
  */
 
+/* Accounts size bytes and depth nesting levels to the stanza currently
+ * being parsed. If this exceeds the configured limits, then the stream is
+ * closed and the function returns FALSE. In that case the stanza must not
+ * be processed any further, and the counters are left untouched, since the
+ * element that was rejected does not get a matching end_element call. */
+static gboolean
+inf_xmpp_connection_check_stanza_limits(InfXmppConnection* xmpp,
+                                        gsize size,
+                                        guint depth)
+{
+  InfXmppConnectionPrivate* priv;
+  const gchar* message;
+
+  priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+
+  if(priv->max_stanza_size > 0 &&
+     priv->stanza_size + size > priv->max_stanza_size)
+  {
+    message = _("Received a stanza exceeding the maximum stanza size");
+  }
+  else if(priv->max_stanza_depth > 0 &&
+          priv->stanza_depth + depth > priv->max_stanza_depth)
+  {
+    message = _("Received a stanza exceeding the maximum nesting depth");
+  }
+  else
+  {
+    priv->stanza_size += size;
+    priv->stanza_depth += depth;
+    return TRUE;
+  }
+
+  /* Don't let the parser go on with the rest of the received data, it
+   * would only add to a stanza that is thrown away anyway. */
+  xmlStopParser(priv->parser);
+
+  if(priv->status == INF_XMPP_CONNECTION_CLOSED ||
+     priv->status == INF_XMPP_CONNECTION_CLOSING_GNUTLS)
+    return FALSE;
+
+  /* Same as in sax_error(): We cannot send a <stream:error> in these
+   * states. */
+  if(priv->status != INF_XMPP_CONNECTION_ENCRYPTION_REQUESTED &&
+     priv->status != INF_XMPP_CONNECTION_CONNECTED &&
+     priv->status != INF_XMPP_CONNECTION_AUTH_CONNECTED)
+  {
+    inf_xmpp_connection_terminate_error(
+      xmpp,
+      INF_XMPP_CONNECTION_STREAM_ERROR_POLICY_VIOLATION,
+      message
+    );
+  }
+  else
+  {
+    inf_xmpp_connection_terminate(xmpp);
+  }
+
+  return FALSE;
+}
+
 /* This does actually process the start_element event after several
  * special cases have been handled in sax_start_element(). */
 static void
@@ -1875,12 +1952,22 @@ inf_xmpp_connection_process_start_element(InfXmppConnection* xmpp,
 {
   InfXmppConnectionPrivate* priv;
   xmlNodePtr node;
+  gsize size;
 
   const xmlChar** attr;
   const xmlChar* attr_name;
   const xmlChar* attr_value;
 
   priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+
+  size = strlen((const char*)name);
+  if(attrs != NULL)
+    for(attr = attrs; *attr != NULL; ++attr)
+      size += strlen((const char*)*attr);
+
+  if(!inf_xmpp_connection_check_stanza_limits(xmpp, size, 1))
+    return;
+
   node = xmlNewNode(NULL, name);
 
   if(attrs != NULL)
@@ -2649,6 +2736,8 @@ inf_xmpp_connection_process_end_element(InfXmppConnection* xmpp,
   g_assert(strcmp((const gchar*)priv->cur->name, (const gchar*)name) == 0);
 
   priv->cur = priv->cur->parent;
+  --priv->stanza_depth;
+
   if(priv->cur == NULL)
   {
     /* Got a complete XML message */
@@ -2730,6 +2819,9 @@ inf_xmpp_connection_process_end_element(InfXmppConnection* xmpp,
     xmlFreeNode(priv->root);
     priv->root = NULL;
     priv->cur = NULL;
+
+    priv->stanza_size = 0;
+    g_assert(priv->stanza_depth == 0);
   }
 }
 
@@ -2908,6 +3000,12 @@ inf_xmpp_connection_sax_characters(void* context,
 
   g_assert(priv->status != INF_XMPP_CONNECTION_HANDSHAKING);
 
+  /* This can happen when both a chunk which causes the connection to
+   * terminate and character data happen in the same call to
+   * xmlParseChunk */
+  if(priv->status == INF_XMPP_CONNECTION_CLOSING_GNUTLS)
+    return;
+
   if(priv->root == NULL)
   {
     /* Someone sent content of the <stream:stream> node. Ignore. */
@@ -2915,7 +3013,8 @@ inf_xmpp_connection_sax_characters(void* context,
   else
   {
     g_assert(priv->cur != NULL);
-    xmlNodeAddContentLen(priv->cur, content, len);
+    if(inf_xmpp_connection_check_stanza_limits(xmpp, len, 0))
+      xmlNodeAddContentLen(priv->cur, content, len);
   }
 }
 
@@ -3615,6 +3714,11 @@ inf_xmpp_connection_init(InfXmppConnection* connection)
   priv->root = NULL;
   priv->cur = NULL;
 
+  priv->max_stanza_size = 0;
+  priv->max_stanza_depth = 0;
+  priv->stanza_size = 0;
+  priv->stanza_depth = 0;
+
   priv->doc = NULL;
   priv->buf = NULL;
 
@@ -3793,6 +3897,12 @@ inf_xmpp_connection_set_property(GObject* object,
   case PROP_SECURITY_POLICY:
     priv->security_policy = g_value_get_enum(value);
     break;
+  case PROP_MAX_STANZA_SIZE:
+    priv->max_stanza_size = g_value_get_uint(value);
+    break;
+  case PROP_MAX_STANZA_DEPTH:
+    priv->max_stanza_depth = g_value_get_uint(value);
+    break;
   case PROP_CREDENTIALS:
     /* Cannot change credentials when currently in use */
     g_assert(priv->session == NULL);
@@ -3864,6 +3974,12 @@ inf_xmpp_connection_get_property(GObject* object,
   case PROP_SECURITY_POLICY:
     g_value_set_enum(value, priv->security_policy);
     break;
+  case PROP_MAX_STANZA_SIZE:
+    g_value_set_uint(value, priv->max_stanza_size);
+    break;
+  case PROP_MAX_STANZA_DEPTH:
+    g_value_set_uint(value, priv->max_stanza_depth);
+    break;
   case PROP_TLS_ENABLED:
     g_value_set_boolean(value, inf_xmpp_connection_get_tls_enabled(xmpp));
     break;
@@ -4130,6 +4246,36 @@ inf_xmpp_connection_class_init(InfXmppConnectionClass* xmpp_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_MAX_STANZA_SIZE,
+    g_param_spec_uint(
+      "max-stanza-size",
+      "Maximum stanza size",
+      "The maximum number of bytes of element names, attributes and text "
+      "in a single received stanza, or 0 for no limit",
+      0,
+      G_MAXUINT,
+      INF_XMPP_CONNECTION_DEFAULT_MAX_STANZA_SIZE,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_MAX_STANZA_DEPTH,
+    g_param_spec_uint(
+      "max-stanza-depth",
+      "Maximum stanza depth",
+      "The maximum nesting depth of elements in a single received stanza, "
+      "or 0 for no limit",
+      0,
+      G_MAXUINT,
+      INF_XMPP_CONNECTION_DEFAULT_MAX_STANZA_DEPTH,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT
+    )
+  );
+
   g_object_class_install_property(
     object_class,
     PROP_TLS_ENABLED,
@@ -49,12 +49,19 @@ struct _InfCommunicationManagerJoinedKey {
 typedef struct _InfCommunicationManagerPrivate InfCommunicationManagerPrivate;
 struct _InfCommunicationManagerPrivate {
   InfCommunicationRegistry* registry;
+  InfTimingPolicy* timing_policy;
   GPtrArray* factories;
 
   GHashTable* hosted_groups;
   GHashTable* joined_groups;
 };
 
+enum {
+  PROP_0,
+
+  PROP_TIMING_POLICY
+};
+
 #define INF_COMMUNICATION_MANAGER_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_COMMUNICATION_TYPE_MANAGER, InfCommunicationManagerPrivate))
 
 G_DEFINE_TYPE_WITH_CODE(InfCommunicationManager, inf_communication_manager, G_TYPE_OBJECT,
@@ -182,6 +189,7 @@ inf_communication_manager_init(InfCommunicationManager* manager)
   priv = INF_COMMUNICATION_MANAGER_PRIVATE(manager);
 
   priv->registry = g_object_new(INF_COMMUNICATION_TYPE_REGISTRY, NULL);
+  priv->timing_policy = NULL;
   priv->factories = g_ptr_array_new();
   priv->hosted_groups = g_hash_table_new(g_str_hash, g_str_equal);
 
@@ -232,9 +240,73 @@ inf_communication_manager_dispose(GObject* object)
     priv->registry = NULL;
   }
 
+  if(priv->timing_policy != NULL)
+  {
+    g_object_unref(priv->timing_policy);
+    priv->timing_policy = NULL;
+  }
+
   G_OBJECT_CLASS(inf_communication_manager_parent_class)->dispose(object);
 }
 
+static void
+inf_communication_manager_set_property(GObject* object,
+                                       guint prop_id,
+                                       const GValue* value,
+                                       GParamSpec* pspec)
+{
+  InfCommunicationManager* manager;
+  InfCommunicationManagerPrivate* priv;
+
+  manager = INF_COMMUNICATION_MANAGER(object);
+  priv = INF_COMMUNICATION_MANAGER_PRIVATE(manager);
+
+  switch(prop_id)
+  {
+  case PROP_TIMING_POLICY:
+    if(priv->timing_policy != NULL)
+      g_object_unref(priv->timing_policy);
+
+    priv->timing_policy = INF_TIMING_POLICY(g_value_dup_object(value));
+    if(priv->timing_policy == NULL)
+      priv->timing_policy = g_object_ref(inf_timing_policy_get_default());
+
+    g_object_set(
+      G_OBJECT(priv->registry),
+      "timing-policy", priv->timing_policy,
+      NULL
+    );
+
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+inf_communication_manager_get_property(GObject* object,
+                                       guint prop_id,
+                                       GValue* value,
+                                       GParamSpec* pspec)
+{
+  InfCommunicationManager* manager;
+  InfCommunicationManagerPrivate* priv;
+
+  manager = INF_COMMUNICATION_MANAGER(object);
+  priv = INF_COMMUNICATION_MANAGER_PRIVATE(manager);
+
+  switch(prop_id)
+  {
+  case PROP_TIMING_POLICY:
+    g_value_set_object(value, G_OBJECT(priv->timing_policy));
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
 static void
 inf_communication_manager_class_init(
   InfCommunicationManagerClass* manager_class)
@@ -243,6 +315,22 @@ inf_communication_manager_class_init(
   object_class = G_OBJECT_CLASS(manager_class);
 
   object_class->dispose = inf_communication_manager_dispose;
+  object_class->set_property = inf_communication_manager_set_property;
+  object_class->get_property = inf_communication_manager_get_property;
+
+  g_object_class_install_property(
+    object_class,
+    PROP_TIMING_POLICY,
+    g_param_spec_object(
+      "timing-policy",
+      "Timing policy",
+      "The policy used by the communication registry to limit the number "
+      "of messages enqueued on a connection, and by sessions which do not "
+      "have a policy of their own. If unset, the default policy is used",
+      INF_TYPE_TIMING_POLICY,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT
+    )
+  );
 }
 
 /**
@@ -498,4 +586,20 @@ inf_communication_manager_get_factory_for(InfCommunicationManager* manager,
   return NULL;
 }
 
+/**
+ * inf_communication_manager_get_timing_policy:
+ * @manager: A #InfCommunicationManager.
+ *
+ * Returns the #InfTimingPolicy used by @manager, see
+ * #InfCommunicationManager:timing-policy.
+ *
+ * Returns: (transfer none): The timing policy of @manager.
+ */
+InfTimingPolicy*
+inf_communication_manager_get_timing_policy(InfCommunicationManager* manager)
+{
+  g_return_val_if_fail(INF_COMMUNICATION_IS_MANAGER(manager), NULL);
+  return INF_COMMUNICATION_MANAGER_PRIVATE(manager)->timing_policy;
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -34,11 +34,22 @@
  * inf_communication_method_enqueued() when sending the message cannot be
  * cancelled anymore via inf_communication_registry_cancel_messages() and
  * inf_communication_method_sent() when the message has been sent.
+ *
+ * Messages for the same group are always sent in the order in which they
+ * were scheduled. Between different groups on the same connection, the
+ * registry prioritizes short exchanges such as requests and user status
+ * updates over bulk transfers such as a session synchronization or a large
+ * directory exploration: a group which has more messages scheduled than fit
+ * into a single container is considered a bulk transfer, and only one such
+ * container is sent at a time per connection, with all bulk transfers on the
+ * connection taking turns. Messages of other groups are sent right away, so
+ * they only have to wait for at most one bulk container.
  **/
 
 #include <libinfinity/communication/inf-communication-registry.h>
 #include <libinfinity/communication/inf-communication-group-private.h>
 #include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-timing-policy.h>
 #include <libinfinity/inf-signals.h>
 
 #include <string.h>
@@ -64,9 +75,14 @@ struct _InfCommunicationRegistryEntry {
 
   /* Queue of messages to send */
   guint inner_count;
+  guint queue_length;
   xmlNodePtr queue_begin;
   xmlNodePtr queue_end;
 
+  /* Bulk transfer scheduling, see InfCommunicationRegistrySchedule */
+  gboolean bulk;
+  gboolean waiting;
+
   /* Activation status */
   gboolean registered;
   guint activation_count; /* # messages to be sent until activation */
@@ -75,6 +91,15 @@ struct _InfCommunicationRegistryEntry {
   xmlNodePtr sent_list;
 };
 
+/* Entries with a backlog of messages share one container in flight per
+ * connection. The schedule only exists while one of them is sending. */
+typedef struct _InfCommunicationRegistrySchedule
+  InfCommunicationRegistrySchedule;
+struct _InfCommunicationRegistrySchedule {
+  InfCommunicationRegistryEntry* bulk_entry;
+  GQueue waiting;
+};
+
 typedef struct _InfCommunicationRegistryForeachMethodData
   InfCommunicationRegistryForeachMethodData;
 struct _InfCommunicationRegistryForeachMethodData {
@@ -87,6 +112,15 @@ typedef struct _InfCommunicationRegistryPrivate
 struct _InfCommunicationRegistryPrivate {
   GHashTable* connections;
   GHashTable* entries;
+  GHashTable* schedules;
+
+  InfTimingPolicy* timing_policy;
+};
+
+enum {
+  PROP_0,
+
+  PROP_TIMING_POLICY
 };
 
 #define INF_COMMUNICATION_REGISTRY_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_COMMUNICATION_TYPE_REGISTRY, InfCommunicationRegistryPrivate))
@@ -94,9 +128,6 @@ struct _InfCommunicationRegistryPrivate {
 G_DEFINE_TYPE_WITH_CODE(InfCommunicationRegistry, inf_communication_registry, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfCommunicationRegistry))
 
-/* Maximum number of messages enqueued at the same time */
-static const guint INF_COMMUNICATION_REGISTRY_INNER_QUEUE_LIMIT = 5;
-
 static void
 inf_communication_registry_send_real(InfCommunicationRegistryEntry* entry,
                                      guint num_messages)
@@ -125,6 +156,7 @@ inf_communication_registry_send_real(InfCommunicationRegistryEntry* entry,
   {
     entry->queue_begin = entry->queue_begin->next;
     if(entry->queue_begin == NULL) entry->queue_end = NULL;
+    -- entry->queue_length;
     ++ entry->inner_count;
 
     xmlUnlinkNode(xml);
@@ -192,6 +224,138 @@ inf_communication_registry_send_real(InfCommunicationRegistryEntry* entry,
   }
 }
 
+static void
+inf_communication_registry_schedule_free(gpointer data)
+{
+  InfCommunicationRegistrySchedule* schedule;
+  InfCommunicationRegistryEntry* entry;
+  GList* item;
+
+  schedule = (InfCommunicationRegistrySchedule*)data;
+
+  /* Detach the entries, so that they do not try to remove themselves from
+   * the schedule when they are freed. */
+  if(schedule->bulk_entry != NULL)
+    schedule->bulk_entry->bulk = FALSE;
+
+  for(item = schedule->waiting.head; item != NULL; item = item->next)
+  {
+    entry = (InfCommunicationRegistryEntry*)item->data;
+    entry->waiting = FALSE;
+  }
+
+  g_queue_clear(&schedule->waiting);
+  g_slice_free(InfCommunicationRegistrySchedule, schedule);
+}
+
+static void
+inf_communication_registry_schedule_next(InfCommunicationRegistry* registry,
+                                         InfXmlConnection* connection)
+{
+  InfCommunicationRegistryPrivate* priv;
+  InfCommunicationRegistrySchedule* schedule;
+  InfCommunicationRegistryEntry* entry;
+  InfXmlConnectionStatus status;
+
+  priv = INF_COMMUNICATION_REGISTRY_PRIVATE(registry);
+  schedule = g_hash_table_lookup(priv->schedules, connection);
+  if(schedule == NULL || schedule->bulk_entry != NULL) return;
+
+  if(g_queue_is_empty(&schedule->waiting))
+  {
+    g_hash_table_remove(priv->schedules, connection);
+    return;
+  }
+
+  /* Nothing is sent anymore on a closed connection. The waiting entries are
+   * removed from the schedule when they are freed. */
+  g_object_get(G_OBJECT(connection), "status", &status, NULL);
+  if(status != INF_XML_CONNECTION_OPEN)
+    return;
+
+  entry = g_queue_pop_head(&schedule->waiting);
+  entry->waiting = FALSE;
+  entry->bulk = TRUE;
+  schedule->bulk_entry = entry;
+
+  inf_communication_registry_send_real(
+    entry,
+    inf_timing_policy_get_inner_queue_limit(priv->timing_policy)
+  );
+}
+
+/* Sends the next messages of entry if it is not waiting for previous ones
+ * to be sent. */
+static void
+inf_communication_registry_flush(InfCommunicationRegistryEntry* entry)
+{
+  InfCommunicationRegistryPrivate* priv;
+  InfCommunicationRegistrySchedule* schedule;
+  guint limit;
+
+  if(entry->queue_begin == NULL || entry->inner_count > 0) return;
+  if(entry->bulk == TRUE || entry->waiting == TRUE) return;
+
+  priv = INF_COMMUNICATION_REGISTRY_PRIVATE(entry->registry);
+  limit = inf_timing_policy_get_inner_queue_limit(priv->timing_policy);
+
+  if(entry->queue_length <= limit)
+  {
+    inf_communication_registry_send_real(entry, limit);
+  }
+  else
+  {
+    schedule = g_hash_table_lookup(priv->schedules, entry->key.connection);
+    if(schedule == NULL)
+    {
+      schedule = g_slice_new(InfCommunicationRegistrySchedule);
+      schedule->bulk_entry = NULL;
+      g_queue_init(&schedule->waiting);
+
+      g_hash_table_insert(
+        priv->schedules,
+        entry->key.connection,
+        schedule
+      );
+    }
+
+    entry->waiting = TRUE;
+    g_queue_push_tail(&schedule->waiting, entry);
+
+    inf_communication_registry_schedule_next(
+      entry->registry,
+      entry->key.connection
+    );
+  }
+}
+
+/* Removes entry from the schedule of its connection. The caller needs to
+ * call inf_communication_registry_schedule_next() afterwards so that the
+ * next bulk transfer can continue. */
+static void
+inf_communication_registry_release(InfCommunicationRegistryEntry* entry)
+{
+  InfCommunicationRegistryPrivate* priv;
+  InfCommunicationRegistrySchedule* schedule;
+
+  priv = INF_COMMUNICATION_REGISTRY_PRIVATE(entry->registry);
+  schedule = g_hash_table_lookup(priv->schedules, entry->key.connection);
+  g_assert(schedule != NULL);
+
+  if(entry->bulk == TRUE)
+  {
+    g_assert(schedule->bulk_entry == entry);
+    schedule->bulk_entry = NULL;
+    entry->bulk = FALSE;
+  }
+
+  if(entry->waiting == TRUE)
+  {
+    g_queue_remove(&schedule->waiting, entry);
+    entry->waiting = FALSE;
+  }
+}
+
 /* Required by inf_communication_registry_entry_free() */
 static void
 inf_communication_registry_group_unrefed(gpointer user_data,
@@ -228,6 +392,16 @@ inf_communication_registry_entry_free(gpointer data)
       inf_communication_registry_send_real(entry, G_MAXUINT);
   }
 
+  if(entry->bulk == TRUE || entry->waiting == TRUE)
+  {
+    inf_communication_registry_release(entry);
+
+    inf_communication_registry_schedule_next(
+      entry->registry,
+      entry->key.connection
+    );
+  }
+
   if(entry->group)
   {
     g_object_weak_unref(
@@ -483,12 +657,21 @@ inf_communication_registry_sent_cb(InfXmlConnection* connection,
      * decreased, so we can send more messages now. */
     /* Send next bunch of messages if inner_count reached zero, meaning no
      * more messages have been enqueued, for better packing. */
-    if(entry->inner_count == 0 && entry->queue_end != NULL)
+    if(entry->inner_count == 0)
     {
-      inf_communication_registry_send_real(
-        entry,
-        INF_COMMUNICATION_REGISTRY_INNER_QUEUE_LIMIT - entry->inner_count
-      );
+      /* If this was a bulk container, then the entry goes to the end of the
+       * line so that the other bulk transfers on this connection get their
+       * turn before it sends the next one. */
+      if(entry->bulk == TRUE)
+      {
+        inf_communication_registry_release(entry);
+        inf_communication_registry_flush(entry);
+        inf_communication_registry_schedule_next(registry, connection);
+      }
+      else
+      {
+        inf_communication_registry_flush(entry);
+      }
     }
 
     /* Free the entry in case all scheduled messages have been sent after
@@ -716,6 +899,14 @@ inf_communication_registry_init(InfCommunicationRegistry* registry)
     NULL,
     inf_communication_registry_entry_free
   );
+
+  priv->schedules = g_hash_table_new_full(
+    NULL,
+    NULL,
+    NULL,
+    inf_communication_registry_schedule_free
+  );
+  priv->timing_policy = NULL;
 }
 
 static void
@@ -764,12 +955,74 @@ inf_communication_registry_dispose(GObject* object)
     }
   }
 
+  /* Drop the schedules before the entries, so that freeing the entries
+   * does not start the next bulk transfer on a registry which goes away.
+   * The remaining messages of each entry are still sent when it is freed. */
+  g_hash_table_unref(priv->schedules);
   g_hash_table_unref(priv->connections);
   g_hash_table_unref(priv->entries);
 
+  if(priv->timing_policy != NULL)
+  {
+    g_object_unref(priv->timing_policy);
+    priv->timing_policy = NULL;
+  }
+
   G_OBJECT_CLASS(inf_communication_registry_parent_class)->dispose(object);
 }
 
+static void
+inf_communication_registry_set_property(GObject* object,
+                                        guint prop_id,
+                                        const GValue* value,
+                                        GParamSpec* pspec)
+{
+  InfCommunicationRegistry* registry;
+  InfCommunicationRegistryPrivate* priv;
+
+  registry = INF_COMMUNICATION_REGISTRY(object);
+  priv = INF_COMMUNICATION_REGISTRY_PRIVATE(registry);
+
+  switch(prop_id)
+  {
+  case PROP_TIMING_POLICY:
+    if(priv->timing_policy != NULL)
+      g_object_unref(priv->timing_policy);
+
+    priv->timing_policy = INF_TIMING_POLICY(g_value_dup_object(value));
+    if(priv->timing_policy == NULL)
+      priv->timing_policy = g_object_ref(inf_timing_policy_get_default());
+
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+inf_communication_registry_get_property(GObject* object,
+                                        guint prop_id,
+                                        GValue* value,
+                                        GParamSpec* pspec)
+{
+  InfCommunicationRegistry* registry;
+  InfCommunicationRegistryPrivate* priv;
+
+  registry = INF_COMMUNICATION_REGISTRY(object);
+  priv = INF_COMMUNICATION_REGISTRY_PRIVATE(registry);
+
+  switch(prop_id)
+  {
+  case PROP_TIMING_POLICY:
+    g_value_set_object(value, G_OBJECT(priv->timing_policy));
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
 static void
 inf_communication_registry_class_init(
   InfCommunicationRegistryClass* registry_class)
@@ -778,6 +1031,21 @@ inf_communication_registry_class_init(
   object_class = G_OBJECT_CLASS(registry_class);
 
   object_class->dispose = inf_communication_registry_dispose;
+  object_class->set_property = inf_communication_registry_set_property;
+  object_class->get_property = inf_communication_registry_get_property;
+
+  g_object_class_install_property(
+    object_class,
+    PROP_TIMING_POLICY,
+    g_param_spec_object(
+      "timing-policy",
+      "Timing policy",
+      "The policy which determines how many messages are enqueued on a "
+      "connection at the same time. If unset, the default policy is used",
+      INF_TYPE_TIMING_POLICY,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT
+    )
+  );
 }
 
 /**
@@ -856,9 +1124,13 @@ inf_communication_registry_register(InfCommunicationRegistry* registry,
     entry->method = method;
 
     entry->inner_count = 0;
+    entry->queue_length = 0;
     entry->queue_begin = NULL;
     entry->queue_end = NULL;
 
+    entry->bulk = FALSE;
+    entry->waiting = FALSE;
+
     entry->registered = TRUE;
     entry->activation_count = 0;
 
@@ -1027,15 +1299,11 @@ inf_communication_registry_send(InfCommunicationRegistry* registry,
     entry->queue_end = xml;
   }
 
+  ++ entry->queue_length;
+
   /* If there is something in the inner queue, don't send directly but wait
    * until the message has been sent, for better packing. */
-  if(entry->inner_count == 0)
-  {
-    inf_communication_registry_send_real(
-      entry,
-      INF_COMMUNICATION_REGISTRY_INNER_QUEUE_LIMIT - entry->inner_count
-    );
-  }
+  inf_communication_registry_flush(entry);
 
   g_free(key.publisher_id);
 }
@@ -1075,6 +1343,13 @@ inf_communication_registry_cancel_messages(InfCommunicationRegistry* registry,
   xmlFreeNodeList(entry->queue_begin);
   entry->queue_begin = NULL;
   entry->queue_end = NULL;
+  entry->queue_length = 0;
+
+  if(entry->waiting == TRUE)
+  {
+    inf_communication_registry_release(entry);
+    inf_communication_registry_schedule_next(registry, connection);
+  }
 
   g_free(key.publisher_id);
 }
@@ -29,7 +29,7 @@
  * The functions in this section are utility functions that can be used when
  * implementing a #InfdNotePlugin to handle #InfChatSession<!-- -->s. These
  * functions implement reading and writing the content of an #InfChatSession
- * to an XML file in the storage.
+ * to an XML file in the storage, and locating the session's message archive.
  */
 
 #include <libinfinity/server/infd-chat-filesystem-format.h>
@@ -253,4 +253,31 @@ infd_chat_filesystem_format_write(InfdFilesystemStorage* storage,
   return TRUE;
 }
 
+/**
+ * infd_chat_filesystem_format_get_archive_path:
+ * @storage: A #InfdFilesystemStorage.
+ * @path: Storage path of the chat session.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Returns the filename of the message archive for the chat session stored
+ * at @path in @storage, which can be passed to
+ * inf_chat_session_set_archive_file(). The archive is stored next to the
+ * session itself, but does not show up in the directory listing. If the
+ * function fails, %NULL is returned and @error is set.
+ *
+ * Returns: (type filename) (allow-none) (transfer full): An absolute
+ * filename to be freed with g_free(), or %NULL.
+ */
+gchar*
+infd_chat_filesystem_format_get_archive_path(InfdFilesystemStorage* storage,
+                                             const gchar* path,
+                                             GError** error)
+{
+  g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), NULL);
+  g_return_val_if_fail(path != NULL, NULL);
+  g_return_val_if_fail(error == NULL || *error == NULL, NULL);
+
+  return infd_filesystem_storage_get_path(storage, "archive", path, error);
+}
+
 /* vim:set et sw=2 ts=2: */
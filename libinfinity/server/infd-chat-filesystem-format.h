@@ -51,6 +51,11 @@ infd_chat_filesystem_format_write(InfdFilesystemStorage* storage,
                                   InfChatBuffer* buffer,
                                   GError** error);
 
+gchar*
+infd_chat_filesystem_format_get_archive_path(InfdFilesystemStorage* storage,
+                                             const gchar* path,
+                                             GError** error);
+
 G_END_DECLS
 
 #endif /* __INFD_CHAT_FILESYSTEM_FORMAT_H__ */
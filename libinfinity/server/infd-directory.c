@@ -45,6 +45,8 @@
 #include <libinfinity/common/inf-protocol.h>
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/common/inf-cert-util.h>
+#include <libinfinity/common/inf-timing-policy.h>
+#include <libinfinity/common/inf-xmpp-connection.h>
 #include <libinfinity/communication/inf-communication-object.h>
 #include <libinfinity/inf-i18n.h>
 #include <libinfinity/inf-signals.h>
@@ -181,6 +183,16 @@ struct _InfdDirectoryTransientAccount {
   gchar* dn;
 };
 
+/* Remembers which account a client certificate logs into, so that
+ * reconnecting clients do not need to go through the account storage. */
+typedef struct _InfdDirectoryCertificateCacheEntry
+  InfdDirectoryCertificateCacheEntry;
+struct _InfdDirectoryCertificateCacheEntry {
+  GBytes* fingerprint;
+  InfAclAccountId account_id; /* 0 if the certificate has no account */
+  GList* link; /* in certificate_cache_lru */
+};
+
 typedef struct _InfdDirectoryPrivate InfdDirectoryPrivate;
 struct _InfdDirectoryPrivate {
   InfIo* io;
@@ -198,6 +210,13 @@ struct _InfdDirectoryPrivate {
   InfdDirectoryTransientAccount* transient_accounts;
   guint n_transient_accounts;
 
+  /* fingerprint -> InfdDirectoryCertificateCacheEntry */
+  GHashTable* certificate_cache;
+  GQueue certificate_cache_lru; /* most recently used first */
+  guint certificate_cache_size;
+  guint64 certificate_cache_hits;
+  guint64 certificate_cache_misses;
+
   guint node_counter;
   GHashTable* nodes; /* Mapping from id to node */
   InfdDirectoryNode* root;
@@ -207,6 +226,9 @@ struct _InfdDirectoryPrivate {
   GSList* subscription_requests;
 
   InfdSessionProxy* chat_session;
+
+  InfTimingPolicy* timing_policy;
+  InfIoTimeout* timing_timeout;
 };
 
 enum {
@@ -219,6 +241,8 @@ enum {
 
   PROP_PRIVATE_KEY,
   PROP_CERTIFICATE,
+  PROP_CERTIFICATE_CACHE_SIZE,
+  PROP_TIMING_POLICY,
 
   /* read only */
   PROP_CHAT_SESSION,
@@ -275,9 +299,9 @@ static const unsigned int DAYS = 24 * 60 * 60;
 static guint directory_signals[LAST_SIGNAL];
 static GQuark infd_directory_node_id_quark;
 
-/* Time a session needs to be idle before it is unloaded from RAM */
-/* TODO: This should be a property: */
-static const guint INFD_DIRECTORY_SAVE_TIMEOUT = 60000;
+/* Interval in which round trip times and load are reported to the
+ * timing policy */
+static const guint INFD_DIRECTORY_TIMING_SAMPLE_INTERVAL = 10000;
 
 static void infd_directory_communication_object_iface_init(InfCommunicationObjectInterface* iface);
 static void infd_directory_browser_iface_init(InfBrowserInterface* iface);
@@ -448,6 +472,50 @@ infd_directory_session_save_timeout_func(gpointer user_data)
   g_free(path);
 }
 
+static void
+infd_directory_timing_sample_func(gpointer user_data)
+{
+  InfdDirectory* directory;
+  InfdDirectoryPrivate* priv;
+  GHashTableIter iter;
+  gpointer key;
+  InfTcpConnection* tcp;
+
+  directory = INFD_DIRECTORY(user_data);
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  g_hash_table_iter_init(&iter, priv->connections);
+  while(g_hash_table_iter_next(&iter, &key, NULL))
+  {
+    if(INF_IS_XMPP_CONNECTION(key))
+    {
+      g_object_get(G_OBJECT(key), "tcp-connection", &tcp, NULL);
+      if(tcp != NULL)
+      {
+        inf_timing_policy_add_round_trip_time(
+          priv->timing_policy,
+          inf_tcp_connection_get_round_trip_time(tcp)
+        );
+
+        g_object_unref(tcp);
+      }
+    }
+  }
+
+  inf_timing_policy_set_load(
+    priv->timing_policy,
+    g_hash_table_size(priv->connections)
+  );
+
+  priv->timing_timeout = inf_io_add_timeout(
+    priv->io,
+    INFD_DIRECTORY_TIMING_SAMPLE_INTERVAL,
+    infd_directory_timing_sample_func,
+    directory,
+    NULL
+  );
+}
+
 static void
 infd_directory_start_session_save_timeout(InfdDirectory* directory,
                                           InfdDirectoryNode* node)
@@ -464,7 +532,7 @@ infd_directory_start_session_save_timeout(InfdDirectory* directory,
   {
     node->shared.note.save_timeout = inf_io_add_timeout(
       priv->io,
-      INFD_DIRECTORY_SAVE_TIMEOUT,
+      inf_timing_policy_get_save_timeout(priv->timing_policy),
       infd_directory_session_save_timeout_func,
       timeout_data,
       infd_directory_session_save_timeout_data_free
@@ -764,43 +832,208 @@ infd_directory_acl_sheets_to_xml_for_connection(InfdDirectory* directory,
   return TRUE;
 }
 
+/* Builds the message for one class of connections that see the same ACL
+ * sheets: a copy of xml with the given sheets appended. Returns NULL if
+ * there are no sheets and skip_empty is TRUE. */
+static xmlNodePtr
+infd_directory_acl_sheets_payload(xmlNodePtr xml,
+                                  const InfAclSheet* sheets,
+                                  guint n_sheets,
+                                  gboolean skip_empty)
+{
+  InfAclSheetSet set;
+  xmlNodePtr payload;
+
+  if(n_sheets == 0 && skip_empty == TRUE)
+    return NULL;
+
+  payload = xmlCopyNode(xml, 1);
+  if(n_sheets > 0)
+  {
+    set.own_sheets = NULL;
+    set.sheets = sheets;
+    set.n_sheets = n_sheets;
+    inf_acl_sheet_set_to_xml(&set, payload);
+  }
+
+  return payload;
+}
+
+/* Sends xml to all connections in connections except except, with the
+ * sheets of node's sheet set appended that each connection is allowed to
+ * see, as infd_directory_acl_sheets_to_xml_for_connection() does.
+ * Connections that see the same sheets are grouped together, so that the
+ * sheets are selected and converted to XML only once per group instead of
+ * once per connection. The groups are the connections that queried the
+ * full ACL, the connections of each account with a sheet in the set, and
+ * all others, which only see the default sheet. If skip_empty is TRUE,
+ * nothing is sent to connections that do not see any sheets. */
 static void
-infd_directory_announce_acl_sheets_for_connection(InfdDirectory* directory,
-                                                  const InfdDirectoryNode* nd,
-                                                  const InfAclSheetSet* shts,
-                                                  InfXmlConnection* conn)
+infd_directory_send_with_acl_sheets(InfdDirectory* directory,
+                                    const InfdDirectoryNode* node,
+                                    const InfAclSheetSet* sheets,
+                                    GSList* connections,
+                                    InfXmlConnection* except,
+                                    xmlNodePtr xml,
+                                    gboolean skip_empty)
 {
   InfdDirectoryPrivate* priv;
-  gboolean has_sheets;
-  xmlNodePtr xml;
-  gboolean any_sheets;
+  InfdDirectoryConnectionInfo* info;
+  GHashTable* acl_connections;
+  GHashTable* account_sheets;
+  GHashTable* account_payloads;
+  const InfAclSheet* default_sheet;
+  const InfAclSheet* own_sheet;
+  InfAclSheet selected_sheets[2];
+  guint n_selected;
+  xmlNodePtr full_payload;
+  xmlNodePtr default_payload;
+  gboolean have_full_payload;
+  gboolean have_default_payload;
+  xmlNodePtr payload;
+  GSList* item;
+  guint i;
 
   priv = INFD_DIRECTORY_PRIVATE(directory);
 
-  xml = xmlNewNode(NULL, (const xmlChar*)"set-acl");
+  acl_connections = g_hash_table_new(NULL, NULL);
+  for(item = node->acl_connections; item != NULL; item = item->next)
+    g_hash_table_insert(acl_connections, item->data, item->data);
 
-  any_sheets = infd_directory_acl_sheets_to_xml_for_connection(
-    directory,
-    nd->acl_connections,
-    shts,
-    conn,
-    xml
+  account_sheets = g_hash_table_new(NULL, NULL);
+  for(i = 0; sheets != NULL && i < sheets->n_sheets; ++i)
+  {
+    g_hash_table_insert(
+      account_sheets,
+      GUINT_TO_POINTER(sheets->sheets[i].account),
+      (gpointer)&sheets->sheets[i]
+    );
+  }
+
+  default_sheet = g_hash_table_lookup(
+    account_sheets,
+    GUINT_TO_POINTER(inf_acl_account_id_from_string("default"))
   );
 
-  if(any_sheets == TRUE)
+  if(default_sheet != NULL)
   {
-    inf_xml_util_set_attribute_uint(xml, "id", nd->id);
-
-    inf_communication_group_send_message(
-      INF_COMMUNICATION_GROUP(priv->group),
-      conn,
-      xml
+    g_hash_table_remove(
+      account_sheets,
+      GUINT_TO_POINTER(default_sheet->account)
     );
   }
-  else
+
+  account_payloads = g_hash_table_new_full(
+    NULL,
+    NULL,
+    NULL,
+    (GDestroyNotify)xmlFreeNode
+  );
+
+  full_payload = NULL;
+  default_payload = NULL;
+  have_full_payload = FALSE;
+  have_default_payload = FALSE;
+
+  for(item = connections; item != NULL; item = item->next)
   {
-    xmlFreeNode(xml);
+    if(item->data == except)
+      continue;
+
+    if(g_hash_table_lookup(acl_connections, item->data) != NULL)
+    {
+      if(have_full_payload == FALSE)
+      {
+        full_payload = infd_directory_acl_sheets_payload(
+          xml,
+          sheets != NULL ? sheets->sheets : NULL,
+          sheets != NULL ? sheets->n_sheets : 0,
+          skip_empty
+        );
+
+        have_full_payload = TRUE;
+      }
+
+      payload = full_payload;
+    }
+    else
+    {
+      info = g_hash_table_lookup(priv->connections, item->data);
+      g_assert(info != NULL);
+
+      own_sheet = g_hash_table_lookup(
+        account_sheets,
+        GUINT_TO_POINTER(info->account_id)
+      );
+
+      if(own_sheet != NULL)
+      {
+        payload = g_hash_table_lookup(
+          account_payloads,
+          GUINT_TO_POINTER(info->account_id)
+        );
+
+        if(payload == NULL)
+        {
+          /* Keep the order of the sheet set */
+          n_selected = 0;
+          if(default_sheet != NULL && default_sheet < own_sheet)
+            selected_sheets[n_selected++] = *default_sheet;
+          selected_sheets[n_selected++] = *own_sheet;
+          if(default_sheet != NULL && default_sheet > own_sheet)
+            selected_sheets[n_selected++] = *default_sheet;
+
+          payload = infd_directory_acl_sheets_payload(
+            xml,
+            selected_sheets,
+            n_selected,
+            skip_empty
+          );
+
+          g_hash_table_insert(
+            account_payloads,
+            GUINT_TO_POINTER(info->account_id),
+            payload
+          );
+        }
+      }
+      else
+      {
+        /* Connections without a sheet of their own share one message */
+        if(have_default_payload == FALSE)
+        {
+          default_payload = infd_directory_acl_sheets_payload(
+            xml,
+            default_sheet,
+            default_sheet != NULL ? 1 : 0,
+            skip_empty
+          );
+
+          have_default_payload = TRUE;
+        }
+
+        payload = default_payload;
+      }
+    }
+
+    if(payload != NULL)
+    {
+      inf_communication_group_send_message(
+        INF_COMMUNICATION_GROUP(priv->group),
+        INF_XML_CONNECTION(item->data),
+        xmlCopyNode(payload, 1)
+      );
+    }
   }
+
+  if(full_payload != NULL)
+    xmlFreeNode(full_payload);
+  if(default_payload != NULL)
+    xmlFreeNode(default_payload);
+
+  g_hash_table_destroy(account_payloads);
+  g_hash_table_destroy(account_sheets);
+  g_hash_table_destroy(acl_connections);
 }
 
 static void
@@ -812,55 +1045,52 @@ infd_directory_announce_acl_sheets(InfdDirectory* directory,
 {
   InfdDirectoryPrivate* priv;
   xmlNodePtr xml;
-  GList* connection_list;
-  GSList* local_connection_list;
-  GList* item;
-  GSList* local_item;
+  GSList* connection_list;
+  GHashTableIter hash_iter;
+  gpointer key;
   InfBrowserIter iter;
 
   priv = INFD_DIRECTORY_PRIVATE(directory);
 
+  xml = xmlNewNode(NULL, (const xmlChar*)"set-acl");
+  inf_xml_util_set_attribute_uint(xml, "id", node->id);
+
   /* Go through all connections that see this node, i.e. have explored the
    * parent node. To those connections we need to send an ACL update. */
   if(node->parent == NULL)
   {
-    connection_list = g_hash_table_get_keys(priv->connections);
+    connection_list = NULL;
+    g_hash_table_iter_init(&hash_iter, priv->connections);
+    while(g_hash_table_iter_next(&hash_iter, &key, NULL))
+      connection_list = g_slist_prepend(connection_list, key);
 
-    for(item = connection_list; item != NULL; item = g_list_next(item))
-    {
-      if(item->data != except)
-      {
-        infd_directory_announce_acl_sheets_for_connection(
-          directory,
-          node,
-          sheet_set,
-          INF_XML_CONNECTION(item->data)
-        );
-      }
-    }
+    infd_directory_send_with_acl_sheets(
+      directory,
+      node,
+      sheet_set,
+      connection_list,
+      except,
+      xml,
+      TRUE
+    );
 
-    g_list_free(connection_list);
+    g_slist_free(connection_list);
   }
   else
   {
-    local_connection_list = node->parent->shared.subdir.connections;
-
-    for(local_item = local_connection_list;
-        local_item != NULL;
-        local_item = g_slist_next(local_item))
-    {
-      if(local_item->data != except)
-      {
-        infd_directory_announce_acl_sheets_for_connection(
-          directory,
-          node,
-          sheet_set,
-          INF_XML_CONNECTION(local_item->data)
-        );
-      }
-    }
+    infd_directory_send_with_acl_sheets(
+      directory,
+      node,
+      sheet_set,
+      node->parent->shared.subdir.connections,
+      except,
+      xml,
+      TRUE
+    );
   }
 
+  xmlFreeNode(xml);
+
   iter.node_id = node->id;
   iter.node = node;
 
@@ -872,6 +1102,184 @@ infd_directory_announce_acl_sheets(InfdDirectory* directory,
   );
 }
 
+/*
+ * Certificate login cache
+ */
+
+static void
+infd_directory_certificate_cache_entry_free(gpointer data)
+{
+  InfdDirectoryCertificateCacheEntry* entry;
+  entry = (InfdDirectoryCertificateCacheEntry*)data;
+
+  g_bytes_unref(entry->fingerprint);
+  g_slice_free(InfdDirectoryCertificateCacheEntry, entry);
+}
+
+static GBytes*
+infd_directory_certificate_cache_get_key(gnutls_x509_crt_t cert)
+{
+  guchar fingerprint[32];
+  size_t size;
+  int ret;
+
+  size = sizeof(fingerprint);
+  ret = gnutls_x509_crt_get_fingerprint(
+    cert,
+    GNUTLS_DIG_SHA256,
+    fingerprint,
+    &size
+  );
+
+  /* Without a fingerprint, the certificate simply is not cached */
+  if(ret != GNUTLS_E_SUCCESS)
+    return NULL;
+
+  return g_bytes_new(fingerprint, size);
+}
+
+static void
+infd_directory_certificate_cache_remove_entry(
+  InfdDirectory* directory,
+  InfdDirectoryCertificateCacheEntry* entry)
+{
+  InfdDirectoryPrivate* priv;
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  g_queue_delete_link(&priv->certificate_cache_lru, entry->link);
+  g_hash_table_remove(priv->certificate_cache, entry->fingerprint);
+}
+
+static void
+infd_directory_certificate_cache_trim(InfdDirectory* directory)
+{
+  InfdDirectoryPrivate* priv;
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  while(priv->certificate_cache_lru.length > priv->certificate_cache_size)
+  {
+    infd_directory_certificate_cache_remove_entry(
+      directory,
+      (InfdDirectoryCertificateCacheEntry*)priv->certificate_cache_lru.tail->data
+    );
+  }
+}
+
+static void
+infd_directory_certificate_cache_clear(InfdDirectory* directory)
+{
+  InfdDirectoryPrivate* priv;
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  g_queue_clear(&priv->certificate_cache_lru);
+  g_hash_table_remove_all(priv->certificate_cache);
+}
+
+static gboolean
+infd_directory_certificate_cache_lookup(InfdDirectory* directory,
+                                        GBytes* key,
+                                        InfAclAccountId* account_id)
+{
+  InfdDirectoryPrivate* priv;
+  InfdDirectoryCertificateCacheEntry* entry;
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+  if(priv->certificate_cache_size == 0)
+    return FALSE;
+
+  entry = g_hash_table_lookup(priv->certificate_cache, key);
+  if(entry == NULL)
+  {
+    ++priv->certificate_cache_misses;
+    return FALSE;
+  }
+
+  ++priv->certificate_cache_hits;
+
+  g_queue_unlink(&priv->certificate_cache_lru, entry->link);
+  g_queue_push_head_link(&priv->certificate_cache_lru, entry->link);
+
+  *account_id = entry->account_id;
+  return TRUE;
+}
+
+static void
+infd_directory_certificate_cache_insert(InfdDirectory* directory,
+                                        GBytes* key,
+                                        InfAclAccountId account_id)
+{
+  InfdDirectoryPrivate* priv;
+  InfdDirectoryCertificateCacheEntry* entry;
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+  if(priv->certificate_cache_size == 0)
+    return;
+
+  entry = g_hash_table_lookup(priv->certificate_cache, key);
+  if(entry != NULL)
+    infd_directory_certificate_cache_remove_entry(directory, entry);
+
+  entry = g_slice_new(InfdDirectoryCertificateCacheEntry);
+  entry->fingerprint = g_bytes_ref(key);
+  entry->account_id = account_id;
+
+  g_queue_push_head(&priv->certificate_cache_lru, entry);
+  entry->link = priv->certificate_cache_lru.head;
+  g_hash_table_insert(priv->certificate_cache, entry->fingerprint, entry);
+
+  infd_directory_certificate_cache_trim(directory);
+}
+
+/* Forgets the cached account of the given certificates, for example because
+ * they have been assigned to a new account. */
+static void
+infd_directory_certificate_cache_remove_certificates(
+  InfdDirectory* directory,
+  gnutls_x509_crt_t* certs,
+  guint n_certs)
+{
+  InfdDirectoryPrivate* priv;
+  InfdDirectoryCertificateCacheEntry* entry;
+  GBytes* key;
+  guint i;
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  for(i = 0; i < n_certs; ++i)
+  {
+    key = infd_directory_certificate_cache_get_key(certs[i]);
+    if(key != NULL)
+    {
+      entry = g_hash_table_lookup(priv->certificate_cache, key);
+      if(entry != NULL)
+        infd_directory_certificate_cache_remove_entry(directory, entry);
+      g_bytes_unref(key);
+    }
+  }
+}
+
+/* Forgets all certificates logging into the given account */
+static void
+infd_directory_certificate_cache_remove_account(InfdDirectory* directory,
+                                                InfAclAccountId account_id)
+{
+  InfdDirectoryPrivate* priv;
+  InfdDirectoryCertificateCacheEntry* entry;
+  GList* item;
+  GList* next;
+
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  for(item = priv->certificate_cache_lru.head; item != NULL; item = next)
+  {
+    next = item->next;
+    entry = (InfdDirectoryCertificateCacheEntry*)item->data;
+
+    if(entry->account_id == account_id)
+      infd_directory_certificate_cache_remove_entry(directory, entry);
+  }
+}
+
 static InfAclAccountId
 infd_directory_get_account_for_certificate(InfdDirectory* directory,
                                            gnutls_x509_crt_t cert,
@@ -908,6 +1316,8 @@ infd_directory_login_by_certificate(InfdDirectory* directory,
 {
   InfdDirectoryPrivate* priv;
   InfCertificateChain* chain;
+  gnutls_x509_crt_t cert;
+  GBytes* key;
   InfAclAccountId login_id;
   gchar* dn;
   guint i;
@@ -919,38 +1329,38 @@ infd_directory_login_by_certificate(InfdDirectory* directory,
   login_id = 0;
   if(chain != NULL)
   {
-    error = NULL;
+    cert = inf_certificate_chain_get_own_certificate(chain);
+    key = infd_directory_certificate_cache_get_key(cert);
 
-    dn = inf_cert_util_get_dn(
-      inf_certificate_chain_get_own_certificate(chain)
-    );
-    
-    for(i = 0; i < priv->n_transient_accounts; ++i)
+    if(key == NULL ||
+       !infd_directory_certificate_cache_lookup(directory, key, &login_id))
     {
-      if(priv->transient_accounts[i].dn != NULL)
+      error = NULL;
+      dn = inf_cert_util_get_dn(cert);
+
+      for(i = 0; i < priv->n_transient_accounts; ++i)
       {
-        if(strcmp(priv->transient_accounts[i].dn, dn) == 0)
+        if(priv->transient_accounts[i].dn != NULL)
         {
-          login_id = priv->transient_accounts[i].account.id;
-          break;
+          if(strcmp(priv->transient_accounts[i].dn, dn) == 0)
+          {
+            login_id = priv->transient_accounts[i].account.id;
+            break;
+          }
         }
       }
-    }
 
-    if(login_id == 0)
-    {
-      login_id = infd_directory_get_account_for_certificate(
-        directory,
-        inf_certificate_chain_get_own_certificate(chain),
-        &error
-      );
-
-      if(error != NULL)
+      if(login_id == 0)
       {
-        dn = inf_cert_util_get_dn(
-          inf_certificate_chain_get_own_certificate(chain)
+        login_id = infd_directory_get_account_for_certificate(
+          directory,
+          cert,
+          &error
         );
+      }
 
+      if(error != NULL)
+      {
         g_warning(
           _("Failed to login client \"%s\" by certificate: %s"),
           dn,
@@ -959,9 +1369,18 @@ infd_directory_login_by_certificate(InfdDirectory* directory,
 
         g_error_free(error);
       }
+      else if(key != NULL)
+      {
+        /* Also remember if the certificate does not belong to any account,
+         * since this is the common case for most clients. */
+        infd_directory_certificate_cache_insert(directory, key, login_id);
+      }
+
+      g_free(dn);
     }
 
-    g_free(dn);
+    if(key != NULL)
+      g_bytes_unref(key);
     inf_certificate_chain_unref(chain);
   }
 
@@ -3135,6 +3554,13 @@ infd_directory_create_acl_account_with_certificates(InfdDirectory* directory,
     return 0;
   }
 
+  /* The certificates might have been cached to not belong to any account */
+  infd_directory_certificate_cache_remove_certificates(
+    directory,
+    certs,
+    n_certs
+  );
+
   infd_directory_announce_acl_account(directory, account, conn);
   return account_id;
 }
@@ -3175,6 +3601,9 @@ infd_directory_cleanup_acl_account(InfdDirectory* directory,
   default_id = inf_acl_account_id_from_string("default");
   g_assert(account_id != default_id);
 
+  /* Certificates of this account must not log into it anymore */
+  infd_directory_certificate_cache_remove_account(directory, account_id);
+
   browser = INF_BROWSER(directory);
   iter.node = priv->root;
   iter.node_id = priv->root->id;
@@ -3520,14 +3949,8 @@ infd_directory_node_register(InfdDirectory* directory,
                              InfXmlConnection* except,
                              const gchar* seq)
 {
-  InfdDirectoryPrivate* priv;
   InfBrowserIter iter;
-  InfdDirectoryConnectionInfo* info;
   xmlNodePtr xml;
-  xmlNodePtr copy_xml;
-  GSList* item;
-
-  priv = INFD_DIRECTORY_PRIVATE(directory);
 
   iter.node_id = node->id;
   iter.node = node;
@@ -3542,35 +3965,15 @@ infd_directory_node_register(InfdDirectory* directory,
   if(seq != NULL)
    inf_xml_util_set_attribute(xml, "seq", seq);
 
-  for(item = node->parent->shared.subdir.connections;
-      item != NULL;
-      item = g_slist_next(item))
-  {
-    if(item->data != except)
-    {
-      info = g_hash_table_lookup(priv->connections, item->data);
-      g_assert(info != NULL);
-
-      copy_xml = xmlCopyNode(xml, 1);
-
-      if(node->acl != NULL)
-      {
-        infd_directory_acl_sheets_to_xml_for_connection(
-          directory,
-          node->acl_connections,
-          node->acl,
-          INF_XML_CONNECTION(item->data),
-          copy_xml
-        );
-      }
-
-      inf_communication_group_send_message(
-        INF_COMMUNICATION_GROUP(priv->group),
-        INF_XML_CONNECTION(item->data),
-        copy_xml
-      );
-    }
-  }
+  infd_directory_send_with_acl_sheets(
+    directory,
+    node,
+    node->acl,
+    node->parent->shared.subdir.connections,
+    except,
+    xml,
+    FALSE
+  );
 
   xmlFreeNode(xml);
 }
@@ -3602,6 +4005,8 @@ infd_directory_node_unregister(InfdDirectory* directory,
   xml = infd_directory_node_unregister_to_xml(node);
   if(seq != NULL) inf_xml_util_set_attribute(xml, "seq", seq);
 
+  /* All connections get the same message, so the last one can take the
+   * original instead of a copy. */
   for(item = node->parent->shared.subdir.connections;
       item != NULL;
       item = g_slist_next(item))
@@ -3609,11 +4014,12 @@ infd_directory_node_unregister(InfdDirectory* directory,
     inf_communication_group_send_message(
       INF_COMMUNICATION_GROUP(priv->group),
       INF_XML_CONNECTION(item->data),
-      xmlCopyNode(xml, 1)
+      (item->next == NULL) ? xml : xmlCopyNode(xml, 1)
     );
   }
 
-  xmlFreeNode(xml);
+  if(node->parent->shared.subdir.connections == NULL)
+    xmlFreeNode(xml);
 }
 
 static gboolean
@@ -4367,10 +4773,10 @@ infd_directory_node_explore(InfdDirectory* directory,
     sep_len = 1;
     if(path[len - 1] == '/') sep_len = 0;
 
-    if(len + sep_len + node_len < path_len)
+    if(len + sep_len + node_len > path_len)
     {
       path_len = len + sep_len + node_len;
-      path = g_realloc(path, path_len + sep_len);
+      path = g_realloc(path, path_len + 1);
     }
 
     if(sep_len > 0)
@@ -5271,6 +5677,11 @@ infd_directory_create_acl_account_with_certificate(InfdDirectory* directory,
    * certificates with the new certificate. */
   if(existing != 0)
   {
+    /* Both the previous certificates of the account and the new one
+     * might be cached to log into a different account. */
+    infd_directory_certificate_cache_remove_account(directory, existing);
+    infd_directory_certificate_cache_remove_certificates(directory, &cert, 1);
+
     transient = infd_directory_lookup_transient_account(directory, existing);
 
     if(transient != NULL)
@@ -7895,7 +8306,10 @@ infd_directory_account_storage_account_added_cb(InfdAccountStorage* storage,
                                                 const InfAclAccount* acc,
                                                 gpointer user_data)
 {
-  /* An account has been externally added to the storage: Announce */
+  /* An account has been externally added to the storage: Announce. We do
+   * not know which certificates belong to it, so forget all cached
+   * certificate logins. */
+  infd_directory_certificate_cache_clear(INFD_DIRECTORY(user_data));
   infd_directory_announce_acl_account(INFD_DIRECTORY(user_data), acc, NULL);
 }
 
@@ -8455,6 +8869,9 @@ infd_directory_set_account_storage(InfdDirectory* directory,
   prev_account_storage = priv->account_storage;
   priv->account_storage = account_storage;
 
+  /* Cached certificate logins refer to the previous storage */
+  infd_directory_certificate_cache_clear(directory);
+
   /* Fix all client accounts */
   infd_directory_relogin_clients(directory);
 
@@ -8500,6 +8917,36 @@ infd_directory_set_account_storage(InfdDirectory* directory,
   g_object_notify(G_OBJECT(directory), "account-storage");
 }
 
+/* Sessions and the communication registry use the timing policy of the
+ * communication manager, so the directory shares its policy with them by
+ * setting it on the communication manager. If the directory has no policy
+ * of its own, it uses the one of the communication manager instead. */
+static void
+infd_directory_share_timing_policy(InfdDirectory* directory)
+{
+  InfdDirectoryPrivate* priv;
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  g_assert(priv->communication_manager != NULL);
+
+  if(priv->timing_policy == NULL)
+  {
+    priv->timing_policy = g_object_ref(
+      inf_communication_manager_get_timing_policy(
+        priv->communication_manager
+      )
+    );
+  }
+  else
+  {
+    g_object_set(
+      G_OBJECT(priv->communication_manager),
+      "timing-policy", priv->timing_policy,
+      NULL
+    );
+  }
+}
+
 static void
 infd_directory_set_communication_manager(InfdDirectory* directory,
                                          InfCommunicationManager* manager)
@@ -8512,6 +8959,8 @@ infd_directory_set_communication_manager(InfdDirectory* directory,
   g_assert(priv->communication_manager == NULL);
   priv->communication_manager = manager;
   g_object_ref(manager);
+
+  infd_directory_share_timing_policy(directory);
 }
 
 /*
@@ -8543,6 +8992,18 @@ infd_directory_init(InfdDirectory* directory)
   priv->transient_accounts[0].dn = NULL;
   priv->n_transient_accounts = 1;
 
+  priv->certificate_cache = g_hash_table_new_full(
+    g_bytes_hash,
+    g_bytes_equal,
+    NULL,
+    infd_directory_certificate_cache_entry_free
+  );
+
+  g_queue_init(&priv->certificate_cache_lru);
+  priv->certificate_cache_size = 1024;
+  priv->certificate_cache_hits = 0;
+  priv->certificate_cache_misses = 0;
+
   priv->node_counter = 1;
   priv->nodes = g_hash_table_new(NULL, NULL);
 
@@ -8563,6 +9024,9 @@ infd_directory_init(InfdDirectory* directory)
   priv->subscription_requests = NULL;
 
   priv->chat_session = NULL;
+
+  priv->timing_policy = NULL;
+  priv->timing_timeout = NULL;
 }
 
 static void
@@ -8629,6 +9093,14 @@ infd_directory_constructed(GObject* object)
    * when the storage property was set. */
 
   g_assert(g_hash_table_size(priv->connections) == 0);
+
+  priv->timing_timeout = inf_io_add_timeout(
+    priv->io,
+    INFD_DIRECTORY_TIMING_SAMPLE_INTERVAL,
+    infd_directory_timing_sample_func,
+    directory,
+    NULL
+  );
 }
 
 static void
@@ -8710,6 +9182,18 @@ infd_directory_dispose(GObject* object)
     priv->certificate = NULL;
   }
 
+  if(priv->timing_timeout != NULL)
+  {
+    inf_io_remove_timeout(priv->io, priv->timing_timeout);
+    priv->timing_timeout = NULL;
+  }
+
+  if(priv->timing_policy != NULL)
+  {
+    g_object_unref(priv->timing_policy);
+    priv->timing_policy = NULL;
+  }
+
   if(priv->io != NULL)
   {
     g_object_unref(G_OBJECT(priv->io));
@@ -8736,6 +9220,9 @@ infd_directory_finalize(GObject* object)
   }
   g_free(priv->transient_accounts);
 
+  infd_directory_certificate_cache_clear(directory);
+  g_hash_table_destroy(priv->certificate_cache);
+
   G_OBJECT_CLASS(infd_directory_parent_class)->finalize(object);
 }
 
@@ -8784,6 +9271,19 @@ infd_directory_set_property(GObject* object,
   case PROP_CERTIFICATE:
     priv->certificate = (InfCertificateChain*)g_value_dup_boxed(value);
     break;
+  case PROP_CERTIFICATE_CACHE_SIZE:
+    priv->certificate_cache_size = g_value_get_uint(value);
+    infd_directory_certificate_cache_trim(directory);
+    break;
+  case PROP_TIMING_POLICY:
+    if(priv->timing_policy != NULL)
+      g_object_unref(priv->timing_policy);
+
+    priv->timing_policy = INF_TIMING_POLICY(g_value_dup_object(value));
+    if(priv->communication_manager != NULL)
+      infd_directory_share_timing_policy(directory);
+
+    break;
   case PROP_CHAT_SESSION:
   case PROP_STATUS:
     /* read only */
@@ -8825,6 +9325,12 @@ infd_directory_get_property(GObject* object,
   case PROP_CERTIFICATE:
     g_value_set_boxed(value, priv->certificate);
     break;
+  case PROP_CERTIFICATE_CACHE_SIZE:
+    g_value_set_uint(value, priv->certificate_cache_size);
+    break;
+  case PROP_TIMING_POLICY:
+    g_value_set_object(value, G_OBJECT(priv->timing_policy));
+    break;
   case PROP_CHAT_SESSION:
     g_value_set_object(value, G_OBJECT(priv->chat_session));
     break;
@@ -10587,6 +11093,37 @@ infd_directory_class_init(InfdDirectoryClass* directory_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_CERTIFICATE_CACHE_SIZE,
+    g_param_spec_uint(
+      "certificate-cache-size",
+      "Certificate cache size",
+      "The maximum number of client certificates whose account is "
+      "remembered, or 0 to always look up the account storage",
+      0,
+      G_MAXUINT,
+      1024,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_TIMING_POLICY,
+    g_param_spec_object(
+      "timing-policy",
+      "Timing policy",
+      "The policy which determines how long idle sessions are kept in "
+      "memory. The directory reports round trip times and the number of "
+      "connections to it, and sets it on its communication manager so that "
+      "sessions share it. If unset, the policy of the communication "
+      "manager is used",
+      INF_TYPE_TIMING_POLICY,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT
+    )
+  );
+
   g_object_class_install_property(
     object_class,
     PROP_CHAT_SESSION,
@@ -11156,6 +11693,34 @@ infd_directory_get_support_mask(InfdDirectory* directory,
   *mask = sheet.perms;
 }
 
+/**
+ * infd_directory_get_certificate_cache_stats:
+ * @directory: A #InfdDirectory.
+ * @hits: (out) (allow-none): Location to store the number of cache hits,
+ * or %NULL.
+ * @misses: (out) (allow-none): Location to store the number of cache misses,
+ * or %NULL.
+ *
+ * Reports how often the account of a client certificate was found in the
+ * cache of certificate logins, and how often the account storage had to be
+ * queried instead. The cache size can be set with the
+ * #InfdDirectory:certificate-cache-size property. If the cache is disabled,
+ * neither counter is incremented.
+ */
+void
+infd_directory_get_certificate_cache_stats(InfdDirectory* directory,
+                                           guint64* hits,
+                                           guint64* misses)
+{
+  InfdDirectoryPrivate* priv;
+
+  g_return_if_fail(INFD_IS_DIRECTORY(directory));
+  priv = INFD_DIRECTORY_PRIVATE(directory);
+
+  if(hits != NULL) *hits = priv->certificate_cache_hits;
+  if(misses != NULL) *misses = priv->certificate_cache_misses;
+}
+
 /**
  * infd_directory_get_acl_account_for_connection:
  * @directory: A #InfdDirectory.
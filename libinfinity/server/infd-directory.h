@@ -129,6 +129,11 @@ void
 infd_directory_get_support_mask(InfdDirectory* directory,
                                 InfAclMask* mask);
 
+void
+infd_directory_get_certificate_cache_stats(InfdDirectory* directory,
+                                           guint64* hits,
+                                           guint64* misses);
+
 InfAclAccountId
 infd_directory_get_acl_account_for_connection(InfdDirectory* directory,
                                               InfXmlConnection* connection);
@@ -32,6 +32,7 @@
 
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #ifndef G_OS_WIN32
 # include <sys/types.h>
@@ -44,12 +45,17 @@
 typedef struct _InfdFilesystemStoragePrivate InfdFilesystemStoragePrivate;
 struct _InfdFilesystemStoragePrivate {
   gchar* root_directory;
+
+  gchar* index_file;
+  GHashTable* index; /* path -> InfdFilesystemStorageIndexDir */
+  gboolean index_dirty;
 };
 
 enum {
   PROP_0,
 
-  PROP_ROOT_DIRECTORY
+  PROP_ROOT_DIRECTORY,
+  PROP_INDEX_FILE
 };
 
 #define INFD_FILESYSTEM_STORAGE_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INFD_TYPE_FILESYSTEM_STORAGE, InfdFilesystemStoragePrivate))
@@ -359,6 +365,593 @@ infd_filesystem_storage_get_acl_path(InfdFilesystemStorage* storage,
   return full_path;
 }
 
+/* The node index caches directory listings and ACLs read from disk, so that
+ * exploring a large directory does not need to parse an ACL file for every
+ * child. Listings are validated against the mtime of the directory, ACLs
+ * against the mtime of the ACL file. An entry is only trusted if the file
+ * was modified in an earlier second than when it was read, since otherwise
+ * a modification in the same second would go unnoticed. */
+static const gchar INFD_FILESYSTEM_STORAGE_INDEX_MAGIC[8] =
+  { 'I', 'N', 'F', 'I', 'D', 'X', '0', '1' };
+
+/* mtime for files that do not exist, and for files that cannot be stat'ed */
+#define INFD_FILESYSTEM_STORAGE_INDEX_NOENT (-1)
+#define INFD_FILESYSTEM_STORAGE_INDEX_UNKNOWN (-2)
+
+typedef struct _InfdFilesystemStorageIndexAcl InfdFilesystemStorageIndexAcl;
+struct _InfdFilesystemStorageIndexAcl {
+  gint64 mtime;
+  gint64 scan_time;
+  GSList* acl;
+};
+
+typedef struct _InfdFilesystemStorageIndexDir InfdFilesystemStorageIndexDir;
+struct _InfdFilesystemStorageIndexDir {
+  gboolean listed;
+  gint64 mtime;
+  gint64 scan_time;
+  GSList* nodes;
+
+  /* child name -> InfdFilesystemStorageIndexAcl */
+  GHashTable* acls;
+};
+
+typedef struct _InfdFilesystemStorageIndexReader
+  InfdFilesystemStorageIndexReader;
+struct _InfdFilesystemStorageIndexReader {
+  const guchar* data;
+  gsize size;
+  gsize pos;
+};
+
+static void
+infd_filesystem_storage_index_acl_free(gpointer data)
+{
+  InfdFilesystemStorageIndexAcl* entry;
+  entry = (InfdFilesystemStorageIndexAcl*)data;
+
+  infd_storage_acl_list_free(entry->acl);
+  g_slice_free(InfdFilesystemStorageIndexAcl, entry);
+}
+
+static InfdFilesystemStorageIndexDir*
+infd_filesystem_storage_index_dir_new(void)
+{
+  InfdFilesystemStorageIndexDir* dir;
+
+  dir = g_slice_new(InfdFilesystemStorageIndexDir);
+  dir->listed = FALSE;
+  dir->mtime = INFD_FILESYSTEM_STORAGE_INDEX_UNKNOWN;
+  dir->scan_time = 0;
+  dir->nodes = NULL;
+
+  dir->acls = g_hash_table_new_full(
+    g_str_hash,
+    g_str_equal,
+    g_free,
+    infd_filesystem_storage_index_acl_free
+  );
+
+  return dir;
+}
+
+static void
+infd_filesystem_storage_index_dir_free(gpointer data)
+{
+  InfdFilesystemStorageIndexDir* dir;
+  dir = (InfdFilesystemStorageIndexDir*)data;
+
+  infd_storage_node_list_free(dir->nodes);
+  g_hash_table_destroy(dir->acls);
+  g_slice_free(InfdFilesystemStorageIndexDir, dir);
+}
+
+static GSList*
+infd_filesystem_storage_index_copy_nodes(GSList* nodes)
+{
+  GSList* list;
+  GSList* item;
+
+  list = NULL;
+  for(item = nodes; item != NULL; item = item->next)
+    list = g_slist_prepend(list, infd_storage_node_copy(item->data));
+
+  return g_slist_reverse(list);
+}
+
+static GSList*
+infd_filesystem_storage_index_copy_acl(GSList* acl)
+{
+  GSList* list;
+  GSList* item;
+
+  list = NULL;
+  for(item = acl; item != NULL; item = item->next)
+    list = g_slist_prepend(list, infd_storage_acl_copy(item->data));
+
+  return g_slist_reverse(list);
+}
+
+static gint64
+infd_filesystem_storage_index_stat(const gchar* full_path)
+{
+  GStatBuf st;
+
+  if(g_stat(full_path, &st) == 0)
+    return st.st_mtime;
+  if(errno == ENOENT)
+    return INFD_FILESYSTEM_STORAGE_INDEX_NOENT;
+  return INFD_FILESYSTEM_STORAGE_INDEX_UNKNOWN;
+}
+
+static gboolean
+infd_filesystem_storage_index_valid(gint64 cached_mtime,
+                                    gint64 scan_time,
+                                    gint64 mtime)
+{
+  if(mtime == INFD_FILESYSTEM_STORAGE_INDEX_UNKNOWN)
+    return FALSE;
+  if(cached_mtime != mtime)
+    return FALSE;
+  if(mtime == INFD_FILESYSTEM_STORAGE_INDEX_NOENT)
+    return TRUE;
+  return mtime < scan_time;
+}
+
+/* Splits a storage path into the path of its parent directory and the name
+ * of the node within it. Returns FALSE for the root node. */
+static gboolean
+infd_filesystem_storage_index_split_path(const gchar* path,
+                                         gchar** parent,
+                                         const gchar** name)
+{
+  const gchar* sep;
+
+  sep = strrchr(path, '/');
+  if(sep == NULL || sep[1] == '\0')
+    return FALSE;
+
+  if(sep == path)
+    *parent = g_strdup("/");
+  else
+    *parent = g_strndup(path, sep - path);
+
+  *name = sep + 1;
+  return TRUE;
+}
+
+static InfdFilesystemStorageIndexDir*
+infd_filesystem_storage_index_lookup(InfdFilesystemStorage* storage,
+                                     const gchar* path,
+                                     gboolean create)
+{
+  InfdFilesystemStoragePrivate* priv;
+  InfdFilesystemStorageIndexDir* dir;
+
+  priv = INFD_FILESYSTEM_STORAGE_PRIVATE(storage);
+  dir = g_hash_table_lookup(priv->index, path);
+
+  if(dir == NULL && create)
+  {
+    dir = infd_filesystem_storage_index_dir_new();
+    g_hash_table_insert(priv->index, g_strdup(path), dir);
+  }
+
+  return dir;
+}
+
+/* Drops everything that is known about the node at path */
+static void
+infd_filesystem_storage_index_invalidate(InfdFilesystemStorage* storage,
+                                         const gchar* path)
+{
+  InfdFilesystemStoragePrivate* priv;
+  InfdFilesystemStorageIndexDir* dir;
+  GHashTableIter iter;
+  gpointer key;
+  gchar* parent;
+  const gchar* name;
+  gsize len;
+
+  priv = INFD_FILESYSTEM_STORAGE_PRIVATE(storage);
+
+  if(infd_filesystem_storage_index_split_path(path, &parent, &name))
+  {
+    dir = infd_filesystem_storage_index_lookup(storage, parent, FALSE);
+    if(dir != NULL)
+    {
+      dir->listed = FALSE;
+      infd_storage_node_list_free(dir->nodes);
+      dir->nodes = NULL;
+      g_hash_table_remove(dir->acls, name);
+    }
+
+    g_free(parent);
+  }
+
+  /* Remove the entries for the node itself and all its descendants */
+  len = strlen(path);
+  g_hash_table_iter_init(&iter, priv->index);
+  while(g_hash_table_iter_next(&iter, &key, NULL))
+  {
+    if(strncmp(key, path, len) == 0 &&
+       (((const gchar*)key)[len] == '\0' || ((const gchar*)key)[len] == '/'))
+    {
+      g_hash_table_iter_remove(&iter);
+    }
+  }
+
+  priv->index_dirty = TRUE;
+}
+
+static void
+infd_filesystem_storage_index_put_uint32(GString* str,
+                                         guint32 value)
+{
+  value = GUINT32_TO_LE(value);
+  g_string_append_len(str, (const gchar*)&value, 4);
+}
+
+static void
+infd_filesystem_storage_index_put_uint64(GString* str,
+                                         guint64 value)
+{
+  value = GUINT64_TO_LE(value);
+  g_string_append_len(str, (const gchar*)&value, 8);
+}
+
+static void
+infd_filesystem_storage_index_put_string(GString* str,
+                                         const gchar* value)
+{
+  gsize len;
+
+  len = (value != NULL) ? strlen(value) : 0;
+  infd_filesystem_storage_index_put_uint32(str, len);
+  g_string_append_len(str, value, len);
+}
+
+static void
+infd_filesystem_storage_index_put_mask(GString* str,
+                                       const InfAclMask* mask)
+{
+  guint i;
+  for(i = 0; i < G_N_ELEMENTS(mask->mask); ++i)
+    infd_filesystem_storage_index_put_uint64(str, mask->mask[i]);
+}
+
+static gboolean
+infd_filesystem_storage_index_get_uint32(
+  InfdFilesystemStorageIndexReader* reader,
+  guint32* value)
+{
+  if(reader->size - reader->pos < 4) return FALSE;
+  memcpy(value, reader->data + reader->pos, 4);
+  *value = GUINT32_FROM_LE(*value);
+  reader->pos += 4;
+  return TRUE;
+}
+
+static gboolean
+infd_filesystem_storage_index_get_uint64(
+  InfdFilesystemStorageIndexReader* reader,
+  guint64* value)
+{
+  if(reader->size - reader->pos < 8) return FALSE;
+  memcpy(value, reader->data + reader->pos, 8);
+  *value = GUINT64_FROM_LE(*value);
+  reader->pos += 8;
+  return TRUE;
+}
+
+static gboolean
+infd_filesystem_storage_index_get_int64(
+  InfdFilesystemStorageIndexReader* reader,
+  gint64* value)
+{
+  guint64 uvalue;
+  if(!infd_filesystem_storage_index_get_uint64(reader, &uvalue))
+    return FALSE;
+
+  *value = (gint64)uvalue;
+  return TRUE;
+}
+
+static gchar*
+infd_filesystem_storage_index_get_string(
+  InfdFilesystemStorageIndexReader* reader)
+{
+  guint32 len;
+  gchar* value;
+
+  if(!infd_filesystem_storage_index_get_uint32(reader, &len))
+    return NULL;
+  if(reader->size - reader->pos < len)
+    return NULL;
+
+  value = g_strndup((const gchar*)reader->data + reader->pos, len);
+  reader->pos += len;
+
+  if(strlen(value) != len || !g_utf8_validate(value, len, NULL))
+  {
+    g_free(value);
+    return NULL;
+  }
+
+  return value;
+}
+
+static gboolean
+infd_filesystem_storage_index_get_mask(
+  InfdFilesystemStorageIndexReader* reader,
+  InfAclMask* mask)
+{
+  guint i;
+  for(i = 0; i < G_N_ELEMENTS(mask->mask); ++i)
+    if(!infd_filesystem_storage_index_get_uint64(reader, &mask->mask[i]))
+      return FALSE;
+  return TRUE;
+}
+
+static gboolean
+infd_filesystem_storage_index_read_acl(
+  InfdFilesystemStorageIndexReader* reader,
+  InfdFilesystemStorageIndexDir* dir)
+{
+  InfdFilesystemStorageIndexAcl* entry;
+  InfdStorageAcl* acl;
+  gchar* name;
+  guint32 n_sheets;
+  guint32 i;
+
+  name = infd_filesystem_storage_index_get_string(reader);
+  if(name == NULL) return FALSE;
+
+  entry = g_slice_new(InfdFilesystemStorageIndexAcl);
+  entry->acl = NULL;
+  g_hash_table_replace(dir->acls, name, entry);
+
+  if(!infd_filesystem_storage_index_get_int64(reader, &entry->mtime) ||
+     !infd_filesystem_storage_index_get_int64(reader, &entry->scan_time) ||
+     !infd_filesystem_storage_index_get_uint32(reader, &n_sheets))
+  {
+    return FALSE;
+  }
+
+  for(i = 0; i < n_sheets; ++i)
+  {
+    acl = g_slice_new(InfdStorageAcl);
+    acl->account_id = infd_filesystem_storage_index_get_string(reader);
+    if(acl->account_id == NULL)
+    {
+      g_slice_free(InfdStorageAcl, acl);
+      return FALSE;
+    }
+
+    entry->acl = g_slist_prepend(entry->acl, acl);
+
+    if(!infd_filesystem_storage_index_get_mask(reader, &acl->mask) ||
+       !infd_filesystem_storage_index_get_mask(reader, &acl->perms))
+    {
+      return FALSE;
+    }
+  }
+
+  entry->acl = g_slist_reverse(entry->acl);
+  return TRUE;
+}
+
+static gboolean
+infd_filesystem_storage_index_read_dir(
+  InfdFilesystemStorageIndexReader* reader,
+  GHashTable* index)
+{
+  InfdFilesystemStorageIndexDir* dir;
+  InfdStorageNode* node;
+  gchar* path;
+  guint32 listed;
+  guint32 n_nodes;
+  guint32 n_acls;
+  guint32 type;
+  gchar* name;
+  gchar* identifier;
+  guint32 i;
+
+  path = infd_filesystem_storage_index_get_string(reader);
+  if(path == NULL) return FALSE;
+
+  dir = infd_filesystem_storage_index_dir_new();
+  g_hash_table_replace(index, path, dir);
+
+  if(!infd_filesystem_storage_index_get_uint32(reader, &listed))
+    return FALSE;
+
+  if(listed)
+  {
+    if(!infd_filesystem_storage_index_get_int64(reader, &dir->mtime) ||
+       !infd_filesystem_storage_index_get_int64(reader, &dir->scan_time) ||
+       !infd_filesystem_storage_index_get_uint32(reader, &n_nodes))
+    {
+      return FALSE;
+    }
+
+    dir->listed = TRUE;
+    for(i = 0; i < n_nodes; ++i)
+    {
+      if(!infd_filesystem_storage_index_get_uint32(reader, &type))
+        return FALSE;
+      if((name = infd_filesystem_storage_index_get_string(reader)) == NULL)
+        return FALSE;
+
+      switch(type)
+      {
+      case INFD_STORAGE_NODE_SUBDIRECTORY:
+        node = infd_storage_node_new_subdirectory(name);
+        break;
+      case INFD_STORAGE_NODE_NOTE:
+        identifier = infd_filesystem_storage_index_get_string(reader);
+        if(identifier == NULL)
+        {
+          g_free(name);
+          return FALSE;
+        }
+
+        node = infd_storage_node_new_note(name, identifier);
+        g_free(identifier);
+        break;
+      default:
+        g_free(name);
+        return FALSE;
+      }
+
+      g_free(name);
+      dir->nodes = g_slist_prepend(dir->nodes, node);
+    }
+
+    dir->nodes = g_slist_reverse(dir->nodes);
+  }
+
+  if(!infd_filesystem_storage_index_get_uint32(reader, &n_acls))
+    return FALSE;
+
+  for(i = 0; i < n_acls; ++i)
+    if(!infd_filesystem_storage_index_read_acl(reader, dir))
+      return FALSE;
+
+  return TRUE;
+}
+
+/* Reads the index file with a single read. A missing, outdated or corrupt
+ * index is not an error, since the index is only a cache. */
+static void
+infd_filesystem_storage_index_load(InfdFilesystemStorage* storage)
+{
+  InfdFilesystemStoragePrivate* priv;
+  InfdFilesystemStorageIndexReader reader;
+  GHashTable* index;
+  gchar* content;
+  gsize size;
+  gchar* root;
+  guint32 n_dirs;
+  guint32 i;
+  gboolean result;
+  GError* error;
+
+  priv = INFD_FILESYSTEM_STORAGE_PRIVATE(storage);
+  g_assert(priv->index_file != NULL);
+
+  error = NULL;
+  if(!g_file_get_contents(priv->index_file, &content, &size, &error))
+  {
+    if(error->domain != G_FILE_ERROR || error->code != G_FILE_ERROR_NOENT)
+    {
+      g_warning(
+        _("Failed to read storage index \"%s\": %s"),
+        priv->index_file,
+        error->message
+      );
+    }
+
+    g_error_free(error);
+    return;
+  }
+
+  reader.data = (const guchar*)content;
+  reader.size = size;
+  reader.pos = sizeof(INFD_FILESYSTEM_STORAGE_INDEX_MAGIC);
+
+  index = g_hash_table_new_full(
+    g_str_hash,
+    g_str_equal,
+    g_free,
+    infd_filesystem_storage_index_dir_free
+  );
+
+  result = FALSE;
+  if(size >= sizeof(INFD_FILESYSTEM_STORAGE_INDEX_MAGIC) &&
+     memcmp(content, INFD_FILESYSTEM_STORAGE_INDEX_MAGIC,
+            sizeof(INFD_FILESYSTEM_STORAGE_INDEX_MAGIC)) == 0)
+  {
+    /* The index is only valid for the root directory it was written for */
+    root = infd_filesystem_storage_index_get_string(&reader);
+    if(root != NULL && priv->root_directory != NULL &&
+       strcmp(root, priv->root_directory) == 0 &&
+       infd_filesystem_storage_index_get_uint32(&reader, &n_dirs))
+    {
+      result = TRUE;
+      for(i = 0; i < n_dirs && result; ++i)
+        result = infd_filesystem_storage_index_read_dir(&reader, index);
+    }
+
+    g_free(root);
+  }
+
+  g_free(content);
+
+  if(result)
+  {
+    g_hash_table_destroy(priv->index);
+    priv->index = index;
+  }
+  else
+  {
+    g_hash_table_destroy(index);
+  }
+}
+
+static void
+infd_filesystem_storage_index_write_dir(GString* str,
+                                        const gchar* path,
+                                        InfdFilesystemStorageIndexDir* dir)
+{
+  InfdFilesystemStorageIndexAcl* entry;
+  InfdStorageNode* node;
+  InfdStorageAcl* acl;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  GSList* item;
+
+  infd_filesystem_storage_index_put_string(str, path);
+  infd_filesystem_storage_index_put_uint32(str, dir->listed);
+
+  if(dir->listed)
+  {
+    infd_filesystem_storage_index_put_uint64(str, dir->mtime);
+    infd_filesystem_storage_index_put_uint64(str, dir->scan_time);
+    infd_filesystem_storage_index_put_uint32(str, g_slist_length(dir->nodes));
+
+    for(item = dir->nodes; item != NULL; item = item->next)
+    {
+      node = (InfdStorageNode*)item->data;
+      infd_filesystem_storage_index_put_uint32(str, node->type);
+      infd_filesystem_storage_index_put_string(str, node->name);
+      if(node->type == INFD_STORAGE_NODE_NOTE)
+        infd_filesystem_storage_index_put_string(str, node->identifier);
+    }
+  }
+
+  infd_filesystem_storage_index_put_uint32(str, g_hash_table_size(dir->acls));
+
+  g_hash_table_iter_init(&iter, dir->acls);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    entry = (InfdFilesystemStorageIndexAcl*)value;
+    infd_filesystem_storage_index_put_string(str, key);
+    infd_filesystem_storage_index_put_uint64(str, entry->mtime);
+    infd_filesystem_storage_index_put_uint64(str, entry->scan_time);
+    infd_filesystem_storage_index_put_uint32(str, g_slist_length(entry->acl));
+
+    for(item = entry->acl; item != NULL; item = item->next)
+    {
+      acl = (InfdStorageAcl*)item->data;
+      infd_filesystem_storage_index_put_string(str, acl->account_id);
+      infd_filesystem_storage_index_put_mask(str, &acl->mask);
+      infd_filesystem_storage_index_put_mask(str, &acl->perms);
+    }
+  }
+}
+
 static void
 infd_filesystem_storage_init(InfdFilesystemStorage* storage)
 {
@@ -366,6 +959,28 @@ infd_filesystem_storage_init(InfdFilesystemStorage* storage)
   priv = INFD_FILESYSTEM_STORAGE_PRIVATE(storage);
 
   priv->root_directory = NULL;
+
+  priv->index_file = NULL;
+  priv->index = g_hash_table_new_full(
+    g_str_hash,
+    g_str_equal,
+    g_free,
+    infd_filesystem_storage_index_dir_free
+  );
+  priv->index_dirty = FALSE;
+}
+
+static void
+infd_filesystem_storage_constructed(GObject* object)
+{
+  InfdFilesystemStoragePrivate* priv;
+  priv = INFD_FILESYSTEM_STORAGE_PRIVATE(object);
+
+  /* Load the index only here, since it depends on the root directory */
+  if(priv->index_file != NULL)
+    infd_filesystem_storage_index_load(INFD_FILESYSTEM_STORAGE(object));
+
+  G_OBJECT_CLASS(infd_filesystem_storage_parent_class)->constructed(object);
 }
 
 static void
@@ -374,9 +989,25 @@ infd_filesystem_storage_finalize(GObject* object)
   InfdFilesystemStorage* storage;
   InfdFilesystemStoragePrivate* priv;
 
+  GError* error;
+
   storage = INFD_FILESYSTEM_STORAGE(object);
   priv = INFD_FILESYSTEM_STORAGE_PRIVATE(storage);
 
+  error = NULL;
+  if(!infd_filesystem_storage_flush_index(storage, &error))
+  {
+    g_warning(
+      _("Failed to write storage index \"%s\": %s"),
+      priv->index_file,
+      error->message
+    );
+
+    g_error_free(error);
+  }
+
+  g_hash_table_destroy(priv->index);
+  g_free(priv->index_file);
   g_free(priv->root_directory);
 
   G_OBJECT_CLASS(infd_filesystem_storage_parent_class)->finalize(object);
@@ -402,6 +1033,10 @@ infd_filesystem_storage_set_property(GObject* object,
       g_value_get_string(value)
     );
 
+    break;
+  case PROP_INDEX_FILE:
+    g_assert(priv->index_file == NULL); /* construct only */
+    priv->index_file = g_value_dup_string(value);
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -426,6 +1061,9 @@ infd_filesystem_storage_get_property(GObject* object,
   case PROP_ROOT_DIRECTORY:
     g_value_set_string(value, priv->root_directory);
     break;
+  case PROP_INDEX_FILE:
+    g_value_set_string(value, priv->index_file);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -482,6 +1120,13 @@ infd_filesystem_storage_storage_read_subdirectory(InfdStorage* storage,
 {
   InfdFilesystemStorage* fs_storage;
   InfdFilesystemStoragePrivate* priv;
+  InfdFilesystemStorageIndexDir* dir;
+  GHashTable* names;
+  GHashTableIter iter;
+  gpointer key;
+  GSList* item;
+  gint64 scan_time;
+  gint64 mtime;
   GSList* list;
   gchar* converted_name;
   gchar* full_name;
@@ -500,6 +1145,17 @@ infd_filesystem_storage_storage_read_subdirectory(InfdStorage* storage,
   full_name = g_build_filename(priv->root_directory, converted_name, NULL);
   g_free(converted_name);
 
+  scan_time = time(NULL);
+  mtime = infd_filesystem_storage_index_stat(full_name);
+  dir = infd_filesystem_storage_index_lookup(fs_storage, path, FALSE);
+
+  if(dir != NULL && dir->listed &&
+     infd_filesystem_storage_index_valid(dir->mtime, dir->scan_time, mtime))
+  {
+    g_free(full_name);
+    return infd_filesystem_storage_index_copy_nodes(dir->nodes);
+  }
+
   list = NULL;
 
   result = inf_file_util_list_directory(
@@ -517,6 +1173,34 @@ infd_filesystem_storage_storage_read_subdirectory(InfdStorage* storage,
     return NULL;
   }
 
+  if(mtime >= 0)
+  {
+    dir = infd_filesystem_storage_index_lookup(fs_storage, path, TRUE);
+    infd_storage_node_list_free(dir->nodes);
+
+    dir->listed = TRUE;
+    dir->mtime = mtime;
+    dir->scan_time = scan_time;
+    dir->nodes = infd_filesystem_storage_index_copy_nodes(list);
+
+    /* Forget about ACLs of nodes that no longer exist */
+    if(g_hash_table_size(dir->acls) > 0)
+    {
+      names = g_hash_table_new(g_str_hash, g_str_equal);
+      for(item = list; item != NULL; item = item->next)
+        g_hash_table_add(names, ((InfdStorageNode*)item->data)->name);
+
+      g_hash_table_iter_init(&iter, dir->acls);
+      while(g_hash_table_iter_next(&iter, &key, NULL))
+        if(!g_hash_table_contains(names, key))
+          g_hash_table_iter_remove(&iter);
+
+      g_hash_table_destroy(names);
+    }
+
+    priv->index_dirty = TRUE;
+  }
+
   return list;
 }
 
@@ -547,9 +1231,43 @@ infd_filesystem_storage_storage_create_subdirectory(InfdStorage* storage,
   result = inf_file_util_create_single_directory(full_name, 0755, error);
   g_free(full_name);
 
+  if(result == TRUE)
+    infd_filesystem_storage_index_invalidate(fs_storage, path);
+
   return result;
 }
 
+/* Removes the file next to the node at converted_name with the given
+ * suffix. It is not an error if the file does not exist. */
+static gboolean
+infd_filesystem_storage_remove_aux_file(InfdFilesystemStoragePrivate* priv,
+                                        const gchar* converted_name,
+                                        const gchar* suffix,
+                                        GError** error)
+{
+  gchar* disk_name;
+  gchar* full_name;
+  int save_errno;
+
+  disk_name = g_strconcat(converted_name, suffix, NULL);
+  full_name = g_build_filename(priv->root_directory, disk_name, NULL);
+  g_free(disk_name);
+
+  if(g_unlink(full_name) == -1)
+  {
+    save_errno = errno;
+    if(save_errno != ENOENT)
+    {
+      infd_filesystem_storage_system_error(save_errno, error);
+      g_free(full_name);
+      return FALSE;
+    }
+  }
+
+  g_free(full_name);
+  return TRUE;
+}
+
 static gboolean
 infd_filesystem_storage_storage_remove_node(InfdStorage* storage,
                                             const gchar* identifier,
@@ -562,7 +1280,6 @@ infd_filesystem_storage_storage_remove_node(InfdStorage* storage,
   gchar* disk_name;
   gchar* full_name;
   gboolean result;
-  int save_errno;
 
   fs_storage = INFD_FILESYSTEM_STORAGE(storage);
   priv = INFD_FILESYSTEM_STORAGE_PRIVATE(fs_storage);
@@ -591,35 +1308,53 @@ infd_filesystem_storage_storage_remove_node(InfdStorage* storage,
 
   if(result == TRUE)
   {
-    disk_name = g_strconcat(converted_name, ".xml.acl", NULL);
-    full_name = g_build_filename(priv->root_directory, disk_name, NULL);
-    g_free(disk_name);
+    result = infd_filesystem_storage_remove_aux_file(
+      priv,
+      converted_name,
+      ".xml.acl",
+      error
+    );
+  }
 
-    if(g_unlink(full_name) == -1)
-    {
-      save_errno = errno;
-      if(save_errno != ENOENT)
-      {
-        infd_filesystem_storage_system_error(save_errno, error);
-        result = FALSE;
-      }
-    }
+  if(result == TRUE && identifier != NULL)
+  {
+    /* Auxiliary data stored by note plugins next to the note, such as the
+     * request log of text sessions and the message archive of chat
+     * sessions. If these were kept, a new note created under the same name
+     * would pick them up. */
+    disk_name = g_strconcat(".", identifier, ".log", NULL);
+    result = infd_filesystem_storage_remove_aux_file(
+      priv,
+      converted_name,
+      disk_name,
+      error
+    );
 
-    g_free(full_name);
+    g_free(disk_name);
   }
 
+  if(result == TRUE && identifier != NULL)
+  {
+    result = infd_filesystem_storage_remove_aux_file(
+      priv,
+      converted_name,
+      ".archive",
+      error
+    );
+  }
+
+  /* Even if removal failed, some files might have been removed already */
+  infd_filesystem_storage_index_invalidate(fs_storage, path);
+
   g_free(converted_name);
   return result;
 }
 
 static GSList*
-infd_filesystem_storage_storage_read_acl(InfdStorage* storage,
-                                         const gchar* path,
-                                         GError** error)
+infd_filesystem_storage_read_acl_file(InfdFilesystemStorage* fs_storage,
+                                      const gchar* full_path,
+                                      GError** error)
 {
-  InfdFilesystemStorage* fs_storage;
-  InfdFilesystemStoragePrivate* priv;
-  gchar* full_path;
   GError* local_error;
 
   xmlDocPtr doc;
@@ -629,12 +1364,6 @@ infd_filesystem_storage_storage_read_acl(InfdStorage* storage,
   InfdStorageAcl* acl;
   xmlChar* account_id;
 
-  fs_storage = INFD_FILESYSTEM_STORAGE(storage);
-  priv = INFD_FILESYSTEM_STORAGE_PRIVATE(storage);
-
-  full_path = infd_filesystem_storage_get_acl_path(fs_storage, path, error);
-  if(full_path == NULL) return NULL;
-
   local_error = NULL;
   doc = infd_filesystem_storage_read_xml_file_impl(
     fs_storage,
@@ -643,8 +1372,6 @@ infd_filesystem_storage_storage_read_acl(InfdStorage* storage,
     &local_error
   );
 
-  g_free(full_path);
-
   if(local_error != NULL)
   {
     if(local_error->domain == G_FILE_ERROR &&
@@ -707,6 +1434,93 @@ infd_filesystem_storage_storage_read_acl(InfdStorage* storage,
   return list;
 }
 
+static GSList*
+infd_filesystem_storage_storage_read_acl(InfdStorage* storage,
+                                         const gchar* path,
+                                         GError** error)
+{
+  InfdFilesystemStorage* fs_storage;
+  InfdFilesystemStoragePrivate* priv;
+  InfdFilesystemStorageIndexDir* dir;
+  InfdFilesystemStorageIndexAcl* entry;
+  gchar* full_path;
+  gchar* parent;
+  const gchar* name;
+  gint64 scan_time;
+  gint64 mtime;
+  GError* local_error;
+  GSList* list;
+
+  fs_storage = INFD_FILESYSTEM_STORAGE(storage);
+  priv = INFD_FILESYSTEM_STORAGE_PRIVATE(storage);
+
+  full_path = infd_filesystem_storage_get_acl_path(fs_storage, path, error);
+  if(full_path == NULL) return NULL;
+
+  /* The global ACL is read only once, so it is not indexed */
+  if(!infd_filesystem_storage_index_split_path(path, &parent, &name))
+  {
+    list = infd_filesystem_storage_read_acl_file(fs_storage, full_path, error);
+    g_free(full_path);
+    return list;
+  }
+
+  scan_time = time(NULL);
+  mtime = infd_filesystem_storage_index_stat(full_path);
+
+  entry = NULL;
+  dir = infd_filesystem_storage_index_lookup(fs_storage, parent, FALSE);
+  if(dir != NULL)
+    entry = g_hash_table_lookup(dir->acls, name);
+
+  if(entry != NULL &&
+     infd_filesystem_storage_index_valid(entry->mtime, entry->scan_time, mtime))
+  {
+    g_free(parent);
+    g_free(full_path);
+    return infd_filesystem_storage_index_copy_acl(entry->acl);
+  }
+
+  local_error = NULL;
+  if(mtime == INFD_FILESYSTEM_STORAGE_INDEX_NOENT)
+  {
+    list = NULL;
+  }
+  else
+  {
+    list = infd_filesystem_storage_read_acl_file(
+      fs_storage,
+      full_path,
+      &local_error
+    );
+  }
+
+  g_free(full_path);
+
+  if(local_error != NULL)
+  {
+    g_free(parent);
+    g_propagate_error(error, local_error);
+    return NULL;
+  }
+
+  if(mtime != INFD_FILESYSTEM_STORAGE_INDEX_UNKNOWN)
+  {
+    dir = infd_filesystem_storage_index_lookup(fs_storage, parent, TRUE);
+
+    entry = g_slice_new(InfdFilesystemStorageIndexAcl);
+    entry->mtime = mtime;
+    entry->scan_time = scan_time;
+    entry->acl = infd_filesystem_storage_index_copy_acl(list);
+    g_hash_table_replace(dir->acls, g_strdup(name), entry);
+
+    priv->index_dirty = TRUE;
+  }
+
+  g_free(parent);
+  return list;
+}
+
 static gboolean
 infd_filesystem_storage_storage_write_acl(InfdStorage* storage,
                                           const gchar* path,
@@ -715,6 +1529,9 @@ infd_filesystem_storage_storage_write_acl(InfdStorage* storage,
 {
   InfdFilesystemStorage* fs_storage;
   InfdFilesystemStoragePrivate* priv;
+  InfdFilesystemStorageIndexDir* dir;
+  gchar* parent;
+  const gchar* name;
   gchar* full_path;
 
   xmlNodePtr root;
@@ -730,6 +1547,16 @@ infd_filesystem_storage_storage_write_acl(InfdStorage* storage,
   full_path = infd_filesystem_storage_get_acl_path(fs_storage, path, error);
   if(full_path == NULL) return FALSE;
 
+  /* Drop the cached ACL. It is read again from disk the next time, since
+   * the new file would be modified in the same second as it was cached. */
+  if(infd_filesystem_storage_index_split_path(path, &parent, &name))
+  {
+    dir = infd_filesystem_storage_index_lookup(fs_storage, parent, FALSE);
+    if(dir != NULL && g_hash_table_remove(dir->acls, name))
+      priv->index_dirty = TRUE;
+    g_free(parent);
+  }
+
   root = NULL;
   if(sheet_set != NULL)
   {
@@ -806,6 +1633,7 @@ infd_filesystem_storage_class_init(
   GObjectClass* object_class;
   object_class = G_OBJECT_CLASS(filesystem_storage_class);
 
+  object_class->constructed = infd_filesystem_storage_constructed;
   object_class->finalize = infd_filesystem_storage_finalize;
   object_class->set_property = infd_filesystem_storage_set_property;
   object_class->get_property = infd_filesystem_storage_get_property;
@@ -825,6 +1653,18 @@ infd_filesystem_storage_class_init(
       G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
     )
   );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_INDEX_FILE,
+    g_param_spec_string(
+      "index-file",
+      "Index file",
+      "File in which directory listings and ACLs are cached across restarts",
+      NULL,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY
+    )
+  );
 }
 
 static void
@@ -866,6 +1706,108 @@ infd_filesystem_storage_new(const gchar* root_directory)
   return INFD_FILESYSTEM_STORAGE(object);
 }
 
+/**
+ * infd_filesystem_storage_new_with_index: (constructor)
+ * @root_directory: A directory name in UTF-8.
+ * @index_file: (type filename): File name of the node index.
+ *
+ * Creates a new #InfdFilesystemStorage like infd_filesystem_storage_new(),
+ * which in addition caches directory listings and ACLs in @index_file, so
+ * that they do not need to be read again when the server restarts. See
+ * infd_filesystem_storage_flush_index() for details. @index_file should
+ * not be inside @root_directory, since writing it would otherwise
+ * invalidate the cached listing of the root directory.
+ *
+ * Returns: (transfer full): A new #InfdFilesystemStorage.
+ **/
+InfdFilesystemStorage*
+infd_filesystem_storage_new_with_index(const gchar* root_directory,
+                                       const gchar* index_file)
+{
+  GObject* object;
+
+  object = g_object_new(
+    INFD_TYPE_FILESYSTEM_STORAGE,
+    "root-directory", root_directory,
+    "index-file", index_file,
+    NULL
+  );
+
+  return INFD_FILESYSTEM_STORAGE(object);
+}
+
+/**
+ * infd_filesystem_storage_flush_index:
+ * @storage: A #InfdFilesystemStorage.
+ * @error: Location to store error information, if any.
+ *
+ * Writes the storage's node index to the file given by the
+ * #InfdFilesystemStorage:index-file property. The index caches directory
+ * listings and ACLs, so that a server that is restarted does not need to
+ * read them all from disk again when exploring nodes. Cached entries are
+ * validated against the modification time of the corresponding files.
+ *
+ * The index is also written when @storage is finalized. If no index file is
+ * set, or nothing has changed since the index was last written, the
+ * function does nothing.
+ *
+ * Returns: %TRUE on success, or %FALSE if an error occurred.
+ */
+gboolean
+infd_filesystem_storage_flush_index(InfdFilesystemStorage* storage,
+                                    GError** error)
+{
+  InfdFilesystemStoragePrivate* priv;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+  GString* str;
+  gchar* dirname;
+  gboolean result;
+
+  g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  priv = INFD_FILESYSTEM_STORAGE_PRIVATE(storage);
+  if(priv->index_file == NULL || priv->index_dirty == FALSE)
+    return TRUE;
+
+  str = g_string_sized_new(4096);
+  g_string_append_len(
+    str,
+    INFD_FILESYSTEM_STORAGE_INDEX_MAGIC,
+    sizeof(INFD_FILESYSTEM_STORAGE_INDEX_MAGIC)
+  );
+
+  infd_filesystem_storage_index_put_string(str, priv->root_directory);
+  infd_filesystem_storage_index_put_uint32(str, g_hash_table_size(priv->index));
+
+  g_hash_table_iter_init(&iter, priv->index);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+    infd_filesystem_storage_index_write_dir(str, key, value);
+
+  dirname = g_path_get_dirname(priv->index_file);
+  result = inf_file_util_create_directory(dirname, 0755, error);
+  g_free(dirname);
+
+  if(result == TRUE)
+  {
+    result = g_file_set_contents(
+      priv->index_file,
+      str->str,
+      str->len,
+      error
+    );
+  }
+
+  g_string_free(str, TRUE);
+
+  if(result == TRUE)
+    priv->index_dirty = FALSE;
+
+  return result;
+}
+
 /**
  * infd_filesystem_storage_get_path:
  * @storage: A #InfdFilesystemStorage.
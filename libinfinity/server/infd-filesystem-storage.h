@@ -63,6 +63,14 @@ infd_filesystem_storage_get_type(void) G_GNUC_CONST;
 InfdFilesystemStorage*
 infd_filesystem_storage_new(const gchar* root_directory);
 
+InfdFilesystemStorage*
+infd_filesystem_storage_new_with_index(const gchar* root_directory,
+                                       const gchar* index_file);
+
+gboolean
+infd_filesystem_storage_flush_index(InfdFilesystemStorage* storage,
+                                    GError** error);
+
 gchar*
 infd_filesystem_storage_get_path(InfdFilesystemStorage* storage,
                                  const gchar* identifier,
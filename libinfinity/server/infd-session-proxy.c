@@ -65,7 +65,11 @@ struct _InfdSessionProxyPrivate {
   InfSession* session;
   InfCommunicationHostedGroup* subscription_group;
 
-  GSList* subscriptions;
+  /* Subscriptions in the order they were made, and indexed by connection.
+   * Every incoming request looks up the subscription of its connection, so
+   * this needs to be fast with many subscribers. */
+  GPtrArray* subscriptions;
+  GHashTable* subscription_table;
   guint user_id_counter;
 
   /* Local users that do not belong to a particular connection */
@@ -132,31 +136,14 @@ infd_session_proxy_subscription_free(InfdSessionProxySubscription* subscr)
   g_slice_free(InfdSessionProxySubscription, subscr);
 }
 
-static GSList*
-infd_session_proxy_find_subscription_item(InfdSessionProxy* proxy,
-                                          InfXmlConnection* connection)
-{
-  InfdSessionProxyPrivate* priv;
-  GSList* item;
-
-  priv = INFD_SESSION_PROXY_PRIVATE(proxy);
-  for(item = priv->subscriptions; item != NULL; item = g_slist_next(item))
-    if( ((InfdSessionProxySubscription*)item->data)->connection == connection)
-      return item;
-
-  return NULL;
-}
-
 static InfdSessionProxySubscription*
 infd_session_proxy_find_subscription(InfdSessionProxy* proxy,
                                      InfXmlConnection* connection)
 {
-  GSList* item;
-
-  item = infd_session_proxy_find_subscription_item(proxy, connection);
-  if(item == NULL) return NULL;
+  InfdSessionProxyPrivate* priv;
+  priv = INFD_SESSION_PROXY_PRIVATE(proxy);
 
-  return (InfdSessionProxySubscription*)item->data;
+  return g_hash_table_lookup(priv->subscription_table, connection);
 }
 
 static gboolean
@@ -165,7 +152,7 @@ infd_session_proxy_check_idle(InfdSessionProxy* proxy)
   InfdSessionProxyPrivate* priv;
   priv = INFD_SESSION_PROXY_PRIVATE(proxy);
 
-  if(priv->subscriptions == NULL &&
+  if(priv->subscriptions->len == 0 &&
      priv->local_users == NULL &&
      !inf_session_has_synchronizations(priv->session))
   {
@@ -630,7 +617,7 @@ infd_session_proxy_synchronization_complete_cb(InfSession* session,
   priv = INFD_SESSION_PROXY_PRIVATE(proxy);
 
   /* Set idle if no more synchronizations are running */
-  if(!priv->idle && priv->subscriptions == NULL &&
+  if(!priv->idle && priv->subscriptions->len == 0 &&
      priv->local_users == NULL &&
      !inf_session_has_synchronizations(session))
   {
@@ -685,7 +672,7 @@ infd_session_proxy_synchronization_failed_cb_after(InfSession* session,
   priv = INFD_SESSION_PROXY_PRIVATE(proxy);
 
   /* Set idle if no more synchronizations are running */
-  if(!priv->idle && priv->subscriptions == NULL &&
+  if(!priv->idle && priv->subscriptions->len == 0 &&
      !inf_session_has_synchronizations(session))
   {
     priv->idle = TRUE;
@@ -710,9 +697,13 @@ infd_session_proxy_session_close_cb(InfSession* session,
     proxy
   );
 
-  while(priv->subscriptions != NULL)
+  while(priv->subscriptions->len > 0)
   {
-    subscription = (InfdSessionProxySubscription*)priv->subscriptions->data;
+    /* Most recent subscription first */
+    subscription = (InfdSessionProxySubscription*)g_ptr_array_index(
+      priv->subscriptions,
+      priv->subscriptions->len - 1
+    );
 
     /* Note that this does not call our signal handler because we already
      * disconnected it. This way, we make sure not to send user status updates
@@ -753,7 +744,8 @@ infd_session_proxy_init(InfdSessionProxy* session_proxy)
   priv = INFD_SESSION_PROXY_PRIVATE(session_proxy);
 
   priv->io = NULL;
-  priv->subscriptions = NULL;
+  priv->subscriptions = g_ptr_array_new();
+  priv->subscription_table = g_hash_table_new(NULL, NULL);
   priv->subscription_group = NULL;
   priv->user_id_counter = 1;
   priv->local_users = NULL;
@@ -852,7 +844,7 @@ infd_session_proxy_dispose(GObject* object)
   priv->session = NULL;
 
   g_assert(priv->subscription_group == NULL);
-  g_assert(priv->subscriptions == NULL);
+  g_assert(priv->subscriptions->len == 0);
 
   g_object_unref(priv->io);
   priv->io = NULL;
@@ -862,6 +854,21 @@ infd_session_proxy_dispose(GObject* object)
   G_OBJECT_CLASS(infd_session_proxy_parent_class)->dispose(object);
 }
 
+static void
+infd_session_proxy_finalize(GObject* object)
+{
+  InfdSessionProxy* proxy;
+  InfdSessionProxyPrivate* priv;
+
+  proxy = INFD_SESSION_PROXY(object);
+  priv = INFD_SESSION_PROXY_PRIVATE(proxy);
+
+  g_hash_table_destroy(priv->subscription_table);
+  g_ptr_array_free(priv->subscriptions, TRUE);
+
+  G_OBJECT_CLASS(infd_session_proxy_parent_class)->finalize(object);
+}
+
 static void
 infd_session_proxy_session_init_user_func(InfUser* user,
                                           gpointer user_data)
@@ -1022,7 +1029,8 @@ infd_session_proxy_add_subscription(InfdSessionProxy* proxy,
   g_assert(infd_session_proxy_find_subscription(proxy, connection) == NULL);
 
   subscription = infd_session_proxy_subscription_new(connection, seq_id);
-  priv->subscriptions = g_slist_prepend(priv->subscriptions, subscription);
+  g_ptr_array_add(priv->subscriptions, subscription);
+  g_hash_table_insert(priv->subscription_table, connection, subscription);
 
   if(priv->idle == TRUE)
   {
@@ -1057,7 +1065,8 @@ infd_session_proxy_remove_subscription(InfdSessionProxy* proxy,
     );
   }
 
-  priv->subscriptions = g_slist_remove(priv->subscriptions, subscr);
+  g_hash_table_remove(priv->subscription_table, connection);
+  g_ptr_array_remove(priv->subscriptions, subscr);
   infd_session_proxy_subscription_free(subscr);
 
   if(priv->idle == FALSE && infd_session_proxy_check_idle(proxy) == TRUE)
@@ -1370,6 +1379,7 @@ infd_session_proxy_class_init(InfdSessionProxyClass* proxy_class)
 
   object_class->constructed = infd_session_proxy_constructed;
   object_class->dispose = infd_session_proxy_dispose;
+  object_class->finalize = infd_session_proxy_finalize;
   object_class->set_property = infd_session_proxy_set_property;
   object_class->get_property = infd_session_proxy_get_property;
 
@@ -1693,7 +1703,7 @@ infd_session_proxy_has_subscriptions(InfdSessionProxy* proxy)
   g_return_val_if_fail(INFD_IS_SESSION_PROXY(proxy), FALSE);
   priv = INFD_SESSION_PROXY_PRIVATE(proxy);
 
-  if(priv->subscriptions == NULL)
+  if(priv->subscriptions->len == 0)
     return FALSE;
 
   return TRUE;
@@ -51,10 +51,14 @@ enum {
 };
 
 static guint text_buffer_signals[LAST_SIGNAL];
+static GQuark inf_text_buffer_peek_text_quark;
 
 static void
 inf_text_buffer_default_init(InfTextBufferInterface* iface)
 {
+  inf_text_buffer_peek_text_quark =
+    g_quark_from_static_string("inf-text-buffer-peek-text");
+
   text_buffer_signals[TEXT_INSERTED] = g_signal_new(
     "text-inserted",
     INF_TEXT_TYPE_BUFFER,
@@ -413,6 +417,65 @@ inf_text_buffer_iter_get_text(InfTextBuffer* buffer,
   return iface->iter_get_text(buffer, iter);
 }
 
+/**
+ * inf_text_buffer_iter_peek_text:
+ * @buffer: A #InfTextBuffer.
+ * @iter: A #InfTextBufferIter pointing into @buffer.
+ *
+ * Returns the text of the segment @iter points to, like
+ * inf_text_buffer_iter_get_text(), but without making a copy if @buffer
+ * can avoid it. The text is not null-terminated, use
+ * inf_text_buffer_iter_get_bytes() to find out its size.
+ *
+ * The returned memory is owned by @buffer. It is valid until @buffer is
+ * modified or until this function is called again for @buffer, whichever
+ * comes first. This makes it suitable for walking through all segments of
+ * the buffer to write them somewhere else, one segment at a time.
+ *
+ * If @buffer does not implement the @iter_peek_text virtual function, a
+ * copy of the text is kept with @buffer, and each call replaces the copy
+ * made by the previous one, also if it was made for a different iterator.
+ * Code that runs more than one iteration over the same buffer at a time,
+ * or that needs the text of a segment after moving on to the next one,
+ * must use inf_text_buffer_iter_get_text() instead, which returns a copy
+ * owned by the caller.
+ *
+ * Returns: (transfer none): The text of the segment @iter points to.
+ **/
+gconstpointer
+inf_text_buffer_iter_peek_text(InfTextBuffer* buffer,
+                               InfTextBufferIter* iter)
+{
+  InfTextBufferInterface* iface;
+  gconstpointer text;
+  gpointer copy;
+
+  g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), NULL);
+  g_return_val_if_fail(iter != NULL, NULL);
+
+  iface = INF_TEXT_BUFFER_GET_IFACE(buffer);
+
+  if(iface->iter_peek_text != NULL)
+  {
+    text = iface->iter_peek_text(buffer, iter);
+    if(text != NULL) return text;
+  }
+
+  /* Fall back to a copy which lives until the next call for this buffer,
+   * see the restriction in the documentation above. */
+  g_return_val_if_fail(iface->iter_get_text != NULL, NULL);
+  copy = iface->iter_get_text(buffer, iter);
+
+  g_object_set_qdata_full(
+    G_OBJECT(buffer),
+    inf_text_buffer_peek_text_quark,
+    copy,
+    g_free
+  );
+
+  return copy;
+}
+
 /**
  * inf_text_buffer_iter_get_offset:
  * @buffer: A #InfTextBuffer.
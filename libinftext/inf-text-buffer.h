@@ -83,6 +83,11 @@ typedef struct _InfTextBufferIter InfTextBufferIter;
  * signal.
  * @text_erased: Default signal handler of the #InfTextBuffer::text-erased
  * signal.
+ * @iter_peek_text: Virtual function to obtain the text of a segment a
+ * #InfTextBufferIter points to without copying it. The returned memory must
+ * stay valid until the buffer is modified. It can return %NULL if the text
+ * is not available in this form, in which case @iter_get_text is used.
+ * This function may be %NULL.
  *
  * This structure contains virtual functions and signal handlers of the
  * #InfTextBuffer interface.
@@ -150,6 +155,10 @@ struct _InfTextBufferInterface {
                      guint pos,
                      InfTextChunk* chunk,
                      InfUser* user);
+
+  /* Added after the signal handlers to keep the layout of the structure */
+  gconstpointer(*iter_peek_text)(InfTextBuffer* buffer,
+                                 InfTextBufferIter* iter);
 };
 
 GType
@@ -208,6 +217,10 @@ gpointer
 inf_text_buffer_iter_get_text(InfTextBuffer* buffer,
                               InfTextBufferIter* iter);
 
+gconstpointer
+inf_text_buffer_iter_peek_text(InfTextBuffer* buffer,
+                               InfTextBufferIter* iter);
+
 guint
 inf_text_buffer_iter_get_offset(InfTextBuffer* buffer,
                                 InfTextBufferIter* iter);
@@ -35,6 +35,14 @@
  * #InfTextChunkIter functionality can be used to iterate over the segments
  * of a chunk.
  *
+ * The text of large segments is reference-counted and shared between
+ * chunks instead of being copied, so that copying a chunk, or taking a
+ * substring of it, does not duplicate large pieces of text. Large pieces of
+ * text inserted with inf_text_chunk_insert_text() are in addition looked up
+ * by their content, so that the same text inserted into several chunks,
+ * such as when a paste is received again after undo and redo, is only
+ * stored once in memory. Shared text is copied as soon as it is modified.
+ *
  * The #InfTextChunk API works with characters, not bytes, i.e. all offsets
  * are given in number of characters. This ensures that unicode strings
  * cannot be torn apart in the middle of a multibyte sequence. The encoding
@@ -56,6 +64,10 @@ G_DEFINE_BOXED_TYPE(InfTextChunk, inf_text_chunk, inf_text_chunk_copy, inf_text_
 /* Don't check integrity in stable releases */
 /*#define CHUNK_CHECK_INTEGRITY*/
 
+/* Pieces of text at least this long are shared between segments instead of
+ * being copied, and are indexed by their content when inserted. */
+#define INF_TEXT_CHUNK_BLOB_SHARE_SIZE 4096
+
 typedef struct _InfTextChunkPath InfTextChunkPath;
 struct _InfTextChunkPath {
   gsize (*get_byte_index)(InfTextChunk* chunk,
@@ -72,12 +84,32 @@ struct _InfTextChunk {
   const InfTextChunkPath* path;
 };
 
+typedef struct _InfTextChunkBlobKey InfTextChunkBlobKey;
+struct _InfTextChunkBlobKey {
+  guint hash;
+  gsize size; /* in bytes */
+  const gchar* data;
+};
+
+typedef struct _InfTextChunkBlob InfTextChunkBlob;
+struct _InfTextChunkBlob {
+  gint ref_count;
+  /* Whether the blob is in inf_text_chunk_blob_store. Such blobs are never
+   * modified, since their content is the key of the store. */
+  gboolean stored;
+  InfTextChunkBlobKey key;
+  gsize size; /* allocated bytes */
+  gchar data[1];
+};
+
 typedef struct _InfTextChunkSegment InfTextChunkSegment;
 struct _InfTextChunkSegment {
   guint author;
+  /* Storage for text, possibly shared with other segments */
+  InfTextChunkBlob* blob;
   /* This is gchar so that we can do pointer arithmetic. It does not
    * necessarily store a full character in each byte. This depends on the
-   * encoding specified in the InfTextChunk. */
+   * encoding specified in the InfTextChunk. Points into blob. */
   gchar* text;
   gsize length; /* in bytes */
   guint offset; /* absolute to chunk begin in characters, sort criteria */
@@ -152,6 +184,136 @@ const InfTextChunkPath INF_TEXT_CHUNK_PATH_ICONV = {
   inf_text_chunk_get_byte_index_iconv
 };
 
+/*
+ * Blob store
+ */
+
+/* Maps InfTextChunkBlobKey to InfTextChunkBlob for large blobs, to share
+ * the storage for text that is inserted several times. The store is global
+ * to the process, so that equal text is shared across all chunks, also
+ * those of different buffers and sessions. It is created on first use and
+ * holds no references: a blob removes itself when its last reference is
+ * dropped, so the store is empty again once all chunks are freed.
+ *
+ * Chunks may be used from several threads, so inf_text_chunk_blob_mutex
+ * protects the store. It is held while looking up or inserting a blob, and
+ * while dropping the last reference to a stored blob, so that a lookup
+ * cannot return a blob that is about to be freed. Other reference count
+ * changes are atomic and do not take the mutex. */
+static GMutex inf_text_chunk_blob_mutex;
+static GHashTable* inf_text_chunk_blob_store;
+
+static guint
+inf_text_chunk_blob_key_hash(gconstpointer key)
+{
+  return ((const InfTextChunkBlobKey*)key)->hash;
+}
+
+static gboolean
+inf_text_chunk_blob_key_equal(gconstpointer key1,
+                              gconstpointer key2)
+{
+  const InfTextChunkBlobKey* first;
+  const InfTextChunkBlobKey* second;
+
+  first = (const InfTextChunkBlobKey*)key1;
+  second = (const InfTextChunkBlobKey*)key2;
+
+  if(first->hash != second->hash || first->size != second->size)
+    return FALSE;
+
+  return memcmp(first->data, second->data, first->size) == 0;
+}
+
+static InfTextChunkBlob*
+inf_text_chunk_blob_new(gsize size)
+{
+  InfTextChunkBlob* blob;
+
+  blob = g_malloc(G_STRUCT_OFFSET(InfTextChunkBlob, data) + MAX(size, 1));
+  blob->ref_count = 1;
+  blob->stored = FALSE;
+  blob->size = size;
+
+  return blob;
+}
+
+static InfTextChunkBlob*
+inf_text_chunk_blob_ref(InfTextChunkBlob* blob)
+{
+  g_atomic_int_inc(&blob->ref_count);
+  return blob;
+}
+
+static void
+inf_text_chunk_blob_unref(InfTextChunkBlob* blob)
+{
+  if(blob->stored)
+  {
+    /* Stored blobs only drop their last reference with the mutex held, so
+     * that a concurrent lookup never finds a blob that is being freed. */
+    g_mutex_lock(&inf_text_chunk_blob_mutex);
+    if(g_atomic_int_dec_and_test(&blob->ref_count))
+    {
+      g_hash_table_remove(inf_text_chunk_blob_store, &blob->key);
+      g_free(blob);
+    }
+    g_mutex_unlock(&inf_text_chunk_blob_mutex);
+  }
+  else
+  {
+    if(g_atomic_int_dec_and_test(&blob->ref_count))
+      g_free(blob);
+  }
+}
+
+/* Returns a reference to a stored blob containing the given text */
+static InfTextChunkBlob*
+inf_text_chunk_blob_intern(const gchar* text,
+                           gsize bytes)
+{
+  InfTextChunkBlobKey key;
+  InfTextChunkBlob* blob;
+  gsize i;
+
+  /* FNV-1a */
+  key.hash = 2166136261u;
+  for(i = 0; i < bytes; ++i)
+    key.hash = (key.hash ^ (guchar)text[i]) * 16777619u;
+  key.size = bytes;
+  key.data = text;
+
+  g_mutex_lock(&inf_text_chunk_blob_mutex);
+
+  if(inf_text_chunk_blob_store == NULL)
+  {
+    inf_text_chunk_blob_store = g_hash_table_new(
+      inf_text_chunk_blob_key_hash,
+      inf_text_chunk_blob_key_equal
+    );
+  }
+
+  blob = g_hash_table_lookup(inf_text_chunk_blob_store, &key);
+  if(blob != NULL)
+  {
+    inf_text_chunk_blob_ref(blob);
+  }
+  else
+  {
+    blob = inf_text_chunk_blob_new(bytes);
+    memcpy(blob->data, text, bytes);
+
+    blob->stored = TRUE;
+    blob->key.hash = key.hash;
+    blob->key.size = bytes;
+    blob->key.data = blob->data;
+    g_hash_table_insert(inf_text_chunk_blob_store, &blob->key, blob);
+  }
+
+  g_mutex_unlock(&inf_text_chunk_blob_mutex);
+  return blob;
+}
+
 /*
  * Helper functions
  */
@@ -159,10 +321,98 @@ const InfTextChunkPath INF_TEXT_CHUNK_PATH_ICONV = {
 static void
 inf_text_chunk_segment_free(InfTextChunkSegment* segment)
 {
-  g_free(segment->text);
+  inf_text_chunk_blob_unref(segment->blob);
   g_slice_free(InfTextChunkSegment, segment);
 }
 
+/* Allocates new, uninitialized storage for size bytes of segment text */
+static void
+inf_text_chunk_segment_alloc(InfTextChunkSegment* segment,
+                             gsize size)
+{
+  segment->blob = inf_text_chunk_blob_new(size);
+  segment->text = segment->blob->data;
+}
+
+/* Sets the text of a new segment to a copy of the given text */
+static void
+inf_text_chunk_segment_set_text(InfTextChunkSegment* segment,
+                                gconstpointer text,
+                                gsize bytes)
+{
+  if(bytes >= INF_TEXT_CHUNK_BLOB_SHARE_SIZE)
+  {
+    segment->blob = inf_text_chunk_blob_intern(text, bytes);
+    segment->text = segment->blob->data;
+  }
+  else
+  {
+    inf_text_chunk_segment_alloc(segment, bytes);
+    memcpy(segment->text, text, bytes);
+  }
+
+  segment->length = bytes;
+}
+
+/* Sets the text of a new segment to a part of the text of another segment.
+ * Large parts are shared instead of copied, unless they cover less than
+ * half of the blob, since the slice would keep all of the blob alive. */
+static void
+inf_text_chunk_segment_set_slice(InfTextChunkSegment* segment,
+                                 InfTextChunkSegment* from,
+                                 gsize index,
+                                 gsize bytes)
+{
+  if(bytes >= INF_TEXT_CHUNK_BLOB_SHARE_SIZE &&
+     bytes * 2 >= from->blob->size)
+  {
+    segment->blob = inf_text_chunk_blob_ref(from->blob);
+    segment->text = from->text + index;
+    segment->length = bytes;
+  }
+  else
+  {
+    inf_text_chunk_segment_set_text(segment, from->text + index, bytes);
+  }
+}
+
+/* Makes sure that the segment's text can be modified in place, and that
+ * there is room for size bytes. The segment's current text is kept, up to
+ * size bytes. */
+static void
+inf_text_chunk_segment_reserve(InfTextChunkSegment* segment,
+                               gsize size)
+{
+  InfTextChunkBlob* blob;
+  gchar* text;
+
+  blob = segment->blob;
+  if(!blob->stored && g_atomic_int_get(&blob->ref_count) == 1)
+  {
+    if(segment->text != blob->data)
+    {
+      g_memmove(blob->data, segment->text, MIN(segment->length, size));
+      segment->text = blob->data;
+    }
+
+    if(size > blob->size)
+    {
+      blob = g_realloc(blob, G_STRUCT_OFFSET(InfTextChunkBlob, data) + size);
+      blob->size = size;
+
+      segment->blob = blob;
+      segment->text = blob->data;
+    }
+  }
+  else
+  {
+    text = segment->text;
+    inf_text_chunk_segment_alloc(segment, size);
+    memcpy(segment->text, text, MIN(segment->length, size));
+    inf_text_chunk_blob_unref(blob);
+  }
+}
+
 static int
 inf_text_chunk_segment_cmp(gconstpointer first,
                            gconstpointer second,
@@ -417,8 +667,7 @@ inf_text_chunk_copy(InfTextChunk* self)
     InfTextChunkSegment* segment = g_sequence_get(iter);
     InfTextChunkSegment* new_segment = g_slice_new(InfTextChunkSegment);
     new_segment->author = segment->author;
-    new_segment->text = g_memdup(segment->text, segment->length);
-    new_segment->length = segment->length;
+    inf_text_chunk_segment_set_slice(new_segment, segment, 0, segment->length);
     new_segment->offset = segment->offset;
     g_sequence_append(new_chunk->segments, new_segment);
   }
@@ -526,12 +775,13 @@ inf_text_chunk_substring(InfTextChunk* self,
       new_segment = g_slice_new(InfTextChunkSegment);
       new_segment->author = segment->author;
 
-      new_segment->text = g_memdup(
-        segment->text + begin_index,
+      inf_text_chunk_segment_set_slice(
+        new_segment,
+        segment,
+        begin_index,
         segment->length - begin_index
       );
-      
-      new_segment->length = segment->length - begin_index;
+
       new_segment->offset = current_length;
 
       begin_iter = g_sequence_iter_next(begin_iter);
@@ -551,12 +801,14 @@ inf_text_chunk_substring(InfTextChunk* self,
     /* Don't forget last segment */
     new_segment = g_slice_new(InfTextChunkSegment);
     new_segment->author = segment->author;
-    new_segment->text = g_memdup(
-      segment->text + begin_index,
+
+    inf_text_chunk_segment_set_slice(
+      new_segment,
+      segment,
+      begin_index,
       end_index - begin_index
     );
-    
-    new_segment->length = end_index - begin_index;
+
     new_segment->offset = current_length;
     
     g_sequence_append(result->segments, new_segment);
@@ -632,12 +884,14 @@ inf_text_chunk_insert_text(InfTextChunk* self,
       {
         new_segment = g_slice_new(InfTextChunkSegment);
         new_segment->author = segment->author;
-        new_segment->text = g_memdup(
-          segment->text + offset_index,
+
+        inf_text_chunk_segment_set_slice(
+          new_segment,
+          segment,
+          offset_index,
           segment->length - offset_index
         );
 
-        new_segment->length = segment->length - offset_index;
         new_segment->offset = offset;
 
         iter = g_sequence_iter_next(iter);
@@ -655,15 +909,13 @@ inf_text_chunk_insert_text(InfTextChunk* self,
 
       new_segment = g_slice_new(InfTextChunkSegment);
       new_segment->author = author;
-      new_segment->text = g_memdup(text, bytes);
-      new_segment->length = bytes;
+      inf_text_chunk_segment_set_text(new_segment, text, bytes);
       new_segment->offset = offset;
       g_sequence_insert_before(iter, new_segment);
     }
     else
     {
-      /* TODO: g_malloc + g_free + 2*memcpy? */
-      segment->text = g_realloc(segment->text, segment->length + bytes);
+      inf_text_chunk_segment_reserve(segment, segment->length + bytes);
       if(offset_index < segment->length)
       {
         g_memmove(
@@ -692,8 +944,7 @@ inf_text_chunk_insert_text(InfTextChunk* self,
   {
     new_segment = g_slice_new(InfTextChunkSegment);
     new_segment->author = author;
-    new_segment->text = g_memdup(text, bytes);
-    new_segment->length = bytes;
+    inf_text_chunk_segment_set_text(new_segment, text, bytes);
     new_segment->offset = 0;
 
     g_sequence_append(self->segments, new_segment);
@@ -797,19 +1048,19 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
         if(first_merge->author == first->author && offset > 0)
         {
           /* Can merge first segment */
-          first_merge->length += first->length;
-
-          first_merge->text = g_realloc(
-            first_merge->text,
-            first_merge->length
+          inf_text_chunk_segment_reserve(
+            first_merge,
+            first_merge->length + first->length
           );
 
           memcpy(
-            first_merge->text + first_merge->length - first->length,
+            first_merge->text + first_merge->length,
             first->text,
             first->length
           );
 
+          first_merge->length += first->length;
+
           /* Already inserted */
           first_iter = g_sequence_iter_next(first_iter);
         }
@@ -817,16 +1068,19 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
         if(last_merge->author == last->author && offset < self->length)
         {
           /* Can merge last segment */
-          last_merge->length += last->length;
-          last_merge->text = g_realloc(last_merge->text, last_merge->length);
+          inf_text_chunk_segment_reserve(
+            last_merge,
+            last_merge->length + last->length
+          );
 
           g_memmove(
             last_merge->text + last->length,
             last_merge->text,
-            last_merge->length - last->length
+            last_merge->length
           );
 
           memcpy(last_merge->text, last->text, last->length);
+          last_merge->length += last->length;
           last_merge->offset = offset + last->offset;
 
           /* Merged with last, so don't need to adjust last_merge->offset
@@ -863,7 +1117,7 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
           new_segment->length = last_merge->length - offset_index +
             last->length;
 
-          new_segment->text = g_malloc(new_segment->length);
+          inf_text_chunk_segment_alloc(new_segment, new_segment->length);
           memcpy(new_segment->text, last->text, last->length);
 
           memcpy(
@@ -877,13 +1131,11 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
         else
         {
           /* Split up last part */
-          new_segment->length = last_merge->length - offset_index;
-          new_segment->text = g_malloc(new_segment->length);
-
-          memcpy(
-            new_segment->text,
-            last_merge->text + offset_index,
-            new_segment->length
+          inf_text_chunk_segment_set_slice(
+            new_segment,
+            last_merge,
+            offset_index,
+            last_merge->length - offset_index
           );
 
           new_segment->offset = offset + text->length;
@@ -903,13 +1155,10 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
         if(first_merge->author == first->author)
         {
           /* Merge into first */
-          if(first_merge->length < offset_index + first->length)
-          {
-            first_merge->text = g_realloc(
-              first_merge->text,
-              offset_index + first->length
-            );
-          }
+          inf_text_chunk_segment_reserve(
+            first_merge,
+            offset_index + first->length
+          );
 
           first_merge->length = offset_index + first->length;
 
@@ -940,8 +1189,14 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
         new_segment = g_slice_new(InfTextChunkSegment);
 
         new_segment->author = segment->author;
-        new_segment->text = g_memdup(segment->text, segment->length);
-        new_segment->length = segment->length;
+
+        inf_text_chunk_segment_set_slice(
+          new_segment,
+          segment,
+          0,
+          segment->length
+        );
+
         new_segment->offset = offset + segment->offset;
         g_sequence_insert_before(iter, new_segment);
       }
@@ -967,10 +1222,15 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
       new_segment = g_slice_new(InfTextChunkSegment);
 
       new_segment->author = segment->author;
-      new_segment->text = g_memdup(segment->text, segment->length);
-      new_segment->length = segment->length;
-      new_segment->offset = segment->offset;
 
+      inf_text_chunk_segment_set_slice(
+        new_segment,
+        segment,
+        0,
+        segment->length
+      );
+
+      new_segment->offset = segment->offset;
       g_sequence_append(self->segments, new_segment);
     }
 
@@ -1030,6 +1290,8 @@ inf_text_chunk_erase(InfTextChunk* self,
         if(first == last)
         {
           /* Remove within a segment */
+          inf_text_chunk_segment_reserve(first, first->length);
+
           g_memmove(
             first->text + first_index,
             first->text + last_index,
@@ -1041,13 +1303,10 @@ inf_text_chunk_erase(InfTextChunk* self,
         }
         else
         {
-          if(first->length < first_index + last->length - last_index)
-          {
-            first->text = g_realloc(
-              first->text,
-              first_index + last->length - last_index
-            );
-          }
+          inf_text_chunk_segment_reserve(
+            first,
+            first_index + last->length - last_index
+          );
 
           first->length = first_index + last->length - last_index;
 
@@ -1069,18 +1328,11 @@ inf_text_chunk_erase(InfTextChunk* self,
         g_assert(first_index > 0);
         g_assert(last_index < last->length);
         
-        /* Erase from border segments */
+        /* Erase from border segments. The beginning of last is cut off by
+         * moving its text pointer, which also works for shared text. */
         first->length = first_index;
 
-        if(last_index > 0)
-        {
-          g_memmove(
-            last->text,
-            last->text + last_index,
-            last->length - last_index
-          );
-        }
-
+        last->text += last_index;
         last->length -= last_index;
         last->offset = begin;
 
@@ -1108,12 +1360,7 @@ inf_text_chunk_erase(InfTextChunk* self,
         /* Erase from beginning */
         if(last_index > 0)
         {
-          g_memmove(
-            last->text,
-            last->text + last_index,
-            last->length - last_index
-          );
-
+          last->text += last_index;
           last->length -= last_index;
           last->offset = 0;
 
@@ -1258,8 +1505,11 @@ inf_text_chunk_equal(InfTextChunk* self,
     if(segment1->length != segment2->length)
       return FALSE;
 
-    if(memcmp(segment1->text, segment2->text, segment1->length) != 0)
+    if(segment1->text != segment2->text &&
+       memcmp(segment1->text, segment2->text, segment1->length) != 0)
+    {
       return FALSE;
+    }
 
     iter1 = g_sequence_iter_next(iter1);
     iter2 = g_sequence_iter_next(iter2);
@@ -296,6 +296,13 @@ inf_text_default_buffer_buffer_iter_get_text(InfTextBuffer* buffer,
   );
 }
 
+static gconstpointer
+inf_text_default_buffer_buffer_iter_peek_text(InfTextBuffer* buffer,
+                                              InfTextBufferIter* iter)
+{
+  return inf_text_chunk_iter_get_text(&iter->chunk_iter);
+}
+
 static guint
 inf_text_default_buffer_buffer_iter_get_offset(InfTextBuffer* buffer,
                                                InfTextBufferIter* iter)
@@ -375,6 +382,7 @@ inf_text_default_buffer_text_buffer_iface_init(InfTextBufferInterface* iface)
   iface->iter_get_length = inf_text_default_buffer_buffer_iter_get_length;
   iface->iter_get_bytes = inf_text_default_buffer_buffer_iter_get_bytes;
   iface->iter_get_author = inf_text_default_buffer_buffer_iter_get_author;
+  iface->iter_peek_text = inf_text_default_buffer_buffer_iter_peek_text;
   iface->text_inserted = NULL;
   iface->text_erased = NULL;
 }
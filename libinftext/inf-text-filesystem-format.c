@@ -30,9 +30,17 @@
  * implementing a #InfdNotePlugin to handle #InfTextSession<!-- -->s. These
  * functions implement reading and writing the content of an #InfTextSession
  * to an XML file in the storage.
+ *
+ * In addition to the document itself, the request logs of a session can be
+ * stored in a second file next to it with
+ * inf_text_filesystem_format_write_request_log(). When the session is read
+ * again with inf_text_filesystem_format_read_session(), the request logs
+ * and the users' state vectors are restored, so that users can still undo
+ * their changes after the session has been unloaded from memory.
  */
 
 #include <libinftext/inf-text-filesystem-format.h>
+#include <libinftext/inf-text-default-buffer.h>
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/inf-i18n.h>
 
@@ -43,6 +51,23 @@ typedef struct _InfTextFilesystemFormatWriteData {
   GHashTable* encountered_authors;
 } InfTextFilesystemFormatWriteData;
 
+typedef struct _InfTextFilesystemFormatWriteLogData {
+  InfAdoptedSession* session;
+  xmlNodePtr root;
+} InfTextFilesystemFormatWriteLogData;
+
+typedef struct _InfTextFilesystemFormatLogUser {
+  xmlNodePtr xml;
+  guint id;
+  xmlChar* name;
+  gdouble hue;
+  InfAdoptedStateVector* vector;
+} InfTextFilesystemFormatLogUser;
+
+/* Storage identifier of the request log file. It does not start with "Inf",
+ * so that the file does not show up as a separate node. */
+#define INF_TEXT_FILESYSTEM_FORMAT_LOG_IDENTIFIER "InfText.log"
+
 static GQuark
 inf_text_filesystem_format_error_quark()
 {
@@ -281,6 +306,367 @@ inf_text_filesystem_format_write_foreach_user_func(InfUser* user,
   }
 }
 
+/* Used to detect a request log that does not belong to the document
+ * content, for example because the document was modified in between. */
+static gchar*
+inf_text_filesystem_format_buffer_checksum(InfTextBuffer* buffer)
+{
+  GChecksum* checksum;
+  InfTextBufferIter* iter;
+  gchar* result;
+
+  checksum = g_checksum_new(G_CHECKSUM_SHA1);
+  iter = inf_text_buffer_create_begin_iter(buffer);
+  if(iter != NULL)
+  {
+    do
+    {
+      g_checksum_update(
+        checksum,
+        (const guchar*)inf_text_buffer_iter_peek_text(buffer, iter),
+        inf_text_buffer_iter_get_bytes(buffer, iter)
+      );
+    } while(inf_text_buffer_iter_next(buffer, iter));
+
+    inf_text_buffer_destroy_iter(buffer, iter);
+  }
+
+  result = g_strdup(g_checksum_get_string(checksum));
+  g_checksum_free(checksum);
+  return result;
+}
+
+static void
+inf_text_filesystem_format_write_log_foreach_user_func(InfUser* user,
+                                                       gpointer user_data)
+{
+  InfTextFilesystemFormatWriteLogData* data;
+  InfAdoptedSessionClass* session_class;
+  InfAdoptedRequestLog* log;
+  InfAdoptedRequest* request;
+  InfAdoptedStateVector* prev;
+  xmlNodePtr node;
+  xmlNodePtr child;
+  gchar* time;
+  guint i;
+  guint end;
+
+  data = (InfTextFilesystemFormatWriteLogData*)user_data;
+  session_class = INF_ADOPTED_SESSION_GET_CLASS(data->session);
+
+  /* Users that never issued a request do not appear in any state vector,
+   * and are not needed to restore the logs. */
+  if(inf_adopted_user_get_component(INF_ADOPTED_USER(user),
+                                    inf_user_get_id(user)) == 0)
+  {
+    return;
+  }
+
+  node = xmlNewChild(data->root, NULL, (const xmlChar*)"user", NULL);
+  inf_xml_util_set_attribute_uint(node, "id", inf_user_get_id(user));
+  inf_xml_util_set_attribute(node, "name", inf_user_get_name(user));
+  inf_xml_util_set_attribute_double(
+    node,
+    "hue",
+    inf_text_user_get_hue(INF_TEXT_USER(user))
+  );
+
+  time = inf_adopted_state_vector_to_string(
+    inf_adopted_user_get_vector(INF_ADOPTED_USER(user))
+  );
+
+  inf_xml_util_set_attribute(node, "time", time);
+  g_free(time);
+
+  /* Each request's state is written as a diff to the previous one, which
+   * keeps the file small since consecutive requests of a user mostly
+   * differ in few components. */
+  log = inf_adopted_user_get_request_log(INF_ADOPTED_USER(user));
+  end = inf_adopted_request_log_get_end(log);
+  prev = NULL;
+
+  for(i = inf_adopted_request_log_get_begin(log); i < end; ++i)
+  {
+    request = inf_adopted_request_log_get_request(log, i);
+    child = xmlNewChild(node, NULL, (const xmlChar*)"sync-request", NULL);
+    session_class->request_to_xml(data->session, child, request, prev, TRUE);
+    prev = inf_adopted_request_get_vector(request);
+  }
+}
+
+/* Reads the users of a request log and checks that they are consistent with
+ * the users that have been read from the document already. Users are only
+ * added to the user table after all of them have been checked. */
+static gboolean
+inf_text_filesystem_format_read_log_users(xmlDocPtr doc,
+                                          InfUserTable* user_table,
+                                          InfTextBuffer* buffer,
+                                          GError** error)
+{
+  xmlNodePtr root;
+  xmlNodePtr child;
+  xmlChar* attr;
+  gchar* checksum;
+  gboolean result;
+  GSList* users;
+  GSList* item;
+  InfTextFilesystemFormatLogUser* log_user;
+  InfUser* user;
+
+  root = xmlDocGetRootElement(doc);
+  attr = inf_xml_util_get_attribute_required(root, "checksum", error);
+  if(attr == NULL)
+    return FALSE;
+
+  checksum = inf_text_filesystem_format_buffer_checksum(buffer);
+  result = (strcmp((const char*)attr, checksum) == 0);
+  g_free(checksum);
+  xmlFree(attr);
+
+  if(result == FALSE)
+  {
+    g_set_error_literal(
+      error,
+      inf_text_filesystem_format_error_quark(),
+      INF_TEXT_FILESYSTEM_FORMAT_ERROR_REQUEST_LOG_MISMATCH,
+      _("The request log does not match the document")
+    );
+
+    return FALSE;
+  }
+
+  users = NULL;
+  for(child = root->children; child != NULL && result; child = child->next)
+  {
+    if(child->type != XML_ELEMENT_NODE)
+      continue;
+    if(strcmp((const char*)child->name, "user") != 0)
+      continue;
+
+    log_user = g_slice_new(InfTextFilesystemFormatLogUser);
+    log_user->xml = child;
+    log_user->name = NULL;
+    log_user->vector = NULL;
+    users = g_slist_prepend(users, log_user);
+
+    result = inf_xml_util_get_attribute_uint_required(
+      child,
+      "id",
+      &log_user->id,
+      error
+    );
+
+    if(result == TRUE)
+    {
+      result = inf_xml_util_get_attribute_double_required(
+        child,
+        "hue",
+        &log_user->hue,
+        error
+      );
+    }
+
+    if(result == TRUE)
+    {
+      log_user->name = inf_xml_util_get_attribute_required(
+        child,
+        "name",
+        error
+      );
+
+      if(log_user->name == NULL)
+        result = FALSE;
+    }
+
+    if(result == TRUE)
+    {
+      attr = inf_xml_util_get_attribute_required(child, "time", error);
+      if(attr == NULL)
+      {
+        result = FALSE;
+      }
+      else
+      {
+        log_user->vector =
+          inf_adopted_state_vector_from_string((const gchar*)attr, error);
+        xmlFree(attr);
+
+        if(log_user->vector == NULL)
+          result = FALSE;
+      }
+    }
+
+    if(result == TRUE)
+    {
+      user = inf_user_table_lookup_user_by_id(user_table, log_user->id);
+      if(user == NULL)
+      {
+        user = inf_user_table_lookup_user_by_name(
+          user_table,
+          (const gchar*)log_user->name
+        );
+      }
+
+      if(user != NULL &&
+         (inf_user_get_id(user) != log_user->id ||
+          strcmp(inf_user_get_name(user), (const gchar*)log_user->name) != 0))
+      {
+        g_set_error_literal(
+          error,
+          inf_text_filesystem_format_error_quark(),
+          INF_TEXT_FILESYSTEM_FORMAT_ERROR_REQUEST_LOG_MISMATCH,
+          _("The users of the request log do not match the document")
+        );
+
+        result = FALSE;
+      }
+    }
+  }
+
+  for(item = users; item != NULL; item = item->next)
+  {
+    log_user = (InfTextFilesystemFormatLogUser*)item->data;
+
+    if(result == TRUE)
+    {
+      user = inf_user_table_lookup_user_by_id(user_table, log_user->id);
+      if(user != NULL)
+      {
+        /* The session has not been created yet, so it is fine to just
+         * replace the vector. */
+        g_object_set(G_OBJECT(user), "vector", log_user->vector, NULL);
+      }
+      else
+      {
+        user = INF_USER(
+          g_object_new(
+            INF_TEXT_TYPE_USER,
+            "id", log_user->id,
+            "name", log_user->name,
+            "hue", log_user->hue,
+            "vector", log_user->vector,
+            NULL
+          )
+        );
+
+        inf_user_table_add_user(user_table, user);
+        g_object_unref(user);
+      }
+    }
+
+    if(log_user->vector != NULL)
+      inf_adopted_state_vector_free(log_user->vector);
+    if(log_user->name != NULL)
+      xmlFree(log_user->name);
+    g_slice_free(InfTextFilesystemFormatLogUser, log_user);
+  }
+
+  g_slist_free(users);
+  return result;
+}
+
+/* Fills the request logs of a newly created session, whose users have been
+ * read with inf_text_filesystem_format_read_log_users() before. */
+static gboolean
+inf_text_filesystem_format_read_log_requests(InfAdoptedSession* session,
+                                             xmlDocPtr doc,
+                                             GError** error)
+{
+  InfAdoptedSessionClass* session_class;
+  InfUserTable* user_table;
+  xmlNodePtr child;
+  xmlNodePtr request_xml;
+  guint id;
+  guint n;
+  InfUser* user;
+  InfAdoptedRequestLog* log;
+  InfAdoptedRequest* request;
+  InfAdoptedStateVector* prev;
+
+  session_class = INF_ADOPTED_SESSION_GET_CLASS(session);
+  user_table = inf_session_get_user_table(INF_SESSION(session));
+
+  child = xmlDocGetRootElement(doc)->children;
+  for(; child != NULL; child = child->next)
+  {
+    if(child->type != XML_ELEMENT_NODE)
+      continue;
+    if(strcmp((const char*)child->name, "user") != 0)
+      continue;
+
+    inf_xml_util_get_attribute_uint(child, "id", &id, NULL);
+    user = inf_user_table_lookup_user_by_id(user_table, id);
+    g_assert(user != NULL);
+
+    log = inf_adopted_user_get_request_log(INF_ADOPTED_USER(user));
+    n = inf_adopted_user_get_component(INF_ADOPTED_USER(user), id);
+    prev = NULL;
+
+    for(request_xml = child->children;
+        request_xml != NULL;
+        request_xml = request_xml->next)
+    {
+      if(request_xml->type != XML_ELEMENT_NODE)
+        continue;
+      if(strcmp((const char*)request_xml->name, "sync-request") != 0)
+        continue;
+
+      request = session_class->xml_to_request(
+        session,
+        request_xml,
+        prev,
+        TRUE,
+        error
+      );
+
+      if(request == NULL)
+        return FALSE;
+
+      if(inf_adopted_request_get_user_id(request) != id ||
+         inf_adopted_request_get_index(request) >= n ||
+         (!inf_adopted_request_log_is_empty(log) &&
+          inf_adopted_request_get_index(request) !=
+          inf_adopted_request_log_get_end(log)))
+      {
+        g_object_unref(request);
+
+        g_set_error_literal(
+          error,
+          inf_text_filesystem_format_error_quark(),
+          INF_TEXT_FILESYSTEM_FORMAT_ERROR_REQUEST_LOG_MISMATCH,
+          _("The request log is not consistent")
+        );
+
+        return FALSE;
+      }
+
+      inf_adopted_request_log_add_request(log, request);
+      prev = inf_adopted_request_get_vector(request);
+      g_object_unref(request);
+    }
+
+    /* Like after synchronization, make sure the log begins at the user's
+     * next request if it is empty. */
+    if(inf_adopted_request_log_is_empty(log))
+    {
+      inf_adopted_request_log_set_begin(log, n);
+    }
+    else if(inf_adopted_request_log_get_end(log) != n)
+    {
+      g_set_error_literal(
+        error,
+        inf_text_filesystem_format_error_quark(),
+        INF_TEXT_FILESYSTEM_FORMAT_ERROR_REQUEST_LOG_MISMATCH,
+        _("The request log is not consistent")
+      );
+
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
 /**
  * inf_text_filesystem_format_read:
  * @storage: A #InfdFilesystemStorage.
@@ -454,7 +840,7 @@ inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
   xmlNodePtr segment_node;
 
   guint author;
-  gchar* content;
+  const gchar* content;
   gsize bytes;
   gchar* converted;
   gsize converted_bytes;
@@ -500,7 +886,7 @@ inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
     do
     {
       author = inf_text_buffer_iter_get_author(buffer, iter);
-      content = inf_text_buffer_iter_get_text(buffer, iter);
+      content = inf_text_buffer_iter_peek_text(buffer, iter);
       bytes = inf_text_buffer_iter_get_bytes(buffer, iter);
 
       /* TODO: Use g_hash_table_add with glib 2.32 */
@@ -523,7 +909,6 @@ inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
       {
         /* Buffer is UTF-8, no conversion necessary */
         inf_xml_util_add_child_text(segment_node, content, bytes);
-        g_free(content);
       }
       else
       {
@@ -538,8 +923,6 @@ inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
           error
         );
 
-        g_free(content);
-
         if(converted == NULL)
         {
           xmlFreeNode(buffer_node);
@@ -598,4 +981,228 @@ inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
   return TRUE;
 }
 
+/**
+ * inf_text_filesystem_format_write_request_log:
+ * @storage: A #InfdFilesystemStorage.
+ * @path: Storage path of the document whose request log to write.
+ * @session: The #InfTextSession whose request logs to write.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Writes the request logs of all users of @session, together with the
+ * users' state vectors, into a file next to the document at @path. The
+ * request logs are restored when the session is read back with
+ * inf_text_filesystem_format_read_session(), so that undo history survives
+ * unloading the session. The document itself must be written with
+ * inf_text_filesystem_format_write() at the same time; a request log that
+ * does not match the document is ignored when reading.
+ *
+ * Returns: %TRUE on success or %FALSE on error.
+ */
+gboolean
+inf_text_filesystem_format_write_request_log(InfdFilesystemStorage* storage,
+                                             const gchar* path,
+                                             InfTextSession* session,
+                                             GError** error)
+{
+  InfTextFilesystemFormatWriteLogData data;
+  gchar* checksum;
+  xmlDocPtr doc;
+  gboolean result;
+
+  g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), FALSE);
+  g_return_val_if_fail(path != NULL, FALSE);
+  g_return_val_if_fail(INF_TEXT_IS_SESSION(session), FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  data.session = INF_ADOPTED_SESSION(session);
+  data.root = xmlNewNode(NULL, (const xmlChar*)"inf-text-request-log");
+
+  checksum = inf_text_filesystem_format_buffer_checksum(
+    INF_TEXT_BUFFER(inf_session_get_buffer(INF_SESSION(session)))
+  );
+
+  inf_xml_util_set_attribute(data.root, "checksum", checksum);
+  g_free(checksum);
+
+  inf_user_table_foreach_user(
+    inf_session_get_user_table(INF_SESSION(session)),
+    inf_text_filesystem_format_write_log_foreach_user_func,
+    &data
+  );
+
+  doc = xmlNewDoc((const xmlChar*)"1.0");
+  xmlDocSetRootElement(doc, data.root);
+
+  result = infd_filesystem_storage_write_xml_file(
+    storage,
+    INF_TEXT_FILESYSTEM_FORMAT_LOG_IDENTIFIER,
+    path,
+    doc,
+    error
+  );
+
+  xmlFreeDoc(doc);
+  return result;
+}
+
+/* Reads the session at path, restoring the request logs from log if it is
+ * non-NULL. If the document cannot be read, error is set. If the request
+ * log cannot be restored, log_error is set instead. */
+static InfTextSession*
+inf_text_filesystem_format_load_session(InfdFilesystemStorage* storage,
+                                        const gchar* path,
+                                        InfCommunicationManager* manager,
+                                        InfIo* io,
+                                        xmlDocPtr log,
+                                        GError** log_error,
+                                        GError** error)
+{
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+  InfTextSession* session;
+
+  user_table = inf_user_table_new();
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+  if(!inf_text_filesystem_format_read(storage, path, user_table, buffer,
+                                      error))
+  {
+    g_object_unref(user_table);
+    g_object_unref(buffer);
+    return NULL;
+  }
+
+  if(log != NULL)
+  {
+    if(!inf_text_filesystem_format_read_log_users(log, user_table, buffer,
+                                                  log_error))
+    {
+      g_object_unref(user_table);
+      g_object_unref(buffer);
+      return NULL;
+    }
+  }
+
+  session = inf_text_session_new_with_user_table(
+    manager,
+    buffer,
+    io,
+    user_table,
+    INF_SESSION_RUNNING,
+    NULL,
+    NULL
+  );
+
+  g_object_unref(user_table);
+  g_object_unref(buffer);
+
+  if(log != NULL)
+  {
+    if(!inf_text_filesystem_format_read_log_requests(
+         INF_ADOPTED_SESSION(session), log, log_error))
+    {
+      inf_session_close(INF_SESSION(session));
+      g_object_unref(session);
+      return NULL;
+    }
+  }
+
+  return session;
+}
+
+/**
+ * inf_text_filesystem_format_read_session:
+ * @storage: A #InfdFilesystemStorage.
+ * @path: Storage path to retrieve the session from.
+ * @manager: The #InfCommunicationManager for the new session.
+ * @io: The #InfIo for the new session.
+ * @error: Location to store error information, if any, or %NULL.
+ *
+ * Reads the document at @path with inf_text_filesystem_format_read() into
+ * a new #InfTextDefaultBuffer in UTF-8, and creates a running
+ * #InfTextSession for it. If a request log has been written for the
+ * document with inf_text_filesystem_format_write_request_log(), the users'
+ * request logs and state vectors are restored as well. If the request log
+ * cannot be read or does not match the document, then it is ignored and
+ * the session starts without undo history, as if it had been read with
+ * inf_text_filesystem_format_read().
+ *
+ * Returns: (transfer full): A new #InfTextSession, or %NULL on error.
+ */
+InfTextSession*
+inf_text_filesystem_format_read_session(InfdFilesystemStorage* storage,
+                                        const gchar* path,
+                                        InfCommunicationManager* manager,
+                                        InfIo* io,
+                                        GError** error)
+{
+  InfTextSession* session;
+  xmlDocPtr log;
+  GError* log_error;
+
+  g_return_val_if_fail(INFD_IS_FILESYSTEM_STORAGE(storage), NULL);
+  g_return_val_if_fail(path != NULL, NULL);
+  g_return_val_if_fail(INF_IS_COMMUNICATION_MANAGER(manager), NULL);
+  g_return_val_if_fail(INF_IS_IO(io), NULL);
+  g_return_val_if_fail(error == NULL || *error == NULL, NULL);
+
+  log_error = NULL;
+  log = infd_filesystem_storage_read_xml_file(
+    storage,
+    INF_TEXT_FILESYSTEM_FORMAT_LOG_IDENTIFIER,
+    path,
+    "inf-text-request-log",
+    &log_error
+  );
+
+  /* A missing log is not an error: sessions that were written without one
+   * simply have no undo history. */
+  if(log == NULL &&
+     g_error_matches(log_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+  {
+    g_error_free(log_error);
+    log_error = NULL;
+  }
+
+  session = NULL;
+  if(log_error == NULL)
+  {
+    session = inf_text_filesystem_format_load_session(
+      storage,
+      path,
+      manager,
+      io,
+      log,
+      &log_error,
+      error
+    );
+  }
+
+  if(log != NULL)
+    xmlFreeDoc(log);
+
+  if(log_error != NULL)
+  {
+    g_warning(
+      _("Ignoring request log of \"%s\": %s"),
+      path,
+      log_error->message
+    );
+
+    g_error_free(log_error);
+
+    session = inf_text_filesystem_format_load_session(
+      storage,
+      path,
+      manager,
+      io,
+      NULL,
+      NULL,
+      error
+    );
+  }
+
+  return session;
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -35,6 +35,8 @@ G_BEGIN_DECLS
  * session contains users with duplicate ID or duplicate name.
  * @INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER: A segment of the text
  * document is written by a user which does not exist.
+ * @INF_TEXT_FILESYSTEM_FORMAT_ERROR_REQUEST_LOG_MISMATCH: The stored request
+ * log does not belong to the stored document, or is inconsistent.
  *
  * Errors that can occur when reading a #InfTextSession from a
  * #InfdFilesystemStorage.
@@ -42,7 +44,8 @@ G_BEGIN_DECLS
 typedef enum _InfTextFilesystemFormatError {
   INF_TEXT_FILESYSTEM_FORMAT_ERROR_NOT_A_TEXT_SESSION,
   INF_TEXT_FILESYSTEM_FORMAT_ERROR_USER_EXISTS,
-  INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER
+  INF_TEXT_FILESYSTEM_FORMAT_ERROR_NO_SUCH_USER,
+  INF_TEXT_FILESYSTEM_FORMAT_ERROR_REQUEST_LOG_MISMATCH
 } InfTextFilesystemFormatError;
 
 gboolean
@@ -59,6 +62,19 @@ inf_text_filesystem_format_write(InfdFilesystemStorage* storage,
                                  InfTextBuffer* buffer,
                                  GError** error);
 
+gboolean
+inf_text_filesystem_format_write_request_log(InfdFilesystemStorage* storage,
+                                             const gchar* path,
+                                             InfTextSession* session,
+                                             GError** error);
+
+InfTextSession*
+inf_text_filesystem_format_read_session(InfdFilesystemStorage* storage,
+                                        const gchar* path,
+                                        InfCommunicationManager* manager,
+                                        InfIo* io,
+                                        GError** error);
+
 G_END_DECLS
 
 #endif /* __INF_TEXT_FILESYSTEM_FORMAT_H__ */
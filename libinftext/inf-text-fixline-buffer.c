@@ -144,8 +144,8 @@ inf_text_fixline_buffer_buffer_count_trailing_newlines(InfTextBuffer* buffer,
   InfTextBufferIter* iter;
   guint cur_pos;
 
-  gchar* text;
-  gchar* text_pos;
+  const gchar* text;
+  const gchar* text_pos;
   gunichar c;
 
   /* TODO: Implement this properly with iconv */
@@ -155,7 +155,7 @@ inf_text_fixline_buffer_buffer_count_trailing_newlines(InfTextBuffer* buffer,
   if(iter == NULL) return 0;
 
   cur_pos = inf_text_buffer_get_length(buffer);
-  text = inf_text_buffer_iter_get_text(buffer, iter);
+  text = inf_text_buffer_iter_peek_text(buffer, iter);
   text_pos = text + inf_text_buffer_iter_get_bytes(buffer, iter);
 
   for(cur_pos = inf_text_buffer_get_length(buffer);
@@ -164,9 +164,8 @@ inf_text_fixline_buffer_buffer_count_trailing_newlines(InfTextBuffer* buffer,
   {
     if(text_pos == text)
     {
-      g_free(text);
       inf_text_buffer_iter_prev(buffer, iter);
-      text = inf_text_buffer_iter_get_text(buffer, iter);
+      text = inf_text_buffer_iter_peek_text(buffer, iter);
       text_pos = text + inf_text_buffer_iter_get_bytes(buffer, iter);
     }
 
@@ -177,7 +176,6 @@ inf_text_fixline_buffer_buffer_count_trailing_newlines(InfTextBuffer* buffer,
     if(c != '\n') break;
   }
 
-  g_free(text);
   inf_text_buffer_destroy_iter(buffer, iter);
 
   return inf_text_buffer_get_length(buffer) - cur_pos;
@@ -1589,6 +1587,24 @@ inf_text_fixline_buffer_buffer_iter_get_text(InfTextBuffer* buffer,
   }
 }
 
+static gconstpointer
+inf_text_fixline_buffer_buffer_iter_peek_text(InfTextBuffer* buffer,
+                                              InfTextBufferIter* iter)
+{
+  InfTextFixlineBuffer* fixline_buffer;
+  InfTextFixlineBufferPrivate* priv;
+
+  fixline_buffer = INF_TEXT_FIXLINE_BUFFER(buffer);
+  priv = INF_TEXT_FIXLINE_BUFFER_PRIVATE(fixline_buffer);
+
+  /* The kept newlines are not stored anywhere, let the caller fall back
+   * to inf_text_fixline_buffer_buffer_iter_get_text() for them. */
+  if(iter->base_iter == NULL)
+    return NULL;
+
+  return inf_text_buffer_iter_peek_text(priv->buffer, iter->base_iter);
+}
+
 static guint
 inf_text_fixline_buffer_buffer_iter_get_offset(InfTextBuffer* buffer,
                                                InfTextBufferIter* iter)
@@ -1797,6 +1813,7 @@ inf_text_fixline_buffer_text_buffer_iface_init(InfTextBufferInterface* iface)
   iface->iter_get_length = inf_text_fixline_buffer_buffer_iter_get_length;
   iface->iter_get_bytes = inf_text_fixline_buffer_buffer_iter_get_bytes;
   iface->iter_get_author = inf_text_fixline_buffer_buffer_iter_get_author;
+  iface->iter_peek_text = inf_text_fixline_buffer_buffer_iter_peek_text;
   iface->text_inserted = NULL;
   iface->text_erased = NULL;
 }
@@ -293,6 +293,7 @@ inf_text_session_selection_changed_cb(InfTextUser* user,
   InfTextSessionLocalUser* local;
   GTimeVal current;
   guint diff;
+  guint interval;
 
   session = INF_TEXT_SESSION(user_data);
   priv = INF_TEXT_SESSION_PRIVATE(session);
@@ -312,7 +313,16 @@ inf_text_session_selection_changed_cb(InfTextUser* user,
     g_get_current_time(&current);
     diff = inf_text_session_timeval_diff(&current, &local->last_caret_update);
 
-    if(diff < priv->caret_update_interval)
+    /* The timing policy may throttle caret updates further, for example
+     * on high-latency connections. */
+    interval = MAX(
+      priv->caret_update_interval,
+      inf_timing_policy_get_caret_update_interval(
+        inf_adopted_session_get_timing_policy(INF_ADOPTED_SESSION(session))
+      )
+    );
+
+    if(diff < interval)
     {
       if(local->caret_timeout == NULL)
       {
@@ -320,7 +330,7 @@ inf_text_session_selection_changed_cb(InfTextUser* user,
          * local user. */
         local->caret_timeout = inf_io_add_timeout(
           inf_adopted_session_get_io(INF_ADOPTED_SESSION(local->session)),
-          priv->caret_update_interval - diff,
+          interval - diff,
           inf_text_session_caret_update_timeout_func,
           local,
           NULL
@@ -984,7 +994,7 @@ inf_text_session_to_xml_sync(InfSession* session,
   xmlNodePtr xml;
   gboolean result;
 
-  gchar* text;
+  const gchar* text;
   gsize total_bytes;
   gsize bytes_left;
   GIConv cd;
@@ -1004,7 +1014,7 @@ inf_text_session_to_xml_sync(InfSession* session,
     while(result == TRUE)
     {
       /* Write segment in 1024 byte chunks */
-      text = inf_text_buffer_iter_get_text(buffer, iter);
+      text = inf_text_buffer_iter_peek_text(buffer, iter);
       total_bytes = inf_text_buffer_iter_get_bytes(buffer, iter);
       bytes_left = total_bytes;
 
@@ -1020,7 +1030,6 @@ inf_text_session_to_xml_sync(InfSession* session,
         );
       }
 
-      g_free(text);
       result = inf_text_buffer_iter_next(buffer, iter);
     }
 
@@ -1791,7 +1800,8 @@ inf_text_session_class_init(InfTextSessionClass* text_session_class)
     g_param_spec_uint(
       "caret-update-interval",
       "Caret update interval",
-      "Minimum number of milliseconds between caret update broadcasts",
+      "Minimum number of milliseconds between caret update broadcasts. The "
+      "session's timing policy can raise this value",
       0,
       G_MAXUINT,
       500,
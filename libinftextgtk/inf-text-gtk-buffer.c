@@ -89,6 +89,20 @@ struct _InfTextGtkBufferTagRemove {
   InfTextGtkBufferUserTags* ignore_tags;
 };
 
+/* A range of remotely inserted text from which other users' author tags
+ * still need to be removed. The marks keep track of the range while more
+ * text is inserted. */
+typedef struct _InfTextGtkBufferPendingTags InfTextGtkBufferPendingTags;
+struct _InfTextGtkBufferPendingTags {
+  GtkTextMark* begin;
+  GtkTextMark* end;
+  InfTextGtkBufferUserTags* tags;
+};
+
+/* Maximum number of pending ranges before they are flushed, so that
+ * looking up the range an insertion falls into stays cheap. */
+#define INF_TEXT_GTK_BUFFER_MAX_PENDING_TAGS 16
+
 typedef struct _InfTextGtkBufferPrivate InfTextGtkBufferPrivate;
 struct _InfTextGtkBufferPrivate {
   GtkTextBuffer* buffer;
@@ -97,6 +111,12 @@ struct _InfTextGtkBufferPrivate {
 
   InfTextGtkBufferRecord* record;
 
+  /* Set while applying a remote operation, so that our own GtkTextBuffer
+   * signal handlers ignore the change. */
+  gboolean applying_remote;
+  GQueue pending_tags;
+  guint pending_tags_idle;
+
   gboolean show_user_colors;
 
   InfTextUser* active_user;
@@ -452,6 +472,13 @@ inf_text_gtk_buffer_apply_tag_cb(GtkTextBuffer* gtk_buffer,
                                  GtkTextIter* end,
                                  gpointer user_data)
 {
+  InfTextGtkBufferPrivate* priv;
+  priv = INF_TEXT_GTK_BUFFER_PRIVATE(user_data);
+
+  /* Author tag changes are allowed while applying remote operations */
+  if(priv->applying_remote)
+    return;
+
   /* Don't allow author tags to be applied by default. GTK+ seems to do this
    * when copy+pasting text from the text buffer itself, but we want to make
    * sure that a given segment of text has always a unique author set. */
@@ -479,6 +506,144 @@ inf_text_gtk_buffer_buffer_insert_text_tag_table_foreach_func(GtkTextTag* tag,
   }
 }
 
+/* Remote insertions are applied in batches: The text is inserted right away
+ * with its author tag, but the tags of other users, which GtkTextBuffer
+ * applies when inserting into their text, are removed later, once per
+ * coalesced range. This happens in a high priority idle handler before the
+ * text view is redrawn, or before anything reads author information from
+ * the buffer. */
+static void
+inf_text_gtk_buffer_flush_pending_tags(InfTextGtkBuffer* buffer)
+{
+  InfTextGtkBufferPrivate* priv;
+  InfTextGtkBufferPendingTags* pending;
+  InfTextGtkBufferTagRemove tag_remove;
+
+  priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+
+  if(priv->pending_tags_idle != 0)
+  {
+    g_source_remove(priv->pending_tags_idle);
+    priv->pending_tags_idle = 0;
+  }
+
+  tag_remove.buffer = priv->buffer;
+
+  while(!g_queue_is_empty(&priv->pending_tags))
+  {
+    pending = g_queue_pop_head(&priv->pending_tags);
+
+    gtk_text_buffer_get_iter_at_mark(
+      priv->buffer,
+      &tag_remove.begin_iter,
+      pending->begin
+    );
+
+    gtk_text_buffer_get_iter_at_mark(
+      priv->buffer,
+      &tag_remove.end_iter,
+      pending->end
+    );
+
+    if(!gtk_text_iter_equal(&tag_remove.begin_iter, &tag_remove.end_iter))
+    {
+      tag_remove.ignore_tags = pending->tags;
+
+      gtk_text_tag_table_foreach(
+        gtk_text_buffer_get_tag_table(priv->buffer),
+        inf_text_gtk_buffer_buffer_insert_text_tag_table_foreach_func,
+        &tag_remove
+      );
+    }
+
+    gtk_text_buffer_delete_mark(priv->buffer, pending->begin);
+    gtk_text_buffer_delete_mark(priv->buffer, pending->end);
+    g_slice_free(InfTextGtkBufferPendingTags, pending);
+  }
+}
+
+static gboolean
+inf_text_gtk_buffer_flush_pending_tags_idle_func(gpointer user_data)
+{
+  InfTextGtkBufferPrivate* priv;
+  priv = INF_TEXT_GTK_BUFFER_PRIVATE(user_data);
+
+  priv->pending_tags_idle = 0;
+  inf_text_gtk_buffer_flush_pending_tags(INF_TEXT_GTK_BUFFER(user_data));
+
+  return FALSE;
+}
+
+/* Returns the pending range that text inserted at iter would end up in */
+static InfTextGtkBufferPendingTags*
+inf_text_gtk_buffer_find_pending_tags(InfTextGtkBuffer* buffer,
+                                      const GtkTextIter* iter)
+{
+  InfTextGtkBufferPrivate* priv;
+  InfTextGtkBufferPendingTags* pending;
+  GtkTextIter begin;
+  GtkTextIter end;
+  GList* item;
+
+  priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+
+  /* Most recent first, since remote users typically type consecutively */
+  for(item = priv->pending_tags.tail; item != NULL; item = item->prev)
+  {
+    pending = (InfTextGtkBufferPendingTags*)item->data;
+
+    gtk_text_buffer_get_iter_at_mark(priv->buffer, &begin, pending->begin);
+    gtk_text_buffer_get_iter_at_mark(priv->buffer, &end, pending->end);
+
+    if(gtk_text_iter_compare(&begin, iter) <= 0 &&
+       gtk_text_iter_compare(iter, &end) <= 0)
+    {
+      return pending;
+    }
+  }
+
+  return NULL;
+}
+
+static void
+inf_text_gtk_buffer_add_pending_tags(InfTextGtkBuffer* buffer,
+                                     const GtkTextIter* begin,
+                                     const GtkTextIter* end,
+                                     InfTextGtkBufferUserTags* tags)
+{
+  InfTextGtkBufferPrivate* priv;
+  InfTextGtkBufferPendingTags* pending;
+
+  priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+
+  if(priv->pending_tags.length >= INF_TEXT_GTK_BUFFER_MAX_PENDING_TAGS)
+    inf_text_gtk_buffer_flush_pending_tags(buffer);
+
+  pending = g_slice_new(InfTextGtkBufferPendingTags);
+
+  /* Left gravity at the beginning and right gravity at the end, so that
+   * text inserted at either boundary becomes part of the range. */
+  pending->begin =
+    gtk_text_buffer_create_mark(priv->buffer, NULL, begin, TRUE);
+  pending->end =
+    gtk_text_buffer_create_mark(priv->buffer, NULL, end, FALSE);
+  pending->tags = tags;
+
+  g_queue_push_tail(&priv->pending_tags, pending);
+
+  if(priv->pending_tags_idle == 0)
+  {
+    /* Run before GTK+ redraws, so that stale author colors are never
+     * shown. */
+    priv->pending_tags_idle = g_idle_add_full(
+      G_PRIORITY_HIGH_IDLE,
+      inf_text_gtk_buffer_flush_pending_tags_idle_func,
+      buffer,
+      NULL
+    );
+  }
+}
+
 /* Record tracking:
  * This is to allow and correctly handle nested emissions of GtkTextBuffer's
  * insert-text/delete-range signals. The text-inserted and text-erased
@@ -886,6 +1051,13 @@ inf_text_gtk_buffer_insert_text_cb_before(GtkTextBuffer* gtk_buffer,
   buffer = INF_TEXT_GTK_BUFFER(user_data);
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
 
+  if(priv->applying_remote)
+    return;
+
+  /* Make sure the author tags around the insertion point are final before
+   * the record applies the active user's tag. */
+  inf_text_gtk_buffer_flush_pending_tags(buffer);
+
   g_assert(priv->active_user != NULL);
   chunk = inf_text_chunk_new("UTF-8");
 
@@ -921,6 +1093,9 @@ inf_text_gtk_buffer_insert_text_cb_after(GtkTextBuffer* gtk_buffer,
   buffer = INF_TEXT_GTK_BUFFER(user_data);
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
 
+  if(priv->applying_remote)
+    return;
+
   g_assert(priv->record != NULL);
   g_assert(priv->record->insert == TRUE);
 
@@ -958,6 +1133,9 @@ inf_text_gtk_buffer_delete_range_cb_before(GtkTextBuffer* gtk_buffer,
   buffer = INF_TEXT_GTK_BUFFER(user_data);
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
 
+  if(priv->applying_remote)
+    return;
+
   begin_offset = gtk_text_iter_get_offset(begin);
   end_offset = gtk_text_iter_get_offset(end);
 
@@ -981,7 +1159,10 @@ inf_text_gtk_buffer_delete_range_cb_after(GtkTextBuffer* gtk_buffer,
 
   buffer = INF_TEXT_GTK_BUFFER(user_data);
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
-  
+
+  if(priv->applying_remote)
+    return;
+
   g_assert(priv->record != NULL);
   g_assert(priv->record->insert == FALSE);
   
@@ -1211,6 +1392,8 @@ inf_text_gtk_buffer_set_buffer(InfTextGtkBuffer* buffer,
 
   if(priv->buffer != NULL)
   {
+    inf_text_gtk_buffer_flush_pending_tags(buffer);
+
     inf_signal_handlers_disconnect_by_func(
       G_OBJECT(priv->buffer),
       G_CALLBACK(inf_text_gtk_buffer_apply_tag_cb),
@@ -1333,6 +1516,10 @@ inf_text_gtk_buffer_init(InfTextGtkBuffer* buffer)
     inf_text_gtk_buffer_user_tags_free
   );
 
+  priv->applying_remote = FALSE;
+  g_queue_init(&priv->pending_tags);
+  priv->pending_tags_idle = 0;
+
   priv->show_user_colors = TRUE;
 
   priv->active_user = NULL;
@@ -1352,9 +1539,10 @@ inf_text_gtk_buffer_dispose(GObject* object)
   buffer = INF_TEXT_GTK_BUFFER(object);
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
 
+  /* Pending ranges refer to the user tags */
+  inf_text_gtk_buffer_set_buffer(buffer, NULL);
   g_hash_table_remove_all(priv->user_tags);
 
-  inf_text_gtk_buffer_set_buffer(buffer, NULL);
   inf_text_gtk_buffer_set_active_user(buffer, NULL);
   g_object_unref(priv->user_table);
 
@@ -1543,6 +1731,7 @@ inf_text_gtk_buffer_buffer_get_slice(InfTextBuffer* buffer,
   gchar* text;
 
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+  inf_text_gtk_buffer_flush_pending_tags(INF_TEXT_GTK_BUFFER(buffer));
   gtk_text_buffer_get_iter_at_offset(priv->buffer, &iter, pos);
   result = inf_text_chunk_new("UTF-8");
   remaining = len;
@@ -1592,8 +1781,12 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
 {
   InfTextGtkBufferPrivate* priv;
   InfTextChunkIter chunk_iter;
-  InfTextGtkBufferTagRemove tag_remove;
+  InfTextGtkBufferUserTags* user_tags;
+  InfTextGtkBufferPendingTags* pending;
   GtkTextTag* tag;
+  GtkTextIter begin_iter;
+  GtkTextIter end_iter;
+  guint offset;
 
   GtkTextMark* mark;
   GtkTextIter insert_iter;
@@ -1601,52 +1794,33 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
   gboolean insert_at_selection_bound;
 
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
-  tag_remove.buffer = priv->buffer;
 
   /* This would have to be handled separately, but I think this is unlikely
    * to happen anyway. If it does happen then we would again need to rely on
    * iterator revalidation to happen in the way we expect it. */
   g_assert(priv->record == NULL);
 
-  /* Allow author tag changes within this function: */
-  inf_signal_handlers_block_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_text_gtk_buffer_apply_tag_cb),
-    buffer
-  );
-
-  inf_signal_handlers_block_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_before),
-    buffer
-  );
-
-  inf_signal_handlers_block_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_after),
-    buffer
-  );
+  /* Allow author tag changes within this function, and don't treat the
+   * insertion as a local one: */
+  priv->applying_remote = TRUE;
 
   if(inf_text_chunk_iter_init_begin(chunk, &chunk_iter))
   {
-    gtk_text_buffer_get_iter_at_offset(
-      priv->buffer,
-      &tag_remove.end_iter,
-      pos
-    );
+    offset = pos;
+    gtk_text_buffer_get_iter_at_offset(priv->buffer, &end_iter, offset);
 
     do
     {
-      tag_remove.ignore_tags = inf_text_gtk_buffer_get_user_tags(
+      user_tags = inf_text_gtk_buffer_get_user_tags(
         INF_TEXT_GTK_BUFFER(buffer),
         inf_text_chunk_iter_get_author(&chunk_iter)
       );
 
-      if(tag_remove.ignore_tags)
+      if(user_tags)
       {
         tag = inf_text_gtk_buffer_get_user_tag(
           INF_TEXT_GTK_BUFFER(buffer),
-          tag_remove.ignore_tags,
+          user_tags,
           priv->show_user_colors
         );
       }
@@ -1655,32 +1829,51 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
         tag = NULL;
       }
 
+      /* If we insert into a pending range of another author, then that
+       * range needs to be cleaned up first, since cleaning it up later
+       * would also remove this segment's author tag. */
+      pending = inf_text_gtk_buffer_find_pending_tags(
+        INF_TEXT_GTK_BUFFER(buffer),
+        &end_iter
+      );
+
+      if(pending != NULL && pending->tags != user_tags)
+      {
+        inf_text_gtk_buffer_flush_pending_tags(INF_TEXT_GTK_BUFFER(buffer));
+        gtk_text_buffer_get_iter_at_offset(priv->buffer, &end_iter, offset);
+        pending = NULL;
+      }
+
       gtk_text_buffer_insert_with_tags(
-        tag_remove.buffer,
-        &tag_remove.end_iter,
+        priv->buffer,
+        &end_iter,
         inf_text_chunk_iter_get_text(&chunk_iter),
         inf_text_chunk_iter_get_bytes(&chunk_iter),
         tag,
         NULL
       );
 
-      /* Remove other user tags. If we inserted the new text within another
-       * user's text, GtkTextBuffer automatically applies that tag to the
-       * new text. */
+      offset += inf_text_chunk_iter_get_length(&chunk_iter);
 
-      /* TODO: We could probably look for the tag that we have to remove
-       * before inserting text, to optimize this a bit. */
-      tag_remove.begin_iter = tag_remove.end_iter;
-      gtk_text_iter_backward_chars(
-        &tag_remove.begin_iter,
-        inf_text_chunk_iter_get_length(&chunk_iter)
-      );
+      /* If we inserted the new text within another user's text, GtkTextBuffer
+       * automatically applies that tag to the new text. Remember the range
+       * to remove other user tags later, unless it is already part of a
+       * pending range by the same author. */
+      if(pending == NULL)
+      {
+        begin_iter = end_iter;
+        gtk_text_iter_backward_chars(
+          &begin_iter,
+          inf_text_chunk_iter_get_length(&chunk_iter)
+        );
 
-      gtk_text_tag_table_foreach(
-        gtk_text_buffer_get_tag_table(tag_remove.buffer),
-        inf_text_gtk_buffer_buffer_insert_text_tag_table_foreach_func,
-        &tag_remove
-      );
+        inf_text_gtk_buffer_add_pending_tags(
+          INF_TEXT_GTK_BUFFER(buffer),
+          &begin_iter,
+          &end_iter,
+          user_tags
+        );
+      }
     } while(inf_text_chunk_iter_next(&chunk_iter));
 
     /* Fix left gravity of own cursor on remote insert */
@@ -1693,7 +1886,7 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
       mark = gtk_text_buffer_get_insert(priv->buffer);
       gtk_text_buffer_get_iter_at_mark(priv->buffer, &insert_iter, mark);
 
-      if(gtk_text_iter_equal(&insert_iter, &tag_remove.end_iter))
+      if(gtk_text_iter_equal(&insert_iter, &end_iter))
         insert_at_cursor = TRUE;
       else
         insert_at_cursor = FALSE;
@@ -1701,7 +1894,7 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
       mark = gtk_text_buffer_get_selection_bound(priv->buffer);
       gtk_text_buffer_get_iter_at_mark(priv->buffer, &insert_iter, mark);
 
-      if(gtk_text_iter_equal(&insert_iter, &tag_remove.end_iter))
+      if(gtk_text_iter_equal(&insert_iter, &end_iter))
         insert_at_selection_bound = TRUE;
       else
         insert_at_selection_bound = FALSE;
@@ -1715,7 +1908,7 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
         );
 
         gtk_text_iter_backward_chars(
-          &tag_remove.end_iter,
+          &end_iter,
           inf_text_chunk_get_length(chunk)
         );
 
@@ -1724,7 +1917,7 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
           gtk_text_buffer_move_mark(
             priv->buffer,
             gtk_text_buffer_get_insert(priv->buffer),
-            &tag_remove.end_iter
+            &end_iter
           );
         }
 
@@ -1733,7 +1926,7 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
           gtk_text_buffer_move_mark(
             priv->buffer,
             gtk_text_buffer_get_selection_bound(priv->buffer),
-            &tag_remove.end_iter
+            &end_iter
           );
         }
 
@@ -1746,23 +1939,7 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
     }
   }
 
-  inf_signal_handlers_unblock_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_text_gtk_buffer_apply_tag_cb),
-    buffer
-  );
-
-  inf_signal_handlers_unblock_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_before),
-    buffer
-  );
-
-  inf_signal_handlers_unblock_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_after),
-    buffer
-  );
+  priv->applying_remote = FALSE;
 
   inf_text_buffer_text_inserted(buffer, pos, chunk, user);
 }
@@ -1786,36 +1963,16 @@ inf_text_gtk_buffer_buffer_erase_text(InfTextBuffer* buffer,
    * iterator revalidation to happen in the way we expect it. */
   g_assert(priv->record == NULL);
 
+  /* This also flushes pending author tags, so that the erased chunk has
+   * correct authorship. */
   chunk = inf_text_buffer_get_slice(buffer, pos, len);
 
   gtk_text_buffer_get_iter_at_offset(priv->buffer, &begin, pos);
   gtk_text_buffer_get_iter_at_offset(priv->buffer, &end, pos + len);
 
-  inf_signal_handlers_block_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_text_gtk_buffer_delete_range_cb_before),
-    buffer
-  );
-
-  inf_signal_handlers_block_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_text_gtk_buffer_delete_range_cb_after),
-    buffer
-  );
-
+  priv->applying_remote = TRUE;
   gtk_text_buffer_delete(priv->buffer, &begin, &end);
-
-  inf_signal_handlers_unblock_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_text_gtk_buffer_delete_range_cb_before),
-    buffer
-  );
-
-  inf_signal_handlers_unblock_by_func(
-    G_OBJECT(priv->buffer),
-    G_CALLBACK(inf_text_gtk_buffer_delete_range_cb_after),
-    buffer
-  );
+  priv->applying_remote = FALSE;
 
   inf_text_buffer_text_erased(buffer, pos, chunk, user);
   inf_text_chunk_free(chunk);
@@ -1828,6 +1985,7 @@ inf_text_gtk_buffer_buffer_create_begin_iter(InfTextBuffer* buffer)
   InfTextBufferIter* iter;
 
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+  inf_text_gtk_buffer_flush_pending_tags(INF_TEXT_GTK_BUFFER(buffer));
 
   if(gtk_text_buffer_get_char_count(priv->buffer) == 0)
   {
@@ -1856,6 +2014,7 @@ inf_text_gtk_buffer_buffer_create_end_iter(InfTextBuffer* buffer)
   InfTextBufferIter* iter;
 
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+  inf_text_gtk_buffer_flush_pending_tags(INF_TEXT_GTK_BUFFER(buffer));
 
   if(gtk_text_buffer_get_char_count(priv->buffer) == 0)
   {
@@ -2148,6 +2307,7 @@ inf_text_gtk_buffer_text_buffer_iface_init(InfTextBufferInterface* iface)
   iface->iter_get_length = inf_text_gtk_buffer_buffer_iter_get_length;
   iface->iter_get_bytes = inf_text_gtk_buffer_buffer_iter_get_bytes;
   iface->iter_get_author = inf_text_gtk_buffer_buffer_iter_get_author;
+  iface->iter_peek_text = NULL;
   iface->text_inserted = NULL;
   iface->text_erased = NULL;
 }
@@ -2314,6 +2474,7 @@ inf_text_gtk_buffer_get_author(InfTextGtkBuffer* buffer,
   );
 
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+  inf_text_gtk_buffer_flush_pending_tags(buffer);
   return inf_text_gtk_buffer_iter_get_author(location);
 }
 
@@ -2366,6 +2527,7 @@ inf_text_gtk_buffer_is_author_toggle(InfTextGtkBuffer* buffer,
   g_return_val_if_fail(INF_TEXT_GTK_IS_BUFFER(buffer), FALSE);
   g_return_val_if_fail(iter != NULL, FALSE);
 
+  inf_text_gtk_buffer_flush_pending_tags(buffer);
   return inf_text_gtk_buffer_iter_is_author_toggle(
     iter,
     user_on,
@@ -2403,6 +2565,7 @@ inf_text_gtk_buffer_forward_to_author_toggle(InfTextGtkBuffer* buffer,
   if(gtk_text_iter_is_end(iter))
     return FALSE;
 
+  inf_text_gtk_buffer_flush_pending_tags(buffer);
   inf_text_gtk_buffer_iter_next_author_toggle(iter, user_on, user_off);
   return TRUE;
 }
@@ -2437,6 +2600,7 @@ inf_text_gtk_buffer_backward_to_author_toggle(InfTextGtkBuffer* buffer,
   if(gtk_text_iter_is_start(iter))
     return FALSE;
 
+  inf_text_gtk_buffer_flush_pending_tags(buffer);
   inf_text_gtk_buffer_iter_prev_author_toggle(iter, user_on, user_off);
   return TRUE;
 }
@@ -2713,6 +2877,8 @@ inf_text_gtk_buffer_show_user_colors(InfTextGtkBuffer* buffer,
   g_return_if_fail(end != NULL);
 
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+  inf_text_gtk_buffer_flush_pending_tags(buffer);
+
   iter = *start;
   prev = iter;
 
@@ -57,6 +57,11 @@ struct _InfTextGtkViewUser {
   InfIoTimeout* timeout; /* TODO: Use glib for that; remove InfIo property */
   guint revalidate_idle;
 
+  /* Whether the fields below are up to date. They are only computed when
+   * the user is visible, and kept across frames until the user's selection
+   * or the layout of the text view changes. */
+  gboolean area_valid;
+
   /* All in buffer coordinates: */
 
   /* The rectangular area occupied by the cursor */
@@ -134,21 +139,24 @@ inf_text_gtk_view_find_user(InfTextGtkView* view,
   return NULL;
 }
 
-/* Compute cursor_rect, selection_bound_rect */
-static void
-inf_text_gtk_view_user_compute_user_area(InfTextGtkViewUser* view_user)
+/* Compute cursor_rect, selection_bound_rect and the current line if the user
+ * is within the visible part of the text view. Returns whether the user
+ * area is valid, i.e. FALSE if the user is not visible. */
+static gboolean
+inf_text_gtk_view_user_ensure_user_area(InfTextGtkViewUser* view_user)
 {
   InfTextGtkViewPrivate* priv;
   GtkTextIter iter;
+  GtkTextIter bound_iter;
+  GdkRectangle visible_rect;
+  gint bound_y;
+  gint bound_height;
   gfloat cursor_aspect_ratio;
 
-  priv = INF_TEXT_GTK_VIEW_PRIVATE(view_user->view);
+  if(view_user->area_valid)
+    return TRUE;
 
-  gtk_widget_style_get(
-    GTK_WIDGET(priv->textview),
-    "cursor-aspect-ratio", &cursor_aspect_ratio,
-    NULL
-  );
+  priv = INF_TEXT_GTK_VIEW_PRIVATE(view_user->view);
 
   gtk_text_buffer_get_iter_at_offset(
     gtk_text_view_get_buffer(priv->textview),
@@ -156,7 +164,14 @@ inf_text_gtk_view_user_compute_user_area(InfTextGtkViewUser* view_user)
     inf_text_user_get_caret_position(view_user->user)
   );
 
-  /* Find current line */
+  bound_iter = iter;
+  gtk_text_iter_forward_chars(
+    &bound_iter,
+    inf_text_user_get_selection_length(view_user->user)
+  );
+
+  /* Find current line. The line heights are cached by the text view, so
+   * this is cheap compared to computing the character locations below. */
   gtk_text_view_get_line_yrange(
     priv->textview,
     &iter,
@@ -164,6 +179,31 @@ inf_text_gtk_view_user_compute_user_area(InfTextGtkViewUser* view_user)
     &view_user->line_height
   );
 
+  gtk_text_view_get_line_yrange(
+    priv->textview,
+    &bound_iter,
+    &bound_y,
+    &bound_height
+  );
+
+  /* Don't bother with users that are not visible. This is done again when
+   * the visible area changes and they are drawn. */
+  gtk_text_view_get_visible_rect(priv->textview, &visible_rect);
+
+  if(MAX(view_user->line_y + view_user->line_height,
+         bound_y + bound_height) <= visible_rect.y ||
+     MIN(view_user->line_y, bound_y) >=
+       visible_rect.y + visible_rect.height)
+  {
+    return FALSE;
+  }
+
+  gtk_widget_style_get(
+    GTK_WIDGET(priv->textview),
+    "cursor-aspect-ratio", &cursor_aspect_ratio,
+    NULL
+  );
+
   /* TODO: We don't need the cursor rect for show-remote-current-lines, and
    * we don't need the selection rect for show-remote-cursors and
    * show-remote-current-lines. So we might not even want to compute them in
@@ -182,14 +222,9 @@ inf_text_gtk_view_user_compute_user_area(InfTextGtkViewUser* view_user)
   );
 
   /* Find selection bound */
-  gtk_text_iter_forward_chars(
-    &iter,
-    inf_text_user_get_selection_length(view_user->user)
-  );
-
   gtk_text_view_get_iter_location(
     priv->textview,
-    &iter,
+    &bound_iter,
     &view_user->selection_bound_rect
   );
 
@@ -197,6 +232,21 @@ inf_text_gtk_view_user_compute_user_area(InfTextGtkViewUser* view_user)
     (int)(view_user->selection_bound_rect.height * cursor_aspect_ratio),
     1
   );
+
+  view_user->area_valid = TRUE;
+  return TRUE;
+}
+
+static void
+inf_text_gtk_view_invalidate_user_areas(InfTextGtkView* view)
+{
+  InfTextGtkViewPrivate* priv;
+  GSList* item;
+
+  priv = INF_TEXT_GTK_VIEW_PRIVATE(view);
+
+  for(item = priv->users; item != NULL; item = item->next)
+    ((InfTextGtkViewUser*)item->data)->area_valid = FALSE;
 }
 
 static guint
@@ -250,7 +300,8 @@ inf_text_gtk_view_get_right_margin(GtkTextView* view)
 }
 
 /* Invalidate the whole area of the textview covered by the given user:
- * cursor, selection, current line */
+ * cursor, selection, current line. The user area is computed first if it is
+ * not valid, and nothing is done if the user is not visible. */
 static void
 inf_text_gtk_view_user_invalidate_user_area(InfTextGtkViewUser* view_user)
 {
@@ -263,6 +314,9 @@ inf_text_gtk_view_user_invalidate_user_area(InfTextGtkViewUser* view_user)
 
   priv = INF_TEXT_GTK_VIEW_PRIVATE(view_user->view);
 
+  if(!inf_text_gtk_view_user_ensure_user_area(view_user))
+    return;
+
   if(gtk_widget_get_realized(GTK_WIDGET(priv->textview)))
   {
     /* Invalidate cursors/selections */
@@ -543,7 +597,14 @@ inf_text_gtk_view_draw_before_cb(GtkWidget* widget,
     v = MAX(v, 0.3);
     s = MAX(s, 0.1 + 0.3*(1 - v));
 
-    sort_users = g_slist_copy(priv->users);
+    sort_users = NULL;
+    for(item = priv->users; item != NULL; item = item->next)
+    {
+      view_user = (InfTextGtkViewUser*)item->data;
+      if(inf_text_gtk_view_user_ensure_user_area(view_user))
+        sort_users = g_slist_prepend(sort_users, view_user);
+    }
+
     sort_users =
       g_slist_sort(sort_users, inf_text_gtk_view_user_line_position_cmp);
 
@@ -792,7 +853,8 @@ inf_text_gtk_view_draw_after_cb(GtkWidget* widget,
         end = MIN(MAX(end, area_begin), area_end);
         g_assert(end >= begin);
 
-        if(begin != end)
+        if(begin != end &&
+           inf_text_gtk_view_user_ensure_user_area(view_user))
         {
           if(sel > 0)
           {
@@ -1067,7 +1129,8 @@ inf_text_gtk_view_draw_after_cb(GtkWidget* widget,
     for(item = priv->users; item != NULL; item = item->next)
     {
       view_user = (InfTextGtkViewUser*)item->data;
-      if(view_user->cursor_visible)
+      if(view_user->cursor_visible &&
+         inf_text_gtk_view_user_ensure_user_area(view_user))
       {
         gtk_text_view_buffer_to_window_coords(
           priv->textview,
@@ -1099,19 +1162,8 @@ static void
 inf_text_gtk_view_style_updated_cb(GtkWidget* widget,
                                    gpointer user_data)
 {
-  InfTextGtkView* view;
-  InfTextGtkViewPrivate* priv;
-  GSList* item;
-  InfTextGtkViewUser* view_user;
-
-  view = INF_TEXT_GTK_VIEW(user_data);
-  priv = INF_TEXT_GTK_VIEW_PRIVATE(view);
-
-  for(item = priv->users; item != NULL; item = item->next)
-  {
-    view_user = (InfTextGtkViewUser*)item->data;
-    inf_text_gtk_view_user_compute_user_area(view_user);
-  }
+  /* Recompute lazily, for visible users only */
+  inf_text_gtk_view_invalidate_user_areas(INF_TEXT_GTK_VIEW(user_data));
 }
 
 static void
@@ -1119,19 +1171,8 @@ inf_text_gtk_view_size_allocate_cb(GtkWidget* widget,
                                    GtkAllocation* allocation,
                                    gpointer user_data)
 {
-  InfTextGtkView* view;
-  InfTextGtkViewPrivate* priv;
-  GSList* item;
-  InfTextGtkViewUser* view_user;
-
-  view = INF_TEXT_GTK_VIEW(user_data);
-  priv = INF_TEXT_GTK_VIEW_PRIVATE(view);
-
-  for(item = priv->users; item != NULL; item = item->next)
-  {
-    view_user = (InfTextGtkViewUser*)item->data;
-    inf_text_gtk_view_user_compute_user_area(view_user);
-  }
+  /* Recompute lazily, for visible users only */
+  inf_text_gtk_view_invalidate_user_areas(INF_TEXT_GTK_VIEW(user_data));
 }
 
 static void
@@ -1263,7 +1304,7 @@ inf_text_gtk_view_user_selection_changed_cb(InfTextUser* user,
    * shifted and is therefore invalidated anyway.
    * b) Both text and cursor have not been shifted, no redraw necessary.
    * Note that we need to recompute the user area though because it might
-   * have moved. */
+   * have moved. This is done lazily, only if the user is visible. */
   if(by_request)
   {
     /* Invalidate current user area, e.g. to get rid of cursor at previous
@@ -1274,7 +1315,7 @@ inf_text_gtk_view_user_selection_changed_cb(InfTextUser* user,
     inf_text_gtk_view_user_invalidate_user_area(view_user);
   }
 
-  inf_text_gtk_view_user_compute_user_area(view_user);
+  view_user->area_valid = FALSE;
 
   if(by_request)
   {
@@ -1328,7 +1369,8 @@ inf_text_gtk_view_add_user(InfTextGtkView* view,
   view_user->cursor_visible = TRUE;
   view_user->timeout = NULL;
   view_user->revalidate_idle = 0;
-  inf_text_gtk_view_user_compute_user_area(view_user);
+  view_user->area_valid = FALSE;
+  inf_text_gtk_view_user_ensure_user_area(view_user);
   inf_text_gtk_view_user_reset_timeout(view_user);
   priv->users = g_slist_prepend(priv->users, view_user);
 
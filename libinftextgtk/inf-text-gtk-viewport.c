@@ -45,7 +45,9 @@ typedef struct _InfTextGtkViewportUser InfTextGtkViewportUser;
 struct _InfTextGtkViewportUser {
   InfTextGtkViewport* viewport;
   InfTextUser* user;
+  /* The marker as it was last drawn or queued for drawing */
   GdkRectangle rectangle;
+  gboolean rectangle_valid;
 };
 
 typedef struct _InfTextGtkViewportPrivate InfTextGtkViewportPrivate;
@@ -56,6 +58,18 @@ struct _InfTextGtkViewportPrivate {
   GSList* users;
 
   gboolean show_user_markers;
+
+  /* Scrollbar geometry, shared by all user markers, so that it does not
+   * need to be recomputed for every user */
+  gboolean geometry_valid;
+  gint end_y;
+  gint scroll_x;
+  gint scroll_y;
+  gint scroll_height;
+  gint slider_size;
+
+  /* Marker updates are coalesced in an idle handler */
+  guint update_idle;
 };
 
 enum {
@@ -91,36 +105,81 @@ inf_text_gtk_viewport_find_user(InfTextGtkViewport* viewport,
   return NULL;
 }
 
-static void
-inf_text_gtk_viewport_user_compute_user_area(InfTextGtkViewportUser* user)
+static gboolean
+inf_text_gtk_viewport_ensure_geometry(InfTextGtkViewport* viewport)
 {
   InfTextGtkViewportPrivate* priv;
   GtkWidget* textview;
   GtkWidget* scrollbar;
   GtkTextIter iter;
   GdkRectangle rect;
-  gint y;
-  gint end_y;
 
-  gint scroll_height;
-  gint slider_size;
   gint stepper_size;
   gint stepper_spacing;
   gint border;
   GdkRectangle allocation;
-  gint scroll_ox;
-  gint scroll_oy;
+
+  priv = INF_TEXT_GTK_VIEWPORT_PRIVATE(viewport);
+  if(priv->geometry_valid)
+    return TRUE;
+
+  if(priv->scroll == NULL)
+    return FALSE;
+
+  textview = gtk_bin_get_child(GTK_BIN(priv->scroll));
+  scrollbar = gtk_scrolled_window_get_vscrollbar(priv->scroll);
+  if(!GTK_IS_TEXT_VIEW(textview) || scrollbar == NULL ||
+     !gtk_widget_get_realized(textview))
+  {
+    return FALSE;
+  }
+
+  gtk_text_buffer_get_end_iter(
+    gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview)),
+    &iter
+  );
+
+  gtk_text_view_get_iter_location(GTK_TEXT_VIEW(textview), &iter, &rect);
+  priv->end_y = rect.y;
+
+  gtk_widget_style_get(
+    scrollbar,
+    "slider-width", &priv->slider_size,
+    "stepper-size", &stepper_size,
+    "stepper-spacing", &stepper_spacing,
+    "trough-border", &border,
+    NULL
+  );
+
+  gtk_widget_get_allocation(scrollbar, &allocation);
+
+  priv->scroll_x = border + allocation.x;
+  priv->scroll_y = border + stepper_size + stepper_spacing;
+  priv->scroll_height = allocation.height - 2*priv->scroll_y;
+  priv->scroll_y += allocation.y;
+
+  priv->geometry_valid = TRUE;
+  return TRUE;
+}
+
+static void
+inf_text_gtk_viewport_user_compute_user_area(InfTextGtkViewportUser* user)
+{
+  InfTextGtkViewportPrivate* priv;
+  GtkWidget* textview;
+  GtkTextIter iter;
+  GdkRectangle rect;
+  gint y;
   gint dy;
 
   priv = INF_TEXT_GTK_VIEWPORT_PRIVATE(user->viewport);
 
   /* TODO: We might want to skip this if show-user-markers is false. */
 
-  textview = gtk_bin_get_child(GTK_BIN(priv->scroll));
-  scrollbar = gtk_scrolled_window_get_vscrollbar(priv->scroll);
-  if(GTK_IS_TEXT_VIEW(textview) && scrollbar != NULL &&
-     gtk_widget_get_realized(textview))
+  if(inf_text_gtk_viewport_ensure_geometry(user->viewport))
   {
+    textview = gtk_bin_get_child(GTK_BIN(priv->scroll));
+
     gtk_text_buffer_get_iter_at_offset(
       gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview)),
       &iter,
@@ -130,51 +189,28 @@ inf_text_gtk_viewport_user_compute_user_area(InfTextGtkViewportUser* user)
     gtk_text_view_get_iter_location(GTK_TEXT_VIEW(textview), &iter, &rect);
     y = rect.y;
 
-    gtk_text_buffer_get_end_iter(
-      gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview)),
-      &iter
-    );
+    g_assert(priv->end_y > 0 || y == 0);
 
-    gtk_text_view_get_iter_location(GTK_TEXT_VIEW(textview), &iter, &rect);
-    end_y = rect.y;
+    if(priv->end_y > 0)
+      y = y * priv->scroll_height / priv->end_y;
 
-    g_assert(end_y > 0 || y == 0);
+    user->rectangle.x = priv->scroll_x;
+    user->rectangle.y = priv->scroll_y + y - priv->slider_size/3;
+    user->rectangle.width = priv->slider_size;
+    user->rectangle.height = priv->slider_size*2/3;
 
-    gtk_widget_style_get(
-      scrollbar,
-      "slider-width", &slider_size,
-      "stepper-size", &stepper_size,
-      "stepper-spacing", &stepper_spacing,
-      "trough-border", &border,
-      NULL
-    );
-
-    gtk_widget_get_allocation(scrollbar, &allocation);
-
-    scroll_ox = border;
-    scroll_oy = border + stepper_size + stepper_spacing;
-    scroll_height = allocation.height - 2*scroll_oy;
-
-    if(end_y > 0)
-      y = y * scroll_height / end_y;
-
-    user->rectangle.x = scroll_ox + allocation.x;
-    user->rectangle.y = scroll_oy + allocation.y + y - slider_size/3;
-    user->rectangle.width = slider_size;
-    user->rectangle.height = slider_size*2/3;
-
-    if(user->rectangle.y < scroll_oy + allocation.y)
+    if(user->rectangle.y < priv->scroll_y)
     {
-      dy = scroll_oy + allocation.y - user->rectangle.y;
+      dy = priv->scroll_y - user->rectangle.y;
       user->rectangle.y += dy;
       user->rectangle.height -= dy;
     }
 
     if(user->rectangle.y + user->rectangle.height >
-       scroll_oy + allocation.y + scroll_height)
+       priv->scroll_y + priv->scroll_height)
     {
       user->rectangle.height =
-        scroll_oy + allocation.y + scroll_height - user->rectangle.y;
+        priv->scroll_y + priv->scroll_height - user->rectangle.y;
     }
   }
   else
@@ -182,6 +218,8 @@ inf_text_gtk_viewport_user_compute_user_area(InfTextGtkViewportUser* user)
     user->rectangle.x = user->rectangle.y = 0;
     user->rectangle.width = user->rectangle.height = 0;
   }
+
+  user->rectangle_valid = TRUE;
 }
 
 static void
@@ -212,6 +250,83 @@ inf_text_gtk_viewport_user_invalidate_user_area(InfTextGtkViewportUser* user)
   }
 }
 
+/* Recomputes the marker of the given user, and redraws it if it moved */
+static void
+inf_text_gtk_viewport_user_update_user_area(InfTextGtkViewportUser* user)
+{
+  GdkRectangle old_rectangle;
+  GdkRectangle new_rectangle;
+
+  old_rectangle = user->rectangle;
+  inf_text_gtk_viewport_user_compute_user_area(user);
+  new_rectangle = user->rectangle;
+
+  if(old_rectangle.x != new_rectangle.x ||
+     old_rectangle.y != new_rectangle.y ||
+     old_rectangle.width != new_rectangle.width ||
+     old_rectangle.height != new_rectangle.height)
+  {
+    user->rectangle = old_rectangle;
+    inf_text_gtk_viewport_user_invalidate_user_area(user);
+    user->rectangle = new_rectangle;
+    inf_text_gtk_viewport_user_invalidate_user_area(user);
+  }
+}
+
+static gboolean
+inf_text_gtk_viewport_update_idle_func(gpointer user_data)
+{
+  InfTextGtkViewportPrivate* priv;
+  InfTextGtkViewportUser* viewport_user;
+  GSList* item;
+
+  priv = INF_TEXT_GTK_VIEWPORT_PRIVATE(user_data);
+  priv->update_idle = 0;
+
+  for(item = priv->users; item != NULL; item = item->next)
+  {
+    viewport_user = (InfTextGtkViewportUser*)item->data;
+    if(!viewport_user->rectangle_valid)
+      inf_text_gtk_viewport_user_update_user_area(viewport_user);
+  }
+
+  return FALSE;
+}
+
+static void
+inf_text_gtk_viewport_queue_update(InfTextGtkViewport* viewport,
+                                   InfTextGtkViewportUser* user)
+{
+  InfTextGtkViewportPrivate* priv;
+  GSList* item;
+
+  priv = INF_TEXT_GTK_VIEWPORT_PRIVATE(viewport);
+
+  if(user != NULL)
+  {
+    user->rectangle_valid = FALSE;
+  }
+  else
+  {
+    /* The geometry changed, so all markers need to be recomputed */
+    priv->geometry_valid = FALSE;
+    for(item = priv->users; item != NULL; item = item->next)
+      ((InfTextGtkViewportUser*)item->data)->rectangle_valid = FALSE;
+  }
+
+  /* Run before GTK+ redraws, so that markers are up to date in the
+   * next frame. */
+  if(priv->update_idle == 0)
+  {
+    priv->update_idle = g_idle_add_full(
+      G_PRIORITY_HIGH_IDLE,
+      inf_text_gtk_viewport_update_idle_func,
+      viewport,
+      NULL
+    );
+  }
+}
+
 static gboolean
 inf_text_gtk_viewport_scrollbar_draw_cb(GtkWidget* scrollbar,
                                         cairo_t* cr,
@@ -294,63 +409,21 @@ inf_text_gtk_viewport_scrollbar_size_allocate_cb(GtkWidget* scrollbar,
                                                  GtkAllocation* allocation,
                                                  gpointer user_data)
 {
-  InfTextGtkViewport* viewport;
-  InfTextGtkViewportPrivate* priv;
-  GSList* item;
-  InfTextGtkViewportUser* viewport_user;
-
-  viewport = INF_TEXT_GTK_VIEWPORT(user_data);
-  priv = INF_TEXT_GTK_VIEWPORT_PRIVATE(viewport);
-
-  for(item = priv->users; item != NULL; item = item->next)
-  {
-    viewport_user = (InfTextGtkViewportUser*)item->data;
-    inf_text_gtk_viewport_user_invalidate_user_area(viewport_user);
-    inf_text_gtk_viewport_user_compute_user_area(viewport_user);
-    inf_text_gtk_viewport_user_invalidate_user_area(viewport_user);
-  }
+  inf_text_gtk_viewport_queue_update(INF_TEXT_GTK_VIEWPORT(user_data), NULL);
 }
 
 static void
 inf_text_gtk_viewport_adjustment_changed_cb(GtkAdjustment* adjustment,
                                             gpointer user_data)
 {
-  InfTextGtkViewport* viewport;
-  InfTextGtkViewportPrivate* priv;
-  GSList* item;
-  InfTextGtkViewportUser* viewport_user;
-
-  viewport = INF_TEXT_GTK_VIEWPORT(user_data);
-  priv = INF_TEXT_GTK_VIEWPORT_PRIVATE(viewport);
-
-  for(item = priv->users; item != NULL; item = item->next)
-  {
-    viewport_user = (InfTextGtkViewportUser*)item->data;
-    inf_text_gtk_viewport_user_invalidate_user_area(viewport_user);
-    inf_text_gtk_viewport_user_compute_user_area(viewport_user);
-    inf_text_gtk_viewport_user_invalidate_user_area(viewport_user);
-  }
+  inf_text_gtk_viewport_queue_update(INF_TEXT_GTK_VIEWPORT(user_data), NULL);
 }
 
 static void
 inf_text_gtk_viewport_scrollbar_style_updated_cb(GtkWidget* scrollbar,
                                                  gpointer user_data)
 {
-  InfTextGtkViewport* viewport;
-  InfTextGtkViewportPrivate* priv;
-  GSList* item;
-  InfTextGtkViewportUser* viewport_user;
-
-  viewport = INF_TEXT_GTK_VIEWPORT(user_data);
-  priv = INF_TEXT_GTK_VIEWPORT_PRIVATE(viewport);
-
-  for(item = priv->users; item != NULL; item = item->next)
-  {
-    viewport_user = (InfTextGtkViewportUser*)item->data;
-    inf_text_gtk_viewport_user_invalidate_user_area(viewport_user);
-    inf_text_gtk_viewport_user_compute_user_area(viewport_user);
-    inf_text_gtk_viewport_user_invalidate_user_area(viewport_user);
-  }
+  inf_text_gtk_viewport_queue_update(INF_TEXT_GTK_VIEWPORT(user_data), NULL);
 }
 
 static void
@@ -366,13 +439,8 @@ inf_text_gtk_viewport_user_selection_changed_cb(InfTextUser* user,
   viewport_user = (InfTextGtkViewportUser*)user_data;
   priv = INF_TEXT_GTK_VIEWPORT_PRIVATE(viewport_user->viewport);
 
-  /* TODO: Just invalidate the region that really changed, by comparing
-   * old and new rectangle's coordinates */
-  inf_text_gtk_viewport_user_invalidate_user_area(viewport_user);
-
-  /* Recompute and revalidate */
-  inf_text_gtk_viewport_user_compute_user_area(viewport_user);
-  inf_text_gtk_viewport_user_invalidate_user_area(viewport_user);
+  /* Recompute and revalidate, coalescing multiple changes */
+  inf_text_gtk_viewport_queue_update(viewport_user->viewport, viewport_user);
 }
 
 static void
@@ -401,10 +469,11 @@ inf_text_gtk_viewport_add_user(InfTextGtkViewport* viewport,
 
   viewport_user->viewport = viewport;
   viewport_user->user = INF_TEXT_USER(user);
+  viewport_user->rectangle.x = viewport_user->rectangle.y = 0;
+  viewport_user->rectangle.width = viewport_user->rectangle.height = 0;
+  viewport_user->rectangle_valid = FALSE;
   priv->users = g_slist_prepend(priv->users, viewport_user);
 
-  inf_text_gtk_viewport_user_compute_user_area(viewport_user);
-
   g_signal_connect_after(
     user,
     "selection-changed",
@@ -419,7 +488,7 @@ inf_text_gtk_viewport_add_user(InfTextGtkViewport* viewport,
     viewport_user
   );
 
-  inf_text_gtk_viewport_user_invalidate_user_area(viewport_user);
+  inf_text_gtk_viewport_queue_update(viewport, viewport_user);
 }
 
 static void
@@ -579,6 +648,13 @@ inf_text_gtk_viewport_set_scrolled_window(InfTextGtkViewport* viewport,
 
   if(priv->scroll != NULL)
   {
+    if(priv->update_idle != 0)
+    {
+      g_source_remove(priv->update_idle);
+      priv->update_idle = 0;
+    }
+
+    priv->geometry_valid = FALSE;
     scrollbar = gtk_scrolled_window_get_vscrollbar(priv->scroll);
 
     /* Can already be unset at this point */
@@ -734,6 +810,9 @@ inf_text_gtk_viewport_init(InfTextGtkViewport* viewport)
   priv->users = NULL;
 
   priv->show_user_markers = TRUE;
+
+  priv->geometry_valid = FALSE;
+  priv->update_idle = 0;
 }
 
 static void
@@ -748,6 +827,12 @@ inf_text_gtk_viewport_dispose(GObject* object)
   inf_text_gtk_viewport_set_user_table(viewport, NULL);
   inf_text_gtk_viewport_set_scrolled_window(viewport, NULL);
 
+  if(priv->update_idle != 0)
+  {
+    g_source_remove(priv->update_idle);
+    priv->update_idle = 0;
+  }
+
   g_assert(priv->active_user == NULL);
   g_assert(priv->users == NULL);
 
@@ -0,0 +1,465 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks reading, writing and appending to certificate map files, as used
+ * for the known hosts of InfCertificateVerify. */
+
+#include <libinfinity/common/inf-cert-util.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <gnutls/x509.h>
+
+#include <glib/gstdio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+static GQuark
+inf_test_certificate_map_error(void)
+{
+  return g_quark_from_static_string("INF_TEST_CERTIFICATE_MAP_ERROR");
+}
+
+static gnutls_x509_crt_t
+inf_test_certificate_map_load(const gchar* filename,
+                              GError** error)
+{
+  GPtrArray* certs;
+  gnutls_x509_crt_t cert;
+  guint i;
+
+  certs = inf_cert_util_read_certificate(filename, NULL, error);
+  if(certs == NULL) return NULL;
+
+  g_assert(certs->len > 0);
+  cert = certs->pdata[0];
+  for(i = 1; i < certs->len; ++i)
+    gnutls_x509_crt_deinit(certs->pdata[i]);
+  g_ptr_array_free(certs, TRUE);
+
+  return cert;
+}
+
+/* Checks that hostname maps to expected in table, or that it is not
+ * contained in table if expected is NULL. */
+static gboolean
+inf_test_certificate_map_expect(GHashTable* table,
+                                const gchar* hostname,
+                                gnutls_x509_crt_t expected,
+                                GError** error)
+{
+  gpointer value;
+  gboolean found;
+
+  found = g_hash_table_lookup_extended(table, hostname, NULL, &value);
+  if(expected == NULL)
+  {
+    if(found && value != NULL)
+    {
+      g_set_error(
+        error,
+        inf_test_certificate_map_error(),
+        0,
+        "Host \"%s\" is in the map but should not be",
+        hostname
+      );
+
+      return FALSE;
+    }
+
+    return TRUE;
+  }
+
+  if(!found || value == NULL)
+  {
+    g_set_error(
+      error,
+      inf_test_certificate_map_error(),
+      1,
+      "Host \"%s\" is not in the map",
+      hostname
+    );
+
+    return FALSE;
+  }
+
+  if(!inf_cert_util_compare_fingerprint(value, expected, error))
+  {
+    if(error != NULL && *error != NULL)
+      return FALSE;
+
+    g_set_error(
+      error,
+      inf_test_certificate_map_error(),
+      2,
+      "Host \"%s\" has the wrong certificate",
+      hostname
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+inf_test_certificate_map_expect_file(const gchar* filename,
+                                     const gchar* hostname,
+                                     gnutls_x509_crt_t expected,
+                                     guint expected_size,
+                                     GError** error)
+{
+  GHashTable* table;
+  gboolean result;
+
+  table = inf_cert_util_read_certificate_map(filename, error);
+  if(table == NULL) return FALSE;
+
+  result = inf_test_certificate_map_expect(table, hostname, expected, error);
+  if(result == TRUE && g_hash_table_size(table) != expected_size)
+  {
+    g_set_error(
+      error,
+      inf_test_certificate_map_error(),
+      3,
+      "Map has %u entries instead of %u",
+      g_hash_table_size(table),
+      expected_size
+    );
+
+    result = FALSE;
+  }
+
+  g_hash_table_destroy(table);
+  return result;
+}
+
+/* Returns the number of lines in filename which have an entry for hostname.
+ * Files that older versions of libinfinity can read have at most one. */
+static guint
+inf_test_certificate_map_count_entries(const gchar* filename,
+                                       const gchar* hostname)
+{
+  gchar* content;
+  gchar** lines;
+  gchar* prefix;
+  guint count;
+  guint i;
+
+  if(!g_file_get_contents(filename, &content, NULL, NULL))
+    return 0;
+
+  lines = g_strsplit(content, "\n", 0);
+  prefix = g_strdup_printf("%s:", hostname);
+
+  count = 0;
+  for(i = 0; lines[i] != NULL; ++i)
+    if(g_str_has_prefix(lines[i], prefix))
+      ++count;
+
+  g_free(prefix);
+  g_strfreev(lines);
+  g_free(content);
+  return count;
+}
+
+static gboolean
+inf_test_certificate_map_append_raw(const gchar* filename,
+                                    const gchar* line,
+                                    GError** error)
+{
+  FILE* file;
+
+  file = g_fopen(filename, "ab");
+  if(file == NULL)
+  {
+    g_set_error_literal(
+      error,
+      G_FILE_ERROR,
+      g_file_error_from_errno(errno),
+      g_strerror(errno)
+    );
+
+    return FALSE;
+  }
+
+  fputs(line, file);
+  fclose(file);
+  return TRUE;
+}
+
+static gboolean
+inf_test_certificate_map_run(const gchar* filename,
+                             gnutls_x509_crt_t cert1,
+                             gnutls_x509_crt_t cert2,
+                             GError** error)
+{
+  GHashTable* table;
+  GHashTable* appended;
+  GStatBuf st;
+  goffset old_size;
+  gchar* content;
+  gsize size;
+  gboolean result;
+
+  /* Initial file with a single host */
+  printf("write...");
+
+  table = g_hash_table_new(g_str_hash, g_str_equal);
+  g_hash_table_insert(table, (gpointer)"host-a", cert1);
+  result = inf_cert_util_write_certificate_map(table, filename, error);
+  g_hash_table_destroy(table);
+
+  if(!result) return FALSE;
+  if(!inf_test_certificate_map_expect_file(filename, "host-a", cert1, 1, error))
+    return FALSE;
+
+  printf(" OK\n");
+
+  /* Appending adds a new host and keeps the existing one */
+  printf("append...");
+
+  if(g_stat(filename, &st) != 0)
+  {
+    g_set_error_literal(
+      error,
+      G_FILE_ERROR,
+      g_file_error_from_errno(errno),
+      g_strerror(errno)
+    );
+
+    return FALSE;
+  }
+
+  old_size = st.st_size;
+  if(!inf_cert_util_append_certificate_map(filename, "host-b", cert2, error))
+    return FALSE;
+  if(!inf_test_certificate_map_expect_file(filename, "host-a", cert1, 2, error))
+    return FALSE;
+  if(!inf_test_certificate_map_expect_file(filename, "host-b", cert2, 2, error))
+    return FALSE;
+
+  if(inf_test_certificate_map_count_entries(filename, "host-a") != 1 ||
+     inf_test_certificate_map_count_entries(filename, "host-b") != 1)
+  {
+    g_set_error(
+      error,
+      inf_test_certificate_map_error(),
+      4,
+      "Appending a new host produced duplicate entries"
+    );
+
+    return FALSE;
+  }
+
+  printf(" OK\n");
+
+  /* Only the appended part needs to be parsed to pick up the new host */
+  printf("incremental-parse...");
+
+  if(!g_file_get_contents(filename, &content, &size, error))
+    return FALSE;
+
+  g_assert(size > (gsize)old_size);
+  appended = inf_cert_util_parse_certificate_map(
+    content + old_size,
+    size - old_size,
+    error
+  );
+
+  g_free(content);
+  if(appended == NULL) return FALSE;
+
+  result = inf_test_certificate_map_expect(appended, "host-b", cert2, error);
+  if(result == TRUE && g_hash_table_size(appended) != 1)
+  {
+    g_set_error(
+      error,
+      inf_test_certificate_map_error(),
+      5,
+      "Parsing the appended part yields %u entries instead of 1",
+      g_hash_table_size(appended)
+    );
+
+    result = FALSE;
+  }
+
+  g_hash_table_destroy(appended);
+  if(!result) return FALSE;
+
+  printf(" OK\n");
+
+  /* A later entry for the same host overrides the earlier one */
+  printf("override...");
+
+  if(!inf_cert_util_append_certificate_map(filename, "host-a", cert2, error))
+    return FALSE;
+  if(!inf_test_certificate_map_expect_file(filename, "host-a", cert2, 2, error))
+    return FALSE;
+
+  printf(" OK\n");
+
+  /* An empty certificate removes the host. When parsing only a part of the
+   * file, the removal is reported as a NULL entry. */
+  printf("removal...");
+
+  if(g_stat(filename, &st) != 0)
+  {
+    g_set_error_literal(
+      error,
+      G_FILE_ERROR,
+      g_file_error_from_errno(errno),
+      g_strerror(errno)
+    );
+
+    return FALSE;
+  }
+
+  old_size = st.st_size;
+  if(!inf_test_certificate_map_append_raw(filename, "host-b:\n", error))
+    return FALSE;
+  if(!inf_test_certificate_map_expect_file(filename, "host-b", NULL, 1, error))
+    return FALSE;
+
+  if(!g_file_get_contents(filename, &content, &size, error))
+    return FALSE;
+
+  appended = inf_cert_util_parse_certificate_map(
+    content + old_size,
+    size - old_size,
+    error
+  );
+
+  g_free(content);
+  if(appended == NULL) return FALSE;
+
+  result = TRUE;
+  if(!g_hash_table_lookup_extended(appended, "host-b", NULL, NULL) ||
+     g_hash_table_lookup(appended, "host-b") != NULL)
+  {
+    g_set_error(
+      error,
+      inf_test_certificate_map_error(),
+      6,
+      "Removal of a host is not reported by partial parsing"
+    );
+
+    result = FALSE;
+  }
+
+  g_hash_table_destroy(appended);
+  if(!result) return FALSE;
+
+  printf(" OK\n");
+
+  /* Rewriting the map leaves one entry per host */
+  printf("compact...");
+
+  table = inf_cert_util_read_certificate_map(filename, error);
+  if(table == NULL) return FALSE;
+
+  result = inf_cert_util_write_certificate_map(table, filename, error);
+  g_hash_table_destroy(table);
+  if(!result) return FALSE;
+
+  if(inf_test_certificate_map_count_entries(filename, "host-a") != 1 ||
+     inf_test_certificate_map_count_entries(filename, "host-b") != 0)
+  {
+    g_set_error(
+      error,
+      inf_test_certificate_map_error(),
+      7,
+      "Rewritten map does not have exactly one entry per host"
+    );
+
+    return FALSE;
+  }
+
+  if(!inf_test_certificate_map_expect_file(filename, "host-a", cert2, 1, error))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  gnutls_x509_crt_t cert1;
+  gnutls_x509_crt_t cert2;
+  gchar* filename;
+  GError* error;
+  int res;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  cert1 = inf_test_certificate_map_load(
+    CERTS_DIR G_DIR_SEPARATOR_S "test-good-crt.pem",
+    &error
+  );
+
+  if(cert1 == NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  cert2 = inf_test_certificate_map_load(
+    CERTS_DIR G_DIR_SEPARATOR_S "test-expire-crt.pem",
+    &error
+  );
+
+  if(cert2 == NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    gnutls_x509_crt_deinit(cert1);
+    return EXIT_FAILURE;
+  }
+
+  filename = g_build_filename(g_get_tmp_dir(), "certificate-map-test", NULL);
+  g_unlink(filename);
+
+  res = EXIT_SUCCESS;
+  if(!inf_test_certificate_map_run(filename, cert1, cert2, &error))
+  {
+    printf(" %s\n", error->message);
+    g_error_free(error);
+    res = EXIT_FAILURE;
+  }
+
+  g_unlink(filename);
+  g_free(filename);
+  gnutls_x509_crt_deinit(cert2);
+  gnutls_x509_crt_deinit(cert1);
+  inf_deinit();
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -19,10 +19,16 @@
 
 #include <libinftext/inf-text-chunk.h>
 
+#include <string.h>
+
 int main()
 {
   InfTextChunk* chunk;
   InfTextChunk* chunk2;
+  InfTextChunk* chunk3;
+  gchar large[10000];
+  gchar* text;
+  gsize bytes;
 
   chunk2 = inf_text_chunk_new("UTF-8");
 
@@ -35,5 +41,38 @@ int main()
   inf_text_chunk_free(chunk);
   inf_text_chunk_free(chunk2);
 
+  /* Large text is shared between chunks, make sure that modifying one of
+   * them leaves the others alone. */
+  memset(large, 'x', sizeof(large));
+
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(chunk, 0, large, 10000, 10000, 500);
+  chunk2 = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(chunk2, 0, large, 10000, 10000, 500);
+  g_assert(inf_text_chunk_equal(chunk, chunk2));
+
+  chunk3 = inf_text_chunk_substring(chunk, 100, 9000);
+  inf_text_chunk_insert_text(chunk, 5000, "ab", 2, 2, 500);
+  inf_text_chunk_insert_text(chunk2, 5000, "c", 1, 1, 501);
+  inf_text_chunk_erase(chunk3, 0, 10);
+  inf_text_chunk_insert_text(chunk3, 0, "d", 1, 1, 500);
+
+  text = inf_text_chunk_get_text(chunk, &bytes);
+  g_assert(bytes == 10002 && memcmp(text + 4999, "xabx", 4) == 0);
+  g_free(text);
+
+  text = inf_text_chunk_get_text(chunk2, &bytes);
+  g_assert(bytes == 10001 && memcmp(text + 4999, "xcx", 3) == 0);
+  g_free(text);
+
+  text = inf_text_chunk_get_text(chunk3, &bytes);
+  g_assert(bytes == 8991 && memcmp(text, "dxx", 3) == 0);
+  g_assert(memchr(text + 1, 'a', bytes - 1) == NULL);
+  g_free(text);
+
+  inf_text_chunk_free(chunk3);
+  inf_text_chunk_free(chunk);
+  inf_text_chunk_free(chunk2);
+
   return 0;
 }
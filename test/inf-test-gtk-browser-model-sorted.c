@@ -0,0 +1,485 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Drives an InfdDirectory on a temporary filesystem storage through
+ * explorations, additions and removals, and checks that an
+ * InfGtkBrowserModelSorted on top of an InfGtkBrowserStore shows the nodes
+ * in the right order and at the right paths after each of them. */
+
+#include <libinfgtk/inf-gtk-browser-model-sorted.h>
+#include <libinfgtk/inf-gtk-browser-store.h>
+#include <libinfinity/server/infd-directory.h>
+#include <libinfinity/server/infd-filesystem-storage.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-file-util.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <glib/gstdio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct _InfTestGtkBrowserModelSorted InfTestGtkBrowserModelSorted;
+struct _InfTestGtkBrowserModelSorted {
+  gchar* root;
+  InfBrowser* browser;
+  InfGtkBrowserStore* store;
+  InfGtkBrowserModelSorted* model;
+
+  /* Number of rows announced and removed directly below the toplevel row */
+  guint n_inserted;
+  guint n_deleted;
+};
+
+static void
+inf_test_gtk_browser_model_sorted_row_inserted_cb(GtkTreeModel* model,
+                                                  GtkTreePath* path,
+                                                  GtkTreeIter* iter,
+                                                  gpointer user_data)
+{
+  InfTestGtkBrowserModelSorted* test;
+  test = (InfTestGtkBrowserModelSorted*)user_data;
+
+  if(gtk_tree_path_get_depth(path) == 2)
+    ++test->n_inserted;
+}
+
+static void
+inf_test_gtk_browser_model_sorted_row_deleted_cb(GtkTreeModel* model,
+                                                 GtkTreePath* path,
+                                                 gpointer user_data)
+{
+  InfTestGtkBrowserModelSorted* test;
+  test = (InfTestGtkBrowserModelSorted*)user_data;
+
+  if(gtk_tree_path_get_depth(path) == 2)
+    ++test->n_deleted;
+}
+
+/* Looks up the browser node shown at the given path */
+static gboolean
+inf_test_gtk_browser_model_sorted_lookup(InfTestGtkBrowserModelSorted* test,
+                                         const gchar* path_str,
+                                         InfBrowserIter* browser_iter)
+{
+  GtkTreePath* path;
+  GtkTreeIter iter;
+  InfBrowser* browser;
+  gboolean result;
+
+  path = gtk_tree_path_new_from_string(path_str);
+  result = gtk_tree_model_get_iter(GTK_TREE_MODEL(test->model), &iter, path);
+  gtk_tree_path_free(path);
+
+  if(result)
+  {
+    result = inf_gtk_browser_model_tree_iter_to_browser_iter(
+      INF_GTK_BROWSER_MODEL(test->model),
+      &iter,
+      &browser,
+      browser_iter
+    );
+  }
+
+  if(!result)
+  {
+    printf(" No node at path %s\n", path_str);
+    return FALSE;
+  }
+
+  g_object_unref(browser);
+  return TRUE;
+}
+
+/* Checks that the children of the row at parent_str are the nodes called
+ * names, in that order, and that each of them can be found at its path
+ * and by its browser node. */
+static gboolean
+inf_test_gtk_browser_model_sorted_check(InfTestGtkBrowserModelSorted* test,
+                                        const gchar* parent_str,
+                                        const gchar* const* names)
+{
+  GtkTreeModel* model;
+  GtkTreePath* parent_path;
+  GtkTreePath* expected_path;
+  GtkTreePath* path;
+  GtkTreeIter parent;
+  GtkTreeIter iter;
+  GtkTreeIter found;
+  InfBrowser* browser;
+  InfBrowserIter browser_iter;
+  gchar* path_str;
+  const gchar* name;
+  gboolean result;
+  guint n_names;
+  gint i;
+
+  model = GTK_TREE_MODEL(test->model);
+  n_names = g_strv_length((gchar**)names);
+
+  parent_path = gtk_tree_path_new_from_string(parent_str);
+  result = gtk_tree_model_get_iter(model, &parent, parent_path);
+  g_assert(result == TRUE);
+
+  if(gtk_tree_model_iter_n_children(model, &parent) != (gint)n_names)
+  {
+    printf(
+      " Row %s has %d children instead of %u\n",
+      parent_str,
+      gtk_tree_model_iter_n_children(model, &parent),
+      n_names
+    );
+
+    gtk_tree_path_free(parent_path);
+    return FALSE;
+  }
+
+  if(gtk_tree_model_iter_has_child(model, &parent) != (n_names > 0))
+  {
+    printf(" Row %s does not tell whether it has children\n", parent_str);
+    gtk_tree_path_free(parent_path);
+    return FALSE;
+  }
+
+  i = 0;
+  for(result = gtk_tree_model_iter_children(model, &iter, &parent);
+      result == TRUE;
+      result = gtk_tree_model_iter_next(model, &iter), ++i)
+  {
+    expected_path = gtk_tree_path_copy(parent_path);
+    gtk_tree_path_append_index(expected_path, i);
+    path_str = gtk_tree_path_to_string(expected_path);
+
+    path = gtk_tree_model_get_path(model, &iter);
+    if(gtk_tree_path_compare(path, expected_path) != 0)
+    {
+      printf(" Row %s reports a different path\n", path_str);
+      result = FALSE;
+    }
+
+    gtk_tree_path_free(path);
+
+    if(result)
+    {
+      result = inf_gtk_browser_model_tree_iter_to_browser_iter(
+        INF_GTK_BROWSER_MODEL(test->model),
+        &iter,
+        &browser,
+        &browser_iter
+      );
+
+      if(result)
+      {
+        name = inf_browser_get_node_name(browser, &browser_iter);
+        if(strcmp(name, names[i]) != 0)
+        {
+          printf(
+            " Row %s is \"%s\" instead of \"%s\"\n",
+            path_str,
+            name,
+            names[i]
+          );
+
+          result = FALSE;
+        }
+        else if(!inf_gtk_browser_model_browser_iter_to_tree_iter(
+                  INF_GTK_BROWSER_MODEL(test->model),
+                  browser,
+                  &browser_iter,
+                  &found) ||
+                found.user_data != iter.user_data)
+        {
+          printf(" Node \"%s\" is not found at row %s\n", name, path_str);
+          result = FALSE;
+        }
+
+        g_object_unref(browser);
+      }
+      else
+      {
+        printf(" Row %s has no browser node\n", path_str);
+      }
+    }
+
+    g_free(path_str);
+    gtk_tree_path_free(expected_path);
+
+    if(!result)
+    {
+      gtk_tree_path_free(parent_path);
+      return FALSE;
+    }
+  }
+
+  gtk_tree_path_free(parent_path);
+
+  /* Rows that were added to the view before must all have been
+   * announced, otherwise a GtkTreeView would get out of sync. */
+  if(strcmp(parent_str, "0") == 0 &&
+     test->n_inserted - test->n_deleted != n_names)
+  {
+    printf(
+      " %u rows were inserted and %u deleted, but there are %u\n",
+      test->n_inserted,
+      test->n_deleted,
+      n_names
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+inf_test_gtk_browser_model_sorted_explore(InfTestGtkBrowserModelSorted* test)
+{
+  static const gchar* const names[] =
+    { "beta", "gamma", "item9", "item10", NULL };
+
+  GtkTreeIter top;
+  InfBrowserIter iter;
+
+  printf("explore...");
+
+  gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(test->model), &top, NULL, 0);
+
+  /* Read the (still empty) root directory into the model first, as a view
+   * would when the row is expanded, so that explored nodes are inserted
+   * one by one instead of being read all at once afterwards. */
+  if(gtk_tree_model_iter_n_children(GTK_TREE_MODEL(test->model), &top) != 0)
+  {
+    printf(" Toplevel row has children before exploration\n");
+    return FALSE;
+  }
+
+  inf_browser_get_root(test->browser, &iter);
+  inf_browser_explore(test->browser, &iter, NULL, NULL);
+
+  if(!inf_test_gtk_browser_model_sorted_check(test, "0", names))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+static gboolean
+inf_test_gtk_browser_model_sorted_add(InfTestGtkBrowserModelSorted* test)
+{
+  static const gchar* const names[] =
+    { "alpha", "beta", "gamma", "item9", "item10", NULL };
+
+  InfBrowserIter iter;
+
+  printf("add...");
+
+  inf_browser_get_root(test->browser, &iter);
+  inf_browser_add_subdirectory(test->browser, &iter, "alpha", NULL, NULL, NULL);
+
+  if(!inf_test_gtk_browser_model_sorted_check(test, "0", names))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+static gboolean
+inf_test_gtk_browser_model_sorted_remove(InfTestGtkBrowserModelSorted* test)
+{
+  static const gchar* const names[] =
+    { "alpha", "gamma", "item9", "item10", NULL };
+
+  InfBrowserIter iter;
+
+  printf("remove...");
+
+  if(!inf_test_gtk_browser_model_sorted_lookup(test, "0:1", &iter))
+    return FALSE;
+
+  inf_browser_remove_node(test->browser, &iter, NULL, NULL);
+
+  if(!inf_test_gtk_browser_model_sorted_check(test, "0", names))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+static gboolean
+inf_test_gtk_browser_model_sorted_subdirectory(InfTestGtkBrowserModelSorted* t)
+{
+  static const gchar* const names[] = { "one", "two", NULL };
+  static const gchar* const no_names[] = { NULL };
+  static const gchar* const top_names[] = { "alpha", "item9", "item10", NULL };
+
+  InfBrowserIter iter;
+
+  printf("subdirectory...");
+
+  if(!inf_test_gtk_browser_model_sorted_check(t, "0:1", no_names))
+    return FALSE;
+  if(!inf_test_gtk_browser_model_sorted_lookup(t, "0:1", &iter))
+    return FALSE;
+
+  inf_browser_explore(t->browser, &iter, NULL, NULL);
+
+  if(!inf_test_gtk_browser_model_sorted_check(t, "0:1", names))
+    return FALSE;
+
+  /* Removing the subdirectory removes its children along with it */
+  inf_browser_remove_node(t->browser, &iter, NULL, NULL);
+
+  if(!inf_test_gtk_browser_model_sorted_check(t, "0", top_names))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+static gboolean
+inf_test_gtk_browser_model_sorted_setup(InfTestGtkBrowserModelSorted* test,
+                                        GError** error)
+{
+  static const gchar* const directories[] =
+    { "gamma", "beta", "gamma/two", "gamma/one", NULL };
+  static const gchar* const notes[] =
+    { "item10.InfText", "item9.InfText", NULL };
+
+  InfStandaloneIo* io;
+  InfCommunicationManager* manager;
+  InfdFilesystemStorage* storage;
+  gchar* path;
+  guint i;
+
+  test->root = g_dir_make_tmp("inf-test-gtk-browser-model-sorted-XXXXXX",
+                              error);
+  if(test->root == NULL)
+    return FALSE;
+
+  for(i = 0; directories[i] != NULL; ++i)
+  {
+    path = g_build_filename(test->root, directories[i], NULL);
+    g_mkdir(path, 0700);
+    g_free(path);
+  }
+
+  /* Note types without a plugin are shown as nodes of unknown type, which
+   * is good enough to test the order of notes and subdirectories. */
+  for(i = 0; notes[i] != NULL; ++i)
+  {
+    path = g_build_filename(test->root, notes[i], NULL);
+    if(!g_file_set_contents(path, "", 0, error))
+    {
+      g_free(path);
+      return FALSE;
+    }
+
+    g_free(path);
+  }
+
+  io = inf_standalone_io_new();
+  manager = inf_communication_manager_new();
+  storage = infd_filesystem_storage_new(test->root);
+
+  test->browser = INF_BROWSER(
+    infd_directory_new(INF_IO(io), INFD_STORAGE(storage), manager)
+  );
+
+  test->store = inf_gtk_browser_store_new(INF_IO(io), manager);
+  inf_gtk_browser_store_add_browser(test->store, test->browser, "test");
+
+  test->model = inf_gtk_browser_model_sorted_new(
+    INF_GTK_BROWSER_MODEL(test->store)
+  );
+
+  test->n_inserted = 0;
+  test->n_deleted = 0;
+
+  g_signal_connect(
+    G_OBJECT(test->model),
+    "row-inserted",
+    G_CALLBACK(inf_test_gtk_browser_model_sorted_row_inserted_cb),
+    test
+  );
+
+  g_signal_connect(
+    G_OBJECT(test->model),
+    "row-deleted",
+    G_CALLBACK(inf_test_gtk_browser_model_sorted_row_deleted_cb),
+    test
+  );
+
+  g_object_unref(storage);
+  g_object_unref(manager);
+  g_object_unref(io);
+  return TRUE;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  InfTestGtkBrowserModelSorted test;
+  GError* error;
+  int res;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  if(!inf_test_gtk_browser_model_sorted_setup(&test, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    g_free(test.root);
+    inf_deinit();
+    return EXIT_FAILURE;
+  }
+
+  /* Each step builds on the state left by the previous one */
+  res = EXIT_FAILURE;
+  if(inf_test_gtk_browser_model_sorted_explore(&test) &&
+     inf_test_gtk_browser_model_sorted_add(&test) &&
+     inf_test_gtk_browser_model_sorted_remove(&test) &&
+     inf_test_gtk_browser_model_sorted_subdirectory(&test))
+  {
+    res = EXIT_SUCCESS;
+  }
+
+  g_object_unref(test.model);
+  g_object_unref(test.store);
+  g_object_unref(test.browser);
+
+  if(!inf_file_util_delete(test.root, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+  }
+
+  g_free(test.root);
+  inf_deinit();
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */
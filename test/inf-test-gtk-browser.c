@@ -22,6 +22,7 @@
 #include <libinftextgtk/inf-text-gtk-viewport.h>
 #include <libinfgtk/inf-gtk-browser-view.h>
 #include <libinfgtk/inf-gtk-browser-store.h>
+#include <libinfgtk/inf-gtk-browser-model-sorted.h>
 #include <libinfgtk/inf-gtk-chat.h>
 #include <libinfgtk/inf-gtk-io.h>
 #include <libinftext/inf-text-session.h>
@@ -867,6 +868,7 @@ main(int argc,
   InfDiscoveryAvahi* avahi;
 #endif
   InfGtkBrowserStore* store;
+  InfGtkBrowserModelSorted* sorted;
   GtkWidget* view;
   GtkWidget* scroll;
   GtkWidget* window;
@@ -946,8 +948,11 @@ main(int argc,
   g_object_unref(G_OBJECT(avahi));
 #endif
 
-  view = inf_gtk_browser_view_new_with_model(INF_GTK_BROWSER_MODEL(store));
+  sorted = inf_gtk_browser_model_sorted_new(INF_GTK_BROWSER_MODEL(store));
   g_object_unref(G_OBJECT(store));
+
+  view = inf_gtk_browser_view_new_with_model(INF_GTK_BROWSER_MODEL(sorted));
+  g_object_unref(G_OBJECT(sorted));
   gtk_widget_show(view);
 
   g_signal_connect(
@@ -0,0 +1,295 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Compares the cost of adding, updating and removing watches, timeouts and
+ * dispatches on InfGtkIo and InfStandaloneIo. */
+
+#include <libinfgtk/inf-gtk-io.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-init.h>
+
+#ifndef G_OS_WIN32
+# include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef void(*InfTestGtkIoIterationFunc)(InfIo*);
+
+typedef struct _InfTestGtkIoDispatchData InfTestGtkIoDispatchData;
+struct _InfTestGtkIoDispatchData {
+  InfIo* io;
+  guint n_dispatches;
+  guint n_executed;
+};
+
+static void
+inf_test_gtk_io_gtk_iteration(InfIo* io)
+{
+  g_main_context_iteration(NULL, TRUE);
+}
+
+static void
+inf_test_gtk_io_standalone_iteration(InfIo* io)
+{
+  inf_standalone_io_iteration(INF_STANDALONE_IO(io));
+}
+
+static void
+inf_test_gtk_io_report(const gchar* io_name,
+                       const gchar* what,
+                       guint n,
+                       gint64 start)
+{
+  gint64 elapsed;
+  elapsed = g_get_monotonic_time() - start;
+
+  printf(
+    "%-16s %-24s %8u ops %10.3f ms %8.1f ns/op\n",
+    io_name,
+    what,
+    n,
+    elapsed / 1000.0,
+    elapsed * 1000.0 / n
+  );
+}
+
+static void
+inf_test_gtk_io_timeout_func(gpointer user_data)
+{
+}
+
+static void
+inf_test_gtk_io_watch_func(InfNativeSocket* socket,
+                           InfIoEvent event,
+                           gpointer user_data)
+{
+}
+
+static void
+inf_test_gtk_io_dispatch_func(gpointer user_data)
+{
+  InfTestGtkIoDispatchData* data;
+  data = (InfTestGtkIoDispatchData*)user_data;
+
+  ++data->n_executed;
+}
+
+static gpointer
+inf_test_gtk_io_dispatch_thread_func(gpointer user_data)
+{
+  InfTestGtkIoDispatchData* data;
+  guint i;
+
+  data = (InfTestGtkIoDispatchData*)user_data;
+  for(i = 0; i < data->n_dispatches; ++i)
+    inf_io_add_dispatch(data->io, inf_test_gtk_io_dispatch_func, data, NULL);
+
+  return NULL;
+}
+
+static void
+inf_test_gtk_io_bench_timeouts(InfIo* io,
+                               const gchar* io_name,
+                               guint n)
+{
+  InfIoTimeout** timeouts;
+  gint64 start;
+  guint i;
+
+  timeouts = g_malloc(sizeof(InfIoTimeout*) * n);
+
+  start = g_get_monotonic_time();
+  for(i = 0; i < n; ++i)
+  {
+    timeouts[i] = inf_io_add_timeout(
+      io,
+      60000 + i,
+      inf_test_gtk_io_timeout_func,
+      NULL,
+      NULL
+    );
+  }
+  inf_test_gtk_io_report(io_name, "add timeout", n, start);
+
+  /* Remove in insertion order, which is the worst case for a list that is
+   * prepended to. */
+  start = g_get_monotonic_time();
+  for(i = 0; i < n; ++i)
+    inf_io_remove_timeout(io, timeouts[i]);
+  inf_test_gtk_io_report(io_name, "remove timeout", n, start);
+
+  g_free(timeouts);
+}
+
+#ifndef G_OS_WIN32
+static void
+inf_test_gtk_io_bench_watches(InfIo* io,
+                              const gchar* io_name,
+                              guint n)
+{
+  InfNativeSocket* sockets;
+  InfIoWatch** watches;
+  gint64 start;
+  guint i;
+  int fds[2];
+
+  sockets = g_malloc(sizeof(InfNativeSocket) * n);
+  watches = g_malloc(sizeof(InfIoWatch*) * n);
+
+  for(i = 0; i < n; i += 2)
+  {
+    if(pipe(fds) == -1)
+    {
+      perror("pipe");
+      exit(EXIT_FAILURE);
+    }
+
+    sockets[i] = fds[0];
+    if(i + 1 < n) sockets[i + 1] = fds[1];
+    else close(fds[1]);
+  }
+
+  start = g_get_monotonic_time();
+  for(i = 0; i < n; ++i)
+  {
+    watches[i] = inf_io_add_watch(
+      io,
+      &sockets[i],
+      INF_IO_ERROR,
+      inf_test_gtk_io_watch_func,
+      NULL,
+      NULL
+    );
+  }
+  inf_test_gtk_io_report(io_name, "add watch", n, start);
+
+  /* This is what happens every time a connection starts or stops having
+   * data to send. */
+  start = g_get_monotonic_time();
+  for(i = 0; i < n; ++i)
+  {
+    inf_io_update_watch(io, watches[i], INF_IO_ERROR | INF_IO_INCOMING);
+    inf_io_update_watch(io, watches[i], INF_IO_ERROR);
+  }
+  inf_test_gtk_io_report(io_name, "update watch", 2 * n, start);
+
+  start = g_get_monotonic_time();
+  for(i = 0; i < n; ++i)
+    inf_io_remove_watch(io, watches[i]);
+  inf_test_gtk_io_report(io_name, "remove watch", n, start);
+
+  for(i = 0; i < n; ++i)
+    close(sockets[i]);
+
+  g_free(watches);
+  g_free(sockets);
+}
+#endif
+
+static void
+inf_test_gtk_io_bench_dispatches(InfIo* io,
+                                 const gchar* io_name,
+                                 InfTestGtkIoIterationFunc iteration_func,
+                                 guint n)
+{
+  InfTestGtkIoDispatchData data;
+  GThread* thread;
+  gint64 start;
+
+  data.io = io;
+  data.n_dispatches = n;
+  data.n_executed = 0;
+
+  start = g_get_monotonic_time();
+
+  thread = g_thread_new(
+    "inf-test-gtk-io",
+    inf_test_gtk_io_dispatch_thread_func,
+    &data
+  );
+
+  while(data.n_executed < n)
+    iteration_func(io);
+
+  g_thread_join(thread);
+  inf_test_gtk_io_report(io_name, "cross-thread dispatch", n, start);
+}
+
+static void
+inf_test_gtk_io_bench(InfIo* io,
+                      const gchar* io_name,
+                      InfTestGtkIoIterationFunc iteration_func,
+                      guint n)
+{
+  inf_test_gtk_io_bench_timeouts(io, io_name, n);
+#ifndef G_OS_WIN32
+  /* Stay well below the file descriptor limit */
+  inf_test_gtk_io_bench_watches(io, io_name, MIN(n, 512));
+#endif
+  inf_test_gtk_io_bench_dispatches(io, io_name, iteration_func, n);
+}
+
+int
+main(int argc,
+     char* argv[])
+{
+  GError* error;
+  InfGtkIo* gtk_io;
+  InfStandaloneIo* standalone_io;
+  guint n;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  n = 10000;
+  if(argc > 1)
+    n = strtoul(argv[1], NULL, 10);
+  if(n == 0)
+    n = 1;
+
+  gtk_io = inf_gtk_io_new();
+  inf_test_gtk_io_bench(
+    INF_IO(gtk_io),
+    "InfGtkIo",
+    inf_test_gtk_io_gtk_iteration,
+    n
+  );
+  g_object_unref(gtk_io);
+
+  standalone_io = inf_standalone_io_new();
+  inf_test_gtk_io_bench(
+    INF_IO(standalone_io),
+    "InfStandaloneIo",
+    inf_test_gtk_io_standalone_iteration,
+    n
+  );
+  g_object_unref(standalone_io);
+
+  inf_deinit();
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
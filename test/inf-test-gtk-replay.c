@@ -0,0 +1,368 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Replays session records into an InfTextGtkBuffer which is shown in an
+ * offscreen window, together with an InfTextGtkView and an
+ * InfTextGtkViewport, and reports how long it takes to apply the requests
+ * and to draw the window. This needs a display, but nothing is shown on
+ * it, so it can be run with a virtual one, for example with xvfb-run. */
+
+#include <libinftextgtk/inf-text-gtk-buffer.h>
+#include <libinftextgtk/inf-text-gtk-view.h>
+#include <libinftextgtk/inf-text-gtk-viewport.h>
+#include <libinfgtk/inf-gtk-io.h>
+#include <libinftext/inf-text-session.h>
+#include <libinfinity/adopted/inf-adopted-session-replay.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <gtk/gtk.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef G_OS_WIN32
+# include <sys/resource.h>
+#endif
+
+typedef struct _InfTestGtkReplay InfTestGtkReplay;
+struct _InfTestGtkReplay {
+  InfIo* io;
+
+  /* Set when the session is created */
+  GtkTextBuffer* textbuffer;
+  InfUserTable* user_table;
+
+  GtkWidget* window;
+  InfTextGtkView* view;
+  InfTextGtkViewport* viewport;
+
+  guint n_requests;
+  gint64 apply_time;
+  gint64 apply_max;
+
+  guint n_frames;
+  gint64 draw_time;
+  gint64 draw_max;
+};
+
+static InfSession*
+inf_test_gtk_replay_session_new(InfIo* io,
+                                InfCommunicationManager* manager,
+                                InfSessionStatus status,
+                                InfCommunicationGroup* sync_group,
+                                InfXmlConnection* sync_connection,
+                                const gchar* path,
+                                gpointer user_data)
+{
+  InfTestGtkReplay* replay;
+  InfTextGtkBuffer* buffer;
+  InfTextSession* session;
+
+  replay = (InfTestGtkReplay*)user_data;
+  g_assert(replay->textbuffer == NULL);
+
+  replay->textbuffer = gtk_text_buffer_new(NULL);
+  replay->user_table = inf_user_table_new();
+  buffer = inf_text_gtk_buffer_new(replay->textbuffer, replay->user_table);
+
+  session = inf_text_session_new_with_user_table(
+    manager,
+    INF_TEXT_BUFFER(buffer),
+    io,
+    replay->user_table,
+    status,
+    sync_group,
+    sync_connection
+  );
+
+  g_object_unref(buffer);
+  return INF_SESSION(session);
+}
+
+static void
+inf_test_gtk_replay_create_window(InfTestGtkReplay* replay)
+{
+  GtkWidget* scroll;
+  GtkWidget* textview;
+
+  textview = gtk_text_view_new_with_buffer(replay->textbuffer);
+  gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(textview), GTK_WRAP_WORD_CHAR);
+
+  scroll = gtk_scrolled_window_new(NULL, NULL);
+  gtk_scrolled_window_set_policy(
+    GTK_SCROLLED_WINDOW(scroll),
+    GTK_POLICY_AUTOMATIC,
+    GTK_POLICY_ALWAYS
+  );
+
+  gtk_container_add(GTK_CONTAINER(scroll), textview);
+
+  replay->window = gtk_offscreen_window_new();
+  gtk_window_set_default_size(GTK_WINDOW(replay->window), 800, 600);
+  gtk_container_add(GTK_CONTAINER(replay->window), scroll);
+  gtk_widget_show_all(replay->window);
+
+  replay->view = inf_text_gtk_view_new(
+    replay->io,
+    GTK_TEXT_VIEW(textview),
+    replay->user_table
+  );
+
+  replay->viewport = inf_text_gtk_viewport_new(
+    GTK_SCROLLED_WINDOW(scroll),
+    replay->user_table
+  );
+}
+
+static void
+inf_test_gtk_replay_destroy_window(InfTestGtkReplay* replay)
+{
+  if(replay->viewport != NULL)
+    g_object_unref(replay->viewport);
+  if(replay->view != NULL)
+    g_object_unref(replay->view);
+  if(replay->window != NULL)
+    gtk_widget_destroy(replay->window);
+
+  if(replay->user_table != NULL)
+    g_object_unref(replay->user_table);
+  if(replay->textbuffer != NULL)
+    g_object_unref(replay->textbuffer);
+
+  replay->viewport = NULL;
+  replay->view = NULL;
+  replay->window = NULL;
+  replay->user_table = NULL;
+  replay->textbuffer = NULL;
+}
+
+/* Runs everything that GTK+ has queued for the next frame, such as
+ * revalidating the text layout, and then draws the whole window. */
+static void
+inf_test_gtk_replay_draw_frame(InfTestGtkReplay* replay)
+{
+  cairo_surface_t* surface;
+  cairo_t* cr;
+  gint64 begin;
+  gint64 time;
+
+  begin = g_get_monotonic_time();
+
+  while(g_main_context_iteration(NULL, FALSE))
+    ;
+
+  surface = cairo_image_surface_create(
+    CAIRO_FORMAT_ARGB32,
+    gtk_widget_get_allocated_width(replay->window),
+    gtk_widget_get_allocated_height(replay->window)
+  );
+
+  cr = cairo_create(surface);
+  gtk_widget_draw(replay->window, cr);
+  cairo_destroy(cr);
+  cairo_surface_destroy(surface);
+
+  time = g_get_monotonic_time() - begin;
+
+  ++replay->n_frames;
+  replay->draw_time += time;
+  if(time > replay->draw_max)
+    replay->draw_max = time;
+}
+
+static glong
+inf_test_gtk_replay_get_max_rss(void)
+{
+#ifndef G_OS_WIN32
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) == 0)
+    return usage.ru_maxrss;
+#endif
+  return -1;
+}
+
+static gboolean
+inf_test_gtk_replay_run(InfTestGtkReplay* replay,
+                        const gchar* record,
+                        guint frame_interval,
+                        GError** error)
+{
+  InfcNotePlugin plugin;
+  InfAdoptedSessionReplay* session_replay;
+  GError* local_error;
+  gint64 begin;
+  gint64 time;
+  gboolean result;
+
+  plugin.user_data = replay;
+  plugin.note_type = "InfText";
+  plugin.session_new = inf_test_gtk_replay_session_new;
+
+  session_replay = inf_adopted_session_replay_new();
+
+  begin = g_get_monotonic_time();
+  result = inf_adopted_session_replay_set_record(
+    session_replay,
+    record,
+    &plugin,
+    error
+  );
+
+  if(result == FALSE)
+  {
+    g_object_unref(session_replay);
+    inf_test_gtk_replay_destroy_window(replay);
+    return FALSE;
+  }
+
+  inf_test_gtk_replay_create_window(replay);
+  inf_test_gtk_replay_draw_frame(replay);
+
+  fprintf(
+    stderr,
+    "%s: %d characters, initial load and first frame %.3f ms\n",
+    record,
+    gtk_text_buffer_get_char_count(replay->textbuffer),
+    (g_get_monotonic_time() - begin) / 1000.
+  );
+
+  replay->n_requests = 0;
+  replay->apply_time = 0;
+  replay->apply_max = 0;
+  replay->n_frames = 0;
+  replay->draw_time = 0;
+  replay->draw_max = 0;
+
+  local_error = NULL;
+  for(;;)
+  {
+    begin = g_get_monotonic_time();
+    result = inf_adopted_session_replay_play_next(
+      session_replay,
+      &local_error
+    );
+
+    time = g_get_monotonic_time() - begin;
+
+    if(result == FALSE)
+      break;
+
+    ++replay->n_requests;
+    replay->apply_time += time;
+    if(time > replay->apply_max)
+      replay->apply_max = time;
+
+    if(replay->n_requests % frame_interval == 0)
+      inf_test_gtk_replay_draw_frame(replay);
+  }
+
+  if(local_error != NULL)
+  {
+    g_propagate_error(error, local_error);
+  }
+  else
+  {
+    inf_test_gtk_replay_draw_frame(replay);
+
+    printf(
+      "%s: %u requests, apply %.3f ms (avg %.3f ms, max %.3f ms), "
+      "%u frames, draw %.3f ms (avg %.3f ms, max %.3f ms), "
+      "max RSS %ld kB\n",
+      record,
+      replay->n_requests,
+      replay->apply_time / 1000.,
+      replay->n_requests > 0 ?
+        replay->apply_time / 1000. / replay->n_requests : 0.,
+      replay->apply_max / 1000.,
+      replay->n_frames,
+      replay->draw_time / 1000.,
+      replay->draw_time / 1000. / replay->n_frames,
+      replay->draw_max / 1000.,
+      inf_test_gtk_replay_get_max_rss()
+    );
+
+    result = TRUE;
+  }
+
+  g_object_unref(session_replay);
+  inf_test_gtk_replay_destroy_window(replay);
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  InfTestGtkReplay replay;
+  GError* error;
+  guint frame_interval;
+  int first;
+  int i;
+  int ret;
+
+  gtk_init(&argc, &argv);
+
+  frame_interval = 1;
+  first = 1;
+  if(argc > 2 && strcmp(argv[1], "-f") == 0)
+  {
+    frame_interval = strtoul(argv[2], NULL, 10);
+    first = 3;
+  }
+
+  if(argc <= first || frame_interval == 0)
+  {
+    fprintf(
+      stderr,
+      "Usage: %s [-f <requests-per-frame>] <record-file1> "
+      "<record-file2> ...\n",
+      argv[0]
+    );
+
+    return -1;
+  }
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  memset(&replay, 0, sizeof(replay));
+  replay.io = INF_IO(inf_gtk_io_new());
+
+  ret = 0;
+  for(i = first; i < argc; ++i)
+  {
+    if(!inf_test_gtk_replay_run(&replay, argv[i], frame_interval, &error))
+    {
+      fprintf(stderr, "%s: %s\n", argv[i], error->message);
+      g_error_free(error);
+      error = NULL;
+
+      ret = -1;
+    }
+  }
+
+  g_object_unref(replay.io);
+  inf_deinit();
+  return ret;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -33,10 +33,14 @@
 #include <libinfinity/common/inf-protocol.h>
 #include <libinfinity/common/inf-init.h>
 
+#include <stdlib.h>
 #include <string.h>
 
+typedef struct _InfTestMassJoin InfTestMassJoin;
+
 typedef struct _InfTestMassJoiner InfTestMassJoiner;
 struct _InfTestMassJoiner {
+  InfTestMassJoin* massjoin;
   InfCommunicationManager* communication_manager;
   InfcBrowser* browser;
   InfcSessionProxy* session;
@@ -45,10 +49,15 @@ struct _InfTestMassJoiner {
   gchar* username;
 };
 
-typedef struct _InfTestMassJoin InfTestMassJoin;
 struct _InfTestMassJoin {
   InfIo* io;
   GSList* joiners;
+
+  /* Time from the start until all users have joined, which mostly depends
+   * on how well the server handles many subscriptions to one session. */
+  guint n_joiners;
+  guint n_joined;
+  gint64 begin;
 };
 
 static InfSession*
@@ -93,6 +102,17 @@ inf_test_mass_join_user_join_finished_cb(InfRequest* request,
   if(error == NULL)
   {
     fprintf(stdout, "Joiner %s: User joined!\n", joiner->username);
+
+    ++joiner->massjoin->n_joined;
+    if(joiner->massjoin->n_joined == joiner->massjoin->n_joiners)
+    {
+      fprintf(
+        stdout,
+        "All %u users joined after %.3f ms\n",
+        joiner->massjoin->n_joiners,
+        (g_get_monotonic_time() - joiner->massjoin->begin) / 1000.
+      );
+    }
   }
   else
   {
@@ -379,6 +399,7 @@ inf_test_mass_join_connect(InfTestMassJoin* massjoin,
   );
 
   joiner = g_slice_new(InfTestMassJoiner);
+  joiner->massjoin = massjoin;
   joiner->communication_manager = inf_communication_manager_new();
   joiner->browser = infc_browser_new(
     massjoin->io,
@@ -429,7 +450,7 @@ main(int argc,
 {
   InfTestMassJoin massjoin;
   GError* error;
-  int i;
+  guint i;
   gchar* name;
 
   error = NULL;
@@ -441,10 +462,16 @@ main(int argc,
 
   massjoin.io = INF_IO(inf_standalone_io_new());
   massjoin.joiners = NULL;
+  massjoin.n_joiners = 128;
+  massjoin.n_joined = 0;
+  massjoin.begin = g_get_monotonic_time();
+
+  if(argc > 1)
+    massjoin.n_joiners = strtoul(argv[1], NULL, 10);
 
-  for(i = 0; i < 128; ++i)
+  for(i = 0; i < massjoin.n_joiners; ++i)
   {
-    name = g_strdup_printf("MassJoin%03d", i);
+    name = g_strdup_printf("MassJoin%03u", i);
 
     inf_test_mass_join_connect(
       &massjoin,
@@ -0,0 +1,308 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks that a short exchange overtakes bulk transfers which share its
+ * connection in InfCommunicationRegistry, and measures the latency of
+ * keystrokes typed while several bulk transfers are running. Latency is
+ * measured in the number of bulk messages that arrive between sending a
+ * keystroke and its arrival, since simulated connections have no notion of
+ * time. */
+
+#include <libinfinity/communication/inf-communication-manager.h>
+#include <libinfinity/communication/inf-communication-hosted-group.h>
+#include <libinfinity/common/inf-simulated-connection.h>
+#include <libinfinity/common/inf-timing-policy.h>
+#include <libinfinity/common/inf-init.h>
+#include <libinfinity/inf-signals.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_BULK_GROUPS 3
+#define N_BULK_MESSAGES 1000
+#define N_KEYSTROKES 20
+
+typedef struct _InfTestRegistrySchedule InfTestRegistrySchedule;
+struct _InfTestRegistrySchedule {
+  InfCommunicationHostedGroup* keystroke_group;
+  InfXmlConnection* connection;
+
+  guint bulk_received;
+  guint keystrokes_sent;
+  guint keystrokes_received;
+
+  gboolean keystroke_pending;
+  guint keystroke_sent_at;
+
+  guint max_latency;
+  guint total_latency;
+};
+
+static guint
+inf_test_registry_schedule_count_messages(xmlNodePtr xml)
+{
+  xmlNodePtr child;
+  guint count;
+
+  count = 0;
+  for(child = xml->children; child != NULL; child = child->next)
+    if(child->type == XML_ELEMENT_NODE)
+      ++count;
+
+  return count;
+}
+
+static void
+inf_test_registry_schedule_received_cb(InfXmlConnection* connection,
+                                       xmlNodePtr xml,
+                                       gpointer user_data)
+{
+  InfTestRegistrySchedule* test;
+  xmlChar* name;
+  guint count;
+  guint latency;
+
+  test = (InfTestRegistrySchedule*)user_data;
+  name = xmlGetProp(xml, (const xmlChar*)"name");
+  g_assert(name != NULL);
+
+  count = inf_test_registry_schedule_count_messages(xml);
+
+  if(strcmp((const char*)name, "keystroke") == 0)
+  {
+    g_assert(test->keystroke_pending == TRUE);
+
+    latency = test->bulk_received - test->keystroke_sent_at;
+    test->max_latency = MAX(test->max_latency, latency);
+    test->total_latency += latency;
+
+    test->keystrokes_received += count;
+    test->keystroke_pending = FALSE;
+  }
+  else
+  {
+    test->bulk_received += count;
+
+    /* Type the next keystroke as soon as the previous one has arrived.
+     * The first container of each group is sent before the registry knows
+     * that the group has a backlog, so only start once the bulk transfers
+     * are scheduled, which is when containers of more than one message
+     * arrive. */
+    if(count > 1 &&
+       test->keystroke_pending == FALSE &&
+       test->keystrokes_sent < N_KEYSTROKES)
+    {
+      test->keystroke_pending = TRUE;
+      test->keystroke_sent_at = test->bulk_received;
+      ++test->keystrokes_sent;
+
+      inf_communication_group_send_message(
+        INF_COMMUNICATION_GROUP(test->keystroke_group),
+        test->connection,
+        xmlNewNode(NULL, (const xmlChar*)"insert")
+      );
+    }
+  }
+
+  xmlFree(name);
+}
+
+static gboolean
+inf_test_registry_schedule_run(void)
+{
+  static const gchar* const methods[] = { "central", NULL };
+
+  InfCommunicationManager* manager;
+  InfCommunicationHostedGroup* bulk_groups[N_BULK_GROUPS];
+  InfSimulatedConnection* local;
+  InfSimulatedConnection* remote;
+  InfTestRegistrySchedule test;
+  gchar* name;
+  guint limit;
+  guint i;
+  guint j;
+  gboolean result;
+
+  printf("overtake...");
+
+  local = inf_simulated_connection_new();
+  remote = inf_simulated_connection_new();
+  inf_simulated_connection_connect(local, remote);
+  inf_simulated_connection_set_mode(local, INF_SIMULATED_CONNECTION_DELAYED);
+
+  manager = inf_communication_manager_new();
+
+  test.keystroke_group =
+    inf_communication_manager_open_group(manager, "keystroke", methods);
+  test.connection = INF_XML_CONNECTION(local);
+  test.bulk_received = 0;
+  test.keystrokes_sent = 0;
+  test.keystrokes_received = 0;
+  test.keystroke_pending = FALSE;
+  test.keystroke_sent_at = 0;
+  test.max_latency = 0;
+  test.total_latency = 0;
+
+  inf_communication_hosted_group_add_member(
+    test.keystroke_group,
+    INF_XML_CONNECTION(local)
+  );
+
+  for(i = 0; i < N_BULK_GROUPS; ++i)
+  {
+    name = g_strdup_printf("bulk-%u", i);
+    bulk_groups[i] =
+      inf_communication_manager_open_group(manager, name, methods);
+    g_free(name);
+
+    inf_communication_hosted_group_add_member(
+      bulk_groups[i],
+      INF_XML_CONNECTION(local)
+    );
+  }
+
+  g_signal_connect(
+    G_OBJECT(remote),
+    "received",
+    G_CALLBACK(inf_test_registry_schedule_received_cb),
+    &test
+  );
+
+  /* Schedule all bulk transfers at once, like several sessions being
+   * synchronized to the same client */
+  for(j = 0; j < N_BULK_MESSAGES; ++j)
+  {
+    for(i = 0; i < N_BULK_GROUPS; ++i)
+    {
+      inf_communication_group_send_message(
+        INF_COMMUNICATION_GROUP(bulk_groups[i]),
+        INF_XML_CONNECTION(local),
+        xmlNewNode(NULL, (const xmlChar*)"sync-segment")
+      );
+    }
+  }
+
+  inf_simulated_connection_flush(local);
+
+  /* While the bulk transfers are running, a keystroke should have to wait
+   * for at most one bulk container, no matter how many bulk transfers share
+   * the connection. */
+  limit = inf_timing_policy_get_inner_queue_limit(
+    inf_timing_policy_get_default()
+  );
+
+  result = TRUE;
+  if(test.bulk_received != N_BULK_GROUPS * N_BULK_MESSAGES)
+  {
+    printf(
+      " %u bulk messages arrived instead of %u\n",
+      test.bulk_received,
+      N_BULK_GROUPS * N_BULK_MESSAGES
+    );
+
+    result = FALSE;
+  }
+  else if(test.keystrokes_sent != N_KEYSTROKES ||
+          test.keystrokes_received != N_KEYSTROKES)
+  {
+    printf(
+      " %u of %u keystrokes were sent and %u arrived\n",
+      test.keystrokes_sent,
+      N_KEYSTROKES,
+      test.keystrokes_received
+    );
+
+    result = FALSE;
+  }
+  else if(test.max_latency > limit)
+  {
+    printf(
+      " A keystroke waited for %u bulk messages, but at most %u are sent "
+      "at a time\n",
+      test.max_latency,
+      limit
+    );
+
+    result = FALSE;
+  }
+
+  if(result)
+  {
+    printf(
+      " OK (keystroke latency: max %u, mean %.1f bulk messages)\n",
+      test.max_latency,
+      (double)test.total_latency / N_KEYSTROKES
+    );
+  }
+
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(remote),
+    G_CALLBACK(inf_test_registry_schedule_received_cb),
+    &test
+  );
+
+  for(i = 0; i < N_BULK_GROUPS; ++i)
+  {
+    inf_communication_hosted_group_remove_member(
+      bulk_groups[i],
+      INF_XML_CONNECTION(local)
+    );
+
+    g_object_unref(bulk_groups[i]);
+  }
+
+  inf_communication_hosted_group_remove_member(
+    test.keystroke_group,
+    INF_XML_CONNECTION(local)
+  );
+
+  g_object_unref(test.keystroke_group);
+  g_object_unref(manager);
+
+  inf_xml_connection_close(INF_XML_CONNECTION(local));
+  g_object_unref(local);
+  g_object_unref(remote);
+
+  return result;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  GError* error;
+  int res;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  res = EXIT_SUCCESS;
+  if(!inf_test_registry_schedule_run()) res = EXIT_FAILURE;
+
+  inf_deinit();
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */
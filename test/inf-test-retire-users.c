@@ -0,0 +1,434 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks that InfAdoptedAlgorithm keeps transforming correctly when users
+ * that have left the session are retired in inf_adopted_algorithm_cleanup(),
+ * and when they come back and issue requests again. */
+
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-default-insert-operation.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct _InfTestRetireUsers InfTestRetireUsers;
+struct _InfTestRetireUsers {
+  InfTextBuffer* buffer;
+  InfUserTable* user_table;
+  InfAdoptedAlgorithm* algorithm;
+
+  InfAdoptedUser* a;
+  InfAdoptedUser* b;
+  InfAdoptedUser* c;
+};
+
+static GQuark
+inf_test_retire_users_error(void)
+{
+  return g_quark_from_static_string("INF_TEST_RETIRE_USERS_ERROR");
+}
+
+static InfAdoptedUser*
+inf_test_retire_users_add_user(InfUserTable* user_table,
+                               guint id,
+                               const gchar* name)
+{
+  InfUser* user;
+
+  user = INF_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", id,
+      "name", name,
+      "status", INF_USER_ACTIVE,
+      "flags", 0,
+      NULL
+    )
+  );
+
+  inf_user_table_add_user(user_table, user);
+  g_object_unref(user);
+
+  return INF_ADOPTED_USER(user);
+}
+
+/* Executes an insertion of text at pos made by user in state vector, in the
+ * same way as InfAdoptedSession does for requests received from the
+ * network. */
+static gboolean
+inf_test_retire_users_insert(InfTestRetireUsers* test,
+                             InfAdoptedUser* user,
+                             InfAdoptedStateVector* vector,
+                             guint pos,
+                             const gchar* text,
+                             GError** error)
+{
+  InfTextChunk* chunk;
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* request;
+  guint user_id;
+  gboolean result;
+
+  user_id = inf_user_get_id(INF_USER(user));
+
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(
+    chunk,
+    0,
+    text,
+    strlen(text),
+    g_utf8_strlen(text, -1),
+    user_id
+  );
+
+  operation = INF_ADOPTED_OPERATION(
+    inf_text_default_insert_operation_new(pos, chunk)
+  );
+
+  inf_text_chunk_free(chunk);
+
+  request = inf_adopted_request_new_do(
+    vector,
+    user_id,
+    operation,
+    g_get_real_time()
+  );
+
+  g_object_unref(operation);
+
+  result = inf_adopted_algorithm_execute_request(
+    test->algorithm,
+    request,
+    TRUE,
+    error
+  );
+
+  if(result == TRUE)
+  {
+    inf_adopted_user_set_vector(
+      user,
+      inf_adopted_state_vector_copy(inf_adopted_request_get_vector(request))
+    );
+  }
+
+  g_object_unref(request);
+  return result;
+}
+
+/* Makes all available users acknowledge the current state, as if they had
+ * sent a noop, and then cleans up the request logs. */
+static void
+inf_test_retire_users_sync(InfTestRetireUsers* test)
+{
+  InfAdoptedStateVector* current;
+  InfAdoptedUser* users[3];
+  guint i;
+
+  current = inf_adopted_algorithm_get_current(test->algorithm);
+  users[0] = test->a;
+  users[1] = test->b;
+  users[2] = test->c;
+
+  for(i = 0; i < 3; ++i)
+  {
+    if(inf_user_get_status(INF_USER(users[i])) != INF_USER_UNAVAILABLE)
+    {
+      inf_adopted_user_set_vector(
+        users[i],
+        inf_adopted_state_vector_copy(current)
+      );
+    }
+  }
+
+  inf_adopted_algorithm_cleanup(test->algorithm);
+}
+
+static gboolean
+inf_test_retire_users_check_buffer(InfTestRetireUsers* test,
+                                   const gchar* expected,
+                                   GError** error)
+{
+  InfTextChunk* chunk;
+  gchar* text;
+  gsize bytes;
+  gboolean result;
+
+  chunk = inf_text_buffer_get_slice(
+    test->buffer,
+    0,
+    inf_text_buffer_get_length(test->buffer)
+  );
+
+  text = inf_text_chunk_get_text(chunk, &bytes);
+  inf_text_chunk_free(chunk);
+
+  result = bytes == strlen(expected) && memcmp(text, expected, bytes) == 0;
+  if(result == FALSE)
+  {
+    g_set_error(
+      error,
+      inf_test_retire_users_error(),
+      0,
+      "Buffer is \"%.*s\" instead of \"%s\"",
+      (int)bytes,
+      text,
+      expected
+    );
+  }
+
+  g_free(text);
+  return result;
+}
+
+static gboolean
+inf_test_retire_users_check_log_empty(InfAdoptedUser* user,
+                                      GError** error)
+{
+  InfAdoptedRequestLog* log;
+  log = inf_adopted_user_get_request_log(user);
+
+  if(inf_adopted_request_log_get_begin(log) !=
+     inf_adopted_request_log_get_end(log))
+  {
+    g_set_error(
+      error,
+      inf_test_retire_users_error(),
+      1,
+      "Request log of user \"%s\" has not been cleaned up",
+      inf_user_get_name(INF_USER(user))
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+inf_test_retire_users_run(InfTestRetireUsers* test,
+                          GError** error)
+{
+  InfAdoptedStateVector* vector;
+  GError* local_error;
+  gboolean result;
+
+  /* C makes a change and leaves. Once everybody else has seen the change,
+   * cleanup removes the request and retires C. */
+  printf("retire...");
+
+  vector = inf_adopted_state_vector_copy(
+    inf_adopted_algorithm_get_current(test->algorithm)
+  );
+
+  result = inf_test_retire_users_insert(test, test->c, vector, 0, "c", error);
+  inf_adopted_state_vector_free(vector);
+  if(!result) return FALSE;
+
+  inf_test_retire_users_sync(test);
+  g_object_set(G_OBJECT(test->c), "status", INF_USER_UNAVAILABLE, NULL);
+  inf_test_retire_users_sync(test);
+
+  if(!inf_test_retire_users_check_log_empty(test->c, error))
+    return FALSE;
+  if(!inf_test_retire_users_check_buffer(test, "c", error))
+    return FALSE;
+
+  /* A request which has not seen C's change would need C's request to be
+   * transformed, but that is gone. This must be rejected instead of being
+   * translated. */
+  vector = inf_adopted_state_vector_new();
+  local_error = NULL;
+  result = inf_test_retire_users_insert(
+    test,
+    test->a,
+    vector,
+    0,
+    "x",
+    &local_error
+  );
+
+  inf_adopted_state_vector_free(vector);
+
+  if(result == TRUE)
+  {
+    g_set_error(
+      error,
+      inf_test_retire_users_error(),
+      2,
+      "Request not including the retired user's change was accepted"
+    );
+
+    return FALSE;
+  }
+
+  g_error_free(local_error);
+  if(!inf_test_retire_users_check_buffer(test, "c", error))
+    return FALSE;
+
+  printf(" OK\n");
+
+  /* Concurrent requests of the remaining users are transformed against each
+   * other, and cleanup still works with C retired. */
+  printf("cleanup-with-retired...");
+
+  vector = inf_adopted_state_vector_copy(
+    inf_adopted_algorithm_get_current(test->algorithm)
+  );
+
+  result = inf_test_retire_users_insert(test, test->a, vector, 0, "a", error);
+  if(result)
+    result = inf_test_retire_users_insert(test, test->b, vector, 1, "b", error);
+
+  inf_adopted_state_vector_free(vector);
+  if(!result) return FALSE;
+
+  if(!inf_test_retire_users_check_buffer(test, "acb", error))
+    return FALSE;
+
+  inf_test_retire_users_sync(test);
+
+  /* If the least common predecessor computed during cleanup lost the
+   * component of the retired user, then no request would be causally
+   * before it, and nothing would be removed. */
+  if(!inf_test_retire_users_check_log_empty(test->a, error) ||
+     !inf_test_retire_users_check_log_empty(test->b, error))
+  {
+    return FALSE;
+  }
+
+  printf(" OK\n");
+
+  /* C comes back and makes a change concurrently to A and B. C is
+   * reactivated when its request is executed, so that the concurrent
+   * requests are transformed against it. */
+  printf("reactivate-by-request...");
+
+  g_object_set(G_OBJECT(test->c), "status", INF_USER_ACTIVE, NULL);
+  inf_adopted_user_set_vector(
+    test->c,
+    inf_adopted_state_vector_copy(
+      inf_adopted_algorithm_get_current(test->algorithm)
+    )
+  );
+
+  vector = inf_adopted_state_vector_copy(
+    inf_adopted_algorithm_get_current(test->algorithm)
+  );
+
+  result = inf_test_retire_users_insert(test, test->c, vector, 3, "C", error);
+  if(result)
+    result = inf_test_retire_users_insert(test, test->a, vector, 0, "A", error);
+  if(result)
+    result = inf_test_retire_users_insert(test, test->b, vector, 2, "B", error);
+
+  inf_adopted_state_vector_free(vector);
+  if(!result) return FALSE;
+
+  if(!inf_test_retire_users_check_buffer(test, "AacBbC", error))
+    return FALSE;
+
+  printf(" OK\n");
+
+  /* C leaves and is retired again. When it comes back, cleanup reactivates
+   * it. Its next request needs to be kept until everybody has seen it. */
+  printf("reactivate-by-cleanup...");
+
+  inf_test_retire_users_sync(test);
+  g_object_set(G_OBJECT(test->c), "status", INF_USER_UNAVAILABLE, NULL);
+  inf_test_retire_users_sync(test);
+
+  if(!inf_test_retire_users_check_log_empty(test->c, error))
+    return FALSE;
+
+  g_object_set(G_OBJECT(test->c), "status", INF_USER_ACTIVE, NULL);
+  inf_test_retire_users_sync(test);
+
+  vector = inf_adopted_state_vector_copy(
+    inf_adopted_algorithm_get_current(test->algorithm)
+  );
+
+  result = inf_test_retire_users_insert(test, test->c, vector, 0, "1", error);
+  inf_adopted_state_vector_free(vector);
+  if(!result) return FALSE;
+
+  /* A has not yet seen C's request, so it must stay in the log */
+  inf_adopted_algorithm_cleanup(test->algorithm);
+
+  vector = inf_adopted_state_vector_copy(inf_adopted_user_get_vector(test->a));
+  result = inf_test_retire_users_insert(test, test->a, vector, 6, "2", error);
+  inf_adopted_state_vector_free(vector);
+  if(!result) return FALSE;
+
+  if(!inf_test_retire_users_check_buffer(test, "1AacBbC2", error))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  InfTestRetireUsers test;
+  GError* error;
+  int res;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  test.buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  test.user_table = inf_user_table_new();
+  test.a = inf_test_retire_users_add_user(test.user_table, 1, "A");
+  test.b = inf_test_retire_users_add_user(test.user_table, 2, "B");
+  test.c = inf_test_retire_users_add_user(test.user_table, 3, "C");
+
+  /* Remove every request as soon as everybody has processed it */
+  test.algorithm = inf_adopted_algorithm_new_full(
+    test.user_table,
+    INF_BUFFER(test.buffer),
+    0
+  );
+
+  res = EXIT_SUCCESS;
+  if(!inf_test_retire_users_run(&test, &error))
+  {
+    printf(" %s\n", error->message);
+    g_error_free(error);
+    res = EXIT_FAILURE;
+  }
+
+  g_object_unref(test.algorithm);
+  g_object_unref(test.user_table);
+  g_object_unref(test.buffer);
+  inf_deinit();
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */
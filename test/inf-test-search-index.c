@@ -0,0 +1,358 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Builds the search index of the infinoted search plugin over a generated
+ * corpus, and reports how long it takes to index, save, load and query it.
+ * Query results are checked against a brute-force search. */
+
+#include <infinoted/plugins/util/infinoted-plugin-util-search-index.h>
+
+#include <glib/gstdio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define N_VOCABULARY 20000
+#define N_QUERIES 1000
+
+typedef struct _InfTestSearchIndexDocument InfTestSearchIndexDocument;
+struct _InfTestSearchIndexDocument {
+  gchar* path;
+  GString* text;
+  GHashTable* words; /* word number + 1 */
+};
+
+/* Word frequencies roughly follow a power law, like in natural text */
+static guint
+inf_test_search_index_random_word(GRand* rand)
+{
+  gdouble r;
+  r = g_rand_double(rand);
+  return (guint)(r * r * r * N_VOCABULARY);
+}
+
+static gchar**
+inf_test_search_index_make_vocabulary(GRand* rand)
+{
+  gchar** vocabulary;
+  GString* word;
+  guint len;
+  guint i;
+  guint j;
+
+  vocabulary = g_new(gchar*, N_VOCABULARY + 1);
+  word = g_string_sized_new(16);
+
+  for(i = 0; i < N_VOCABULARY; ++i)
+  {
+    /* Make words unique by appending the number */
+    g_string_truncate(word, 0);
+    len = g_rand_int_range(rand, 2, 9);
+    for(j = 0; j < len; ++j)
+      g_string_append_c(word, 'a' + g_rand_int_range(rand, 0, 26));
+    g_string_append_printf(word, "%u", i);
+
+    vocabulary[i] = g_strdup(word->str);
+  }
+
+  vocabulary[N_VOCABULARY] = NULL;
+  g_string_free(word, TRUE);
+  return vocabulary;
+}
+
+static gboolean
+inf_test_search_index_matches(InfTestSearchIndexDocument* document,
+                              const guint* query,
+                              guint n_query)
+{
+  guint i;
+
+  for(i = 0; i < n_query; ++i)
+    if(!g_hash_table_lookup(document->words, GUINT_TO_POINTER(query[i] + 1)))
+      return FALSE;
+
+  return TRUE;
+}
+
+int main(int argc, char* argv[])
+{
+  InfinotedPluginUtilSearchIndex* index;
+  InfinotedPluginUtilSearchIndex* loaded;
+  InfinotedPluginUtilSearchTerms* terms;
+  InfTestSearchIndexDocument* documents;
+  GRand* rand;
+  gchar** vocabulary;
+  guint n_documents;
+  guint n_words;
+  guint query[3];
+  guint n_query;
+  GString* query_text;
+  gchar** results;
+  gchar** loaded_results;
+  guint n_expected;
+  guint n_results;
+  guint word;
+  guint i;
+  guint j;
+  gint64 begin;
+  gint64 query_time;
+  gchar* filename;
+  GStatBuf statbuf;
+  GError* error;
+  int fd;
+  int ret;
+
+  n_documents = 10000;
+  n_words = 1000;
+  if(argc > 1) n_documents = strtoul(argv[1], NULL, 10);
+  if(argc > 2) n_words = strtoul(argv[2], NULL, 10);
+
+  if(n_documents == 0 || n_words == 0)
+  {
+    fprintf(
+      stderr,
+      "Usage: %s [<documents> [<words-per-document>]]\n",
+      argv[0]
+    );
+
+    return -1;
+  }
+
+  rand = g_rand_new_with_seed(42);
+  vocabulary = inf_test_search_index_make_vocabulary(rand);
+
+  documents = g_new(InfTestSearchIndexDocument, n_documents);
+  for(i = 0; i < n_documents; ++i)
+  {
+    documents[i].path = g_strdup_printf("/dir%u/doc%u", i % 100, i);
+    documents[i].text = g_string_sized_new(n_words * 8);
+    documents[i].words = g_hash_table_new(NULL, NULL);
+
+    for(j = 0; j < n_words; ++j)
+    {
+      word = inf_test_search_index_random_word(rand);
+      g_hash_table_insert(
+        documents[i].words,
+        GUINT_TO_POINTER(word + 1),
+        GUINT_TO_POINTER(word + 1)
+      );
+
+      /* Mix case and punctuation, the tokenizer has to handle them */
+      if(j % 10 == 0)
+      {
+        g_string_append_c(
+          documents[i].text,
+          g_ascii_toupper(vocabulary[word][0])
+        );
+
+        g_string_append(documents[i].text, vocabulary[word] + 1);
+        g_string_append(documents[i].text, ".\n");
+      }
+      else
+      {
+        g_string_append(documents[i].text, vocabulary[word]);
+        g_string_append_c(documents[i].text, ' ');
+      }
+    }
+  }
+
+  /* Index the documents in chunks, like the plugin does with the segments
+   * of a text buffer, so that words are cut between calls. */
+  index = infinoted_plugin_util_search_index_new();
+  begin = g_get_monotonic_time();
+  for(i = 0; i < n_documents; ++i)
+  {
+    terms = infinoted_plugin_util_search_terms_new();
+    for(j = 0; j < documents[i].text->len; j += 61)
+    {
+      infinoted_plugin_util_search_terms_add_text(
+        terms,
+        documents[i].text->str + j,
+        MIN(61, documents[i].text->len - j)
+      );
+    }
+
+    infinoted_plugin_util_search_index_set_document(
+      index,
+      documents[i].path,
+      i,
+      terms
+    );
+  }
+
+  printf(
+    "Indexed %u documents with %u words each in %.3f ms\n",
+    n_documents,
+    n_words,
+    (g_get_monotonic_time() - begin) / 1000.
+  );
+
+  error = NULL;
+  fd = g_file_open_tmp("inf-test-search-index-XXXXXX", &filename, &error);
+  if(fd == -1)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  close(fd);
+
+  begin = g_get_monotonic_time();
+  if(!infinoted_plugin_util_search_index_save(index, filename, &error))
+  {
+    fprintf(stderr, "Failed to save index: %s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  g_stat(filename, &statbuf);
+  printf(
+    "Saved index (%ld bytes) in %.3f ms\n",
+    (long)statbuf.st_size,
+    (g_get_monotonic_time() - begin) / 1000.
+  );
+
+  loaded = infinoted_plugin_util_search_index_new();
+  begin = g_get_monotonic_time();
+  if(!infinoted_plugin_util_search_index_load(loaded, filename, &error))
+  {
+    fprintf(stderr, "Failed to load index: %s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  printf(
+    "Loaded index in %.3f ms\n",
+    (g_get_monotonic_time() - begin) / 1000.
+  );
+
+  g_unlink(filename);
+  g_free(filename);
+
+  ret = 0;
+  query_time = 0;
+  query_text = g_string_sized_new(64);
+  for(i = 0; i < N_QUERIES && ret == 0; ++i)
+  {
+    n_query = g_rand_int_range(rand, 1, 4);
+    g_string_truncate(query_text, 0);
+    for(j = 0; j < n_query; ++j)
+    {
+      query[j] = inf_test_search_index_random_word(rand);
+      g_string_append(query_text, vocabulary[query[j]]);
+      g_string_append_c(query_text, ' ');
+    }
+
+    begin = g_get_monotonic_time();
+    results = infinoted_plugin_util_search_index_query(
+      index,
+      query_text->str,
+      0
+    );
+    query_time += g_get_monotonic_time() - begin;
+
+    n_expected = 0;
+    for(j = 0; j < n_documents; ++j)
+      if(inf_test_search_index_matches(&documents[j], query, n_query))
+        ++n_expected;
+
+    n_results = g_strv_length(results);
+    loaded_results = infinoted_plugin_util_search_index_query(
+      loaded,
+      query_text->str,
+      0
+    );
+
+    if(n_results != n_expected)
+    {
+      fprintf(
+        stderr,
+        "Query \"%s\": expected %u results, got %u\n",
+        query_text->str,
+        n_expected,
+        n_results
+      );
+
+      ret = -1;
+    }
+    else if(g_strv_length(loaded_results) != n_results)
+    {
+      fprintf(
+        stderr,
+        "Query \"%s\": loaded index returned %u results instead of %u\n",
+        query_text->str,
+        g_strv_length(loaded_results),
+        n_results
+      );
+
+      ret = -1;
+    }
+    else
+    {
+      for(j = 0; j < n_results; ++j)
+      {
+        if(strcmp(results[j], loaded_results[j]) != 0)
+        {
+          fprintf(
+            stderr,
+            "Query \"%s\": loaded index returned different documents\n",
+            query_text->str
+          );
+
+          ret = -1;
+          break;
+        }
+      }
+    }
+
+    g_strfreev(loaded_results);
+    g_strfreev(results);
+  }
+
+  if(ret == 0)
+  {
+    printf(
+      "Ran %u queries in %.3f ms (avg %.3f ms)\n",
+      N_QUERIES,
+      query_time / 1000.,
+      query_time / 1000. / N_QUERIES
+    );
+  }
+
+  g_string_free(query_text, TRUE);
+  infinoted_plugin_util_search_index_free(loaded);
+  infinoted_plugin_util_search_index_free(index);
+
+  for(i = 0; i < n_documents; ++i)
+  {
+    g_hash_table_destroy(documents[i].words);
+    g_string_free(documents[i].text, TRUE);
+    g_free(documents[i].path);
+  }
+
+  g_free(documents);
+  g_strfreev(vocabulary);
+  g_rand_free(rand);
+  return ret;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,261 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks that dispatches of InfStandaloneIo can be removed from other
+ * threads while the loop is running them, and that each dispatch is then
+ * either run or removed, but never both, and released exactly once. */
+
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_THREADS 4
+#define N_DISPATCHES 20000
+
+typedef struct _InfTestStandaloneIo InfTestStandaloneIo;
+
+typedef struct _InfTestStandaloneIoRecord InfTestStandaloneIoRecord;
+struct _InfTestStandaloneIoRecord {
+  InfTestStandaloneIo* test;
+
+  /* Protected by the test's mutex. Cleared when the dispatch runs or is
+   * removed, so that it is never removed after it has been freed, which is
+   * how users of inf_io_remove_dispatch() keep track of it. */
+  InfIoDispatch* dispatch;
+
+  gint n_run;
+  gint n_removed;
+  gint n_notified;
+};
+
+struct _InfTestStandaloneIo {
+  InfStandaloneIo* io;
+  GMutex mutex;
+
+  InfTestStandaloneIoRecord* records;
+  gint n_threads_running;
+};
+
+typedef struct _InfTestStandaloneIoThread InfTestStandaloneIoThread;
+struct _InfTestStandaloneIoThread {
+  InfTestStandaloneIo* test;
+  guint first;
+  guint count;
+};
+
+static void
+inf_test_standalone_io_dispatch_func(gpointer user_data)
+{
+  InfTestStandaloneIoRecord* record;
+  record = (InfTestStandaloneIoRecord*)user_data;
+
+  /* If the dispatch was removed after the loop took it off the queue, then
+   * it is still run, and needs to check whether it is still wanted. */
+  g_mutex_lock(&record->test->mutex);
+  if(record->dispatch != NULL)
+  {
+    record->dispatch = NULL;
+    ++record->n_run;
+  }
+  g_mutex_unlock(&record->test->mutex);
+}
+
+static void
+inf_test_standalone_io_dispatch_notify(gpointer user_data)
+{
+  InfTestStandaloneIoRecord* record;
+  record = (InfTestStandaloneIoRecord*)user_data;
+
+  g_atomic_int_inc(&record->n_notified);
+}
+
+static void
+inf_test_standalone_io_quit_func(gpointer user_data)
+{
+  inf_standalone_io_loop_quit(INF_STANDALONE_IO(user_data));
+}
+
+static gpointer
+inf_test_standalone_io_thread_func(gpointer user_data)
+{
+  InfTestStandaloneIoThread* thread;
+  InfTestStandaloneIo* test;
+  InfTestStandaloneIoRecord* record;
+  guint i;
+
+  thread = (InfTestStandaloneIoThread*)user_data;
+  test = thread->test;
+
+  /* Remove every other dispatch right after adding it, so that removals
+   * race with the loop taking the same dispatch off the queue. */
+  for(i = thread->first; i < thread->first + thread->count; ++i)
+  {
+    record = &test->records[i];
+
+    g_mutex_lock(&test->mutex);
+    record->dispatch = inf_io_add_dispatch(
+      INF_IO(test->io),
+      inf_test_standalone_io_dispatch_func,
+      record,
+      inf_test_standalone_io_dispatch_notify
+    );
+    g_mutex_unlock(&test->mutex);
+
+    if(i % 2 == 1)
+    {
+      g_mutex_lock(&test->mutex);
+      if(record->dispatch != NULL)
+      {
+        inf_io_remove_dispatch(INF_IO(test->io), record->dispatch);
+        record->dispatch = NULL;
+        ++record->n_removed;
+      }
+      g_mutex_unlock(&test->mutex);
+    }
+  }
+
+  /* The last thread to finish stops the loop. Dispatches are run in the
+   * order they were added, so all others have been run by then. */
+  if(g_atomic_int_dec_and_test(&test->n_threads_running))
+  {
+    inf_io_add_dispatch(
+      INF_IO(test->io),
+      inf_test_standalone_io_quit_func,
+      test->io,
+      NULL
+    );
+  }
+
+  return NULL;
+}
+
+static gboolean
+inf_test_standalone_io_remove_dispatch(void)
+{
+  InfTestStandaloneIo test;
+  InfTestStandaloneIoThread threads[N_THREADS];
+  GThread* handles[N_THREADS];
+  InfTestStandaloneIoRecord* record;
+  guint n_run;
+  guint n_removed;
+  guint i;
+  gboolean result;
+
+  printf("remove-dispatch...");
+
+  test.io = inf_standalone_io_new();
+  g_mutex_init(&test.mutex);
+  test.records = g_new0(InfTestStandaloneIoRecord, N_THREADS * N_DISPATCHES);
+  test.n_threads_running = N_THREADS;
+
+  for(i = 0; i < N_THREADS * N_DISPATCHES; ++i)
+    test.records[i].test = &test;
+
+  for(i = 0; i < N_THREADS; ++i)
+  {
+    threads[i].test = &test;
+    threads[i].first = i * N_DISPATCHES;
+    threads[i].count = N_DISPATCHES;
+
+    handles[i] = g_thread_new(
+      "inf-test-standalone-io",
+      inf_test_standalone_io_thread_func,
+      &threads[i]
+    );
+  }
+
+  inf_standalone_io_loop(test.io);
+
+  for(i = 0; i < N_THREADS; ++i)
+    g_thread_join(handles[i]);
+
+  result = TRUE;
+  n_run = 0;
+  n_removed = 0;
+
+  for(i = 0; i < N_THREADS * N_DISPATCHES && result; ++i)
+  {
+    record = &test.records[i];
+
+    if(record->n_run + record->n_removed != 1)
+    {
+      printf(
+        " Dispatch %u was run %d times and removed %d times\n",
+        i,
+        record->n_run,
+        record->n_removed
+      );
+
+      result = FALSE;
+    }
+    else if(record->n_notified != 1)
+    {
+      printf(
+        " Dispatch %u was released %d times\n",
+        i,
+        record->n_notified
+      );
+
+      result = FALSE;
+    }
+
+    n_run += record->n_run;
+    n_removed += record->n_removed;
+  }
+
+  if(result)
+  {
+    printf(
+      " OK (%u dispatches run, %u removed)\n",
+      n_run,
+      n_removed
+    );
+  }
+
+  g_free(test.records);
+  g_mutex_clear(&test.mutex);
+  g_object_unref(test.io);
+  return result;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  GError* error;
+  int res;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  res = EXIT_SUCCESS;
+  if(!inf_test_standalone_io_remove_dispatch()) res = EXIT_FAILURE;
+
+  inf_deinit();
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */
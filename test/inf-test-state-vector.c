@@ -50,7 +50,7 @@ static void cmp(const char* should_be, InfAdoptedStateVector* vec) {
 #define apply(op, args) inf_adopted_state_vector_##op args
 
 static void l_test() {
-  InfAdoptedStateVector* vec, * vec_;
+  InfAdoptedStateVector* vec, * vec_, * vec2;
   int i;
   char* str;
 
@@ -125,6 +125,38 @@ static void l_test() {
 
   apply(free, (vec));
   apply(free, (vec_));
+
+  /* diff round trip with many components */
+  vec = apply(new, ());
+  for (i = 1; i <= 300; ++i)
+    apply(set, (vec, i * 3, i));
+
+  vec_ = apply(copy, (vec));
+  for (i = 1; i <= 300; i += 7)
+    apply(add, (vec_, i * 3, 2));
+  apply(add, (vec_, 1, 1));
+  apply(add, (vec_, 1000, 5));
+
+  str = apply(to_string_diff, (vec_, vec));
+  vec2 = apply(from_string_diff, (str, vec, NULL));
+  g_free(str);
+  g_assert(vec2 != NULL);
+  g_assert(apply(compare, (vec2, vec_)) == 0);
+
+  apply(free, (vec2));
+  apply(free, (vec_));
+  apply(free, (vec));
+
+  /* unsorted diffs are accepted, duplicate IDs are not */
+  vec = apply(from_string, ("2:3", NULL));
+  vec_ = apply(from_string_diff, ("5:1;2:1", vec, NULL));
+  g_assert(vec_ != NULL);
+  cmp("2:4;5:1", vec_);
+  apply(free, (vec_));
+
+  g_assert(apply(from_string_diff, ("2:1;2:1", vec, NULL)) == NULL);
+  g_assert(apply(from_string_diff, ("2;5:1", vec, NULL)) == NULL);
+  apply(free, (vec));
 }
 
 int main(int argc, char* argv[])
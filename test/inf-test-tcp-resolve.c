@@ -0,0 +1,865 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks the lookup cache of InfNameResolver, and how InfTcpConnection races
+ * connection attempts to multiple resolved addresses. The connection tests
+ * only use the loopback interface. A connection attempt is delayed by
+ * connecting to a listening socket whose backlog is full, so that the
+ * connection request is dropped and only retransmitted after a second.
+ * Depending on whether the backlog is emptied or the socket is closed in the
+ * meanwhile, the retransmitted request succeeds or fails. */
+
+#include <libinfinity/common/inf-name-resolver.h>
+#include <libinfinity/common/inf-name-resolver-private.h>
+#include <libinfinity/common/inf-tcp-connection.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-ip-address.h>
+#include <libinfinity/common/inf-init.h>
+#include <libinfinity/inf-signals.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Time in milliseconds after which a test gives up waiting */
+#define INF_TEST_TCP_RESOLVE_WAIT 5000
+
+typedef struct _InfTestTcpResolveListener InfTestTcpResolveListener;
+struct _InfTestTcpResolveListener {
+  int socket;
+  int filler;
+  guint port;
+};
+
+typedef struct _InfTestTcpResolveConnection InfTestTcpResolveConnection;
+struct _InfTestTcpResolveConnection {
+  InfTcpConnection* connection;
+  gboolean connected;
+  guint n_errors;
+  gint64 started;
+  gint64 finished;
+};
+
+static void
+inf_test_tcp_resolve_resolved_cb(InfNameResolver* resolver,
+                                 const GError* error,
+                                 gpointer user_data)
+{
+  ++*(guint*)user_data;
+}
+
+/* Runs io until *counter becomes nonzero, or until the waiting time is
+ * over. */
+static gboolean
+inf_test_tcp_resolve_wait(InfStandaloneIo* io,
+                          const guint* counter,
+                          guint msecs)
+{
+  gint64 deadline;
+
+  deadline = g_get_monotonic_time() + (gint64)msecs * 1000;
+  while(*counter == 0 && g_get_monotonic_time() < deadline)
+    inf_standalone_io_iteration_timeout(io, 50);
+
+  return *counter != 0;
+}
+
+/* Resolves hostname and service and returns the first address found, or
+ * NULL on error. Also checks that the result is reported asynchronously. */
+static gchar*
+inf_test_tcp_resolve_lookup(InfStandaloneIo* io,
+                            const gchar* hostname,
+                            const gchar* service)
+{
+  InfNameResolver* resolver;
+  guint n_resolved;
+  gchar* address;
+
+  resolver = inf_name_resolver_new(INF_IO(io), hostname, service, NULL);
+  n_resolved = 0;
+
+  g_signal_connect(
+    G_OBJECT(resolver),
+    "resolved",
+    G_CALLBACK(inf_test_tcp_resolve_resolved_cb),
+    &n_resolved
+  );
+
+  address = NULL;
+  if(inf_name_resolver_start(resolver, NULL) &&
+     n_resolved == 0 &&
+     inf_name_resolver_finished(resolver) == FALSE &&
+     inf_test_tcp_resolve_wait(io, &n_resolved, INF_TEST_TCP_RESOLVE_WAIT) &&
+     inf_name_resolver_get_n_addresses(resolver) > 0)
+  {
+    address = inf_ip_address_to_string(
+      inf_name_resolver_get_address(resolver, 0)
+    );
+  }
+
+  g_object_unref(resolver);
+  return address;
+}
+
+static gboolean
+inf_test_tcp_resolve_expect(InfStandaloneIo* io,
+                            const gchar* hostname,
+                            const gchar* service,
+                            const gchar* expected)
+{
+  gchar* address;
+  gboolean result;
+
+  address = inf_test_tcp_resolve_lookup(io, hostname, service);
+  result = address != NULL && strcmp(address, expected) == 0;
+
+  if(!result)
+  {
+    printf(
+      " %s:%s resolved to %s instead of %s\n",
+      hostname,
+      service,
+      address != NULL ? address : "nothing",
+      expected
+    );
+  }
+
+  g_free(address);
+  return result;
+}
+
+/* Adds an entry to the cache which makes hostname resolve to 127.0.0.2.
+ * Looking up numeric 127.0.0.1 in the cache therefore shows whether the
+ * result came from the cache, without querying DNS. */
+static void
+inf_test_tcp_resolve_add_to_cache(const gchar* hostname,
+                                  const gchar* service)
+{
+  InfIpAddress* address;
+  guint port;
+
+  address = inf_ip_address_new_from_string("127.0.0.2");
+  port = 6523;
+
+  _inf_name_resolver_add_to_cache(
+    hostname,
+    service,
+    NULL,
+    (const InfIpAddress* const*)&address,
+    &port,
+    1,
+    NULL,
+    0,
+    0
+  );
+
+  inf_ip_address_free(address);
+}
+
+static gboolean
+inf_test_tcp_resolve_cache_hit(InfStandaloneIo* io)
+{
+  InfNameResolver* resolver;
+  guint n_resolved;
+  gboolean result;
+
+  printf("cache-hit...");
+  _inf_name_resolver_reset_cache(60, 256);
+
+  inf_test_tcp_resolve_add_to_cache("127.0.0.1", "1");
+
+  /* The lookup helper checks that the result is delivered in a later
+   * iteration of the InfIo, as for a lookup that is not cached. */
+  result = inf_test_tcp_resolve_expect(io, "127.0.0.1", "1", "127.0.0.2");
+
+  /* Different services are cached separately */
+  result = result &&
+    inf_test_tcp_resolve_expect(io, "127.0.0.1", "2", "127.0.0.1");
+
+  /* Disposing the resolver while the result is pending cancels it */
+  if(result)
+  {
+    resolver = inf_name_resolver_new(INF_IO(io), "127.0.0.1", "1", NULL);
+    n_resolved = 0;
+
+    g_signal_connect(
+      G_OBJECT(resolver),
+      "resolved",
+      G_CALLBACK(inf_test_tcp_resolve_resolved_cb),
+      &n_resolved
+    );
+
+    inf_name_resolver_start(resolver, NULL);
+    g_object_unref(resolver);
+
+    inf_standalone_io_iteration_timeout(io, 50);
+    if(n_resolved != 0)
+    {
+      printf(" Result was reported for a disposed resolver\n");
+      result = FALSE;
+    }
+  }
+
+  if(result) printf(" OK\n");
+  return result;
+}
+
+static gboolean
+inf_test_tcp_resolve_cache_expiry(InfStandaloneIo* io)
+{
+  gboolean result;
+
+  printf("cache-expiry...");
+  _inf_name_resolver_reset_cache(1, 256);
+
+  inf_test_tcp_resolve_add_to_cache("127.0.0.1", "1");
+  result = inf_test_tcp_resolve_expect(io, "127.0.0.1", "1", "127.0.0.2");
+
+  if(result)
+  {
+    g_usleep(1100 * 1000);
+    result = inf_test_tcp_resolve_expect(io, "127.0.0.1", "1", "127.0.0.1");
+  }
+
+  if(result) printf(" OK\n");
+  return result;
+}
+
+static gboolean
+inf_test_tcp_resolve_cache_eviction(InfStandaloneIo* io)
+{
+  gboolean result;
+
+  printf("cache-eviction...");
+
+  /* Results which are still valid are not evicted for new ones */
+  _inf_name_resolver_reset_cache(60, 2);
+  inf_test_tcp_resolve_add_to_cache("127.0.0.1", "1");
+  inf_test_tcp_resolve_add_to_cache("127.0.0.1", "2");
+  inf_test_tcp_resolve_add_to_cache("127.0.0.1", "3");
+
+  result =
+    inf_test_tcp_resolve_expect(io, "127.0.0.1", "1", "127.0.0.2") &&
+    inf_test_tcp_resolve_expect(io, "127.0.0.1", "2", "127.0.0.2") &&
+    inf_test_tcp_resolve_expect(io, "127.0.0.1", "3", "127.0.0.1");
+
+  /* Expired results make room for new ones */
+  if(result)
+  {
+    _inf_name_resolver_reset_cache(1, 2);
+    inf_test_tcp_resolve_add_to_cache("127.0.0.1", "1");
+    inf_test_tcp_resolve_add_to_cache("127.0.0.1", "2");
+
+    g_usleep(1100 * 1000);
+    inf_test_tcp_resolve_add_to_cache("127.0.0.1", "3");
+
+    result =
+      inf_test_tcp_resolve_expect(io, "127.0.0.1", "3", "127.0.0.2") &&
+      inf_test_tcp_resolve_expect(io, "127.0.0.1", "1", "127.0.0.1");
+  }
+
+  if(result) printf(" OK\n");
+  return result;
+}
+
+/* Creates a socket listening on the loopback interface. If full is TRUE,
+ * then its backlog is filled so that further connection requests are
+ * dropped. */
+static InfTestTcpResolveListener*
+inf_test_tcp_resolve_listener_new(gboolean full)
+{
+  InfTestTcpResolveListener* listener;
+  struct sockaddr_in addr;
+  socklen_t len;
+
+  listener = g_slice_new(InfTestTcpResolveListener);
+  listener->socket = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+  listener->filler = -1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+
+  len = sizeof(addr);
+  if(bind(listener->socket, (struct sockaddr*)&addr, len) != 0 ||
+     getsockname(listener->socket, (struct sockaddr*)&addr, &len) != 0 ||
+     listen(listener->socket, 0) != 0)
+  {
+    g_error("Failed to create listening socket");
+  }
+
+  listener->port = ntohs(addr.sin_port);
+
+  if(full)
+  {
+    listener->filler = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if(connect(listener->filler, (struct sockaddr*)&addr, len) != 0)
+      g_error("Failed to fill backlog of listening socket");
+  }
+
+  return listener;
+}
+
+static void
+inf_test_tcp_resolve_listener_free(InfTestTcpResolveListener* listener)
+{
+  if(listener->filler != -1) close(listener->filler);
+  if(listener->socket != -1) close(listener->socket);
+  g_slice_free(InfTestTcpResolveListener, listener);
+}
+
+/* Empties the backlog, so that the next connection request succeeds */
+static void
+inf_test_tcp_resolve_listener_release_func(gpointer user_data)
+{
+  InfTestTcpResolveListener* listener;
+  int accepted;
+
+  listener = (InfTestTcpResolveListener*)user_data;
+
+  accepted = accept(listener->socket, NULL, NULL);
+  if(accepted != -1) close(accepted);
+
+  close(listener->filler);
+  listener->filler = -1;
+}
+
+/* Closes the socket, so that the next connection request is refused */
+static void
+inf_test_tcp_resolve_listener_close_func(gpointer user_data)
+{
+  InfTestTcpResolveListener* listener;
+  listener = (InfTestTcpResolveListener*)user_data;
+
+  close(listener->filler);
+  close(listener->socket);
+  listener->filler = -1;
+  listener->socket = -1;
+}
+
+/* Returns a port on the loopback interface which refuses connections */
+static guint
+inf_test_tcp_resolve_closed_port(void)
+{
+  InfTestTcpResolveListener* listener;
+  guint port;
+
+  listener = inf_test_tcp_resolve_listener_new(FALSE);
+  port = listener->port;
+  inf_test_tcp_resolve_listener_free(listener);
+
+  return port;
+}
+
+static void
+inf_test_tcp_resolve_error_cb(InfTcpConnection* connection,
+                              const GError* error,
+                              gpointer user_data)
+{
+  InfTestTcpResolveConnection* test;
+  test = (InfTestTcpResolveConnection*)user_data;
+
+  ++test->n_errors;
+  test->finished = g_get_monotonic_time();
+}
+
+static void
+inf_test_tcp_resolve_notify_status_cb(GObject* object,
+                                      GParamSpec* pspec,
+                                      gpointer user_data)
+{
+  InfTestTcpResolveConnection* test;
+  InfTcpConnectionStatus status;
+
+  test = (InfTestTcpResolveConnection*)user_data;
+  g_object_get(object, "status", &status, NULL);
+
+  if(status == INF_TCP_CONNECTION_CONNECTED)
+  {
+    test->connected = TRUE;
+    test->finished = g_get_monotonic_time();
+  }
+}
+
+/* Makes hostname resolve to 127.0.0.1 with the given ports, and to the
+ * backup port on 127.0.0.1 if that is nonzero, and opens a connection to it.
+ * The name resolver reports its results to resolver_io. */
+static gboolean
+inf_test_tcp_resolve_connect(InfTestTcpResolveConnection* test,
+                             InfStandaloneIo* io,
+                             InfStandaloneIo* resolver_io,
+                             const gchar* hostname,
+                             const guint* ports,
+                             guint n_ports,
+                             guint backup_port)
+{
+  static const gchar* const backup_targets[] = { "127.0.0.1" };
+
+  InfIpAddress* loopback;
+  const InfIpAddress** addresses;
+  InfNameResolver* resolver;
+  GError* error;
+  guint i;
+
+  loopback = inf_ip_address_new_from_string("127.0.0.1");
+  addresses = g_new(const InfIpAddress*, n_ports);
+  for(i = 0; i < n_ports; ++i)
+    addresses[i] = loopback;
+
+  _inf_name_resolver_add_to_cache(
+    hostname,
+    NULL,
+    NULL,
+    addresses,
+    ports,
+    n_ports,
+    backup_port != 0 ? backup_targets : NULL,
+    backup_port,
+    backup_port != 0 ? 1 : 0
+  );
+
+  g_free(addresses);
+  inf_ip_address_free(loopback);
+
+  resolver = inf_name_resolver_new(INF_IO(resolver_io), hostname, NULL, NULL);
+  test->connection = inf_tcp_connection_new_resolve(INF_IO(io), resolver);
+  g_object_unref(resolver);
+
+  test->connected = FALSE;
+  test->n_errors = 0;
+  test->started = g_get_monotonic_time();
+  test->finished = 0;
+
+  g_signal_connect(
+    G_OBJECT(test->connection),
+    "error",
+    G_CALLBACK(inf_test_tcp_resolve_error_cb),
+    test
+  );
+
+  g_signal_connect(
+    G_OBJECT(test->connection),
+    "notify::status",
+    G_CALLBACK(inf_test_tcp_resolve_notify_status_cb),
+    test
+  );
+
+  error = NULL;
+  if(!inf_tcp_connection_open(test->connection, &error))
+  {
+    printf(" %s\n", error->message);
+    g_error_free(error);
+    g_object_unref(test->connection);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+inf_test_tcp_resolve_disconnect(InfTestTcpResolveConnection* test)
+{
+  InfTcpConnectionStatus status;
+
+  g_object_get(G_OBJECT(test->connection), "status", &status, NULL);
+  if(status != INF_TCP_CONNECTION_CLOSED)
+    inf_tcp_connection_close(test->connection);
+
+  g_object_unref(test->connection);
+}
+
+/* Runs io until the connection is established or has failed */
+static void
+inf_test_tcp_resolve_run(InfTestTcpResolveConnection* test,
+                         InfStandaloneIo* io,
+                         guint msecs)
+{
+  gint64 deadline;
+
+  deadline = g_get_monotonic_time() + (gint64)msecs * 1000;
+  while(!test->connected && test->n_errors == 0 &&
+        g_get_monotonic_time() < deadline)
+  {
+    inf_standalone_io_iteration_timeout(io, 50);
+  }
+}
+
+static gboolean
+inf_test_tcp_resolve_race(InfStandaloneIo* io)
+{
+  InfTestTcpResolveListener* hanging;
+  InfTestTcpResolveListener* working;
+  InfTestTcpResolveConnection test;
+  guint ports[2];
+  gboolean result;
+
+  printf("race...");
+  _inf_name_resolver_reset_cache(60, 256);
+
+  /* The first address does not answer, so the second one is tried before
+   * the first attempt times out. */
+  hanging = inf_test_tcp_resolve_listener_new(TRUE);
+  working = inf_test_tcp_resolve_listener_new(FALSE);
+  ports[0] = hanging->port;
+  ports[1] = working->port;
+
+  result = inf_test_tcp_resolve_connect(
+    &test,
+    io,
+    io,
+    "race.invalid",
+    ports,
+    2,
+    0
+  );
+
+  if(result)
+  {
+    inf_test_tcp_resolve_run(&test, io, INF_TEST_TCP_RESOLVE_WAIT);
+
+    if(!test.connected ||
+       inf_tcp_connection_get_remote_port(test.connection) != ports[1])
+    {
+      printf(" Connection to the second address was not established\n");
+      result = FALSE;
+    }
+    else if(test.finished - test.started > 900 * 1000)
+    {
+      printf(" Second address was not tried before the first timed out\n");
+      result = FALSE;
+    }
+
+    inf_test_tcp_resolve_disconnect(&test);
+  }
+
+  inf_test_tcp_resolve_listener_free(working);
+  inf_test_tcp_resolve_listener_free(hanging);
+
+  if(result) printf(" OK\n");
+  return result;
+}
+
+static gboolean
+inf_test_tcp_resolve_race_winner(InfStandaloneIo* io)
+{
+  InfTestTcpResolveListener* slow;
+  InfTestTcpResolveListener* hanging;
+  InfTestTcpResolveConnection test;
+  InfIoTimeout* timeout;
+  guint ports[2];
+  int accepted;
+  char buf[4];
+  gboolean result;
+
+  printf("race-winner...");
+  _inf_name_resolver_reset_cache(60, 256);
+
+  /* The first attempt succeeds only after the second one has been started,
+   * and while that is still pending. The first attempt then replaces the
+   * second one as the connection's socket. */
+  slow = inf_test_tcp_resolve_listener_new(TRUE);
+  hanging = inf_test_tcp_resolve_listener_new(TRUE);
+  ports[0] = slow->port;
+  ports[1] = hanging->port;
+
+  result = inf_test_tcp_resolve_connect(
+    &test,
+    io,
+    io,
+    "race-winner.invalid",
+    ports,
+    2,
+    0
+  );
+
+  if(result)
+  {
+    timeout = inf_io_add_timeout(
+      INF_IO(io),
+      500,
+      inf_test_tcp_resolve_listener_release_func,
+      slow,
+      NULL
+    );
+
+    inf_test_tcp_resolve_run(&test, io, INF_TEST_TCP_RESOLVE_WAIT);
+    if(slow->filler != -1)
+      inf_io_remove_timeout(INF_IO(io), timeout);
+
+    if(!test.connected ||
+       inf_tcp_connection_get_remote_port(test.connection) != ports[0])
+    {
+      printf(" Connection to the first address was not established\n");
+      result = FALSE;
+    }
+    else
+    {
+      /* Data must go through the socket of the winning attempt */
+      inf_tcp_connection_send(test.connection, "ping", 4);
+      inf_standalone_io_iteration_timeout(io, 50);
+
+      accepted = accept(slow->socket, NULL, NULL);
+      if(accepted == -1 ||
+         recv(accepted, buf, 4, MSG_WAITALL) != 4 ||
+         memcmp(buf, "ping", 4) != 0)
+      {
+        printf(" Data was not sent through the winning connection\n");
+        result = FALSE;
+      }
+
+      if(accepted != -1) close(accepted);
+    }
+
+    inf_test_tcp_resolve_disconnect(&test);
+  }
+
+  inf_test_tcp_resolve_listener_free(hanging);
+  inf_test_tcp_resolve_listener_free(slow);
+
+  if(result) printf(" OK\n");
+  return result;
+}
+
+/* Makes the first attempt fail only after the others have failed already,
+ * and checks that the error is reported once, when the last attempt fails.
+ * If backup is TRUE, then a backup lookup yields one more address which
+ * fails as well. */
+static gboolean
+inf_test_tcp_resolve_all_fail(InfStandaloneIo* io,
+                              gboolean backup)
+{
+  InfTestTcpResolveListener* slow;
+  InfTestTcpResolveConnection test;
+  InfIoTimeout* timeout;
+  guint ports[2];
+  gboolean result;
+
+  printf(backup ? "all-fail-after-backup..." : "all-fail...");
+  _inf_name_resolver_reset_cache(60, 256);
+
+  slow = inf_test_tcp_resolve_listener_new(TRUE);
+  ports[0] = slow->port;
+  ports[1] = inf_test_tcp_resolve_closed_port();
+
+  result = inf_test_tcp_resolve_connect(
+    &test,
+    io,
+    io,
+    backup ? "all-fail-backup.invalid" : "all-fail.invalid",
+    ports,
+    2,
+    backup ? inf_test_tcp_resolve_closed_port() : 0
+  );
+
+  if(result)
+  {
+    timeout = inf_io_add_timeout(
+      INF_IO(io),
+      500,
+      inf_test_tcp_resolve_listener_close_func,
+      slow,
+      NULL
+    );
+
+    inf_test_tcp_resolve_run(&test, io, INF_TEST_TCP_RESOLVE_WAIT);
+    if(slow->socket != -1)
+      inf_io_remove_timeout(INF_IO(io), timeout);
+
+    /* Give a duplicate error the chance to show up */
+    inf_standalone_io_iteration_timeout(io, 100);
+
+    if(test.connected || test.n_errors != 1)
+    {
+      printf(
+        " Expected one error, but got %u%s\n",
+        test.n_errors,
+        test.connected ? " and a connection" : ""
+      );
+
+      result = FALSE;
+    }
+    else if(test.finished - test.started < 700 * 1000)
+    {
+      printf(" Error was reported before the first attempt failed\n");
+      result = FALSE;
+    }
+
+    inf_test_tcp_resolve_disconnect(&test);
+  }
+
+  inf_test_tcp_resolve_listener_free(slow);
+
+  if(result) printf(" OK\n");
+  return result;
+}
+
+/* All attempts fail while the backup lookup is still running. The error
+ * must only be reported once the backup lookup has finished, and the
+ * address it found has failed as well. */
+static gboolean
+inf_test_tcp_resolve_all_fail_during_backup(InfStandaloneIo* io)
+{
+  InfStandaloneIo* resolver_io;
+  InfTestTcpResolveListener* slow;
+  InfTestTcpResolveConnection test;
+  InfNameResolver* resolver;
+  InfIoTimeout* timeout;
+  InfTcpConnectionStatus status;
+  guint ports[2];
+  guint n_resolved;
+  gboolean result;
+
+  printf("all-fail-during-backup...");
+  _inf_name_resolver_reset_cache(60, 256);
+
+  /* The resolver reports to a separate InfIo, so that the result of the
+   * backup lookup is held back until that InfIo is run. */
+  resolver_io = inf_standalone_io_new();
+
+  slow = inf_test_tcp_resolve_listener_new(TRUE);
+  ports[0] = slow->port;
+  ports[1] = inf_test_tcp_resolve_closed_port();
+
+  result = inf_test_tcp_resolve_connect(
+    &test,
+    io,
+    resolver_io,
+    "all-fail-during-backup.invalid",
+    ports,
+    2,
+    inf_test_tcp_resolve_closed_port()
+  );
+
+  if(result)
+  {
+    g_object_get(G_OBJECT(test.connection), "resolver", &resolver, NULL);
+    n_resolved = 0;
+
+    g_signal_connect(
+      G_OBJECT(resolver),
+      "resolved",
+      G_CALLBACK(inf_test_tcp_resolve_resolved_cb),
+      &n_resolved
+    );
+
+    /* Deliver the cached result of the initial lookup */
+    inf_test_tcp_resolve_wait(resolver_io, &n_resolved, 1000);
+    n_resolved = 0;
+
+    timeout = inf_io_add_timeout(
+      INF_IO(io),
+      500,
+      inf_test_tcp_resolve_listener_close_func,
+      slow,
+      NULL
+    );
+
+    /* Both addresses fail within this time, the first one after about a
+     * second. */
+    inf_test_tcp_resolve_run(&test, io, 2000);
+    if(slow->socket != -1)
+      inf_io_remove_timeout(INF_IO(io), timeout);
+
+    g_object_get(G_OBJECT(test.connection), "status", &status, NULL);
+    if(test.connected || test.n_errors != 0 ||
+       status != INF_TCP_CONNECTION_CONNECTING)
+    {
+      printf(" Connection gave up before the backup lookup finished\n");
+      result = FALSE;
+    }
+
+    if(result)
+    {
+      /* Now let the backup lookup finish, and connect to its address */
+      if(!inf_test_tcp_resolve_wait(resolver_io, &n_resolved, 1000))
+      {
+        printf(" Backup lookup did not finish\n");
+        result = FALSE;
+      }
+      else
+      {
+        inf_test_tcp_resolve_run(&test, io, INF_TEST_TCP_RESOLVE_WAIT);
+        inf_standalone_io_iteration_timeout(io, 100);
+
+        if(test.connected || test.n_errors != 1)
+        {
+          printf(" Expected one error, but got %u\n", test.n_errors);
+          result = FALSE;
+        }
+      }
+    }
+
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(resolver),
+      G_CALLBACK(inf_test_tcp_resolve_resolved_cb),
+      &n_resolved
+    );
+
+    g_object_unref(resolver);
+    inf_test_tcp_resolve_disconnect(&test);
+  }
+
+  inf_test_tcp_resolve_listener_free(slow);
+  g_object_unref(resolver_io);
+
+  if(result) printf(" OK\n");
+  return result;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  InfStandaloneIo* io;
+  GError* error;
+  int res;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  io = inf_standalone_io_new();
+  res = EXIT_SUCCESS;
+
+  if(!inf_test_tcp_resolve_cache_hit(io)) res = EXIT_FAILURE;
+  if(!inf_test_tcp_resolve_cache_expiry(io)) res = EXIT_FAILURE;
+  if(!inf_test_tcp_resolve_cache_eviction(io)) res = EXIT_FAILURE;
+  if(!inf_test_tcp_resolve_race(io)) res = EXIT_FAILURE;
+  if(!inf_test_tcp_resolve_race_winner(io)) res = EXIT_FAILURE;
+  if(!inf_test_tcp_resolve_all_fail(io, FALSE)) res = EXIT_FAILURE;
+  if(!inf_test_tcp_resolve_all_fail(io, TRUE)) res = EXIT_FAILURE;
+  if(!inf_test_tcp_resolve_all_fail_during_backup(io)) res = EXIT_FAILURE;
+
+  g_object_unref(io);
+  inf_deinit();
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,489 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks that the request log written next to a text document restores
+ * undo history when the document is read back, and that a missing, stale
+ * or inconsistent request log is ignored instead of failing the load. */
+
+#include <libinftext/inf-text-filesystem-format.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-user.h>
+#include <libinfinity/server/infd-filesystem-storage.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-file-util.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <glib/gstdio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATH "/document"
+
+typedef struct _InfTestTextFilesystemFormat InfTestTextFilesystemFormat;
+struct _InfTestTextFilesystemFormat {
+  gchar* root;
+  InfdFilesystemStorage* storage;
+  InfCommunicationManager* manager;
+  InfIo* io;
+};
+
+static gchar*
+inf_test_text_filesystem_format_get_text(InfTextSession* session)
+{
+  InfTextBuffer* buffer;
+  InfTextChunk* chunk;
+  gchar* text;
+  gsize bytes;
+
+  buffer = INF_TEXT_BUFFER(inf_session_get_buffer(INF_SESSION(session)));
+  chunk = inf_text_buffer_get_slice(
+    buffer,
+    0,
+    inf_text_buffer_get_length(buffer)
+  );
+
+  text = inf_text_chunk_get_text(chunk, &bytes);
+  inf_text_chunk_free(chunk);
+
+  text = g_realloc(text, bytes + 1);
+  text[bytes] = '\0';
+  return text;
+}
+
+static gboolean
+inf_test_text_filesystem_format_expect_text(InfTextSession* session,
+                                            const gchar* expected)
+{
+  gchar* text;
+  gboolean result;
+
+  text = inf_test_text_filesystem_format_get_text(session);
+  result = (strcmp(text, expected) == 0);
+
+  if(!result)
+    printf(" Text is \"%s\" instead of \"%s\"\n", text, expected);
+
+  g_free(text);
+  return result;
+}
+
+/* Writes a document with two requests by a single user, and its request
+ * log. */
+static gboolean
+inf_test_text_filesystem_format_write(InfTestTextFilesystemFormat* test)
+{
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+  InfTextSession* session;
+  InfUser* user;
+  GError* error;
+  gboolean result;
+
+  user_table = inf_user_table_new();
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+  user = INF_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", 1,
+      "name", "Alice",
+      "hue", 0.5,
+      "status", INF_USER_ACTIVE,
+      "flags", INF_USER_LOCAL,
+      NULL
+    )
+  );
+
+  inf_user_table_add_user(user_table, user);
+  g_object_unref(user);
+
+  session = inf_text_session_new_with_user_table(
+    test->manager,
+    buffer,
+    test->io,
+    user_table,
+    INF_SESSION_RUNNING,
+    NULL,
+    NULL
+  );
+
+  inf_text_buffer_insert_text(buffer, 0, "Hello", 5, 5, user);
+  inf_text_buffer_insert_text(buffer, 5, " World", 6, 6, user);
+
+  error = NULL;
+  result = inf_text_filesystem_format_write(
+    test->storage,
+    PATH,
+    user_table,
+    buffer,
+    &error
+  );
+
+  if(result)
+  {
+    result = inf_text_filesystem_format_write_request_log(
+      test->storage,
+      PATH,
+      session,
+      &error
+    );
+  }
+
+  if(!result)
+  {
+    printf(" Failed to write session: %s\n", error->message);
+    g_error_free(error);
+  }
+
+  inf_session_close(INF_SESSION(session));
+  g_object_unref(session);
+  g_object_unref(user_table);
+  g_object_unref(buffer);
+  return result;
+}
+
+/* Reads the document back, and checks that its content is unchanged, and
+ * whether Alice can undo her last request. */
+static gboolean
+inf_test_text_filesystem_format_read(InfTestTextFilesystemFormat* test,
+                                     const gchar* text,
+                                     gboolean can_undo)
+{
+  InfTextSession* session;
+  InfAdoptedAlgorithm* algorithm;
+  InfUser* user;
+  GError* error;
+  gboolean result;
+
+  error = NULL;
+  session = inf_text_filesystem_format_read_session(
+    test->storage,
+    PATH,
+    test->manager,
+    test->io,
+    &error
+  );
+
+  if(session == NULL)
+  {
+    printf(" Failed to read session: %s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  result = inf_test_text_filesystem_format_expect_text(session, text);
+
+  user = inf_user_table_lookup_user_by_name(
+    inf_session_get_user_table(INF_SESSION(session)),
+    "Alice"
+  );
+
+  if(result && user == NULL)
+  {
+    printf(" User \"Alice\" was not restored\n");
+    result = FALSE;
+  }
+
+  if(result)
+  {
+    /* Rejoin, as the server does when the user joins again */
+    g_object_set(G_OBJECT(user), "flags", INF_USER_LOCAL, NULL);
+    g_object_set(G_OBJECT(user), "status", INF_USER_ACTIVE, NULL);
+
+    algorithm =
+      inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session));
+
+    if(inf_adopted_algorithm_can_undo(algorithm, INF_ADOPTED_USER(user)) !=
+       can_undo)
+    {
+      printf(
+        can_undo ? " Undo is not possible after reading the session\n"
+                 : " Undo is possible without a request log\n"
+      );
+
+      result = FALSE;
+    }
+    else if(can_undo)
+    {
+      inf_adopted_session_undo(
+        INF_ADOPTED_SESSION(session),
+        INF_ADOPTED_USER(user),
+        1
+      );
+
+      result = inf_test_text_filesystem_format_expect_text(session, "Hello");
+    }
+  }
+
+  inf_session_close(INF_SESSION(session));
+  g_object_unref(session);
+  return result;
+}
+
+static gchar*
+inf_test_text_filesystem_format_log_path(InfTestTextFilesystemFormat* test)
+{
+  gchar* path;
+
+  path = infd_filesystem_storage_get_path(
+    test->storage,
+    "InfText.log",
+    PATH,
+    NULL
+  );
+
+  g_assert(path != NULL);
+  return path;
+}
+
+static gboolean
+inf_test_text_filesystem_format_round_trip(InfTestTextFilesystemFormat* test)
+{
+  printf("round-trip...");
+
+  if(!inf_test_text_filesystem_format_write(test))
+    return FALSE;
+  if(!inf_test_text_filesystem_format_read(test, "Hello World", TRUE))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+static gboolean
+inf_test_text_filesystem_format_missing(InfTestTextFilesystemFormat* test)
+{
+  gchar* log_path;
+
+  printf("missing-log...");
+
+  if(!inf_test_text_filesystem_format_write(test))
+    return FALSE;
+
+  log_path = inf_test_text_filesystem_format_log_path(test);
+  g_unlink(log_path);
+  g_free(log_path);
+
+  if(!inf_test_text_filesystem_format_read(test, "Hello World", FALSE))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+static gboolean
+inf_test_text_filesystem_format_stale(InfTestTextFilesystemFormat* test)
+{
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+  GError* error;
+  gboolean result;
+
+  printf("stale-log...");
+
+  if(!inf_test_text_filesystem_format_write(test))
+    return FALSE;
+
+  /* Overwrite the document without updating the log, as if it had been
+   * edited by another program in between. */
+  user_table = inf_user_table_new();
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  error = NULL;
+
+  result = inf_text_filesystem_format_read(
+    test->storage,
+    PATH,
+    user_table,
+    buffer,
+    &error
+  );
+
+  if(result)
+  {
+    inf_text_buffer_insert_text(
+      buffer,
+      11,
+      "!",
+      1,
+      1,
+      inf_user_table_lookup_user_by_id(user_table, 1)
+    );
+
+    result = inf_text_filesystem_format_write(
+      test->storage,
+      PATH,
+      user_table,
+      buffer,
+      &error
+    );
+  }
+
+  g_object_unref(user_table);
+  g_object_unref(buffer);
+
+  if(!result)
+  {
+    printf(" Failed to modify document: %s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  if(!inf_test_text_filesystem_format_read(test, "Hello World!", FALSE))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+static gboolean
+inf_test_text_filesystem_format_inconsistent(InfTestTextFilesystemFormat* t)
+{
+  gchar* log_path;
+  gchar* content;
+  gchar** parts;
+  gchar* modified;
+  GError* error;
+  gboolean result;
+
+  printf("inconsistent-log...");
+
+  if(!inf_test_text_filesystem_format_write(t))
+    return FALSE;
+
+  /* The checksum still matches the document, but the user in the log does
+   * not match the one in the document anymore. */
+  log_path = inf_test_text_filesystem_format_log_path(t);
+  error = NULL;
+
+  result = g_file_get_contents(log_path, &content, NULL, &error);
+  if(result)
+  {
+    parts = g_strsplit(content, "name=\"Alice\"", -1);
+    modified = g_strjoinv("name=\"Mallory\"", parts);
+    result = g_file_set_contents(log_path, modified, -1, &error);
+
+    g_free(modified);
+    g_strfreev(parts);
+    g_free(content);
+  }
+
+  g_free(log_path);
+
+  if(!result)
+  {
+    printf(" Failed to modify request log: %s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  if(!inf_test_text_filesystem_format_read(t, "Hello World", FALSE))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+static gboolean
+inf_test_text_filesystem_format_corrupt(InfTestTextFilesystemFormat* test)
+{
+  gchar* log_path;
+  GError* error;
+  gboolean result;
+
+  printf("corrupt-log...");
+
+  if(!inf_test_text_filesystem_format_write(test))
+    return FALSE;
+
+  log_path = inf_test_text_filesystem_format_log_path(test);
+  error = NULL;
+  result = g_file_set_contents(log_path, "<inf-text-request-log", -1, &error);
+  g_free(log_path);
+
+  if(!result)
+  {
+    printf(" Failed to modify request log: %s\n", error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+
+  if(!inf_test_text_filesystem_format_read(test, "Hello World", FALSE))
+    return FALSE;
+
+  printf(" OK\n");
+  return TRUE;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  InfTestTextFilesystemFormat test;
+  GError* error;
+  int res;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  test.root = g_dir_make_tmp("inf-test-text-filesystem-format-XXXXXX", &error);
+  if(test.root == NULL)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    inf_deinit();
+    return EXIT_FAILURE;
+  }
+
+  test.storage = infd_filesystem_storage_new(test.root);
+  test.manager = inf_communication_manager_new();
+  test.io = INF_IO(inf_standalone_io_new());
+
+  res = EXIT_SUCCESS;
+  if(!inf_test_text_filesystem_format_round_trip(&test)) res = EXIT_FAILURE;
+  if(!inf_test_text_filesystem_format_missing(&test)) res = EXIT_FAILURE;
+  if(!inf_test_text_filesystem_format_stale(&test)) res = EXIT_FAILURE;
+  if(!inf_test_text_filesystem_format_inconsistent(&test))
+    res = EXIT_FAILURE;
+  if(!inf_test_text_filesystem_format_corrupt(&test)) res = EXIT_FAILURE;
+
+  g_object_unref(test.io);
+  g_object_unref(test.manager);
+  g_object_unref(test.storage);
+
+  if(!inf_file_util_delete(test.root, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+  }
+
+  g_free(test.root);
+  inf_deinit();
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,316 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks how InfTimingPolicy derives its effective values from round trip
+ * time and load, and that InfCommunicationManager hands its policy on. */
+
+#include <libinfinity/communication/inf-communication-manager.h>
+#include <libinfinity/common/inf-timing-policy.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct _InfTestTimingPolicyValues InfTestTimingPolicyValues;
+struct _InfTestTimingPolicyValues {
+  guint save_timeout;
+  guint noop_interval;
+  guint caret_update_interval;
+  guint inner_queue_limit;
+};
+
+static gboolean
+inf_test_timing_policy_expect(InfTimingPolicy* policy,
+                              guint save_timeout,
+                              guint noop_interval,
+                              guint caret_update_interval,
+                              guint inner_queue_limit)
+{
+  InfTestTimingPolicyValues actual;
+
+  actual.save_timeout = inf_timing_policy_get_save_timeout(policy);
+  actual.noop_interval = inf_timing_policy_get_noop_interval(policy);
+  actual.caret_update_interval =
+    inf_timing_policy_get_caret_update_interval(policy);
+  actual.inner_queue_limit = inf_timing_policy_get_inner_queue_limit(policy);
+
+  if(actual.save_timeout != save_timeout ||
+     actual.noop_interval != noop_interval ||
+     actual.caret_update_interval != caret_update_interval ||
+     actual.inner_queue_limit != inner_queue_limit)
+  {
+    printf(
+      " Effective values are %u/%u/%u/%u instead of %u/%u/%u/%u\n",
+      actual.save_timeout,
+      actual.noop_interval,
+      actual.caret_update_interval,
+      actual.inner_queue_limit,
+      save_timeout,
+      noop_interval,
+      caret_update_interval,
+      inner_queue_limit
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+inf_test_timing_policy_notify_cb(GObject* object,
+                                 GParamSpec* pspec,
+                                 gpointer user_data)
+{
+  ++*(guint*)user_data;
+}
+
+static gboolean
+inf_test_timing_policy_fixed(void)
+{
+  InfTimingPolicy* policy;
+  gboolean adaptive;
+  gboolean result;
+
+  printf("fixed...");
+
+  /* Policies are not adaptive unless asked to be, so measurements do not
+   * change anything. */
+  policy = inf_timing_policy_new();
+  g_object_get(G_OBJECT(policy), "adaptive", &adaptive, NULL);
+
+  result = TRUE;
+  if(adaptive)
+  {
+    printf(" Policy is adaptive by default\n");
+    result = FALSE;
+  }
+
+  inf_timing_policy_add_round_trip_time(policy, 500000);
+  inf_timing_policy_set_load(policy, 1000);
+
+  result = result &&
+    inf_test_timing_policy_expect(policy, 60000, 30, 0, 5);
+
+  if(result) printf(" OK\n");
+
+  g_object_unref(policy);
+  return result;
+}
+
+static gboolean
+inf_test_timing_policy_load(void)
+{
+  InfTimingPolicy* policy;
+  gboolean result;
+
+  printf("load...");
+
+  policy = inf_timing_policy_new();
+  g_object_set(G_OBJECT(policy), "adaptive", TRUE, NULL);
+
+  /* Below the reference load, the configured values are used */
+  inf_timing_policy_set_load(policy, 99);
+  result = inf_test_timing_policy_expect(policy, 60000, 30, 0, 5);
+
+  /* The no-op interval grows by the configured value for every multiple of
+   * the reference load, and the save timeout shrinks in proportion to the
+   * load once it exceeds the reference load. */
+  inf_timing_policy_set_load(policy, 100);
+  result = result &&
+    inf_test_timing_policy_expect(policy, 60000, 60, 0, 5);
+
+  inf_timing_policy_set_load(policy, 200);
+  result = result &&
+    inf_test_timing_policy_expect(policy, 30000, 90, 0, 5);
+
+  /* Both are bounded */
+  inf_timing_policy_set_load(policy, 100000);
+  result = result &&
+    inf_test_timing_policy_expect(policy, 5000, 120, 0, 5);
+
+  /* A configured save timeout below the minimum is not raised */
+  g_object_set(G_OBJECT(policy), "save-timeout", 1000, NULL);
+  result = result &&
+    inf_test_timing_policy_expect(policy, 1000, 120, 0, 5);
+
+  /* Turning adaptation off goes back to the configured values */
+  g_object_set(G_OBJECT(policy), "adaptive", FALSE, NULL);
+  result = result &&
+    inf_test_timing_policy_expect(policy, 1000, 30, 0, 5);
+
+  if(result) printf(" OK\n");
+
+  g_object_unref(policy);
+  return result;
+}
+
+static gboolean
+inf_test_timing_policy_round_trip_time(void)
+{
+  InfTimingPolicy* policy;
+  guint n_notifies;
+  guint rtt;
+  guint i;
+  gboolean result;
+
+  printf("round-trip-time...");
+
+  policy = inf_timing_policy_new();
+  g_object_set(
+    G_OBJECT(policy),
+    "adaptive", TRUE,
+    "caret-update-interval", 100,
+    NULL
+  );
+
+  n_notifies = 0;
+  g_signal_connect(
+    G_OBJECT(policy),
+    "notify::effective-caret-update-interval",
+    G_CALLBACK(inf_test_timing_policy_notify_cb),
+    &n_notifies
+  );
+
+  /* A sample of zero means unknown and is ignored */
+  inf_timing_policy_add_round_trip_time(policy, 0);
+  result = inf_test_timing_policy_expect(policy, 60000, 30, 100, 5);
+
+  /* The first sample is taken as it is. The caret update interval is
+   * raised to the round trip time, and the inner queue limit grows by the
+   * configured value for every 100ms. */
+  inf_timing_policy_add_round_trip_time(policy, 250000);
+  result = result &&
+    inf_test_timing_policy_expect(policy, 60000, 30, 250, 15);
+
+  /* Further samples are smoothed with a gain of 1/8 */
+  inf_timing_policy_add_round_trip_time(policy, 50000);
+  g_object_get(G_OBJECT(policy), "round-trip-time", &rtt, NULL);
+  if(result && rtt != 225000)
+  {
+    printf(" Smoothed round trip time is %u instead of 225000\n", rtt);
+    result = FALSE;
+  }
+
+  result = result &&
+    inf_test_timing_policy_expect(policy, 60000, 30, 225, 15);
+
+  if(result && n_notifies != 2)
+  {
+    printf(
+      " Effective caret update interval was notified %u times instead "
+      "of 2\n",
+      n_notifies
+    );
+
+    result = FALSE;
+  }
+
+  /* The caret update interval does not go below the configured value */
+  for(i = 0; i < 10; ++i)
+    inf_timing_policy_add_round_trip_time(policy, 1000);
+  result = result &&
+    inf_test_timing_policy_expect(policy, 60000, 30, 100, 5);
+
+  /* The inner queue limit is bounded on very slow links */
+  inf_timing_policy_add_round_trip_time(policy, G_MAXUINT);
+  result = result &&
+    inf_test_timing_policy_expect(
+      policy,
+      60000,
+      30,
+      inf_timing_policy_get_caret_update_interval(policy),
+      64
+    );
+
+  if(result) printf(" OK\n");
+
+  g_object_unref(policy);
+  return result;
+}
+
+static gboolean
+inf_test_timing_policy_manager(void)
+{
+  InfCommunicationManager* manager;
+  InfTimingPolicy* policy;
+  gboolean result;
+
+  printf("manager...");
+
+  manager = inf_communication_manager_new();
+  result = TRUE;
+
+  if(inf_communication_manager_get_timing_policy(manager) !=
+     inf_timing_policy_get_default())
+  {
+    printf(" Communication manager does not use the default policy\n");
+    result = FALSE;
+  }
+
+  policy = inf_timing_policy_new();
+  g_object_set(G_OBJECT(manager), "timing-policy", policy, NULL);
+  if(result && inf_communication_manager_get_timing_policy(manager) != policy)
+  {
+    printf(" Communication manager does not use the policy it was given\n");
+    result = FALSE;
+  }
+
+  g_object_set(G_OBJECT(manager), "timing-policy", NULL, NULL);
+  if(result &&
+     inf_communication_manager_get_timing_policy(manager) !=
+     inf_timing_policy_get_default())
+  {
+    printf(" Unsetting the policy does not restore the default policy\n");
+    result = FALSE;
+  }
+
+  if(result) printf(" OK\n");
+
+  g_object_unref(policy);
+  g_object_unref(manager);
+  return result;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  GError* error;
+  int res;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  res = EXIT_SUCCESS;
+  if(!inf_test_timing_policy_fixed()) res = EXIT_FAILURE;
+  if(!inf_test_timing_policy_load()) res = EXIT_FAILURE;
+  if(!inf_test_timing_policy_round_trip_time()) res = EXIT_FAILURE;
+  if(!inf_test_timing_policy_manager()) res = EXIT_FAILURE;
+
+  inf_deinit();
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,317 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks that the name index of InfUserTable follows users being added,
+ * renamed and removed, also with many users as in a mass join. */
+
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_USERS 1000
+
+static InfUser*
+inf_test_user_table_add(InfUserTable* user_table,
+                        guint id,
+                        const gchar* name,
+                        InfUserFlags flags)
+{
+  InfUser* user;
+
+  user = INF_USER(
+    g_object_new(
+      INF_TYPE_USER,
+      "id", id,
+      "name", name,
+      "status", INF_USER_ACTIVE,
+      "flags", flags,
+      NULL
+    )
+  );
+
+  inf_user_table_add_user(user_table, user);
+  g_object_unref(user);
+  return user;
+}
+
+static gboolean
+inf_test_user_table_expect(InfUserTable* user_table,
+                           const gchar* name,
+                           InfUser* expected)
+{
+  InfUser* user;
+  user = inf_user_table_lookup_user_by_name(user_table, name);
+
+  if(user != expected)
+  {
+    printf(
+      " Lookup of \"%s\" returned user %d instead of user %d\n",
+      name,
+      user != NULL ? (gint)inf_user_get_id(user) : -1,
+      expected != NULL ? (gint)inf_user_get_id(expected) : -1
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+inf_test_user_table_count_func(InfUser* user,
+                               gpointer user_data)
+{
+  ++*(guint*)user_data;
+}
+
+static gboolean
+inf_test_user_table_rename(void)
+{
+  InfUserTable* user_table;
+  InfUser* alice;
+  InfUser* bob;
+  gboolean result;
+
+  printf("rename...");
+
+  user_table = inf_user_table_new();
+  alice = inf_test_user_table_add(user_table, 1, "Alice", 0);
+  bob = inf_test_user_table_add(user_table, 2, "Bob", 0);
+
+  result =
+    inf_test_user_table_expect(user_table, "Alice", alice) &&
+    inf_test_user_table_expect(user_table, "Bob", bob);
+
+  /* The old name is free after the rename, and the user is found under the
+   * new one. */
+  g_object_set(G_OBJECT(alice), "name", "Carol", NULL);
+  result = result &&
+    inf_test_user_table_expect(user_table, "Alice", NULL) &&
+    inf_test_user_table_expect(user_table, "Carol", alice) &&
+    inf_test_user_table_expect(user_table, "Bob", bob);
+
+  /* The freed name can be taken by another user */
+  g_object_set(G_OBJECT(bob), "name", "Alice", NULL);
+  result = result &&
+    inf_test_user_table_expect(user_table, "Alice", bob) &&
+    inf_test_user_table_expect(user_table, "Bob", NULL);
+
+  /* Lookups are case-sensitive */
+  result = result &&
+    inf_test_user_table_expect(user_table, "carol", NULL);
+
+  if(result) printf(" OK\n");
+
+  g_object_unref(user_table);
+  return result;
+}
+
+static gboolean
+inf_test_user_table_remove(void)
+{
+  InfUserTable* user_table;
+  InfUser* alice;
+  InfUser* bob;
+  gboolean result;
+
+  printf("remove...");
+
+  user_table = inf_user_table_new();
+  alice = inf_test_user_table_add(user_table, 1, "Alice", INF_USER_LOCAL);
+  bob = inf_test_user_table_add(user_table, 2, "Bob", 0);
+
+  /* Keep the user alive after removal, to check that renaming it does not
+   * affect the table anymore. */
+  g_object_ref(alice);
+  inf_user_table_remove_user(user_table, alice);
+
+  result =
+    inf_test_user_table_expect(user_table, "Alice", NULL) &&
+    inf_test_user_table_expect(user_table, "Bob", bob) &&
+    inf_user_table_lookup_user_by_id(user_table, 1) == NULL;
+
+  g_object_set(G_OBJECT(alice), "name", "Bob2", NULL);
+  result = result &&
+    inf_test_user_table_expect(user_table, "Bob2", NULL);
+
+  /* A renamed user that is removed frees its new name, not its old one */
+  g_object_set(G_OBJECT(bob), "name", "Dave", NULL);
+  inf_user_table_remove_user(user_table, bob);
+  result = result &&
+    inf_test_user_table_expect(user_table, "Bob", NULL) &&
+    inf_test_user_table_expect(user_table, "Dave", NULL);
+
+  if(result) printf(" OK\n");
+
+  g_object_unref(alice);
+  g_object_unref(user_table);
+  return result;
+}
+
+static gboolean
+inf_test_user_table_duplicate(void)
+{
+  InfUserTable* user_table;
+  InfUser* first;
+  InfUser* second;
+  InfUser* found;
+  gboolean result;
+
+  printf("duplicate...");
+
+  /* Names should be unique, but the table must not lose track of users if
+   * they are not. */
+  user_table = inf_user_table_new();
+  first = inf_test_user_table_add(user_table, 1, "Alice", 0);
+  second = inf_test_user_table_add(user_table, 2, "Alice", 0);
+
+  found = inf_user_table_lookup_user_by_name(user_table, "Alice");
+  result = found == first || found == second;
+  if(!result)
+    printf(" Neither user with a duplicate name is found\n");
+
+  /* When one leaves the index, the other one takes its place */
+  g_object_set(G_OBJECT(found), "name", "Bob", NULL);
+  result = result &&
+    inf_test_user_table_expect(user_table, "Bob", found) &&
+    inf_test_user_table_expect(
+      user_table,
+      "Alice",
+      found == first ? second : first
+    );
+
+  if(result) printf(" OK\n");
+
+  g_object_unref(user_table);
+  return result;
+}
+
+static gboolean
+inf_test_user_table_mass_join(void)
+{
+  InfUserTable* user_table;
+  InfUser** users;
+  gchar* name;
+  guint n_local;
+  guint i;
+  gboolean result;
+
+  printf("mass-join...");
+
+  user_table = inf_user_table_new();
+  users = g_new(InfUser*, N_USERS);
+
+  for(i = 0; i < N_USERS; ++i)
+  {
+    name = g_strdup_printf("User_%u", i);
+    users[i] = inf_test_user_table_add(
+      user_table,
+      i + 1,
+      name,
+      (i % 5 == 0) ? INF_USER_LOCAL : 0
+    );
+
+    g_free(name);
+  }
+
+  /* Every other user leaves, and every third one is renamed */
+  for(i = 0; i < N_USERS; i += 2)
+    g_object_set(G_OBJECT(users[i]), "status", INF_USER_UNAVAILABLE, NULL);
+
+  for(i = 0; i < N_USERS; i += 3)
+  {
+    name = g_strdup_printf("Renamed_%u", i);
+    g_object_set(G_OBJECT(users[i]), "name", name, NULL);
+    g_free(name);
+  }
+
+  result = TRUE;
+  for(i = 0; i < N_USERS && result; ++i)
+  {
+    name = g_strdup_printf("User_%u", i);
+    result = inf_test_user_table_expect(
+      user_table,
+      name,
+      (i % 3 == 0) ? NULL : users[i]
+    );
+    g_free(name);
+
+    if(result && i % 3 == 0)
+    {
+      name = g_strdup_printf("Renamed_%u", i);
+      result = inf_test_user_table_expect(user_table, name, users[i]);
+      g_free(name);
+    }
+  }
+
+  /* Only local users that are still available are iterated, i.e. those
+   * with an odd index */
+  n_local = 0;
+  inf_user_table_foreach_local_user(
+    user_table,
+    inf_test_user_table_count_func,
+    &n_local
+  );
+
+  if(result && n_local != N_USERS / 10)
+  {
+    printf(
+      " %u local users are available, expected %u\n",
+      n_local,
+      N_USERS / 10
+    );
+
+    result = FALSE;
+  }
+
+  if(result) printf(" OK\n");
+
+  g_free(users);
+  g_object_unref(user_table);
+  return result;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  GError* error;
+  int res;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  res = EXIT_SUCCESS;
+  if(!inf_test_user_table_rename()) res = EXIT_FAILURE;
+  if(!inf_test_user_table_remove()) res = EXIT_FAILURE;
+  if(!inf_test_user_table_duplicate()) res = EXIT_FAILURE;
+  if(!inf_test_user_table_mass_join()) res = EXIT_FAILURE;
+
+  inf_deinit();
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */
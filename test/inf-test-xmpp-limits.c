@@ -0,0 +1,452 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2015 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Checks that InfXmppConnection terminates the stream when it receives a
+ * stanza exceeding the maximum stanza size or nesting depth, and that it
+ * keeps the stream open for stanzas within the limits. The client and the
+ * server are connected via the loopback interface. */
+
+#include <libinfinity/server/infd-xmpp-server.h>
+#include <libinfinity/server/infd-xml-server.h>
+#include <libinfinity/server/infd-tcp-server.h>
+#include <libinfinity/common/inf-xmpp-connection.h>
+#include <libinfinity/common/inf-tcp-connection.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-ip-address.h>
+#include <libinfinity/common/inf-init.h>
+#include <libinfinity/inf-signals.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Time in milliseconds after which a test gives up waiting */
+#define INF_TEST_XMPP_LIMITS_WAIT 5000
+
+#define INF_TEST_XMPP_LIMITS_MAX_SIZE 4096
+#define INF_TEST_XMPP_LIMITS_MAX_DEPTH 8
+
+typedef struct _InfTestXmppLimits InfTestXmppLimits;
+struct _InfTestXmppLimits {
+  InfStandaloneIo* io;
+  guint port;
+
+  /* Server side of the connection currently being tested */
+  InfXmlConnection* connection;
+  guint n_received;
+  guint n_errors;
+  GError* error;
+};
+
+static void
+inf_test_xmpp_limits_received_cb(InfXmlConnection* connection,
+                                 xmlNodePtr xml,
+                                 gpointer user_data)
+{
+  InfTestXmppLimits* test;
+  test = (InfTestXmppLimits*)user_data;
+
+  if(strcmp((const char*)xml->name, "message") == 0)
+    ++test->n_received;
+}
+
+static void
+inf_test_xmpp_limits_error_cb(InfXmlConnection* connection,
+                              const GError* error,
+                              gpointer user_data)
+{
+  InfTestXmppLimits* test;
+  test = (InfTestXmppLimits*)user_data;
+
+  if(test->error == NULL)
+    test->error = g_error_copy(error);
+  ++test->n_errors;
+}
+
+static void
+inf_test_xmpp_limits_new_connection_cb(InfdXmlServer* server,
+                                       InfXmlConnection* connection,
+                                       gpointer user_data)
+{
+  InfTestXmppLimits* test;
+  test = (InfTestXmppLimits*)user_data;
+
+  g_assert(test->connection == NULL);
+  test->connection = connection;
+  g_object_ref(connection);
+
+  g_object_set(
+    G_OBJECT(connection),
+    "max-stanza-size", INF_TEST_XMPP_LIMITS_MAX_SIZE,
+    "max-stanza-depth", INF_TEST_XMPP_LIMITS_MAX_DEPTH,
+    NULL
+  );
+
+  g_signal_connect(
+    G_OBJECT(connection),
+    "received",
+    G_CALLBACK(inf_test_xmpp_limits_received_cb),
+    test
+  );
+
+  g_signal_connect(
+    G_OBJECT(connection),
+    "error",
+    G_CALLBACK(inf_test_xmpp_limits_error_cb),
+    test
+  );
+}
+
+static InfXmlConnectionStatus
+inf_test_xmpp_limits_get_status(InfXmlConnection* connection)
+{
+  InfXmlConnectionStatus status;
+  g_object_get(G_OBJECT(connection), "status", &status, NULL);
+  return status;
+}
+
+/* Runs the IO until the client connection is open and the server has
+ * accepted it, or until the waiting time is over. */
+static gboolean
+inf_test_xmpp_limits_wait_open(InfTestXmppLimits* test,
+                               InfXmlConnection* client)
+{
+  gint64 deadline;
+
+  deadline = g_get_monotonic_time() + INF_TEST_XMPP_LIMITS_WAIT * 1000;
+  while(g_get_monotonic_time() < deadline)
+  {
+    if(test->connection != NULL &&
+       inf_test_xmpp_limits_get_status(test->connection) ==
+       INF_XML_CONNECTION_OPEN &&
+       inf_test_xmpp_limits_get_status(client) == INF_XML_CONNECTION_OPEN)
+    {
+      return TRUE;
+    }
+
+    if(inf_test_xmpp_limits_get_status(client) == INF_XML_CONNECTION_CLOSED)
+      return FALSE;
+
+    inf_standalone_io_iteration_timeout(test->io, 50);
+  }
+
+  return FALSE;
+}
+
+/* Runs the IO until the server has either received a message or closed the
+ * connection, or until the waiting time is over. */
+static void
+inf_test_xmpp_limits_wait_result(InfTestXmppLimits* test)
+{
+  gint64 deadline;
+
+  deadline = g_get_monotonic_time() + INF_TEST_XMPP_LIMITS_WAIT * 1000;
+  while(test->n_received == 0 &&
+        inf_test_xmpp_limits_get_status(test->connection) ==
+        INF_XML_CONNECTION_OPEN &&
+        g_get_monotonic_time() < deadline)
+  {
+    inf_standalone_io_iteration_timeout(test->io, 50);
+  }
+}
+
+/* Returns a <message> stanza with depth nested elements in total, and
+ * text_size bytes of text in the innermost one. */
+static xmlNodePtr
+inf_test_xmpp_limits_make_stanza(guint depth,
+                                 gsize text_size)
+{
+  xmlNodePtr stanza;
+  xmlNodePtr cur;
+  gchar* text;
+  guint i;
+
+  stanza = xmlNewNode(NULL, (const xmlChar*)"message");
+
+  cur = stanza;
+  for(i = 1; i < depth; ++i)
+    cur = xmlNewChild(cur, NULL, (const xmlChar*)"body", NULL);
+
+  if(text_size > 0)
+  {
+    text = g_malloc(text_size + 1);
+    memset(text, 'x', text_size);
+    text[text_size] = '\0';
+    xmlNodeAddContent(cur, (const xmlChar*)text);
+    g_free(text);
+  }
+
+  return stanza;
+}
+
+/* Sends stanza from a new client connection, and checks that the server
+ * either processes it and keeps the connection open, or rejects it with a
+ * policy violation and closes the connection. */
+static gboolean
+inf_test_xmpp_limits_run(InfTestXmppLimits* test,
+                         const gchar* name,
+                         xmlNodePtr stanza,
+                         gboolean expect_accept)
+{
+  InfIpAddress* address;
+  InfTcpConnection* tcp;
+  InfXmppConnection* client;
+  InfXmlConnectionStatus status;
+  GError* error;
+  gboolean result;
+
+  printf("%s...", name);
+
+  test->connection = NULL;
+  test->n_received = 0;
+  test->n_errors = 0;
+  test->error = NULL;
+
+  address = inf_ip_address_new_loopback4();
+  error = NULL;
+
+  tcp = inf_tcp_connection_new_and_open(
+    INF_IO(test->io),
+    address,
+    test->port,
+    &error
+  );
+
+  inf_ip_address_free(address);
+
+  if(tcp == NULL)
+  {
+    printf(" %s\n", error->message);
+    g_error_free(error);
+    xmlFreeNode(stanza);
+    return FALSE;
+  }
+
+  client = inf_xmpp_connection_new(
+    tcp,
+    INF_XMPP_CONNECTION_CLIENT,
+    NULL,
+    "localhost",
+    INF_XMPP_CONNECTION_SECURITY_ONLY_UNSECURED,
+    NULL,
+    NULL,
+    NULL
+  );
+
+  g_object_unref(tcp);
+
+  result = TRUE;
+  if(!inf_test_xmpp_limits_wait_open(test, INF_XML_CONNECTION(client)))
+  {
+    printf(" Connection could not be established\n");
+    xmlFreeNode(stanza);
+    result = FALSE;
+  }
+  else
+  {
+    inf_xml_connection_send(INF_XML_CONNECTION(client), stanza);
+    inf_test_xmpp_limits_wait_result(test);
+
+    status = inf_test_xmpp_limits_get_status(test->connection);
+    if(expect_accept)
+    {
+      if(test->n_received != 1)
+      {
+        printf(" Stanza within the limits was not received\n");
+        result = FALSE;
+      }
+      else if(test->n_errors > 0 || status != INF_XML_CONNECTION_OPEN)
+      {
+        printf(" Stanza within the limits closed the connection\n");
+        result = FALSE;
+      }
+    }
+    else
+    {
+      if(test->n_received != 0)
+      {
+        printf(" Stanza exceeding the limits was processed\n");
+        result = FALSE;
+      }
+      else if(status == INF_XML_CONNECTION_OPEN)
+      {
+        printf(" Stanza exceeding the limits did not close the connection\n");
+        result = FALSE;
+      }
+      else if(test->error == NULL ||
+              test->error->code !=
+              INF_XMPP_CONNECTION_STREAM_ERROR_POLICY_VIOLATION ||
+              test->error->domain != g_quark_from_static_string(
+                "INF_XMPP_CONNECTION_STREAM_ERROR"))
+      {
+        printf(" Connection was not closed with a policy violation\n");
+        result = FALSE;
+      }
+    }
+  }
+
+  if(result) printf(" OK\n");
+
+  if(inf_test_xmpp_limits_get_status(INF_XML_CONNECTION(client)) ==
+     INF_XML_CONNECTION_OPEN)
+  {
+    inf_xml_connection_close(INF_XML_CONNECTION(client));
+  }
+
+  g_object_unref(client);
+
+  if(test->connection != NULL)
+  {
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(test->connection),
+      G_CALLBACK(inf_test_xmpp_limits_received_cb),
+      test
+    );
+
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(test->connection),
+      G_CALLBACK(inf_test_xmpp_limits_error_cb),
+      test
+    );
+
+    if(inf_test_xmpp_limits_get_status(test->connection) ==
+       INF_XML_CONNECTION_OPEN)
+    {
+      inf_xml_connection_close(test->connection);
+    }
+
+    g_object_unref(test->connection);
+    test->connection = NULL;
+  }
+
+  if(test->error != NULL)
+  {
+    g_error_free(test->error);
+    test->error = NULL;
+  }
+
+  return result;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  InfTestXmppLimits test;
+  InfIpAddress* address;
+  InfdTcpServer* server;
+  InfdXmppServer* xmpp;
+  GError* error;
+  int res;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  test.io = inf_standalone_io_new();
+  test.connection = NULL;
+  test.error = NULL;
+
+  address = inf_ip_address_new_loopback4();
+  server = g_object_new(
+    INFD_TYPE_TCP_SERVER,
+    "io", test.io,
+    "local-address", address,
+    "local-port", 0,
+    NULL
+  );
+  inf_ip_address_free(address);
+
+  if(infd_tcp_server_open(server, &error) == FALSE)
+  {
+    fprintf(stderr, "Could not open server: %s\n", error->message);
+    g_error_free(error);
+    g_object_unref(server);
+    g_object_unref(test.io);
+    inf_deinit();
+    return EXIT_FAILURE;
+  }
+
+  g_object_get(G_OBJECT(server), "local-port", &test.port, NULL);
+
+  xmpp = infd_xmpp_server_new(
+    server,
+    INF_XMPP_CONNECTION_SECURITY_ONLY_UNSECURED,
+    NULL,
+    NULL,
+    NULL
+  );
+
+  g_signal_connect(
+    G_OBJECT(xmpp),
+    "new-connection",
+    G_CALLBACK(inf_test_xmpp_limits_new_connection_cb),
+    &test
+  );
+
+  res = EXIT_SUCCESS;
+
+  /* Stanzas right at the limits are still accepted */
+  if(!inf_test_xmpp_limits_run(
+       &test,
+       "normal",
+       inf_test_xmpp_limits_make_stanza(INF_TEST_XMPP_LIMITS_MAX_DEPTH, 1024),
+       TRUE))
+  {
+    res = EXIT_FAILURE;
+  }
+
+  if(!inf_test_xmpp_limits_run(
+       &test,
+       "oversize",
+       inf_test_xmpp_limits_make_stanza(2, 2 * INF_TEST_XMPP_LIMITS_MAX_SIZE),
+       FALSE))
+  {
+    res = EXIT_FAILURE;
+  }
+
+  if(!inf_test_xmpp_limits_run(
+       &test,
+       "overdeep",
+       inf_test_xmpp_limits_make_stanza(INF_TEST_XMPP_LIMITS_MAX_DEPTH + 1, 0),
+       FALSE))
+  {
+    res = EXIT_FAILURE;
+  }
+
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(xmpp),
+    G_CALLBACK(inf_test_xmpp_limits_new_connection_cb),
+    &test
+  );
+
+  g_object_unref(xmpp);
+  infd_tcp_server_close(server);
+  g_object_unref(server);
+  g_object_unref(test.io);
+
+  inf_deinit();
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */